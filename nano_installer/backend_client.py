@@ -0,0 +1,304 @@
+import os
+import socket
+import struct
+import subprocess
+import tempfile
+
+from nano_installer.constants import BACKEND_PATH
+
+# Must match DAEMON_SOCKET_DIR, DAEMON_READY_PREFIX and STATUS_PREFIX in src/nano_backend.h
+DAEMON_SOCKET_DIR = "/run/nano-installer"
+DAEMON_READY_PREFIX = "[NANO_DAEMON_READY]"
+BACKEND_ERROR_PREFIX = "[NANO_BACKEND_ERROR]"
+STATUS_PREFIX = "[NANO_STATUS] "
+
+# Frame header: 1 type byte + 4-byte big-endian payload length (see src/daemon.c)
+_FRAME_HEADER = struct.Struct(">cI")
+
+
+def daemon_socket_path() -> str:
+    """Returns the per-user socket the privileged daemon listens on."""
+    return f"{DAEMON_SOCKET_DIR}/backend-{os.getuid()}.sock"
+
+
+def parse_status_record(record: str) -> dict | None:
+    """
+    Parses one progress record from the backend's status channel:
+    phase, package, percent, ETA in seconds (-1 if unknown) and message, tab-separated.
+    """
+    fields = record.rstrip("\n").split("\t", 4)
+    if len(fields) != 5:
+        return None
+    phase, package, percent, eta, message = fields
+    try:
+        return {"type": "status", "phase": phase, "package": package,
+                "percent": float(percent), "eta": int(eta), "message": message}
+    except ValueError:
+        return None
+
+
+def _recv_exact(sock: socket.socket, size: int) -> bytes | None:
+    data = b""
+    while len(data) < size:
+        chunk = sock.recv(size - len(data))
+        if not chunk:
+            return None
+        data += chunk
+    return data
+
+
+def _connect() -> socket.socket | None:
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    try:
+        sock.connect(daemon_socket_path())
+        return sock
+    except OSError:
+        sock.close()
+        return None
+
+
+class BackendJob:
+    """A single backend command running inside the privileged daemon."""
+
+    def __init__(self, sock: socket.socket, args: list[str]):
+        self._sock = sock
+        self.returncode = None
+        payload = b"".join(str(arg).encode("utf-8") + b"\0" for arg in args)
+        self._sock.sendall(_FRAME_HEADER.pack(b"R", len(payload)) + payload)
+
+    def iter_frames(self):
+        """
+        Yields ("log", line) for output and ("status", record) for progress records as
+        they arrive, and sets returncode when the job ends.
+        """
+        buffer = b""
+        status_buffer = b"" # Records can be split across frames too: the daemon forwards raw pipe reads
+        try:
+            while True:
+                header = _recv_exact(self._sock, _FRAME_HEADER.size)
+                if header is None:
+                    break
+                frame_type, length = _FRAME_HEADER.unpack(header)
+                payload = _recv_exact(self._sock, length) if length else b""
+                if payload is None:
+                    break
+                if frame_type == b"O":
+                    buffer += payload
+                    *lines, buffer = buffer.split(b"\n")
+                    for line in lines:
+                        yield "log", line.decode("utf-8", errors="replace") + "\n"
+                elif frame_type == b"S":
+                    status_buffer += payload
+                    *records, status_buffer = status_buffer.split(b"\n")
+                    for record in records:
+                        if record:
+                            yield "status", record.decode("utf-8", errors="replace")
+                elif frame_type == b"X":
+                    self.returncode = struct.unpack(">i", payload)[0]
+                    break
+        except OSError:
+            pass
+        if buffer:
+            yield "log", buffer.decode("utf-8", errors="replace")
+        if self.returncode is None:
+            self.returncode = -1 # Connection lost before the job reported its exit code
+
+    def cancel(self):
+        """Cancels the job; the daemon stops the job's whole process group when we hang up."""
+        try:
+            self._sock.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+
+    def close(self):
+        self._sock.close()
+
+
+def is_daemon_running() -> bool:
+    sock = _connect()
+    if sock is None:
+        return False
+    sock.close()
+    return True
+
+
+def start_daemon(password: str) -> tuple[int, str]:
+    """
+    Launches the privileged daemon through sudo, authenticating once for the session.
+    Returns (0, output) once the daemon is listening, or the sudo/backend failure.
+    """
+    cmd = ["sudo", "-S", BACKEND_PATH, "daemon"]
+    proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
+    proc.stdin.write(password + '\n')
+    proc.stdin.close()
+
+    output_lines = []
+    for line in proc.stdout:
+        if line.startswith(DAEMON_READY_PREFIX):
+            proc.stdout.close()
+            return 0, "".join(output_lines)
+        output_lines.append(line)
+
+    proc.wait()
+    return proc.returncode or 1, "".join(output_lines)
+
+
+def shutdown_daemon():
+    """Asks a running daemon to exit. Safe to call when none is running."""
+    sock = _connect()
+    if sock is None:
+        return
+    try:
+        sock.sendall(_FRAME_HEADER.pack(b"Q", 0))
+    except OSError:
+        pass
+    finally:
+        sock.close()
+
+
+def run_query(args: list[str], binary: bool = False) -> str | bytes | None:
+    """
+    Runs one of the backend's read-only query commands (e.g. deb-info) as the
+    current user. Returns its stdout (bytes if binary is set), or None if the
+    query failed or the backend is missing or too old to know the command.
+    """
+    text_args = {} if binary else {"text": True, "encoding": "utf-8", "errors": "replace"}
+    try:
+        result = subprocess.run([BACKEND_PATH] + list(args), capture_output=True, **text_args)
+    except OSError:
+        return None
+    if result.returncode != 0:
+        return None
+    return result.stdout
+
+
+def stream_query(args: list[str]):
+    """
+    Runs a query command and yields its stdout line by line as it is produced,
+    for queries that report results incrementally (e.g. leftover-scan). Raises
+    OSError if the backend cannot be started and CalledProcessError if the
+    query fails; closing the generator early terminates the query.
+    """
+    # stderr goes to a file: a query that reports many problems there (one per unreadable
+    # directory, say) would otherwise fill a pipe nobody reads until stdout ends, and stall.
+    with tempfile.TemporaryFile() as errors:
+        proc = subprocess.Popen([BACKEND_PATH] + list(args), stdout=subprocess.PIPE, stderr=errors,
+                                text=True, encoding="utf-8", errors="replace")
+        try:
+            for line in proc.stdout:
+                yield line.rstrip("\n")
+            if proc.wait() != 0:
+                errors.seek(0)
+                stderr = errors.read().decode("utf-8", errors="replace")
+                raise subprocess.CalledProcessError(proc.returncode, proc.args, stderr=stderr)
+        finally:
+            if proc.poll() is None:
+                proc.terminate()
+                proc.wait()
+            proc.stdout.close()
+
+
+def run_sectioned_query(args: list[str], on_status=None) -> dict[str, bytes] | None:
+    """
+    Runs a query whose output is a series of sections, each a "<name> <length>"
+    line followed by that many bytes and a newline (e.g. deb-ingest), and
+    returns the section payloads by name. Status records printed
+    before the sections are parsed and passed to on_status as they arrive.
+    Returns None if the query failed or the backend is missing.
+    """
+    try:
+        proc = subprocess.Popen([BACKEND_PATH] + list(args), stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+    except OSError:
+        return None
+    status_prefix = STATUS_PREFIX.encode()
+    sections = {}
+    with proc:
+        while line := proc.stdout.readline():
+            if line.startswith(status_prefix):
+                record = parse_status_record(line[len(status_prefix):].decode("utf-8", "replace"))
+                if record and on_status:
+                    on_status(record)
+                continue
+            name, _, length = line.decode("utf-8", "replace").rstrip("\n").partition(" ")
+            if not length.isdigit():
+                proc.kill()
+                return None
+            sections[name] = proc.stdout.read(int(length))
+            proc.stdout.read(1) # Section terminator
+    if proc.returncode != 0:
+        return None
+    return sections
+
+
+def _run_with_sudo(args: list[str], password: str, worker=None) -> tuple[int, str]:
+    """One-shot fallback: runs a single backend command through its own sudo call."""
+    cmd = ["sudo", "-S", BACKEND_PATH] + list(args)
+    output_lines = []
+    # Use preexec_fn=os.setsid to create a new process group for safe termination
+    proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
+
+    # Pass the process to the worker thread for cancellation handling
+    if worker: worker.set_process(proc)
+
+    proc.stdin.write(password + '\n')
+    proc.stdin.close()
+
+    while True:
+        # Check for cancellation request
+        if worker and not worker.is_running():
+            # The worker's stop() method handles process termination
+            return -15, "".join(output_lines) # Return SIGTERM code for cancellation
+
+        line = proc.stdout.readline()
+        if not line: break
+        if line.startswith(STATUS_PREFIX):
+            # Without the daemon, progress records share stdout behind a fixed prefix.
+            record = parse_status_record(line[len(STATUS_PREFIX):])
+            if record and worker: worker.progress.emit(record)
+            continue
+        output_lines.append(line)
+        if worker: worker.progress.emit({"type": "log", "line": line})
+
+    proc.wait()
+    return proc.returncode, "".join(output_lines)
+
+
+def run_privileged(args: list[str], password: str, worker=None) -> tuple[int, str]:
+    """
+    Runs a backend command as root and streams its output and progress records
+    to the worker.
+    Jobs go through the session daemon, which is started on first use; if the
+    daemon cannot be started for a reason other than authentication (e.g. an
+    older backend), the command falls back to a one-shot sudo call.
+    Returns (returncode, combined output).
+    """
+    if not is_daemon_running():
+        rc, output = start_daemon(password)
+        if rc != 0:
+            if BACKEND_ERROR_PREFIX in output:
+                return _run_with_sudo(args, password, worker)
+            return rc, output # Authentication failure; the wizard handles the retry
+
+    sock = _connect()
+    if sock is None:
+        return _run_with_sudo(args, password, worker)
+
+    job = BackendJob(sock, args)
+    if worker: worker.set_process(job)
+    output_lines = []
+    try:
+        for kind, text in job.iter_frames():
+            if worker and not worker.is_running():
+                return -15, "".join(output_lines)
+            if kind == "status":
+                record = parse_status_record(text)
+                if record and worker: worker.progress.emit(record)
+                continue
+            output_lines.append(text)
+            if worker: worker.progress.emit({"type": "log", "line": text})
+    finally:
+        job.close()
+
+    if worker and not worker.is_running():
+        return -15, "".join(output_lines)
+    return job.returncode, "".join(output_lines)
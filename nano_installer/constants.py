@@ -1,3 +1,4 @@
+import os
 from pathlib import Path
 
 # --- Constants ---
@@ -16,12 +17,29 @@ def get_backend_path() -> str:
     return BACKEND_PATH_SOURCE
 
 BACKEND_PATH = get_backend_path()
+# Per-user cache directory; the backend keeps its file index here too (FILE_INDEX_CACHE_NAME in src/file_index.h)
+_XDG_CACHE_HOME = os.environ.get("XDG_CACHE_HOME", "")
+USER_CACHE_DIR = (Path(_XDG_CACHE_HOME) if _XDG_CACHE_HOME.startswith("/") else Path.home() / ".cache") / "nano-installer"
+# Most .deb files the backend accepts in one `apt-op install` transaction (MAX_BATCH_DEBS in src/nano_backend.h)
+BACKEND_MAX_BATCH_DEBS = 256
+# Most paths the install wizard's Files tab shows at once; a path prefix narrows the rest down
+FILES_LIST_MAX = 2000
 
 # Icon and Asset Paths
 APP_ICON_NAME = "nano-installer.png"
 APP_ICON_THEME_NAME = "nano-installer" # The name used in .desktop files and themes
 APP_ICON_PATH_INSTALLED = f"/usr/share/nano-installer/assets/{APP_ICON_NAME}"
 APP_ICON_PATH_SOURCE = str(Path(__file__).parent.parent / "assets" / APP_ICON_NAME)
+# Rules for the offline content scan (`deb-scan`, see src/content_scan.c for the format)
+SCAN_RULES_PATH_INSTALLED = "/usr/share/nano-installer/assets/scan-rules.txt"
+SCAN_RULES_PATH_SOURCE = str(Path(__file__).parent.parent / "assets" / "scan-rules.txt")
+
+def get_scan_rules_path() -> str:
+    """Returns the installed rule file if there is one, otherwise the one in the source tree."""
+    if Path(SCAN_RULES_PATH_INSTALLED).exists():
+        return SCAN_RULES_PATH_INSTALLED
+    return SCAN_RULES_PATH_SOURCE
 
 REPORT_ISSUES_URL = "https://github.com/putinservai-cyber/Nano-deb-Installer/issues"
-GITHUB_RELEASES_API = "https://api.github.com/repos/putinservai-cyber/Nano-deb-Installer/releases"
\ No newline at end of file
+GITHUB_RELEASES_API = "https://api.github.com/repos/putinservai-cyber/Nano-deb-Installer/releases"
+VIRUSTOTAL_FILE_REPORT_API = "https://www.virustotal.com/api/v3/files"
\ No newline at end of file
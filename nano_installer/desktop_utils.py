@@ -2,6 +2,8 @@ import subprocess
 import time
 from pathlib import Path
 
+from nano_installer.utils import get_package_files, get_repo_package_info, DESKTOP_FILE_PATTERN
+
 def create_desktop_shortcut(pkg_name: str, log_callback):
     """
     High-level function to create a desktop shortcut for an installed package.
@@ -11,19 +13,13 @@ def create_desktop_shortcut(pkg_name: str, log_callback):
     log_callback(f"\n--- Creating desktop shortcut for {pkg_name} ---")
     try:
         # 1. Find the original .desktop file installed by the package
-        dpkg_cmd = ["dpkg", "-L", pkg_name]
-        dpkg_proc = subprocess.Popen(dpkg_cmd, stdout=subprocess.PIPE, text=True, encoding='utf-8')
-        grep_cmd = ["grep", r'/usr/share/applications/.*\.desktop$']
-        grep_proc = subprocess.Popen(grep_cmd, stdin=dpkg_proc.stdout, stdout=subprocess.PIPE, text=True, encoding='utf-8')
-        dpkg_proc.stdout.close()
-        desktop_files_output, _ = grep_proc.communicate()
-
-        if not desktop_files_output:
+        desktop_files = get_package_files(pkg_name, DESKTOP_FILE_PATTERN)
+
+        if not desktop_files:
             log_callback("[WARNING] No .desktop file found for this package. Creating generic shortcut.")
             _create_generic_shortcut(pkg_name, log_callback)
             return
 
-        desktop_files = [f.strip() for f in desktop_files_output.strip().split('\n') if f.strip()]
         created_shortcuts = []
         
         for desktop_file_path in desktop_files:
@@ -279,13 +275,10 @@ def _create_generic_shortcut(pkg_name: str, log_callback):
         shortcut_path = desktop_dir / f"{safe_filename}.desktop"
         
         description = "Installed application"
-        try:
-            desc_result = subprocess.run(['apt-cache', 'show', pkg_name], capture_output=True, text=True)
-            for line in desc_result.stdout.split('\n'):
-                if line.startswith('Description:'):
-                    description = line.split(':', 1)[1].strip()
-                    break
-        except Exception: pass
+        for stanza in get_repo_package_info(pkg_name, ["Description"]):
+            if stanza.get("Description"):
+                description = stanza["Description"].split('\n', 1)[0]
+                break
         
         content = f"""[Desktop Entry]
 Version=1.0
@@ -311,17 +304,8 @@ X-Creation-Time={int(time.time())}
 
 def _find_shortcuts_from_installed_files(pkg_name: str, desktop_dir: Path, found_paths: set):
     try:
-        dpkg_cmd = ["dpkg", "-L", pkg_name]
-        dpkg_proc = subprocess.Popen(dpkg_cmd, stdout=subprocess.PIPE, text=True, encoding='utf-8')
-        grep_cmd = ["grep", r'/usr/share/applications/.*\.desktop$']
-        grep_proc = subprocess.Popen(grep_cmd, stdin=dpkg_proc.stdout, stdout=subprocess.PIPE, text=True, encoding='utf-8')
-        dpkg_proc.stdout.close()
-        desktop_files_output, _ = grep_proc.communicate()
-        
-        if not desktop_files_output: return
-        
-        for desktop_file_path in desktop_files_output.strip().split('\n'):
-            original_desktop_path = Path(desktop_file_path.strip())
+        for desktop_file_path in get_package_files(pkg_name, DESKTOP_FILE_PATTERN):
+            original_desktop_path = Path(desktop_file_path)
             if not original_desktop_path.is_file(): continue
             
             desktop_info = _parse_complete_desktop_file(original_desktop_path)
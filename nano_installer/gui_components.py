@@ -333,7 +333,7 @@ class OfflinePage(QWidget):
         super().__init__()
         layout = QVBoxLayout(self)
 
-        # A single button to select a .deb file
+        # A single button to select one or more .deb files
         self.btn_select_deb = QPushButton(get_icon("document-open", APP_ICON_PATH_SOURCE), " Select .deb Package...")
         self.btn_select_deb.setMinimumHeight(50) # Make the button more prominent
 
@@ -342,16 +342,24 @@ class OfflinePage(QWidget):
         button_layout.addWidget(self.btn_select_deb)
         button_layout.addStretch()
 
+        drop_hint = QLabel("or drop .deb files here to install them together")
+        drop_hint.setAlignment(Qt.AlignCenter)
+        drop_hint.setEnabled(False) # Render as secondary text
+
         layout.addStretch(1)
         layout.addLayout(button_layout)
+        layout.addWidget(drop_hint)
         layout.addStretch(1)
 
+        # Dropped files are queued into a single batch install
+        self.setAcceptDrops(True)
+
         # Signals
         self.btn_select_deb.clicked.connect(self.on_select_deb)
 
     def on_select_deb(self):
         dialog = QFileDialog(self)
-        dialog.setFileMode(QFileDialog.ExistingFile)
+        dialog.setFileMode(QFileDialog.ExistingFiles)
         dialog.setNameFilter("Debian Packages (*.deb)")
         dialog.setWindowTitle("Select .deb Package")
         dialog.setDirectory(str(Path.home()))
@@ -361,6 +369,24 @@ class OfflinePage(QWidget):
         if dialog.exec_():
             files = dialog.selectedFiles()
             if files:
-                # process_deb_file is imported locally to avoid circular dependency
-                from .main import process_deb_file
-                process_deb_file(files[0], self)
\ No newline at end of file
+                # process_deb_files is imported locally to avoid circular dependency
+                from .main import process_deb_files
+                process_deb_files(files, self)
+
+    @staticmethod
+    def _dropped_deb_paths(mime_data) -> list[str]:
+        if not mime_data.hasUrls():
+            return []
+        return [url.toLocalFile() for url in mime_data.urls()
+                if url.isLocalFile() and url.toLocalFile().endswith(".deb")]
+
+    def dragEnterEvent(self, event):
+        if self._dropped_deb_paths(event.mimeData()):
+            event.acceptProposedAction()
+
+    def dropEvent(self, event):
+        files = self._dropped_deb_paths(event.mimeData())
+        if files:
+            event.acceptProposedAction()
+            from .main import process_deb_files
+            process_deb_files(files, self)
\ No newline at end of file
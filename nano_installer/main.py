@@ -6,6 +6,7 @@ from pathlib import Path
 # This allows the script to be run directly and find the 'nano_installer' package.
 sys.path.insert(0, str(Path(__file__).parent.parent))
 
+import atexit
 import logging
 from urllib.parse import urlparse, unquote
 import subprocess
@@ -26,12 +27,13 @@ from PyQt5.QtWidgets import (
 # Local imports (now absolute)
 from nano_installer.settings import SettingsManager, SettingsPage
 from nano_installer.gui_components import OfflinePage
-from nano_installer.wizards import InstallWizard, UninstallWizard, UpdateCacheWizard, UpgradeSystemWizard
+from nano_installer.wizards import InstallWizard, BatchInstallWizard, UninstallWizard, UpdateCacheWizard, UpgradeSystemWizard
 from nano_installer.donation_page import DonationPage
 from nano_installer.report_page import ReportPage
-from nano_installer.utils import get_deb_info, get_installed_version, compare_versions, is_critical_package, get_nano_installer_package_name, get_icon
+from nano_installer.utils import get_deb_info, get_installed_version, compare_versions_batch, is_critical_package, get_nano_installer_package_name, get_icon
 from nano_installer.constants import APP_NAME, VERSION, BACKEND_PATH, APP_ICON_PATH_INSTALLED, APP_ICON_PATH_SOURCE, APP_ICON_THEME_NAME
 from nano_installer.self_update import check_for_self_update
+from nano_installer.backend_client import shutdown_daemon
 
 # -----------------------
 # Core Logic
@@ -69,8 +71,8 @@ def process_deb_file(path_str: str, parent: QWidget):
         wiz.exec_()
     else:
         # Case 2: It is installed, compare versions
-        is_newer = compare_versions(deb_version, 'gt', installed_version)
-        is_same = compare_versions(deb_version, 'eq', installed_version)
+        is_newer, is_same = compare_versions_batch([(deb_version, 'gt', installed_version),
+                                                    (deb_version, 'eq', installed_version)])
 
         if is_newer:
             # Update
@@ -116,6 +118,65 @@ def process_deb_file(path_str: str, parent: QWidget):
                 wiz = InstallWizard(path, parent, is_downgrade=True, is_extract_mode=is_extract_mode, pkg_name=pkg_name)
                 wiz.exec_()
 
+def process_deb_files(path_strs: list[str], parent: QWidget):
+    """
+    Processes one or more .deb files. A single file goes through the full install
+    flow; several files are queued into one batch transaction.
+    """
+    if len(path_strs) == 1:
+        process_deb_file(path_strs[0], parent)
+        return
+
+    queued = []
+    skipped = []
+    downgrades = [] # (path, package, installed version, version in the file)
+    for path_str in path_strs:
+        path = Path(path_str)
+        deb_info = get_deb_info(path, fields=["Package", "Version"])
+        if not deb_info or not deb_info.get("Package"):
+            skipped.append(f"{path.name}: could not read package information")
+            continue
+        is_critical, critical_reason = is_critical_package(deb_info["Package"])
+        if is_critical:
+            skipped.append(f"{path.name}: {critical_reason}")
+            continue
+        installed_version = get_installed_version(deb_info["Package"])
+        deb_version = deb_info.get("Version", "")
+        if installed_version and deb_version and compare_versions_batch([(deb_version, 'lt', installed_version)])[0]:
+            downgrades.append((path, deb_info["Package"], installed_version, deb_version))
+        queued.append(path)
+
+    # The same confirmation the single-package flow asks for, once for all the roll-backs in the batch.
+    if downgrades:
+        msg_box = QMessageBox(parent)
+        msg_box.setIcon(QMessageBox.Warning)
+        msg_box.setWindowTitle("Older Versions Detected")
+        msg_box.setText("Some of the selected files contain older versions of installed packages.")
+        msg_box.setInformativeText("\n".join(f"{name}: installed {installed}, selected {version}"
+                                              for _path, name, installed, version in downgrades)
+                                   + "\n\nDo you want to roll these packages back?")
+        rollback_button = msg_box.addButton("Roll Back", QMessageBox.AcceptRole)
+        leave_out_button = msg_box.addButton("Leave Them Out", QMessageBox.RejectRole)
+        msg_box.addButton(QMessageBox.Cancel)
+        msg_box.exec_()
+        if msg_box.clickedButton() == leave_out_button:
+            rolled_back = {path for path, *_ in downgrades}
+            queued = [path for path in queued if path not in rolled_back]
+        elif msg_box.clickedButton() != rollback_button:
+            return
+
+    if skipped:
+        QMessageBox.warning(parent, "Some Packages Skipped",
+                            "The following files will not be installed:\n\n" + "\n".join(skipped))
+    if not queued:
+        return
+    if len(queued) == 1:
+        process_deb_file(str(queued[0]), parent)
+        return
+
+    wiz = BatchInstallWizard(queued, parent)
+    wiz.exec_()
+
 # -----------------------
 # Main Application Window
 # -----------------------
@@ -222,7 +283,7 @@ def handle_command_line_args():
     import argparse
     
     parser = argparse.ArgumentParser(description='Nano Installer - Advanced .deb Package Manager')
-    parser.add_argument('file', nargs='?', help='.deb file to install')
+    parser.add_argument('file', nargs='*', help='.deb file(s) to install')
     parser.add_argument('--uninstall', metavar='PACKAGE', help='Uninstall specified package')
     parser.add_argument('--settings', action='store_true', help='Open settings dialog')
     parser.add_argument('--about', action='store_true', help='Show about dialog')
@@ -290,6 +351,9 @@ def main():
     # Initialize QApplication early to show message boxes
     app = QApplication(sys.argv)
 
+    # Don't leave the privileged backend daemon running after the GUI exits.
+    atexit.register(shutdown_daemon)
+
 
     
     # Set the application icon globally. This helps with consistency.
@@ -326,24 +390,22 @@ def main():
         uninstall_wiz.exec_()
         sys.exit(0)
 
-    file_to_process = None
-    # Check if a file path was passed as a command-line argument
-    if args.file:
-        path_arg = args.file
-
+    files_to_process = []
+    # Check if file paths were passed as command-line arguments
+    for path_arg in args.file:
         # Handle file URIs (e.g., from GNOME Files) which start with 'file://'
         if path_arg.startswith('file://'):
             path_arg = unquote(urlparse(path_arg).path)
 
         path = Path(path_arg)
         if path.is_file() and path.suffix == '.deb':
-            file_to_process = str(path)
+            files_to_process.append(str(path))
 
-    if file_to_process:
-        # Launched with a .deb file. We don't need to show the main window.
+    if files_to_process:
+        # Launched with .deb files. We don't need to show the main window.
         # We create a temporary, invisible parent widget for our dialogs.
         temp_parent = QWidget()
-        process_deb_file(file_to_process, temp_parent)
+        process_deb_files(files_to_process, temp_parent)
         # The application will exit after the modal wizard/dialog closes.
         sys.exit(0)
     else:
@@ -0,0 +1,256 @@
+import hashlib
+import os
+import sqlite3
+import subprocess
+import time
+from contextlib import closing
+
+import requests
+
+from nano_installer.backend_client import STATUS_PREFIX, parse_status_record, stream_query
+from nano_installer.constants import USER_CACHE_DIR, VIRUSTOTAL_FILE_REPORT_API, get_scan_rules_path
+
+HASH_CHUNK_SIZE = 1024 * 1024
+
+# Scan verdicts are cached per package digest. A clean verdict can still turn
+# bad as engines catch up with new malware, so it is trusted for a day; flagged
+# verdicts rarely get withdrawn and are kept for a month.
+SCAN_CACHE_PATH = USER_CACHE_DIR / "scan-results.sqlite"
+SCAN_CACHE_TTL = {"clean": 24 * 3600, "suspicious": 30 * 24 * 3600, "danger": 30 * 24 * 3600}
+VERDICT_RANK = {"clean": 0, "suspicious": 1, "danger": 2}
+OFFLINE_REPORT_MAX_HITS = 50
+
+class ScanCache:
+    """
+    digest -> (verdict, engine counts, report, time) in a small SQLite file.
+    WAL mode lets several wizards read while one writes. The cache is an
+    optimisation only, so every database error is treated as a miss.
+    """
+    def __init__(self, path=SCAN_CACHE_PATH):
+        self.path = path
+
+    def _connect(self) -> sqlite3.Connection:
+        self.path.parent.mkdir(parents=True, exist_ok=True)
+        db = sqlite3.connect(self.path, timeout=5)
+        db.execute("PRAGMA journal_mode=WAL")
+        db.execute("""CREATE TABLE IF NOT EXISTS scan_results (
+                          sha256 TEXT PRIMARY KEY, verdict TEXT NOT NULL, malicious INTEGER NOT NULL,
+                          suspicious INTEGER NOT NULL, engines INTEGER NOT NULL, report TEXT NOT NULL,
+                          scanned_at INTEGER NOT NULL) WITHOUT ROWID""")
+        return db
+
+    def get(self, sha256: str) -> dict | None:
+        """Returns the cached result for a digest, or None if there is none or it has expired."""
+        try:
+            with closing(self._connect()) as db:
+                row = db.execute("SELECT verdict, malicious, suspicious, engines, report, scanned_at "
+                                 "FROM scan_results WHERE sha256 = ?", (sha256,)).fetchone()
+        except (sqlite3.Error, OSError):
+            return None
+        if row is None:
+            return None
+        verdict, malicious, suspicious, engines, report, scanned_at = row
+        if time.time() - scanned_at > SCAN_CACHE_TTL.get(verdict, 0):
+            return None
+        return {"verdict": verdict, "malicious": malicious, "suspicious": suspicious,
+                "engines": engines, "report": report, "scanned_at": scanned_at}
+
+    def put(self, sha256: str, verdict: str, malicious: int, suspicious: int, engines: int, report: str):
+        """Stores a result and drops entries that have expired under every policy."""
+        now = int(time.time())
+        try:
+            with closing(self._connect()) as db, db:
+                db.execute("INSERT OR REPLACE INTO scan_results VALUES (?, ?, ?, ?, ?, ?, ?)",
+                           (sha256, verdict, malicious, suspicious, engines, report, now))
+                db.execute("DELETE FROM scan_results WHERE scanned_at < ?", (now - max(SCAN_CACHE_TTL.values()),))
+        except (sqlite3.Error, OSError):
+            pass
+
+def _emit_hash_progress(worker, record: dict):
+    """Forwards a "hash" status record to the wizard with a human-readable line."""
+    if not worker:
+        return
+    record["line"] = f"Calculating hash... {record['percent']:.0f}% ({record['message']})"
+    worker.progress.emit(record)
+
+def _calculate_file_hash_python(file_path: str, worker=None) -> str:
+    """Fallback for when the backend is unavailable: hashlib, with coarse progress."""
+    total = os.path.getsize(file_path) or 1
+    sha256 = hashlib.sha256()
+    done = 0
+    with open(file_path, "rb") as f:
+        while chunk := f.read(HASH_CHUNK_SIZE):
+            sha256.update(chunk)
+            done += len(chunk)
+            if done % (64 * HASH_CHUNK_SIZE) == 0:
+                _emit_hash_progress(worker, {"type": "status", "phase": "hash", "package": os.path.basename(file_path),
+                                             "percent": 100.0 * done / total, "eta": -1, "message": "hashlib"})
+    return sha256.hexdigest()
+
+def calculate_file_hash(file_path: str, worker=None) -> str:
+    """
+    Returns the SHA-256 of a file as lowercase hex. Uses the backend's native
+    `sha256` query, which streams progress and throughput as "hash" status
+    records; falls back to hashlib.
+    """
+    digest = None
+    try:
+        for line in stream_query(["sha256", "--progress", file_path]):
+            if line.startswith(STATUS_PREFIX):
+                record = parse_status_record(line[len(STATUS_PREFIX):])
+                if record:
+                    _emit_hash_progress(worker, record)
+            elif line:
+                digest = line.split(None, 1)[0]
+    except (OSError, subprocess.CalledProcessError):
+        digest = None
+    if digest and len(digest) == 64:
+        return digest
+    return _calculate_file_hash_python(file_path, worker)
+
+def scan_with_virustotal(file_path: str, worker=None, file_hash: str = None) -> str:
+    """
+    Looks the file's SHA-256 up on VirusTotal; pass file_hash if it is already
+    known. A recent result for the same digest is answered from the local scan
+    cache without any network access. Returns a report starting with "Clean",
+    "SUSPICIOUS" or "DANGER!"; raises if no verdict could be obtained.
+    """
+    from nano_installer.settings import SettingsManager # Local import: settings pulls in the GUI modules
+
+    if not file_hash:
+        file_hash = calculate_file_hash(file_path, worker)
+
+    cache = ScanCache()
+    cached = cache.get(file_hash)
+    if cached:
+        scanned = time.strftime("%Y-%m-%d %H:%M", time.localtime(cached["scanned_at"]))
+        if worker: worker.progress.emit({"type": "log", "line": f"Using cached scan result from {scanned}"})
+        return f"{cached['report']}\n(Cached result from {scanned})"
+
+    api_key = SettingsManager().get_virustotal_api_key()
+    if not api_key:
+        raise ValueError("No VirusTotal API key is configured, so the file could not be scanned.")
+
+    if worker: worker.progress.emit({"type": "log", "line": "Querying VirusTotal..."})
+    try:
+        response = requests.get(f"{VIRUSTOTAL_FILE_REPORT_API}/{file_hash}",
+                                headers={"x-apikey": api_key}, timeout=30)
+    except requests.exceptions.RequestException as e:
+        raise RuntimeError(f"Could not reach VirusTotal: {e}") from e
+    if response.status_code == 404:
+        raise RuntimeError(f"VirusTotal has no report for this file yet (SHA-256: {file_hash}).")
+    if response.status_code == 401:
+        raise RuntimeError("VirusTotal rejected the configured API key.")
+    response.raise_for_status()
+
+    stats = response.json().get("data", {}).get("attributes", {}).get("last_analysis_stats", {})
+    malicious = stats.get("malicious", 0)
+    suspicious = stats.get("suspicious", 0)
+    engines = sum(value for value in stats.values() if isinstance(value, int))
+    summary = f"SHA-256: {file_hash}\nEngines: {engines}, malicious: {malicious}, suspicious: {suspicious}"
+    if malicious > 0:
+        verdict, report = "danger", f"DANGER! {malicious} of {engines} engines flagged this file as malicious.\n\n{summary}"
+    elif suspicious > 0:
+        verdict, report = "suspicious", f"SUSPICIOUS: {suspicious} of {engines} engines flagged this file as suspicious.\n\n{summary}"
+    else:
+        verdict, report = "clean", f"Clean: no engine flagged this file.\n\n{summary}"
+    cache.put(file_hash, verdict, malicious, suspicious, engines, report)
+    return report
+
+
+def scan_offline(file_path: str, worker=None) -> dict | None:
+    """
+    Matches every file in the package, maintainer scripts included, against the
+    local rule file with the backend's `deb-scan` query. Needs no network.
+    Returns {"verdict", "hits", "files", "bytes", "rules"}, where each hit is a
+    dict of severity, rule, path, offset and count; None if the scan could not run.
+    """
+    hits, summary = [], None
+    try:
+        for line in stream_query(["deb-scan", "--progress", "--rules", get_scan_rules_path(), file_path]):
+            if line.startswith(STATUS_PREFIX):
+                record = parse_status_record(line[len(STATUS_PREFIX):])
+                if record and worker:
+                    record["line"] = f"Scanning package contents... {record['percent']:.0f}% ({record['message']})"
+                    worker.progress.emit(record)
+                continue
+            fields = line.split("\t")
+            if fields[0] == "hit" and len(fields) == 6:
+                hits.append({"severity": fields[1], "rule": fields[2], "path": fields[3],
+                             "offset": int(fields[4]), "count": int(fields[5])})
+            elif fields[0] == "summary" and len(fields) == 4:
+                summary = {"files": int(fields[1]), "bytes": int(fields[2]), "rules": int(fields[3])}
+    except (OSError, ValueError, subprocess.CalledProcessError):
+        return None
+    if summary is None:
+        return None
+    severities = {hit["severity"] for hit in hits}
+    verdict = "danger" if "danger" in severities else "suspicious" if "suspicious" in severities else "clean"
+    return {"verdict": verdict, "hits": hits, **summary}
+
+def _format_offline_report(result: dict) -> str:
+    """The offline scan as a report; flagged files are listed worst first."""
+    flagged = [hit for hit in result["hits"] if hit["severity"] != "info"]
+    worst_files = len({hit["path"] for hit in flagged if hit["severity"] == result["verdict"]})
+    scanned = f"{result['files']} files ({result['bytes'] / 1e6:.1f} MB) checked against {result['rules']} local rules"
+    if result["verdict"] == "danger":
+        headline = f"DANGER! The offline scan found known malicious content in {worst_files} file(s)."
+    elif result["verdict"] == "suspicious":
+        headline = f"SUSPICIOUS: the offline scan found risky content in {worst_files} file(s)."
+    else:
+        headline = "Clean: the offline scan found nothing."
+    lines = [headline, scanned]
+    flagged.sort(key=lambda hit: -VERDICT_RANK.get(hit["severity"], 0))
+    for hit in flagged[:OFFLINE_REPORT_MAX_HITS]:
+        lines.append(f"  [{hit['severity']}] {hit['rule']}: {hit['path']} at byte {hit['offset']} ({hit['count']}x)")
+    if len(flagged) > OFFLINE_REPORT_MAX_HITS:
+        lines.append(f"  ... and {len(flagged) - OFFLINE_REPORT_MAX_HITS} more")
+    return "\n".join(lines)
+
+def _format_script_risks(risks: list[dict]) -> tuple[str, str]:
+    """The maintainer-script findings as (verdict, report); informational ones are only counted."""
+    flagged = sorted((risk for risk in risks if risk["severity"] != "info"),
+                     key=lambda risk: -VERDICT_RANK.get(risk["severity"], 0))
+    verdict = flagged[0]["severity"] if flagged else "clean"
+    if verdict == "danger":
+        headline = f"DANGER! The maintainer scripts run {len(flagged)} risky command(s), some of them high-risk."
+    elif verdict == "suspicious":
+        headline = f"SUSPICIOUS: the maintainer scripts run {len(flagged)} risky command(s)."
+    else:
+        headline = "Clean: the maintainer scripts run nothing risky."
+    lines = [headline]
+    for risk in flagged[:OFFLINE_REPORT_MAX_HITS]:
+        lines.append(f"  [{risk['severity']}] {risk['check']}: {risk['script']} line {risk['line']}: {risk['source']}")
+    if len(risks) > len(flagged):
+        lines.append(f"  ({len(risks) - len(flagged)} informational finding(s), see the package information)")
+    return verdict, "\n".join(lines)
+
+def _report_verdict(report: str) -> str:
+    return "danger" if report.startswith("DANGER!") else "suspicious" if report.startswith("SUSPICIOUS") else "clean"
+
+def scan_package(file_path: str, worker=None, file_hash: str = None, script_risks: list = None) -> str:
+    """
+    The pre-install security scan: the offline content scan, the
+    maintainer-script findings from ingest (if given) and a VirusTotal lookup.
+    The part with the worst verdict leads the report ("Clean", "SUSPICIOUS" or
+    "DANGER!"). If VirusTotal cannot be asked, the local verdicts stand on their
+    own with a note saying so; raises only if nothing produced a verdict.
+    """
+    if worker: worker.progress.emit({"type": "log", "line": "Scanning package contents..."})
+    parts = [] # (verdict, report); notes have no verdict and go last
+    offline = scan_offline(file_path, worker)
+    if offline is not None:
+        parts.append((offline["verdict"], _format_offline_report(offline)))
+    if script_risks is not None:
+        parts.append(_format_script_risks(script_risks))
+    try:
+        online = scan_with_virustotal(file_path, worker, file_hash)
+        parts.insert(0, (_report_verdict(online), online))
+    except Exception as e:
+        if not parts:
+            raise
+        parts.append((None, f"VirusTotal was not consulted: {e}"))
+    if offline is None:
+        parts.append((None, "(The offline content scan could not run.)"))
+    parts.sort(key=lambda part: -VERDICT_RANK.get(part[0], -1))
+    return "\n\n".join(report for _, report in parts)
@@ -256,18 +256,41 @@ class InstallationSettingsWidget(QWidget):
 
         shortcut_group.setLayout(shortcut_layout)
         layout.addWidget(shortcut_group)
+        layout.addSpacing(15)
+
+        # --- Unsafe I/O Section ---
+        unsafe_io_group = QGroupBox("Disk Writes")
+        unsafe_io_layout = QVBoxLayout()
+
+        self.cb_unsafe_io = QCheckBox("Skip disk syncs during installs and upgrades (unsafe I/O)")
+        unsafe_io_layout.addWidget(self.cb_unsafe_io)
+
+        unsafe_io_label = QLabel(
+            "<b>Only for throwaway systems</b> such as CI runners and temporary VMs: the package manager "
+            "stops waiting for each installed file to reach the disk, which speeds up packages with many "
+            "small files. A crash or power failure during or shortly after an installation can leave "
+            "files empty or missing."
+        )
+        unsafe_io_label.setWordWrap(True)
+        unsafe_io_layout.addWidget(unsafe_io_label)
+
+        unsafe_io_group.setLayout(unsafe_io_layout)
+        layout.addWidget(unsafe_io_group)
 
         layout.addStretch()
 
         # Connections
         self.cb_extract_mode.toggled.connect(self.on_extract_mode_toggled)
         self.cb_create_shortcut.toggled.connect(self.on_create_shortcut_toggled)
+        self.cb_unsafe_io.toggled.connect(self.on_unsafe_io_toggled)
 
     def _load_settings(self):
         is_extract_mode = self.settings_manager.get_setting("install_and_extract_enabled", "false") == "true"
         self.cb_extract_mode.setChecked(is_extract_mode)
         is_shortcut_mode = self.settings_manager.get_setting("create_desktop_shortcut_enabled", "false") == "true"
         self.cb_create_shortcut.setChecked(is_shortcut_mode)
+        is_unsafe_io = self.settings_manager.get_setting("unsafe_io_enabled", "false") == "true"
+        self.cb_unsafe_io.setChecked(is_unsafe_io)
 
     def on_extract_mode_toggled(self, checked):
         self.settings_manager.set_setting("install_and_extract_enabled", "true" if checked else "false")
@@ -275,6 +298,9 @@ class InstallationSettingsWidget(QWidget):
     def on_create_shortcut_toggled(self, checked):
         self.settings_manager.set_setting("create_desktop_shortcut_enabled", "true" if checked else "false")
 
+    def on_unsafe_io_toggled(self, checked):
+        self.settings_manager.set_setting("unsafe_io_enabled", "true" if checked else "false")
+
 
 class SecuritySettingsWidget(QWidget):
     def __init__(self, settings_manager, parent=None):
@@ -1,16 +1,20 @@
 import os
 import sys
-import io
 
 import subprocess
 from pathlib import Path
 import re
 import time
-import tarfile
+import fnmatch
 
 from PyQt5.QtCore import QThread, pyqtSignal
 from PyQt5.QtGui import QPixmap, QIcon
 
+from nano_installer.backend_client import STATUS_PREFIX, parse_status_record, run_query, run_sectioned_query, stream_query
+
+# Application launchers a package installs (matches what `grep /usr/share/applications/.*\.desktop$` did)
+DESKTOP_FILE_PATTERN = "*/usr/share/applications/*.desktop"
+
 # -----------------------
 # Worker Thread for background tasks
 # -----------------------
@@ -40,8 +44,8 @@ class WorkerThread(QThread):
     def is_running(self):
         return self._is_running and self.isRunning()
 
-    def set_process(self, proc: subprocess.Popen):
-        """Sets the subprocess reference for termination."""
+    def set_process(self, proc):
+        """Sets the subprocess (or daemon job) reference for termination."""
         self._process = proc
 
     def stop(self):
@@ -49,7 +53,10 @@ class WorkerThread(QThread):
         self._is_running = False
         self.stop_requested.emit() # Signal the worker function to stop gracefully
         
-        if self._process and self._process.poll() is None:
+        if self._process and hasattr(self._process, "cancel"):
+            # A job running inside the backend daemon; the daemon stops its process group.
+            self._process.cancel()
+        elif self._process and self._process.poll() is None:
             # The process is still running, attempt to terminate it safely
             try:
                 # Send SIGTERM to the process group to stop sudo and the backend
@@ -92,23 +99,160 @@ def get_icon(theme_name: str, fallback_path: str = None) -> QIcon:
     # 4. Return an empty icon if all else fails
     return QIcon()
 
-def get_deb_info(deb_path: Path, fields: list = None):
-    """Extracts specified fields from a .deb file's control information."""
+def parse_control_fields(text: str) -> dict:
+    """
+    Parses "Field: Value" control data. Continuation lines are joined onto the
+    preceding field, with " ." standing for an empty line as in Description.
+    """
+    info = {}
+    key = None
+    for line in text.split('\n'):
+        if line[:1] in (' ', '\t'):
+            if key is not None:
+                continuation = line.strip()
+                info[key] += '\n' + ('' if continuation == '.' else continuation)
+        elif ':' in line:
+            key, value = line.split(':', 1)
+            key = key.strip()
+            info[key] = value.strip()
+    return info
+
+def parse_script_risks(text: str) -> list[dict]:
+    """
+    Parses the backend's maintainer-script findings, one per line with
+    tab-separated severity, check, script, line number and source line.
+    """
+    risks = []
+    for line in text.splitlines():
+        fields = line.strip().split("\t", 4)
+        if len(fields) == 5 and fields[3].isdigit():
+            severity, check, script, line_no, source = fields
+            risks.append({"severity": severity, "check": check, "script": script,
+                          "line": int(line_no), "source": source})
+    return risks
+
+def parse_elf_section(text: str) -> list[dict]:
+    """
+    Parses deb-ingest's "elf" section into one dict per ELF file, with path,
+    arch, type, setid ("setuid", "setgid", "setuid+setgid" or None), interp
+    (or None) and needed: the libraries it links against, each a dict with
+    library, status (see elf_needed_status in the backend) and owner (or None).
+    """
+    elves = {}
+    for line in text.splitlines():
+        fields = line.split("\t")
+        if fields[0] == "elf" and len(fields) == 6:
+            _, path, arch, elf_type, setid, interp = fields
+            elves[path] = {"path": path, "arch": arch, "type": elf_type,
+                           "setid": None if setid == "-" else setid,
+                           "interp": None if interp == "-" else interp, "needed": []}
+        elif fields[0] == "needed" and len(fields) == 5 and fields[1] in elves:
+            _, path, library, status, owner = fields
+            elves[path]["needed"].append({"library": library, "status": status,
+                                          "owner": None if owner == "-" else owner})
+    return list(elves.values())
+
+def parse_file_listing(text: str) -> list[dict]:
+    """Parses the backend's file listing lines into dicts with type, mode, size, path and link (None if not a link)."""
+    files = []
+    for line in text.splitlines():
+        kind, mode, size, path, *link = line.split("\t")
+        files.append({"type": kind, "mode": int(mode, 8), "size": int(size), "path": path,
+                      "link": link[0] if link else None})
+    return files
+
+def get_deb_info(deb_path: Path, fields: list = None, with_script_risks: bool = False):
+    """
+    Extracts specified fields from a .deb file's control information. With
+    with_script_risks, the result also has a "script_risks" list (see
+    parse_script_risks) from the same backend call; it is None if only the
+    dpkg-deb fallback was available.
+    """
     if fields is None:
-        fields = ["Package", "Version", "Maintainer", "Description", "Depends", "Architecture", "Section", "Priority", "Installed-Size"]
+        fields = ["Package", "Version", "Maintainer", "Description", "Pre-Depends", "Depends", "Architecture", "Section", "Priority", "Installed-Size"]
+    # The backend reads the control member in-process and needs no privileges.
+    output = run_query(["deb-info"] + (["--scripts"] if with_script_risks else []) + [str(deb_path)] + fields)
+    if output is not None:
+        info = parse_control_fields(output)
+        if with_script_risks:
+            info["script_risks"] = parse_script_risks(info.pop("Nano-Script-Risks", ""))
+        return info
     try:
         cmd = ["dpkg-deb", "-f", str(deb_path)] + fields
         result = subprocess.run(cmd, capture_output=True, text=True, check=True)
-        info = {}
-        # dpkg-deb -f outputs "Field: Value" pairs, one per line.
-        for line in result.stdout.strip().split('\n'):
-            if ':' in line:
-                key, value = line.split(':', 1)
-                info[key.strip()] = value.strip()
+        info = parse_control_fields(result.stdout)
+        if with_script_risks:
+            info["script_risks"] = None
         return info
     except (subprocess.CalledProcessError, FileNotFoundError):
         return None
 
+def get_repo_package_info(pkg_name: str, fields: list = None) -> list[dict]:
+    """
+    Returns the stanzas apt's package lists have for pkg_name (one per version
+    and architecture), parsed like control files and limited to fields if
+    given; empty if no configured repository has it. Uses the backend's cached
+    index of the lists, falling back to `apt-cache show`.
+    """
+    output = run_query(["apt-show", pkg_name] + list(fields or []))
+    if output is None:
+        try:
+            result = subprocess.run(["apt-cache", "show", pkg_name], capture_output=True, text=True, encoding='utf-8')
+            output = result.stdout if result.returncode == 0 else ""
+        except FileNotFoundError:
+            return []
+    stanzas = [parse_control_fields(stanza) for stanza in output.split("\n\n") if stanza.strip()]
+    if fields:
+        stanzas = [{key: value for key, value in stanza.items() if key in fields} for stanza in stanzas]
+    return stanzas
+
+def get_upgrade_plan() -> dict | None:
+    """
+    Works out what `apt upgrade` would do from the package lists as of the last
+    update, without root: {"upgrades": [{"package", "arch", "installed",
+    "version", "download", "size_change"}], "held": [{"package", "arch",
+    "installed", "version"}], "download": bytes to fetch, "size_change": KiB
+    of disk space gained (negative if freed)}. Returns None if the backend
+    cannot tell.
+    """
+    output = run_query(["upgrade-plan"])
+    if output is None:
+        return None
+    plan = {"upgrades": [], "held": [], "download": 0, "size_change": 0}
+    for line in output.splitlines():
+        kind, *fields = line.split("\t")
+        if kind == "upgrade" and len(fields) == 6:
+            plan["upgrades"].append({"package": fields[0], "arch": fields[1], "installed": fields[2],
+                                     "version": fields[3], "download": int(fields[4]), "size_change": int(fields[5])})
+        elif kind == "held" and len(fields) == 4:
+            plan["held"].append(dict(zip(("package", "arch", "installed", "version"), fields)))
+        elif kind == "summary" and len(fields) == 4:
+            plan["download"], plan["size_change"] = int(fields[1]), int(fields[2])
+    return plan
+
+def simulate_install(deb_paths: list[str], reinstall: bool = False) -> dict | None:
+    """
+    Asks apt what installing the given .deb files would do, without root and
+    without changing anything: {"actions": [{"action", "package", "arch",
+    "installed", "version", "download"}], "installs", "upgrades", "removals",
+    "download": bytes to fetch}. action is install, upgrade, downgrade,
+    reinstall, remove or purge; versions that do not apply are None. Returns
+    None if apt cannot carry out the installation or the backend cannot tell.
+    """
+    output = run_query(["apt-op", "simulate"] + [str(path) for path in deb_paths] + (["--reinstall"] if reinstall else []))
+    if output is None:
+        return None
+    plan = {"actions": [], "installs": 0, "upgrades": 0, "removals": 0, "download": 0}
+    for line in output.splitlines():
+        kind, *fields = line.split("\t")
+        if kind == "summary" and len(fields) == 4:
+            plan["installs"], plan["upgrades"], plan["removals"], plan["download"] = map(int, fields)
+        elif len(fields) == 5:
+            installed, version = (None if value == "-" else value for value in fields[2:4])
+            plan["actions"].append({"action": kind, "package": fields[0], "arch": fields[1], "installed": installed,
+                                    "version": version, "download": int(fields[4])})
+    return plan
+
 def get_installed_version(pkg_name: str):
     """Gets the installed version of a package. Returns None if not installed."""
     try:
@@ -118,90 +262,161 @@ def get_installed_version(pkg_name: str):
     except subprocess.CalledProcessError:
         return None
 
+def compare_versions_batch(comparisons: list[tuple[str, str, str]]) -> list[bool]:
+    """
+    Evaluates several (v1, op, v2) Debian version comparisons with a single
+    backend call. Falls back to one `dpkg --compare-versions` per comparison.
+    """
+    args = ["version-compare"]
+    for v1, op, v2 in comparisons:
+        args += [v1, op, v2]
+    output = run_query(args) if comparisons else ""
+    results = output.split() if output is not None else []
+    if len(results) == len(comparisons):
+        return [result == "true" for result in results]
+
+    fallback = []
+    for v1, op, v2 in comparisons:
+        try:
+            cmd = ["dpkg", "--compare-versions", v1, op, v2]
+            subprocess.run(cmd, check=True, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
+            fallback.append(True)
+        except (subprocess.CalledProcessError, FileNotFoundError):
+            fallback.append(False)
+    return fallback
+
 def compare_versions(v1, op, v2):
-    """Compares two Debian versions using dpkg. Returns True if condition is met."""
-    try:
-        cmd = ["dpkg", "--compare-versions", v1, op, v2]
-        subprocess.run(cmd, check=True, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
-        return True
-    except (subprocess.CalledProcessError, FileNotFoundError):
-        return False
+    """Compares two Debian versions. Returns True if condition is met."""
+    return compare_versions_batch([(v1, op, v2)])[0]
 
 def get_deb_icon_data(deb_path: Path):
-    """Extracts icon data from a .deb file using Python's tarfile for performance."""
-    try:
-        # Find the data archive name (e.g., data.tar.xz)
-        ar_list_cmd = ["ar", "t", str(deb_path)]
-        ar_list_proc = subprocess.run(ar_list_cmd, capture_output=True, text=True, check=True)
-        data_archive_name = next((m for m in ar_list_proc.stdout.splitlines() if m.startswith("data.tar")), None)
-        if not data_archive_name:
-            return None
-
-        # Extract the data archive into an in-memory bytes buffer to make it seekable
-        ar_extract_cmd = ["ar", "p", str(deb_path), data_archive_name]
-        ar_proc = subprocess.run(ar_extract_cmd, stdout=subprocess.PIPE, check=True)
-        data_archive_stream = io.BytesIO(ar_proc.stdout)
-
-        # Use 'r|*' for streaming decompression, which is more robust than 'r:*'
-        with tarfile.open(fileobj=data_archive_stream, mode='r|*') as tf:
-            # Build a map of all members for fast lookups
-            members_map = {member.name: member for member in tf.getmembers() if member.isfile()}
-
-            icon_name = None
-            for member_name, member_obj in members_map.items():
-                if member_name.endswith('.desktop') and '/usr/share/applications/' in member_name:
-                    desktop_content = tf.extractfile(member_obj).read().decode('utf-8', errors='ignore')
-                    for line in desktop_content.split('\n'):
-                        if line.strip().startswith("Icon="):
-                            icon_name = line.split("=", 1).strip()
-                            break
-                    if icon_name:
-                        break
-
-            if not icon_name:
-                return None
-
-            # Find the icon file by searching prioritized paths
-            search_paths = [
-                f"./usr/share/icons/hicolor/scalable/apps/{icon_name}.svg",
-                f"./usr/share/icons/hicolor/256x256/apps/{icon_name}.png",
-                f"./usr/share/icons/hicolor/512x512/apps/{icon_name}.png",
-                f"./usr/share/pixmaps/{icon_name}.svg",
-                f"./usr/share/pixmaps/{icon_name}.png",
-                f"./usr/share/pixmaps/{icon_name}.xpm",
-            ]
-
-            for path in search_paths:
-                if path in members_map:
-                    icon_data = tf.extractfile(members_map[path]).read()
-                    return icon_data
+    """
+    Returns the raw bytes of the icon named by the package's .desktop file, or None.
+    The backend streams data.tar and stops at the icon, so even very large
+    packages are never held in memory.
+    """
+    return run_query(["deb-icon", str(deb_path)], binary=True) or None
 
+def ingest_deb(deb_path: Path, on_status=None) -> dict | None:
+    """
+    Reads a .deb once with the backend's deb-ingest and returns everything the
+    wizards need from it: "sha256", "size", "control" (all fields, parsed),
+    "files" (dicts with type, mode, size, path and link), "script_risks"
+    (maintainer-script findings, see parse_script_risks), "elves" (packaged
+    ELF files, see parse_elf_section; None from a backend without ELF
+    inspection) and "icon" (bytes or None). on_status receives "read" progress records. Returns None if the
+    backend is unavailable or cannot read the package.
+    """
+    sections = run_sectioned_query(["deb-ingest", "--progress", str(deb_path)], on_status)
+    if sections is None or "sha256" not in sections:
         return None
+    return {
+        "sha256": sections["sha256"].decode(),
+        "size": int(sections["size"]),
+        "control": parse_control_fields(sections.get("control", b"").decode("utf-8", "replace")),
+        "files": parse_file_listing(sections.get("files", b"").decode("utf-8", "replace")),
+        "script_risks": parse_script_risks(sections.get("scripts", b"").decode("utf-8", "replace")),
+        "elves": parse_elf_section(sections["elf"].decode("utf-8", "replace")) if "elf" in sections else None,
+        "icon": sections.get("icon") or None,
+    }
+
+def extract_deb(deb_path: Path, dest_dir: Path, only: list[str] = None, on_status=None) -> dict:
+    """
+    Unpacks a .deb's files into dest_dir with the backend's deb-extract (like
+    `dpkg-deb -x`, which it falls back to without the backend). only limits it
+    to those paths (or globs) and everything below them. on_status receives
+    "extract" progress records. Returns {"files", "directories", "links",
+    "bytes", "skipped"} (empty after the fallback); raises CalledProcessError,
+    whose stderr explains why, if the extraction fails.
+    """
+    args = ["deb-extract", "--progress"] + [arg for path in only or [] for arg in ("--only", path)]
+    try:
+        summary = {}
+        for line in stream_query(args + [str(deb_path), str(dest_dir)]):
+            if line.startswith(STATUS_PREFIX):
+                record = parse_status_record(line[len(STATUS_PREFIX):])
+                if record and on_status:
+                    on_status(record)
+            elif line.startswith("summary\t"):
+                values = [int(value) for value in line.split("\t")[1:]]
+                summary = dict(zip(("files", "directories", "links", "bytes", "skipped"), values))
+        return summary
+    except OSError:
+        if only:
+            raise
+    subprocess.run(["dpkg-deb", "-x", str(deb_path), str(dest_dir)], check=True, capture_output=True, text=True)
+    return {}
+
+def list_deb_contents(package: str, prefix: str = None) -> list[dict] | None:
+    """
+    Lists a .deb's files (see parse_file_listing) in path order, only those
+    starting with prefix if given, from the backend's content index. package is
+    a .deb path, or the SHA-256 of one that was ingested before, which answers
+    without reading the archive at all. Returns None if there is no index.
+    """
+    output = run_query(["deb-contents", str(package), "list"] + ([prefix] if prefix else []))
+    return parse_file_listing(output) if output is not None else None
 
-    except (subprocess.CalledProcessError, FileNotFoundError, tarfile.TarError, KeyError):
+def find_file_conflicts(package: str) -> dict | None:
+    """
+    Checks a .deb's files (a path, or an ingested SHA-256 as for
+    list_deb_contents) against those of the installed packages before anything
+    is installed. Returns {"conflicts": {path: [owner, ...]}, "replaces":
+    {path: [owner, ...]}}: dpkg would refuse to overwrite the former, while the
+    package's Replaces field lets it take over the latter. Returns None if the
+    check could not be made.
+    """
+    output = run_query(["deb-contents", str(package), "conflicts"])
+    if output is None:
         return None
+    result = {"conflicts": {}, "replaces": {}}
+    for line in output.splitlines():
+        kind, path, owners = (line.split("\t") + ["", ""])[:3]
+        if kind in ("conflict", "replaces"):
+            result["conflicts" if kind == "conflict" else "replaces"][path] = owners.split(", ")
+    return result
+
+def get_package_files(pkg_name: str, pattern: str = None) -> list[str]:
+    """
+    Lists the files an installed package owns, optionally filtered by an
+    fnmatch-style pattern (where '*' also matches '/').
+    Uses the backend's cached ownership index, falling back to `dpkg -L`.
+    """
+    args = ["package-files", pkg_name] + ([pattern] if pattern else [])
+    output = run_query(args)
+    if output is None:
+        try:
+            result = subprocess.run(["dpkg", "-L", pkg_name], capture_output=True, text=True, encoding='utf-8', check=True)
+            output = "\n".join(line for line in result.stdout.splitlines()
+                               if line and line != "/." and (pattern is None or fnmatch.fnmatchcase(line, pattern)))
+        except (subprocess.CalledProcessError, FileNotFoundError):
+            return []
+    return [line for line in output.splitlines() if line]
+
+def get_file_owners(path: str) -> list[str]:
+    """Returns the installed packages that own path (empty if none), like `dpkg -S`."""
+    output = run_query(["file-owner", path])
+    if output is None:
+        try:
+            result = subprocess.run(["dpkg", "-S", path], capture_output=True, text=True, check=True)
+            output = result.stdout
+        except (subprocess.CalledProcessError, FileNotFoundError):
+            return []
+    for line in output.splitlines():
+        owners, sep, owned_path = line.rpartition(": ")
+        if sep and owned_path == path:
+            return [owner.strip() for owner in owners.split(",")]
+    return []
 
 def get_icon_for_installed_package(pkg_name: str) -> QPixmap:
-    """Finds the icon for an installed package by querying dpkg."""
+    """Finds the icon for an installed package via the .desktop file it owns."""
     try:
         # Find .desktop file installed by the package
-        dpkg_cmd = ["dpkg", "-L", pkg_name]
-        dpkg_proc = subprocess.Popen(dpkg_cmd, stdout=subprocess.PIPE, text=True, encoding='utf-8')
-
-        grep_cmd = ["grep", r'/usr/share/applications/.*\.desktop$']
-        grep_proc = subprocess.Popen(grep_cmd, stdin=dpkg_proc.stdout, stdout=subprocess.PIPE, text=True, encoding='utf-8')
-
-        dpkg_proc.stdout.close()
-        desktop_files_output, _ = grep_proc.communicate()
-
-        if not desktop_files_output:
+        desktop_files = get_package_files(pkg_name, DESKTOP_FILE_PATTERN)
+        if not desktop_files:
             return None
 
         # Take the first .desktop file found
-        desktop_files = desktop_files_output.strip().split('\n')
-        if not desktop_files or not desktop_files[0]:
-            return None
-            
         desktop_file_path = desktop_files[0]
 
         if not Path(desktop_file_path).is_file():
@@ -221,49 +436,62 @@ def get_icon_for_installed_package(pkg_name: str) -> QPixmap:
     except (FileNotFoundError, subprocess.CalledProcessError, IndexError):
         return None
 
-def check_missing_dependencies(depends_string: str, worker=None) -> list[str]:
+def format_dependency_group(group: list[dict]) -> str:
+    """Turns a parsed dependency group back into control-file syntax."""
+    return " | ".join(
+        f"{dep['name']}{':' + dep['arch'] if dep.get('arch') else ''} {dep['version']}".strip() for dep in group)
+
+def _is_group_installed_dpkg_query(group: list[dict]) -> bool:
+    """Fallback for backends without deps-check: one dpkg-query call per alternative."""
+    for dep_info in group:
+        try:
+            # We only care if it's installed, not the version, as apt will handle version resolution.
+            cmd = ["dpkg-query", "-W", "-f=${Status}", dep_info['name']]
+            result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True, check=False)
+            # dpkg-query returns non-zero if the package is not found.
+            if result.returncode == 0 and "install ok installed" in result.stdout.strip():
+                return True
+        except Exception:
+            # Ignore errors and continue to the next alternative
+            continue
+    return False
+
+def check_missing_dependencies(depends_string: str, arch: str = "", worker=None) -> list[str]:
     """
-    Checks which packages in the dependency string are not currently installed.
-    Returns a list of missing dependency groups (represented by their first alternative).
+    Checks which dependency groups are not satisfied by the installed packages,
+    honouring version relations, architecture qualifiers and Provides. arch is
+    the architecture of the package being installed.
+    Returns a list of unsatisfied groups: missing ones are represented by their
+    first alternative, installed-but-wrong-version ones by the full relation.
     """
-    missing_deps = []
     dependency_groups = parse_dependencies(depends_string)
-    
-    for group in dependency_groups:
-        is_satisfied = False
-        
-        # Check if any alternative in the group is installed
-        for dep_info in group:
-            pkg_name = dep_info['name']
-            # Check if the package is installed
-            try:
-                # dpkg-query -W -f='${Status}' <pkg>
-                # We only care if it's installed, not the version, as apt will handle version resolution.
-                cmd = ["dpkg-query", "-W", "-f=${Status}", pkg_name]
-                result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL, text=True, check=False)
-                status = result.stdout.strip()
-                
-                # dpkg-query returns non-zero if the package is not found.
-                # If it returns 0, we check the status.
-                if result.returncode == 0 and "install ok installed" in status:
-                    is_satisfied = True
-                    break # Dependency satisfied by this alternative
-            except Exception:
-                # Ignore errors and continue to the next alternative
-                continue
-        
-        if not is_satisfied:
-            # If no alternative satisfied the dependency, add the first one to the missing list
+    if not dependency_groups:
+        return []
+
+    # The backend indexes the dpkg status database once and answers every group in one call.
+    arch_args = ["--arch", arch] if arch else []
+    output = run_query(["deps-check"] + arch_args + [format_dependency_group(group) for group in dependency_groups])
+    results = output.splitlines() if output is not None else []
+    if len(results) == len(dependency_groups):
+        states = [line.split("\t", 1)[0] for line in results]
+    else:
+        states = ["satisfied" if _is_group_installed_dpkg_query(group) else "missing" for group in dependency_groups]
+
+    unsatisfied = []
+    for group, state in zip(dependency_groups, states):
+        if state == "outdated":
+            unsatisfied.append(f"{format_dependency_group(group)} (installed version does not match)")
+        elif state != "satisfied":
+            # If no alternative satisfied the dependency, report the first one.
             # This is for display purposes in the GUI.
-            missing_deps.append(group[0]['name'])
-            
-    return missing_deps
+            unsatisfied.append(group[0]['name'])
+    return unsatisfied
 
 def parse_dependencies(depends_string: str) -> list[list[dict]]:
     """
     Parses dependency string and returns a list of dependency groups.
     Each group is a list of dictionaries representing alternatives.
-    Example: [[{'name': 'pkg1', 'version': ''}], [{'name': 'pkg2', 'version': ''}, {'name': 'pkg3', 'version': ''}]]
+    Example: [[{'name': 'pkg1', 'arch': '', 'version': ''}], [{'name': 'pkg2', 'arch': 'any', 'version': '(>= 1.0)'}, ...]]
     """
     if not depends_string:
         return []
@@ -285,13 +513,14 @@ def parse_dependencies(depends_string: str) -> list[list[dict]]:
 
             # Use regex to separate the package name from the version specifier
             # The regex is slightly modified to allow uppercase letters in package names (e.g., libGL)
-            match = re.match(r'^\s*([a-zA-Z0-9.+-]+)\s*(\(.*\))?\s*$', alternative_str)
+            # An optional ":arch" qualifier (e.g. python3:any) follows the name.
+            match = re.match(r'^\s*([a-zA-Z0-9.+-]+)(?::([a-z0-9-]+))?\s*(\(.*\))?\s*$', alternative_str)
             if match:
                 pkg_name = match.group(1)
-                version_spec = match.group(2) or "" # e.g., "(>= 1.2.3)"
+                arch = match.group(2) or ""
+                version_spec = match.group(3) or "" # e.g., "(>= 1.2.3)"
                 
-                # Only add the package name and version specifier
-                alternatives.append({'name': pkg_name, 'version': version_spec.strip()})
+                alternatives.append({'name': pkg_name, 'arch': arch, 'version': version_spec.strip()})
         
         if alternatives:
             dependency_groups.append(alternatives)
@@ -322,6 +551,109 @@ def parse_desktop_file(file_path: Path) -> dict:
         return {}
     return config
 
+def format_size(size: int) -> str:
+    """Formats a byte count for display, e.g. 1536 -> "1.5 KiB"."""
+    value = float(size)
+    for unit in ("bytes", "KiB", "MiB", "GiB"):
+        if value < 1024 or unit == "GiB":
+            return f"{int(value)} {unit}" if unit == "bytes" else f"{value:.1f} {unit}"
+        value /= 1024
+
+def _tree_size(path: Path) -> int:
+    """Apparent size of a file, or of everything below a directory, without following symlinks."""
+    try:
+        if path.is_symlink() or not path.is_dir():
+            return path.lstat().st_size
+        total = 0
+        for root, _dirs, files in os.walk(path):
+            for name in files:
+                try:
+                    total += os.lstat(os.path.join(root, name)).st_size
+                except OSError:
+                    pass
+        return total
+    except OSError:
+        return 0
+
+def scan_leftover_files(pkg_name: str, on_found=None) -> list[tuple[Path, int]]:
+    """
+    Finds user config, data and cache entries whose names contain a variation
+    of pkg_name as a whole word (so "foo" finds "foo.conf" but not "foobar"),
+    as (path, size in bytes) pairs. on_found(path, size, top_level) is called
+    for each one as soon as it is found; top_level is False for entries nested
+    inside other directories, which are less likely to belong to the package.
+    Uses the backend's parallel leftover-scan and falls back to a top-level
+    scan of the same locations.
+    """
+    home_dir = Path.home()
+    # Matching is case-insensitive, so only separator variations are needed.
+    base_name = pkg_name.lower()
+    variations = sorted({base_name, base_name.replace('-', ''), base_name.replace('-', '_')})
+    search_dirs = [home_dir / ".config", home_dir / ".local" / "share", home_dir / ".cache"]
+
+    found = []
+    top_dirs = set(search_dirs + [home_dir])
+    def report(path: Path, size: int):
+        found.append((path, size))
+        if on_found:
+            on_found(path, size, path.parent in top_dirs)
+
+    args = ["leftover-scan", "--name", *variations, "--root", *map(str, search_dirs), "--dotfiles", str(home_dir)]
+    try:
+        for line in stream_query(args):
+            size, _kind, path = line.split("\t", 2)
+            report(Path(path), int(size))
+        return found
+    except (OSError, ValueError, subprocess.CalledProcessError):
+        if found:
+            return found # The scan got far enough to be useful
+
+    # Same rule as the backend: the name must not continue with a letter or digit on either side.
+    word = r"[0-9a-z\x80-\U0010ffff]"
+    pattern = re.compile(f"(?<!{word})(?:{'|'.join(map(re.escape, variations))})(?!{word})")
+    for search_dir in search_dirs + [home_dir]:
+        try:
+            for item in search_dir.iterdir():
+                # For home dir, only check for dotfiles
+                if search_dir == home_dir and not item.name.startswith('.'):
+                    continue
+                item_name_lower = item.name.lower()
+                if pattern.search(item_name_lower):
+                    report(item, _tree_size(item))
+        except OSError:
+            continue
+    return found
+
+def verify_installed_packages(packages: list[str] = None, on_problem=None) -> dict | None:
+    """
+    Checks installed packages' files against the MD5 sums dpkg recorded when
+    they were unpacked (all packages if none are named), with the backend's
+    parallel package-verify. Returns {"problems", "nosums", "packages",
+    "files", "bytes"}: each problem is a dict of status ("changed", "missing"
+    or "unreadable"), package, path and error, and is also passed to
+    on_problem as soon as it is found; nosums lists the named packages that
+    have no sums. Returns None if the check could not run.
+    """
+    problems, nosums, summary = [], [], None
+    try:
+        for line in stream_query(["package-verify"] + list(packages or [])):
+            fields = line.split("\t")
+            if fields[0] in ("changed", "missing", "unreadable") and len(fields) >= 3:
+                problem = {"status": fields[0], "package": fields[1], "path": fields[2],
+                           "error": fields[3] if len(fields) > 3 else None}
+                problems.append(problem)
+                if on_problem:
+                    on_problem(problem)
+            elif fields[0] == "nosums" and len(fields) == 2:
+                nosums.append(fields[1])
+            elif fields[0] == "summary" and len(fields) == 7:
+                summary = {"packages": int(fields[1]), "files": int(fields[2]), "bytes": int(fields[3])}
+    except (OSError, ValueError, subprocess.CalledProcessError):
+        return None
+    if summary is None:
+        return None
+    return {"problems": problems, "nosums": nosums, **summary}
+
 def is_critical_package(pkg_name: str) -> tuple[bool, str]:
     """Checks if a package is critical to system stability or nano-installer."""
     # Packages that should never be uninstalled for system safety
@@ -376,14 +708,12 @@ def get_nano_installer_package_name() -> str:
     try:
         # Get the path of the current script
         # In a packaged app, this might be in /usr/lib/python3/dist-packages/nano_installer/
-        script_path = Path(os.path.abspath(sys.argv))
+        script_path = Path(os.path.abspath(sys.argv[0]))
 
         # Try to find which package owns this file
-        result = subprocess.run(['dpkg', '-S', str(script_path)],
-                                capture_output=True, text=True, check=False)
-        if result.returncode == 0:
-            # Extract package name from output like "package-name: /path/to/file"
-            return result.stdout.strip().split(':')[0]
+        owners = get_file_owners(str(script_path))
+        if owners:
+            return owners[0].split(':')[0] # Drop any ":arch" suffix
     except Exception:
         pass
 
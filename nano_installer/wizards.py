@@ -6,7 +6,6 @@ if __name__ == "__main__":
     sys.path.insert(0, str(Path(__file__).parent.parent))
 import subprocess
 import time
-import re
 import hashlib
 from pathlib import Path
 from PyQt5.QtCore import Qt, pyqtSlot
@@ -40,18 +39,37 @@ from nano_installer.utils import (
     compare_versions,
     get_icon_for_installed_package,
     get_deb_icon_data,
+    ingest_deb,
+    extract_deb,
+    list_deb_contents,
+    find_file_conflicts,
     parse_dependencies,
+    format_dependency_group,
+    scan_leftover_files,
+    verify_installed_packages,
+    get_upgrade_plan,
+    simulate_install,
+    format_size,
     check_missing_dependencies, # ADDED
     get_nano_installer_package_name,
 )
-from nano_installer.security import scan_with_virustotal, calculate_file_hash
+from nano_installer.security import scan_package, calculate_file_hash
 from nano_installer.gui_components import AuthenticationDialog, DependencyPopup
 from nano_installer.desktop_utils import create_desktop_shortcut, remove_desktop_shortcuts
-from nano_installer.constants import APP_NAME, BACKEND_PATH # APP_NAME and BACKEND_PATH are defined in constants.py
+from nano_installer.backend_client import run_privileged
+from nano_installer.constants import APP_NAME, BACKEND_PATH, BACKEND_MAX_BATCH_DEBS, FILES_LIST_MAX # APP_NAME and BACKEND_PATH are defined in constants.py
 
 # -----------------------
 # Base Wizard for common operations
 # -----------------------
+def scan_report_status(report: str) -> str:
+    """The verdict of a scan_package report: "danger", "suspicious", "clean", or "error" if it has none."""
+    if "DANGER!" in report:
+        return "danger"
+    if "SUSPICIOUS" in report:
+        return "suspicious"
+    return "clean" if "Clean" in report else "error"
+
 class BaseOperationWizard(QWizard):
     def __init__(self, pkg_name, parent=None):
         super().__init__(parent)
@@ -74,6 +92,10 @@ class BaseOperationWizard(QWizard):
             self.log_text.append("\n[INFO] Cancellation requested. Attempting to stop background process...")
             self._worker_thread.stop()
 
+    def _unsafe_io_args(self):
+        """The backend option that drops dpkg's disk syncs, when enabled in the installation settings."""
+        return ["--unsafe-io"] if self.settings.get_setting("unsafe_io_enabled", "false") == "true" else []
+
     def _create_progress_page(self, title, subtitle):
         """Creates a standardized progress page."""
         page = QWizardPage()
@@ -104,11 +126,32 @@ class BaseOperationWizard(QWizard):
         self.btn_toggle_log.setText("Hide Details" if checked else "Show Details")
         self.log_text.setVisible(checked)
 
+    def _apply_status_record(self, record: dict):
+        """
+        Maps a progress record from the backend's status channel onto the progress bar.
+        Downloads fill the first half of the bar; installation fills the rest (or the
+        whole bar when nothing had to be downloaded).
+        """
+        percent = record.get("percent", 0.0)
+        if record.get("phase") == "download":
+            self._saw_download_phase = True
+            value = percent * 0.5
+        elif record.get("phase") == "install":
+            value = 50 + percent * 0.5 if self._saw_download_phase else percent
+        else:
+            return
+        # Cap at 99% to ensure only the 'done' callback sets it to 100%
+        self.progress.setValue(max(self.progress.value(), min(99, int(value))))
+        message = record.get("message", "").replace("%", "%%")
+        self.progress.setFormat(f"%p% - {message}" if message else "%p%")
+
     def _execute_operation(self):
         """Handles password retrieval and starts the worker thread."""
         self.button(QWizard.BackButton).setEnabled(False)
         self.button(QWizard.NextButton).setEnabled(False)
         self.progress.setValue(5)
+        self.progress.setFormat("%p%")
+        self._saw_download_phase = False
         self.log_text.clear()
 
 
@@ -277,6 +320,13 @@ class InstallWizard(BaseOperationWizard):
         self.deps_list_widget = QListWidget()
         self.deps_list_widget.setVisible(False)
         l_deps.addWidget(self.deps_list_widget)
+        self.conflicts_label = QLabel()
+        self.conflicts_label.setWordWrap(True)
+        self.conflicts_label.setVisible(False)
+        l_deps.addWidget(self.conflicts_label)
+        self.conflicts_list_widget = QListWidget()
+        self.conflicts_list_widget.setVisible(False)
+        l_deps.addWidget(self.conflicts_list_widget)
         l_deps.addStretch()
         
         # Page 3: Detailed Package Information (Old Page 2)
@@ -324,6 +374,33 @@ class InstallWizard(BaseOperationWizard):
         self.deps_list = QListWidget()
         deps_layout.addWidget(self.deps_list)
         self.info_tabs.addTab(deps_tab, "Dependencies")
+
+        # Install scripts tab
+        scripts_tab = QWidget()
+        scripts_layout = QVBoxLayout(scripts_tab)
+        scripts_layout.addWidget(QLabel("Commands the package's install and removal scripts run as root:"))
+        self.scripts_list = QListWidget()
+        scripts_layout.addWidget(self.scripts_list)
+        self.info_tabs.addTab(scripts_tab, "Install Scripts")
+
+        # Binaries tab
+        binaries_tab = QWidget()
+        binaries_layout = QVBoxLayout(binaries_tab)
+        binaries_layout.addWidget(QLabel("Programs and libraries the package ships, and the libraries they load:"))
+        self.binaries_list = QListWidget()
+        binaries_layout.addWidget(self.binaries_list)
+        self.info_tabs.addTab(binaries_tab, "Binaries")
+
+        # Files tab
+        files_tab = QWidget()
+        files_layout = QVBoxLayout(files_tab)
+        self.files_filter_edit = QLineEdit()
+        self.files_filter_edit.setPlaceholderText("Show only paths starting with, e.g. /usr/bin")
+        self.files_filter_edit.textChanged.connect(self.show_files)
+        files_layout.addWidget(self.files_filter_edit)
+        self.files_list = QListWidget()
+        files_layout.addWidget(self.files_list)
+        self.info_tabs.addTab(files_tab, "Files")
         
         l2.addWidget(self.info_tabs)
         
@@ -366,6 +443,12 @@ class InstallWizard(BaseOperationWizard):
         self.extract_info_label.setVisible(self.is_extract_mode)
         l3.addWidget(self.extract_info_label)
 
+        # --- Integrity of the installed version (update/reinstall/downgrade only) ---
+        self.installed_files_label = QLabel()
+        self.installed_files_label.setWordWrap(True)
+        self.installed_files_label.setVisible(False)
+        l3.addWidget(self.installed_files_label)
+
         # --- Desktop Shortcut Option ---
         self.cb_create_shortcut_instance = QCheckBox("Create a desktop shortcut")
         self.cb_create_shortcut_instance.setChecked(True)
@@ -423,6 +506,10 @@ class InstallWizard(BaseOperationWizard):
         self._summary_loaded = False
         self._scan_finished = False
         self._scan_status = None # Explicitly initialize
+        self.deb_sha256 = None # Filled in by load_summary's single read of the package
+        self.deb_files = None
+        self.deb_script_risks = None # Maintainer-script findings, from the same read
+        self.deb_elves = None # Packaged ELF files and their libraries, from the same read
         self.currentIdChanged.connect(self.on_page_changed)
 
         # Override isComplete for the first page to control the "Next" button.
@@ -457,6 +544,80 @@ class InstallWizard(BaseOperationWizard):
         if visible and not self._summary_loaded:
             self.load_summary()
 
+    def show_binaries(self, architecture):
+        """Fills the Binaries tab from the ELF inspection of the package's files."""
+        self.binaries_list.clear()
+        if self.deb_elves is None:
+            self.binaries_list.addItem("• The package's binaries could not be inspected")
+            return
+        notes = {"undeclared": "installed, but its package is not in Depends",
+                 "unpackaged": "installed, but owned by no package",
+                 "missing": "not installed and not in the package",
+                 "unreadable": "library list could not be read"}
+        elf_paths = {elf["path"] for elf in self.deb_elves}
+        # Scripts and other non-ELF files can be setuid/setgid too.
+        for entry in self.deb_files or []:
+            if entry["type"] == "f" and entry["mode"] & 0o6000 and entry["path"] not in elf_paths:
+                kind = ",".join(name for bit, name in ((0o4000, "setuid"), (0o2000, "setgid")) if entry["mode"] & bit)
+                self.binaries_list.addItem(f"• {entry['path']} (not a binary, {kind})")
+        for elf in self.deb_elves:
+            details = [f"{elf['arch']} {elf['type']}"]
+            if architecture not in ("", "Unknown", "all") and elf["arch"] != architecture:
+                details.append(f"does not match the package's {architecture}")
+            if elf["setid"]:
+                details.append(elf["setid"])
+            self.binaries_list.addItem(f"• {elf['path']} ({', '.join(details)})")
+            for needed in elf["needed"]:
+                if needed["status"] in notes:
+                    owner = f" ({needed['owner']})" if needed["owner"] else ""
+                    self.binaries_list.addItem(f"    ↳ {needed['library']}{owner}: {notes[needed['status']]}")
+        if self.binaries_list.count() == 0:
+            self.binaries_list.addItem("• No binaries")
+
+    def show_files(self, prefix=""):
+        """Fills the Files tab from the package's cached content index, or from the listing already read."""
+        self.files_list.clear()
+        prefix = prefix.strip()
+        entries = list_deb_contents(self.deb_sha256, prefix) if self.deb_sha256 else None
+        if entries is None:
+            entries = [entry for entry in self.deb_files or [] if entry["path"].startswith(prefix)]
+        for entry in entries[:FILES_LIST_MAX]:
+            if entry["type"] == "f":
+                self.files_list.addItem(f"{entry['path']} ({format_size(entry['size'])})")
+            elif entry["link"]:
+                self.files_list.addItem(f"{entry['path']} → {entry['link']}")
+            else:
+                self.files_list.addItem(entry["path"] + ("/" if entry["type"] == "d" else ""))
+        if len(entries) > FILES_LIST_MAX:
+            self.files_list.addItem(f"… and {len(entries) - FILES_LIST_MAX} more; type a longer path to narrow it down")
+        elif not entries:
+            self.files_list.addItem("• No matching files")
+
+    def verify_installed_files(self):
+        """Checks the installed version's files against dpkg's MD5 sums, so local changes the operation replaces are shown first."""
+        def verify(pkg_name, worker=None):
+            return verify_installed_packages([pkg_name])
+
+        def on_verified(result):
+            if not result or result["nosums"] or result["files"] == 0:
+                return # Nothing to compare against
+            problems = result["problems"]
+            if not problems:
+                self.installed_files_label.setText(f"All {result['files']} files of the installed {self.pkg_name} are unmodified.")
+            else:
+                verb = self._get_operation_verb().lower()
+                self.installed_files_label.setText(
+                    f"<b>Note:</b> {len(problems)} of the {result['files']} files of the installed {self.pkg_name} "
+                    f"were modified or removed since it was installed. The {verb} will replace them.")
+                self.installed_files_label.setToolTip("\n".join(
+                    f"{problem['status']}: {problem['path']}" for problem in problems[:20]))
+            self.installed_files_label.setVisible(True)
+
+        worker = WorkerThread(verify, self.pkg_name)
+        worker.result.connect(on_verified)
+        worker.start()
+        self._verify_worker = worker
+
     def load_summary(self):
         self.prep_status_label.setText("Loading package information...")
         self.prep_progress.setValue(10)
@@ -482,16 +643,25 @@ class InstallWizard(BaseOperationWizard):
 
             deb_info = info.get("deb_info", {})
             icon_data = info.get("icon_data")
+            self.deb_sha256 = info.get("sha256") # Saves the scan a second read of the package
+            self.deb_files = info.get("files")
+            self.deb_script_risks = info.get("script_risks")
+            self.deb_elves = info.get("elves")
             
             name = deb_info.get("Package", self.deb_path.name)
             self.pkg_name = name # Update the wizard's package name
+            if self.is_update or self.is_reinstall or self.is_downgrade:
+                self.verify_installed_files()
             version = deb_info.get("Version", "Unknown")
             maintainer = deb_info.get("Maintainer", "Unknown")
             architecture = deb_info.get("Architecture", "Unknown")
             size = deb_info.get("Installed-Size", "Unknown")
             section = deb_info.get("Section", "Unknown")
             description = deb_info.get("Description", "No description available.")
-            self.depends_string = deb_info.get("Depends", "") # Store dependency string
+            self.pkg_architecture = deb_info.get("Architecture", "")
+            # Pre-Depends must be met as well, so both fields are checked together.
+            self.depends_string = ", ".join(
+                field for field in (deb_info.get("Pre-Depends", ""), deb_info.get("Depends", "")) if field)
 
             # Update detailed info tabs
             self.pkg_name_detail.setText(f"<b>Package:</b> {name}")
@@ -514,11 +684,22 @@ class InstallWizard(BaseOperationWizard):
                 dependency_groups = parse_dependencies(self.depends_string)
                 for group in dependency_groups:
                     # Display the dependency group, showing alternatives if present
-                    display_text = " | ".join([f"{dep['name']} {dep['version']}".strip() for dep in group])
+                    display_text = format_dependency_group(group)
                     self.deps_list.addItem(f"• {display_text}")
             else:
                 self.deps_list.addItem("• No dependencies required")
 
+            self.scripts_list.clear()
+            if self.deb_script_risks is None:
+                self.scripts_list.addItem("• The install scripts could not be analyzed")
+            elif not self.deb_script_risks:
+                self.scripts_list.addItem("• Nothing noteworthy")
+            for risk in self.deb_script_risks or []:
+                self.scripts_list.addItem(f"• [{risk['severity']}] {risk['check']} ({risk['script']}, line {risk['line']}): {risk['source']}")
+
+            self.show_binaries(architecture)
+            self.show_files(self.files_filter_edit.text())
+
             self.package_name_label.setText(f"Install {name}")
             self.package_details_label.setText(f"Version: {version} | From: {self.deb_path.name}")
 
@@ -538,12 +719,23 @@ class InstallWizard(BaseOperationWizard):
             self.do_scan() # Chain the scan after loading summary
 
         def get_info(deb_path, worker=None):
-            # get_deb_icon_data is imported from utils
-            info = get_deb_info(deb_path) or {}  # Get all available fields
-            return {"deb_info": info, "icon_data": get_deb_icon_data(deb_path)}
+            # One read of the package yields its fields, icon, digest and file list.
+            ingest = ingest_deb(deb_path, worker.progress.emit if worker else None)
+            if ingest is not None:
+                return {"deb_info": ingest["control"], "icon_data": ingest["icon"], "sha256": ingest["sha256"],
+                        "files": ingest["files"], "script_risks": ingest["script_risks"], "elves": ingest["elves"]}
+            info = get_deb_info(deb_path, with_script_risks=True) or {}  # Get all available fields
+            return {"deb_info": info, "icon_data": get_deb_icon_data(deb_path), "sha256": None, "files": None,
+                    "script_risks": info.pop("script_risks", None), "elves": None}
+
+        def on_info_progress(data):
+            if data.get("type") == "status" and data.get("phase") == "read":
+                self.prep_status_label.setText(f"Reading package... {data['percent']:.0f}% ({data['message']})")
+                self.prep_progress.setValue(10 + int(data["percent"] * 0.15))
 
         self.icon_label.setPixmap(QIcon.fromTheme("package-x-generic").pixmap(64, 64))
         worker = WorkerThread(get_info, self.deb_path)
+        worker.progress.connect(on_info_progress)
         worker.result.connect(on_info_loaded)
         worker.start()
         self._summary_worker = worker
@@ -602,15 +794,23 @@ class InstallWizard(BaseOperationWizard):
         self.deps_list_widget.clear()
         self.deps_list_widget.setVisible(False)
         self.button(QWizard.NextButton).setEnabled(False)
+
+        def check(worker=None):
+            # apt's own dry run gives the real transaction; without it only the Depends field can be checked.
+            plan = simulate_install([self.deb_path], self.is_reinstall)
+            return plan if plan is not None else check_missing_dependencies(self.depends_string, self.pkg_architecture)
         
-        def on_done(missing_deps):
-            if isinstance(missing_deps, Exception):
-                self.deps_status_label.setText(f"<font color='red'>Error during dependency check: {missing_deps}</font>")
+        def on_done(result):
+            if isinstance(result, Exception):
+                self.deps_status_label.setText(f"<font color='red'>Error during dependency check: {result}</font>")
                 self.button(QWizard.NextButton).setEnabled(True) # Allow user to proceed anyway
                 self._deps_checked = True # Mark as checked even on error to prevent re-run
                 return
-            
-            if missing_deps:
+
+            if isinstance(result, dict):
+                self.show_install_plan(result)
+            elif result:
+                missing_deps = result
                 self.deps_status_label.setText(f"<font color='orange'><b>{len(missing_deps)} missing dependencies found.</b></font>")
                 self.deps_list_widget.setVisible(True)
                 for dep in missing_deps:
@@ -627,11 +827,72 @@ class InstallWizard(BaseOperationWizard):
             self.button(QWizard.NextButton).setEnabled(True)
             self._deps_checked = True # Mark as checked on success
 
-        # The worker function is check_missing_dependencies from utils.py
-        worker = WorkerThread(check_missing_dependencies, self.depends_string)
+        worker = WorkerThread(check)
         worker.result.connect(on_done)
         worker.start()
         self._deps_worker = worker
+        self.check_file_conflicts()
+
+    def show_install_plan(self, plan):
+        """Lists every package apt's dry run of the installation would install, upgrade or remove."""
+        actions = plan["actions"]
+        removals = [entry for entry in actions if entry["action"] in ("remove", "purge")]
+        for entry in sorted(actions, key=lambda entry: (entry["action"] in ("remove", "purge"), entry["package"])):
+            if entry["action"] in ("remove", "purge"):
+                self.deps_list_widget.addItem(f"• {entry['action']} {entry['package']} ({entry['installed']})")
+            elif entry["installed"]:
+                self.deps_list_widget.addItem(f"• {entry['action']} {entry['package']}: {entry['installed']} → {entry['version']}")
+            else:
+                self.deps_list_widget.addItem(f"• {entry['action']} {entry['package']} ({entry['version']})")
+        self.deps_list_widget.setVisible(bool(actions))
+
+        if len(actions) <= 1:
+            self.deps_status_label.setText("<font color='green'><b>All dependencies are installed; no other package will change.</b></font>")
+            return
+        summary = (f"{plan['installs']} packages will be installed, {plan['upgrades']} upgraded or downgraded "
+                   f"and {plan['removals']} removed. {format_size(plan['download'])} will be downloaded.")
+        if removals:
+            self.deps_status_label.setText(f"<font color='orange'><b>{summary}</b></font>")
+            QMessageBox.warning(self, "Packages Will Be Removed",
+                                f"Installing this package will remove {', '.join(entry['package'] for entry in removals)}.")
+        else:
+            self.deps_status_label.setText(summary)
+
+    def check_file_conflicts(self):
+        """Finds files the package would overwrite in other installed packages, which dpkg only reports halfway through unpacking."""
+        def check(worker=None):
+            # The digest answers from the content index deb-ingest saved; the path makes the backend read the package.
+            result = find_file_conflicts(self.deb_sha256) if self.deb_sha256 else None
+            return result if result is not None else find_file_conflicts(str(self.deb_path))
+
+        def on_checked(result):
+            if not isinstance(result, dict):
+                return # Without the backend's index dpkg itself remains the only check
+            self.conflicts_list_widget.clear()
+            conflicts, replaces = result["conflicts"], result["replaces"]
+            if conflicts:
+                owners = sorted({owner for names in conflicts.values() for owner in names})
+                self.conflicts_label.setText(
+                    f"<font color='orange'><b>{len(conflicts)} files are already installed by {', '.join(owners)}.</b></font> "
+                    "The installation will fail unless that package is removed first.")
+                for path, names in sorted(conflicts.items()):
+                    self.conflicts_list_widget.addItem(f"• {path} ({', '.join(names)})")
+                self.conflicts_list_widget.setVisible(True)
+                QMessageBox.warning(self, "File Conflicts",
+                                    f"This package contains files that also belong to {', '.join(owners)}. "
+                                    "The package manager will refuse to overwrite them, so the installation is likely to fail.")
+            elif replaces:
+                owners = sorted({owner for names in replaces.values() for owner in names})
+                self.conflicts_label.setText(f"{len(replaces)} files will be taken over from {', '.join(owners)}, "
+                                             "which this package declares it replaces.")
+            else:
+                self.conflicts_label.setText("<font color='green'><b>No file conflicts with installed packages.</b></font>")
+            self.conflicts_label.setVisible(True)
+
+        worker = WorkerThread(check)
+        worker.result.connect(on_checked)
+        worker.start()
+        self._conflicts_worker = worker
 
     def do_scan(self):
         self.prep_status_label.setText("Preparing security scan...")
@@ -639,8 +900,12 @@ class InstallWizard(BaseOperationWizard):
         def on_progress(data):
             line = data.get("line", "")
             self.prep_status_label.setText(line)
-            if "Calculating hash" in line:
-                self.prep_progress.setValue(40)
+            if data.get("type") == "status" and data.get("phase") == "scan":
+                # The offline content scan reports how much of the archive it has read.
+                self.prep_progress.setValue(5 + int(data["percent"] * 0.45))
+            elif data.get("type") == "status" and data.get("phase") == "hash":
+                # Only when ingest could not supply the digest; measured like the scan.
+                self.prep_progress.setValue(50 + int(data["percent"] * 0.25))
             elif "Querying" in line:
                 self.prep_progress.setValue(80)
 
@@ -651,14 +916,8 @@ class InstallWizard(BaseOperationWizard):
                 self.scan_result_text.setText(f"{res}")
             elif isinstance(res, str):
                 self.scan_result_text.setText(res)
-                if "DANGER!" in res:
-                    self._scan_status = "danger"
-                elif "SUSPICIOUS" in res:
-                    self._scan_status = "suspicious"
-                elif "Clean" in res:
-                    self._scan_status = "clean"
-                else:
-                    self._scan_status = "error"
+                self._scan_status = scan_report_status(res)
+                if self._scan_status == "error":
                     self.scan_result_text.append("\n\n[Error] Could not parse the scan result.")
             else:
                 self._scan_status = "error"
@@ -667,7 +926,8 @@ class InstallWizard(BaseOperationWizard):
             self.handle_scan_finished()
 
         try:
-            self._scan_thread = WorkerThread(scan_with_virustotal, str(self.deb_path))
+            self._scan_thread = WorkerThread(scan_package, str(self.deb_path), file_hash=self.deb_sha256,
+                                             script_risks=self.deb_script_risks)
             self._scan_thread.progress.connect(on_progress)
             self._scan_thread.result.connect(on_done)
             self._scan_thread.start()
@@ -737,35 +997,15 @@ class InstallWizard(BaseOperationWizard):
                 # apt handles dependencies automatically, simplifying the Python worker.
                 if worker: worker.progress.emit({"type": "log", "line": "\n--- Starting package installation via C backend ---\n"})
                 
-                cmd = ["sudo", "-S", BACKEND_PATH, "apt-op", "install", str(self.deb_path).strip()]
+                args = ["apt-op", "install", str(self.deb_path).strip()]
                 if self.is_reinstall:
-                    cmd.append("--reinstall")
-
-                output_lines = []
-                # Use preexec_fn=os.setsid to create a new process group for safe termination
-                proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
-                
-                # Pass the process to the worker thread for cancellation handling
-                if worker: worker.set_process(proc)
-                
-                proc.stdin.write(password + '\n')
-                proc.stdin.close()
+                    args.append("--reinstall")
+                args += self._unsafe_io_args()
 
                 if worker: worker.progress.emit({"type": "progress", "value": 5})
 
-                while True:
-                    # Check for cancellation request
-                    if worker and not worker.is_running():
-                        # The worker's stop() method handles process termination
-                        return -15, "".join(output_lines) # Return SIGTERM code for cancellation
-                        
-                    line = proc.stdout.readline()
-                    if not line: break
-                    output_lines.append(line)
-                    if worker: worker.progress.emit({"type": "log", "line": line})
-
-                proc.wait()
-                return proc.returncode, "".join(output_lines)
+                # Runs through the session daemon, so sudo is only paid once per session.
+                return run_privileged(args, password, worker)
                 
             except Exception as e:
                 if worker: worker.progress.emit({"type": "log", "line": f"Installation error: {str(e)}\n"})
@@ -781,18 +1021,11 @@ class InstallWizard(BaseOperationWizard):
                 self.install_log_text.append(line.strip())
                 self.install_log_text.verticalScrollBar().setValue(self.install_log_text.verticalScrollBar().maximum())
 
-            # Try to parse progress from apt output
-            # This regex is for the main installation/unpacking phase
-            match = re.search(r'(\d+)\s*%', line)
-            if match:
-                # Cap at 99% to ensure only the 'done' callback sets it to 100%
-                self.progress.setValue(min(99, int(match.group(1))))
+            # Progress comes from the backend's status channel, not from the log text.
+            if data_type == "status":
+                self._apply_status_record(data)
             elif data_type == "progress":
                 self.progress.setValue(data["value"])
-            
-            # Check for the final "Setting up" or "Processing triggers" lines to jump to 99%
-            if "Setting up" in line or "Processing triggers" in line:
-                self.progress.setValue(99)
 
         return install, on_progress, self._handle_worker_completion
 
@@ -805,25 +1038,194 @@ class InstallWizard(BaseOperationWizard):
         if self.is_extract_mode:
             self.install_log_text.append("\n--- Installation successful. Starting extraction phase. ---")
             self.progress.setValue(80) # Visually indicate a new step
-            dest_dir = self.extract_path_edit.text()
-            try:
-                extract_cmd = ["dpkg-deb", "-x", str(self.deb_path), dest_dir]
-                subprocess.run(extract_cmd, check=True, capture_output=True, text=True)
-                self.install_log_text.append("Extraction successful.")
-                self.success_label.setText(f"<b>{self.deb_path.name}</b> was installed and extracted successfully.")
-                self.progress.setValue(100)
-                self.next()
-            except (subprocess.CalledProcessError, FileNotFoundError) as e:
-                error_output = e.stderr if hasattr(e, 'stderr') else str(e)
+            self._extract_package(Path(self.extract_path_edit.text()))
+        else:
+            # Standard install, just finish.
+            self.next()
+
+    def _extract_package(self, dest_dir: Path):
+        """Unpacks the package into dest_dir in the background; the last fifth of the bar follows it."""
+        def extract(worker=None):
+            return extract_deb(self.deb_path, dest_dir, on_status=worker.progress.emit)
+
+        def on_progress(record):
+            self.progress.setValue(max(self.progress.value(), 80 + int(record["percent"] * 0.2)))
+            message = record.get("message", "").replace("%", "%%")
+            self.progress.setFormat(f"%p% - Extracting {message}" if message else "%p%")
+
+        def on_extracted(result):
+            self.progress.setFormat("%p%")
+            if isinstance(result, Exception):
+                error_output = getattr(result, "stderr", None) or str(result)
                 self.install_log_text.append(f"\n[ERROR] Extraction failed:\n{error_output}")
                 self.progress.setStyleSheet("QProgressBar::chunk { background-color: orange; }")
                 self.success_label.setText(f"<b>{self.deb_path.name}</b> was installed, but extraction failed.")
                 QMessageBox.warning(self, "Partial Success", "The package was installed successfully, but the final extraction step failed. See log for details.")
-                self.next()
-        else:
-            # Standard install, just finish.
+            else:
+                if result:
+                    self.install_log_text.append(
+                        f"Extracted {result['files']} files ({format_size(result['bytes'])}) to {dest_dir}.")
+                self.install_log_text.append("Extraction successful.")
+                self.success_label.setText(f"<b>{self.deb_path.name}</b> was installed and extracted successfully.")
+                self.progress.setValue(100)
             self.next()
 
+        worker = WorkerThread(extract)
+        worker.progress.connect(on_progress)
+        worker.result.connect(on_extracted)
+        worker.start()
+        self._extract_worker = worker
+
+# -----------------------
+# Batch install wizard (several offline .debs)
+# -----------------------
+class BatchInstallWizard(BaseOperationWizard):
+    """
+    Installs several .deb files in a single apt transaction, so dependency solving
+    and triggers (man-db, desktop database, icon cache) run once per batch.
+    """
+    def __init__(self, deb_paths: list[Path], parent=None):
+        super().__init__(f"{len(deb_paths)} packages", parent)
+        self.deb_paths = deb_paths
+        self.setWindowTitle(f"Install {len(deb_paths)} Packages")
+
+        # --- Page 1: Queued packages, each through the same security scan as a single install ---
+        self.p1 = QWizardPage()
+        self.p1.setTitle("Security Scan")
+        self.p1.setSubTitle("The following packages will be installed together in one transaction once they are scanned.")
+        l1 = QVBoxLayout(self.p1)
+        self.queue_list = QListWidget()
+        self.queue_list.setSelectionMode(QListWidget.NoSelection)
+        for path in self.deb_paths:
+            self.queue_list.addItem(QListWidgetItem(QIcon.fromTheme("package-x-generic"), f"{path.name}: waiting"))
+        l1.addWidget(self.queue_list)
+        self.scan_result_text = QTextEdit()
+        self.scan_result_text.setReadOnly(True)
+        self.scan_result_text.setLineWrapMode(QTextEdit.NoWrap)
+        self.scan_result_text.setVisible(False)
+        l1.addWidget(self.scan_result_text)
+        self.cb_force_install = QCheckBox("Install anyway, even if threats are found or a scan fails.")
+        self.cb_force_install.setVisible(False)
+        self.cb_force_install.stateChanged.connect(self.p1.completeChanged.emit)
+        l1.addWidget(self.cb_force_install)
+        self.p1.isComplete = self.is_p1_complete
+        self.addPage(self.p1)
+        self._scan_statuses = None # One per file once every scan has finished
+
+        # --- Page 2: Installing ---
+        p2 = self._create_progress_page("Installing", "Please wait while the packages are being installed.")
+        self.addPage(p2)
+
+        # --- Page 3: Success ---
+        p3 = QWizardPage()
+        p3.setFinalPage(True)
+        p3.setTitle("Installation Complete")
+        l3 = QVBoxLayout(p3)
+        success_icon = QLabel()
+        success_icon.setPixmap(QIcon.fromTheme("emblem-ok").pixmap(64, 64))
+        success_icon.setAlignment(Qt.AlignCenter)
+        success_label = QLabel(f"<b>{len(self.deb_paths)}</b> packages were installed successfully.")
+        success_label.setAlignment(Qt.AlignCenter)
+        l3.addStretch()
+        l3.addWidget(success_icon)
+        l3.addSpacing(10)
+        l3.addWidget(success_label)
+        l3.addStretch()
+        self.addPage(p3)
+
+        self.currentIdChanged.connect(self.on_page_changed)
+        self.scan_packages()
+
+    def _get_operation_verb(self):
+        return "install software"
+
+    def scan_packages(self):
+        """Scans every file of the batch in turn; the list shows each verdict as it comes in."""
+        def scan_all(paths, worker=None):
+            statuses = []
+            for index, path in enumerate(paths):
+                if worker: worker.progress.emit({"type": "batch_scan", "index": index, "status": "scanning"})
+                try:
+                    # Ingest supplies the digest and the maintainer-script findings, as in the single-package wizard.
+                    ingest = ingest_deb(path)
+                    report = scan_package(str(path), worker, file_hash=ingest["sha256"] if ingest else None,
+                                          script_risks=ingest["script_risks"] if ingest else None)
+                    status = scan_report_status(report)
+                except Exception as e:
+                    report, status = f"The scan failed: {e}", "error"
+                statuses.append(status)
+                if worker: worker.progress.emit({"type": "batch_scan", "index": index, "status": status, "report": report})
+            return statuses
+
+        labels = {"scanning": "scanning...", "clean": "no threats found", "suspicious": "suspicious",
+                  "danger": "THREATS DETECTED", "error": "scan failed"}
+        def on_progress(data):
+            if data.get("type") != "batch_scan":
+                return
+            path = self.deb_paths[data["index"]]
+            self.queue_list.item(data["index"]).setText(f"{path.name}: {labels[data['status']]}")
+            if data["status"] not in ("scanning", "clean"):
+                self.scan_result_text.append(f"=== {path.name} ===\n{data['report']}\n")
+                self.scan_result_text.setVisible(True)
+                self.cb_force_install.setVisible(True)
+
+        def on_done(statuses):
+            if isinstance(statuses, Exception):
+                self.scan_result_text.append(f"The scan failed: {statuses}")
+                self.scan_result_text.setVisible(True)
+                self.cb_force_install.setVisible(True)
+                statuses = ["error"] * len(self.deb_paths)
+            self._scan_statuses = statuses
+            self.p1.completeChanged.emit()
+
+        self._scan_thread = WorkerThread(scan_all, list(self.deb_paths))
+        self._scan_thread.progress.connect(on_progress)
+        self._scan_thread.result.connect(on_done)
+        self._scan_thread.start()
+
+    def is_p1_complete(self):
+        """Next is enabled once every file is scanned and clean, or the user chose to install anyway."""
+        if self._scan_statuses is None:
+            return False
+        return all(status == "clean" for status in self._scan_statuses) or self.cb_force_install.isChecked()
+
+    @pyqtSlot(int)
+    def on_page_changed(self, idx):
+        if idx == 1: # Progress page
+            self._execute_operation()
+
+        page = self.currentPage()
+        if page and page.isFinalPage():
+            self.button(QWizard.BackButton).hide()
+
+    def _get_worker_callbacks(self):
+        def install_batch(worker=None, password=None):
+            try:
+                output = []
+                paths = [str(path).strip() for path in self.deb_paths]
+                # Batches larger than the backend's bound are split into as few transactions as possible.
+                for start in range(0, len(paths), BACKEND_MAX_BATCH_DEBS):
+                    batch = paths[start:start + BACKEND_MAX_BATCH_DEBS]
+                    if worker: worker.progress.emit({"type": "log", "line": f"\n--- Installing {len(batch)} packages in one transaction via C backend ---\n"})
+                    rc, batch_output = run_privileged(["apt-op", "install"] + batch + self._unsafe_io_args(), password, worker)
+                    output.append(batch_output)
+                    if rc != 0:
+                        return rc, "".join(output)
+                return 0, "".join(output)
+            except Exception as e:
+                if worker: worker.progress.emit({"type": "log", "line": f"Installation error: {str(e)}\n"})
+                return -1, str(e)
+
+        def on_progress(data):
+            line = data.get("line", "")
+            if line:
+                self.log_text.append(line.strip())
+                self.log_text.verticalScrollBar().setValue(self.log_text.verticalScrollBar().maximum())
+            if data.get("type") == "status":
+                self._apply_status_record(data)
+
+        return install_batch, on_progress, self._handle_worker_completion
+
 # -----------------------
 # Uninstall wizard
 # -----------------------
@@ -964,6 +1366,7 @@ class UninstallWizard(BaseOperationWizard):
                     self.uninstall_log_text.append(f"[ERROR] Failed to remove {path_to_remove}: {e}")
 
     def do_uninstall(self): # This is called when the page changes to the progress page
+        self.leftover_files_list.clear()
         self._execute_operation()
 
     def _get_worker_callbacks(self):
@@ -974,94 +1377,31 @@ class UninstallWizard(BaseOperationWizard):
                 # Perform uninstallation using the C backend's apt-op command
                 if worker: worker.progress.emit({"type": "log", "line": "\n--- Starting package removal via C backend ---\n"})
                 
-                # Use apt remove with purge option for complete removal via C backend
-                cmd = ["sudo", "-S", BACKEND_PATH, "apt-op", "purge", self.pkg_name]
-                output_lines = []
-                proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
-                
-                if worker: worker.set_process(proc)
-                
-                proc.stdin.write(password + '\n')
-                proc.stdin.close()
-
                 if worker: worker.progress.emit({"type": "progress", "value": 25})
 
-                while True:
-                    if worker and not worker.is_running():
-                        return -15, "".join(output_lines), []
-                        
-                    line = proc.stdout.readline()
-                    if not line: break
-                    output_lines.append(line)
-                    if worker: worker.progress.emit({"type": "log", "line": line})
-                    
-                proc.wait()
+                # Use apt remove with purge option for complete removal via C backend
+                purge_rc, purge_output = run_privileged(["apt-op", "purge", self.pkg_name], password, worker)
+                if purge_rc == -15:
+                    return -15, purge_output, []
                 
-                # Clean up orphaned dependencies via C backend
+                # Clean up orphaned dependencies via C backend (same daemon, no second sudo prompt)
                 if worker: worker.progress.emit({"type": "log", "line": "\n--- Cleaning up orphaned dependencies via C backend ---\n"})
-                cleanup_cmd = ["sudo", "-S", BACKEND_PATH, "apt-autoremove"]
-                cleanup_proc = subprocess.Popen(cleanup_cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, preexec_fn=os.setsid)
-                
-                if worker: worker.set_process(cleanup_proc)
-                
-                cleanup_proc.stdin.write(password + '\n')
-                cleanup_proc.stdin.close()
-                
-                while True:
-                    if worker and not worker.is_running():
-                        return -15, "".join(output_lines), []
-                        
-                    line = cleanup_proc.stdout.readline()
-                    if not line: break
-                    output_lines.append(line)
-                    if worker: worker.progress.emit({"type": "log", "line": line})
-                    
-                cleanup_proc.wait()
+                cleanup_rc, cleanup_output = run_privileged(["apt-autoremove"], password, worker)
+                output_lines = [purge_output, cleanup_output]
+                if cleanup_rc == -15:
+                    return -15, "".join(output_lines), []
                 
                 # --- Scan for leftover files after successful purge ---
-                if proc.returncode == 0:
+                if purge_rc == 0:
                     if worker: worker.progress.emit({"type": "log", "line": "\n--- Scanning for leftover user configuration and data files ---\n"})
                     
-                    home_dir = Path.home()
-                    # Common locations for user-specific config/data
-                    search_dirs = [
-                        home_dir / ".config",
-                        home_dir / ".local" / "share",
-                        home_dir / ".cache",
-                        home_dir, # For dotfiles like .bashrc
-                    ]
-                    
-                    # --- Improved Name Variation Generation ---
-                    # Create a comprehensive set of name variations to search for.
-                    base_name = self.pkg_name.lower()
-                    pkg_name_variations = {
-                        base_name,
-                        base_name.replace('-', ''),
-                        base_name.replace('-', '_'),
-                        base_name.title().replace('-', ''),
-                        base_name.title()
-                    }
-                    
-                    for search_dir in search_dirs:
-                        if search_dir.is_dir():
-                            try:
-                                for item in search_dir.iterdir():
-                                    item_name_lower = item.name.lower()
-                                    # For home dir, only check for dotfiles
-                                    if search_dir == home_dir and not item.name.startswith('.'):
-                                        continue
-                                    
-                                    # Check if any variation is present in the item's name
-                                    for variation in pkg_name_variations:
-                                        if variation in item_name_lower:
-                                            if item not in leftover_files:
-                                                leftover_files.append(item)
-                                                if worker: worker.progress.emit({"type": "log", "line": f"[INFO] Found potential leftover: {item}\n"})
-                                            break # Move to the next item once a match is found
-                            except OSError as e:
-                                if worker: worker.progress.emit({"type": "log", "line": f"[WARNING] Could not scan {search_dir}: {e}\n"})
+                    # Matches stream in from the backend scanner; on_progress adds each to the cleanup list.
+                    def on_found(path, size, top_level):
+                        if worker: worker.progress.emit({"type": "leftover", "path": str(path), "size": size, "top_level": top_level,
+                                                         "line": f"[INFO] Found potential leftover: {path} ({format_size(size)})\n"})
+                    leftover_files = [path for path, _size in scan_leftover_files(self.pkg_name, on_found)]
                 
-                return proc.returncode, "".join(output_lines), leftover_files
+                return purge_rc, "".join(output_lines), leftover_files
                 
             except Exception as e:
                 if worker: worker.progress.emit({"type": "log", "line": f"Uninstall error: {str(e)}\n"})
@@ -1074,28 +1414,26 @@ class UninstallWizard(BaseOperationWizard):
                 self.uninstall_log_text.append(line.strip())
                 self.uninstall_log_text.verticalScrollBar().setValue(self.uninstall_log_text.verticalScrollBar().maximum())
 
-            match = re.search(r'(\d+)\s*%', line)
-            if match:
-                # Cap at 99% to ensure only the 'done' callback sets it to 100%
-                self.progress.setValue(min(99, int(match.group(1))))
+            if data.get("type") == "status":
+                self._apply_status_record(data)
             elif data.get("type") == "progress":
                 self.progress.setValue(data["value"])
+            elif data.get("type") == "leftover":
+                # Only entries directly in a config/data/cache directory are preselected; nested ones need a look first.
+                label = "Found" if data["top_level"] else "Found (nested)"
+                item = QListWidgetItem(f"{label}: {data['path']} ({format_size(data['size'])})")
+                item.setData(Qt.UserRole, data["path"])
+                item.setCheckState(Qt.Checked if data["top_level"] else Qt.Unchecked)
+                self.leftover_files_list.addItem(item)
 
         return uninstall, on_progress, self._handle_worker_completion
 
     def _on_operation_success(self, output: str, leftover_files: list):
         """Handles successful uninstallation, shortcut removal, and leftover file scan."""
         remove_desktop_shortcuts(self.pkg_name, self.uninstall_log_text.append)
+        # The cleanup page was already populated as the scan reported each entry.
         self.found_leftover_files = leftover_files
         
-        if self.found_leftover_files:
-            # Populate the cleanup page
-            for path in self.found_leftover_files:
-                item = QListWidgetItem(f"Found: {path}")
-                item.setData(Qt.UserRole, str(path))
-                item.setCheckState(Qt.Checked) # Default to checked
-                self.leftover_files_list.addItem(item)
-        
         self.next() # Go to cleanup page or success page
 
 # -----------------------
@@ -1169,27 +1507,7 @@ class UpdateCacheWizard(BaseOperationWizard):
         def update_cache(worker=None, password=None):
             try:
                 if worker: worker.progress.emit({"type": "log", "line": "--- Starting package cache update via C backend ---\n"})
-                cmd = ["sudo", "-S", BACKEND_PATH, "apt-update"]
-                
-                output_lines = []
-                proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
-                
-                if worker: worker.set_process(proc)
-                
-                proc.stdin.write(password + '\n')
-                proc.stdin.close()
-
-                while True:
-                    if worker and not worker.is_running():
-                        return -15, "".join(output_lines)
-                        
-                    line = proc.stdout.readline()
-                    if not line: break
-                    output_lines.append(line)
-                    if worker: worker.progress.emit({"type": "log", "line": line})
-
-                proc.wait()
-                return proc.returncode, "".join(output_lines)
+                return run_privileged(["apt-update"], password, worker)
             except Exception as e:
                 return -1, str(e)
 
@@ -1199,17 +1517,9 @@ class UpdateCacheWizard(BaseOperationWizard):
                 self.update_log_text.append(line)
                 self.update_log_text.verticalScrollBar().setValue(self.update_log_text.verticalScrollBar().maximum())
 
-                # --- Improved Progress Parsing for `apt update` ---
-                # Phase 1: Downloading from repositories (maps to 0-90%)
-                # Matches lines like "Get:1", "Hit:2", etc.
-                match = re.match(r'^(Get|Hit):\d+', line)
-                if match:
-                    # Increment progress for each repository line, but don't go past 90
-                    self.progress.setValue(min(90, self.progress.value() + 4))
-
-                # Phase 2: Reading package lists (final step, 100%)
-                elif "Reading package lists..." in line:
-                    self.progress.setValue(100)
+            # `apt update` only has a download phase; let it use the whole bar.
+            if data.get("type") == "status" and data.get("phase") == "download":
+                self.progress.setValue(max(self.progress.value(), min(99, int(data["percent"]))))
 
         return update_cache, on_progress, self._handle_worker_completion
 
@@ -1238,12 +1548,22 @@ class UpgradeSystemWizard(BaseOperationWizard):
         label.setAlignment(Qt.AlignCenter)
         label.setStyleSheet("font-weight: bold;")
 
+        self.plan_label = QLabel("Checking which packages have updates...")
+        self.plan_label.setWordWrap(True)
+        self.plan_label.setAlignment(Qt.AlignCenter)
+        self.plan_list = QListWidget()
+        self.plan_list.setVisible(False)
+
         l1.addStretch(1)
         l1.addWidget(icon_label)
         l1.addSpacing(10)
         l1.addWidget(label)
+        l1.addSpacing(10)
+        l1.addWidget(self.plan_label)
+        l1.addWidget(self.plan_list)
         l1.addStretch(2)
         self.addPage(p1)
+        self.load_upgrade_plan()
 
         # --- Page 2: Upgrading ---
         p2 = self._create_progress_page("Upgrading System", "Please wait while packages are being downloaded and installed.")
@@ -1273,6 +1593,34 @@ class UpgradeSystemWizard(BaseOperationWizard):
     def _get_operation_verb(self):
         return "upgrade system packages"
 
+    def load_upgrade_plan(self):
+        """Shows what the upgrade will change, worked out from the package lists without root."""
+        def plan(worker=None):
+            return get_upgrade_plan()
+
+        def on_planned(result):
+            if not isinstance(result, dict):
+                self.plan_label.setText("The list of updates could not be determined in advance.")
+                return
+            upgrades, held = result["upgrades"], result["held"]
+            if not upgrades:
+                self.plan_label.setText("No updates are available as of the last package list refresh.")
+            else:
+                change = result["size_change"]
+                disk = f"{format_size(abs(change) * 1024)} of disk space will be {'used' if change >= 0 else 'freed'}"
+                self.plan_label.setText(f"{len(upgrades)} packages will be upgraded. "
+                                        f"{format_size(result['download'])} will be downloaded and {disk}.")
+            for upgrade in sorted(upgrades, key=lambda entry: entry["package"]):
+                self.plan_list.addItem(f"{upgrade['package']}: {upgrade['installed']} → {upgrade['version']}")
+            for entry in sorted(held, key=lambda entry: entry["package"]):
+                self.plan_list.addItem(f"{entry['package']}: kept at {entry['installed']} (on hold, {entry['version']} available)")
+            self.plan_list.setVisible(self.plan_list.count() > 0)
+
+        worker = WorkerThread(plan)
+        worker.result.connect(on_planned)
+        worker.start()
+        self._plan_worker = worker
+
     @pyqtSlot(int)
     def on_page_changed(self, idx):
         if idx == 1: # Progress page
@@ -1286,27 +1634,7 @@ class UpgradeSystemWizard(BaseOperationWizard):
         def upgrade_system(worker=None, password=None):
             try:
                 if worker: worker.progress.emit({"type": "log", "line": "--- Starting system upgrade via C backend ---\n"})
-                cmd = ["sudo", "-S", BACKEND_PATH, "apt-upgrade"]
-                
-                output_lines = []
-                proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
-                
-                if worker: worker.set_process(proc)
-                
-                proc.stdin.write(password + '\n')
-                proc.stdin.close()
-
-                while True:
-                    if worker and not worker.is_running():
-                        return -15, "".join(output_lines)
-                        
-                    line = proc.stdout.readline()
-                    if not line: break
-                    output_lines.append(line)
-                    if worker: worker.progress.emit({"type": "log", "line": line})
-
-                proc.wait()
-                return proc.returncode, "".join(output_lines)
+                return run_privileged(["apt-upgrade"] + self._unsafe_io_args(), password, worker)
             except Exception as e:
                 return -1, str(e)
 
@@ -1316,20 +1644,9 @@ class UpgradeSystemWizard(BaseOperationWizard):
                 self.upgrade_log_text.append(line)
                 self.upgrade_log_text.verticalScrollBar().setValue(self.upgrade_log_text.verticalScrollBar().maximum())
 
-                # --- Progress Parsing for `apt upgrade` ---
-                # Phase 1: Downloading packages (maps to 0-50% of progress bar)
-                # Matches lines like "Progress: [ 12%]"
-                dl_match = re.search(r'Progress:\s*\[\s*(\d+)%\s*\]', line)
-                if dl_match:
-                    progress_val = int(dl_match.group(1)) * 0.5 # Scale to 0-50
-                    self.progress.setValue(int(progress_val))
-                    return
-
-                # Phase 2: Unpacking/Installing from database (maps to 50-100% of progress bar)
-                install_match = re.search(r'\(Reading database\s*\.\.\.\s*(\d+)%\)', line)
-                if install_match:
-                    progress_val = 50 + (int(install_match.group(1)) * 0.5) # Scale to 50-100
-                    self.progress.setValue(int(progress_val))
+            # Downloads map to 0-50% of the bar, unpacking/configuring to 50-100%.
+            if data.get("type") == "status":
+                self._apply_status_record(data)
         return upgrade_system, on_progress, self._handle_worker_completion
 # -----------------------
 # Maintenance wizard
@@ -1376,26 +1693,7 @@ class MaintenanceWizard(BaseOperationWizard):
     def _get_worker_callbacks(self):
         # Reuse the robust install worker, but change the command
         def maintenance_worker(worker=None, password=None):
-            cmd = ["sudo", "-S", BACKEND_PATH, self.backend_command]
-            proc = subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, text=True, bufsize=1, encoding='utf-8', preexec_fn=os.setsid)
-            
-            if worker: worker.set_process(proc)
-            
-            proc.stdin.write(password + '\n')
-            proc.stdin.close()
-            output = []
-            
-            while True:
-                if worker and not worker.is_running():
-                    return -15, "".join(output)
-                    
-                line = proc.stdout.readline()
-                if not line: break
-                output.append(line)
-                if worker: worker.progress.emit({"type": "log", "line": line})
-                
-            proc.wait()
-            return proc.returncode, "".join(output)
+            return run_privileged([self.backend_command], password, worker)
 
         def on_progress(data):
             """Generic progress handler for simple log output."""
@@ -1403,5 +1701,7 @@ class MaintenanceWizard(BaseOperationWizard):
             if line:
                 self.log_text.append(line.strip())
                 self.log_text.verticalScrollBar().setValue(self.log_text.verticalScrollBar().maximum())
+            if data.get("type") == "status":
+                self._apply_status_record(data)
 
         return maintenance_worker, on_progress, self._handle_worker_completion
\ No newline at end of file
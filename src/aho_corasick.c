@@ -0,0 +1,141 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "aho_corasick.h"
+
+static void assign_byte_classes(struct ac_matcher *ac, const char *const *patterns, const size_t *lengths,
+                                size_t count, int fold_case) {
+    uint8_t used[256] = { 0 };
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < lengths[i]; j++) {
+            unsigned char c = (unsigned char)patterns[i][j];
+            used[fold_case ? tolower(c) : c] = 1;
+        }
+    }
+    memset(ac->byte_class, 0, sizeof(ac->byte_class));
+    ac->class_count = 1;
+    for (int c = 0; c < 256; c++) {
+        if (used[c]) ac->byte_class[c] = (uint8_t)ac->class_count++;
+    }
+    if (fold_case) {
+        for (int c = 'A'; c <= 'Z'; c++) ac->byte_class[c] = ac->byte_class[tolower(c)];
+    }
+}
+
+int ac_build(struct ac_matcher *ac, const char *const *patterns, const size_t *lengths, size_t count, int fold_case) {
+    memset(ac, 0, sizeof(*ac));
+    assign_byte_classes(ac, patterns, lengths, count, fold_case);
+
+    size_t max_states = 1;
+    for (size_t i = 0; i < count; i++) max_states += lengths[i];
+    if (max_states > AC_OUTPUT_FLAG / ac->class_count) return -1;
+
+    ac->delta = calloc(max_states * ac->class_count, sizeof(*ac->delta));
+    ac->state_pattern = malloc(max_states * sizeof(*ac->state_pattern));
+    ac->output_link = calloc(max_states, sizeof(*ac->output_link));
+    ac->pattern_next = malloc((count ? count : 1) * sizeof(*ac->pattern_next));
+    ac->pattern_len = malloc((count ? count : 1) * sizeof(*ac->pattern_len));
+    uint32_t *fail = calloc(max_states, sizeof(*fail));
+    uint32_t *queue = malloc(max_states * sizeof(*queue));
+    if (!ac->delta || !ac->state_pattern || !ac->output_link || !ac->pattern_next || !ac->pattern_len || !fail || !queue) {
+        free(fail);
+        free(queue);
+        ac_free(ac);
+        return -1;
+    }
+    for (size_t s = 0; s < max_states; s++) ac->state_pattern[s] = -1;
+
+    // 1. Trie. While building, a zero transition means "no child" (no edge ever leads back to the root).
+    uint32_t classes = ac->class_count;
+    ac->state_count = 1;
+    for (size_t i = 0; i < count; i++) {
+        ac->pattern_len[i] = lengths[i];
+        ac->pattern_next[i] = -1;
+        if (lengths[i] == 0) continue;
+        uint32_t s = 0;
+        for (size_t j = 0; j < lengths[i]; j++) {
+            uint32_t *edge = &ac->delta[(size_t)s * classes + ac->byte_class[(unsigned char)patterns[i][j]]];
+            if (*edge == 0) *edge = ac->state_count++;
+            s = *edge;
+        }
+        ac->pattern_next[i] = ac->state_pattern[s];
+        ac->state_pattern[s] = (int32_t)i;
+    }
+
+    // 2. Breadth-first: failure links, output links, and missing edges filled in from the failure state.
+    size_t head = 0, tail = 0;
+    queue[tail++] = 0;
+    while (head < tail) {
+        uint32_t s = queue[head++];
+        for (uint32_t c = 0; c < classes; c++) {
+            uint32_t *edge = &ac->delta[(size_t)s * classes + c];
+            uint32_t via_fail = s == 0 ? 0 : ac->delta[(size_t)fail[s] * classes + c];
+            if (*edge != 0 && c != 0) {
+                uint32_t child = *edge;
+                fail[child] = via_fail;
+                ac->output_link[child] = ac->state_pattern[via_fail] >= 0 ? via_fail : ac->output_link[via_fail];
+                queue[tail++] = child;
+            } else {
+                *edge = via_fail;
+            }
+        }
+    }
+
+    // 3. Store edges as row offsets, which takes a multiply off the scan's critical path, and flag
+    // every edge into a state where some pattern ends so that scanning only looks further on those.
+    for (size_t e = 0; e < (size_t)ac->state_count * classes; e++) {
+        uint32_t t = ac->delta[e];
+        int output = ac->state_pattern[t] >= 0 || ac->output_link[t] != 0;
+        ac->delta[e] = t * classes | (output ? AC_OUTPUT_FLAG : 0);
+    }
+
+    free(fail);
+    free(queue);
+    ac->pattern_count = count;
+    return 0;
+}
+
+void ac_free(struct ac_matcher *ac) {
+    free(ac->delta);
+    free(ac->state_pattern);
+    free(ac->output_link);
+    free(ac->pattern_next);
+    free(ac->pattern_len);
+    memset(ac, 0, sizeof(*ac));
+}
+
+int ac_scan(const struct ac_matcher *ac, uint32_t *state, const void *data, size_t len, uint64_t offset,
+            ac_match_cb cb, void *ctx) {
+    const unsigned char *p = data;
+    uint32_t row = *state * ac->class_count;
+    for (size_t i = 0; i < len; i++) {
+        uint32_t t = ac->delta[row + ac->byte_class[p[i]]];
+        row = t & ~AC_OUTPUT_FLAG;
+        if (__builtin_expect((t & AC_OUTPUT_FLAG) == 0, 1)) continue;
+        // Walk this state and its output links: every pattern that ends here.
+        uint32_t s = row / ac->class_count;
+        for (uint32_t o = ac->state_pattern[s] >= 0 ? s : ac->output_link[s]; o != 0; o = ac->output_link[o]) {
+            for (int32_t pat = ac->state_pattern[o]; pat >= 0; pat = ac->pattern_next[pat]) {
+                if (cb(pat, offset + i + 1, ctx)) {
+                    *state = s;
+                    return 1;
+                }
+            }
+        }
+    }
+    *state = row / ac->class_count;
+    return 0;
+}
+
+static int stop_at_first(size_t pattern, uint64_t end, void *ctx) {
+    (void)pattern;
+    (void)end;
+    (void)ctx;
+    return 1;
+}
+
+int ac_contains(const struct ac_matcher *ac, const char *text) {
+    uint32_t state = 0;
+    return ac_scan(ac, &state, text, strlen(text), 0, stop_at_first, NULL);
+}
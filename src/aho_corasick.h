@@ -0,0 +1,47 @@
+#ifndef AHO_CORASICK_H
+#define AHO_CORASICK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Multi-pattern matcher compiled to a dense DFA. Bytes are first mapped to
+ * classes (every byte that occurs in no pattern shares class 0, and case
+ * folding is just a coarser mapping), so the transition table is
+ * states x classes rather than states x 256. Matching is one table lookup
+ * per input byte regardless of the number of patterns, and the state can be
+ * carried across buffers to scan a stream.
+ */
+#define AC_OUTPUT_FLAG 0x80000000u
+
+struct ac_matcher {
+    uint8_t byte_class[256];
+    uint32_t class_count;
+    uint32_t state_count;
+    uint32_t *delta;         // state_count * class_count transitions as row offsets, AC_OUTPUT_FLAG into output states
+    int32_t *state_pattern;  // First pattern ending exactly at a state, -1 if none
+    uint32_t *output_link;   // Nearest proper suffix state that ends a pattern, 0 if none
+    int32_t *pattern_next;   // Next pattern ending at the same state, -1 if none
+    size_t *pattern_len;
+    size_t pattern_count;
+};
+
+/** Return nonzero to stop scanning. end is the offset just past the match. */
+typedef int (*ac_match_cb)(size_t pattern, uint64_t end, void *ctx);
+
+/** Compiles the patterns (empty ones are ignored). Returns 0, or -1 if out of memory. */
+int ac_build(struct ac_matcher *ac, const char *const *patterns, const size_t *lengths, size_t count, int fold_case);
+void ac_free(struct ac_matcher *ac);
+
+/**
+ * Feeds len bytes, starting in *state (0 initially), reporting every match.
+ * offset is the stream position of data[0]. Returns 1 if the callback stopped
+ * the scan, 0 otherwise; *state is updated either way.
+ */
+int ac_scan(const struct ac_matcher *ac, uint32_t *state, const void *data, size_t len, uint64_t offset,
+            ac_match_cb cb, void *ctx);
+
+/** Returns 1 if any pattern occurs in the NUL-terminated string. */
+int ac_contains(const struct ac_matcher *ac, const char *text);
+
+#endif // AHO_CORASICK_H
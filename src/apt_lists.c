@@ -0,0 +1,509 @@
+#define _GNU_SOURCE // For memmem()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "apt_lists.h"
+#include "file_index.h"
+
+/*
+ * Package lookups in apt's downloaded Packages files, without apt-cache.
+ *
+ * `apt-cache show` loads (and, after an update, rebuilds) apt's whole binary
+ * cache to print one stanza. Here the Packages files are scanned once, in
+ * parallel, for where each stanza starts; the resulting package -> (file,
+ * offset) table is cached like the file index (see apt_lists.h), so a lookup
+ * is a binary search in an mmap plus one pread of the stanza. Only the plain
+ * *_Packages files apt keeps by default are read; lists stored compressed
+ * (Acquire::GzipIndexes) are not.
+ */
+
+#define SCAN_MAX_THREADS 8
+
+struct scanned_stanza {
+    const char *package;
+    size_t package_len;
+    uint32_t file;
+    uint64_t offset, length;
+};
+
+struct packages_file {
+    char *name;
+    struct stat st;
+    uint32_t flags;
+    const char *data; // mmap of the whole file while the index is built
+    struct scanned_stanza *stanzas;
+    size_t count;
+};
+
+struct scan_job {
+    struct packages_file *files;
+    size_t count;
+    atomic_size_t next;
+};
+
+static int compare_files(const void *a, const void *b) {
+    return strcmp(((const struct packages_file *)a)->name, ((const struct packages_file *)b)->name);
+}
+
+/** Lists the Packages files in APT_LISTS_DIR, sorted by name; an absent directory has none. */
+static struct packages_file *collect_packages_files(size_t *count_out) {
+    *count_out = 0;
+    DIR *dir = opendir(APT_LISTS_DIR);
+    if (dir == NULL) {
+        if (errno == ENOENT) return calloc(1, sizeof(struct packages_file));
+        fprintf(stderr, ERROR_PREFIX "Cannot open " APT_LISTS_DIR ": %s\n", strerror(errno));
+        return NULL;
+    }
+
+    struct packages_file *files = calloc(1, sizeof(*files));
+    size_t count = 0, capacity = 1;
+    struct dirent *entry;
+    while (files != NULL && (entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= 9 || strcmp(entry->d_name + len - 9, "_Packages") != 0) continue;
+        struct stat st;
+        if (fstatat(dirfd(dir), entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (count == capacity) {
+            capacity *= 2;
+            struct packages_file *bigger = realloc(files, capacity * sizeof(*bigger));
+            if (bigger == NULL) break;
+            files = bigger;
+        }
+        files[count] = (struct packages_file){ .name = strdup(entry->d_name), .st = st };
+        if (files[count].name != NULL) count++;
+    }
+    closedir(dir);
+    if (files == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        return NULL;
+    }
+
+    qsort(files, count, sizeof(*files), compare_files);
+    *count_out = count;
+    return files;
+}
+
+static void free_packages_files(struct packages_file *files, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        free(files[i].name);
+        free(files[i].stanzas);
+        if (files[i].data != NULL) munmap((void *)files[i].data, (size_t)files[i].st.st_size);
+    }
+    free(files);
+}
+
+/** The value of a stanza's Package field; NULL if it has none. */
+static const char *stanza_package(const char *stanza, size_t len, size_t *name_len) {
+    const char *field = stanza;
+    if (len < 8 || memcmp(stanza, "Package:", 8) != 0) { // It comes first in practice
+        field = memmem(stanza, len, "\nPackage:", 9);
+        if (field == NULL) return NULL;
+        field++;
+    }
+    const char *end = stanza + len;
+    const char *name = field + 8;
+    while (name < end && (*name == ' ' || *name == '\t')) name++;
+    const char *stop = name;
+    while (stop < end && *stop != '\n' && *stop != ' ' && *stop != '\t') stop++;
+    *name_len = (size_t)(stop - name);
+    return *name_len > 0 ? name : NULL;
+}
+
+/** Finds where each stanza of a Packages file starts; a file that cannot be read counts as empty. */
+static void scan_packages_file(struct packages_file *file, uint32_t index) {
+    size_t size = (size_t)file->st.st_size;
+    if (size == 0) return;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), APT_LISTS_DIR "/%s", file->name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) return;
+    file->data = data;
+    madvise(data, size, MADV_SEQUENTIAL);
+
+    // About one stanza per kilobyte; grown as needed.
+    size_t capacity = size / 1024 + 16;
+    file->stanzas = malloc(capacity * sizeof(*file->stanzas));
+    for (size_t pos = 0; file->stanzas != NULL && pos < size;) {
+        while (pos < size && file->data[pos] == '\n') pos++;
+        if (pos == size) break;
+        const char *start = file->data + pos;
+        const char *blank = memmem(start, size - pos, "\n\n", 2);
+        size_t len = blank != NULL ? (size_t)(blank - start) + 1 : size - pos;
+        pos += len;
+
+        size_t name_len;
+        const char *name = stanza_package(start, len, &name_len);
+        if (name == NULL) continue;
+        if (file->count == capacity) {
+            capacity *= 2;
+            struct scanned_stanza *bigger = realloc(file->stanzas, capacity * sizeof(*bigger));
+            if (bigger == NULL) break;
+            file->stanzas = bigger;
+        }
+        file->stanzas[file->count++] = (struct scanned_stanza){
+            .package = name, .package_len = name_len, .file = index,
+            .offset = (uint64_t)(start - file->data), .length = len,
+        };
+    }
+}
+
+/**
+ * Flags of the suite a Packages file comes from. Its Release (or InRelease)
+ * file shares the longest name prefix: "..._dists_bookworm-backports_InRelease"
+ * for "..._dists_bookworm-backports_main_binary-amd64_Packages". Suites that
+ * also say ButAutomaticUpgrades do deliver upgrades and are not flagged.
+ */
+static uint32_t suite_flags(const char *name) {
+    char path[PATH_MAX], head[16384];
+    for (size_t len = strlen(name); len > 0; len--) {
+        if (name[len - 1] != '_') continue;
+        for (int signed_release = 1; signed_release >= 0; signed_release--) {
+            snprintf(path, sizeof(path), APT_LISTS_DIR "/%.*s%s", (int)len, name, signed_release ? "InRelease" : "Release");
+            int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd == -1) continue;
+            ssize_t n = read(fd, head, sizeof(head) - 1); // The fields come before the long checksum lists
+            close(fd);
+            if (n <= 0) return 0;
+            head[n] = '\0';
+            return strstr(head, "\nNotAutomatic: yes\n") != NULL && strstr(head, "\nButAutomaticUpgrades: yes\n") == NULL
+                ? APT_LISTS_NOT_AUTOMATIC : 0;
+        }
+    }
+    return 0;
+}
+
+static void *scan_worker(void *arg) {
+    struct scan_job *job = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) break;
+        scan_packages_file(&job->files[i], (uint32_t)i);
+        job->files[i].flags = suite_flags(job->files[i].name);
+    }
+    return NULL;
+}
+
+static void scan_in_parallel(struct packages_file *files, size_t count) {
+    struct scan_job job = { .files = files, .count = count };
+    atomic_init(&job.next, 0);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = cpus > 1 ? (size_t)cpus : 1;
+    if (thread_count > count) thread_count = count ? count : 1;
+    if (thread_count > SCAN_MAX_THREADS) thread_count = SCAN_MAX_THREADS;
+
+    pthread_t threads[SCAN_MAX_THREADS];
+    size_t started = 0;
+    for (; started < thread_count - 1; started++) {
+        if (pthread_create(&threads[started], NULL, scan_worker, &job) != 0) break;
+    }
+    scan_worker(&job); // The calling thread works too
+    for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+}
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static void set_views(struct apt_lists *lists) {
+    lists->header = (const struct apt_lists_header *)lists->image;
+    lists->files = (const struct apt_lists_file *)(lists->image + lists->header->files_offset);
+    lists->stanzas = (const struct apt_lists_stanza *)(lists->image + lists->header->stanzas_offset);
+    lists->strings = (const char *)(lists->image + lists->header->strings_offset);
+}
+
+static int compare_scanned(const void *a, const void *b) {
+    const struct scanned_stanza *x = *(const struct scanned_stanza *const *)a;
+    const struct scanned_stanza *y = *(const struct scanned_stanza *const *)b;
+    size_t len = x->package_len < y->package_len ? x->package_len : y->package_len;
+    int cmp = memcmp(x->package, y->package, len);
+    if (cmp != 0) return cmp;
+    if (x->package_len != y->package_len) return x->package_len < y->package_len ? -1 : 1;
+    if (x->file != y->file) return x->file < y->file ? -1 : 1;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+static int same_package(const struct scanned_stanza *a, const struct scanned_stanza *b) {
+    return a->package_len == b->package_len && memcmp(a->package, b->package, a->package_len) == 0;
+}
+
+/** Lays the scanned files out as an index image; a package in several lists stores its name once. */
+static int build_image(struct packages_file *files, size_t count, struct apt_lists *lists) {
+    size_t stanza_count = 0, strings_size = 1;
+    for (size_t i = 0; i < count; i++) {
+        stanza_count += files[i].count;
+        strings_size += strlen(files[i].name) + 1;
+    }
+    const struct scanned_stanza **sorted = malloc((stanza_count ? stanza_count : 1) * sizeof(*sorted));
+    if (sorted == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while indexing the apt lists\n");
+        return -1;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < count; i++) {
+        for (size_t j = 0; j < files[i].count; j++) sorted[n++] = &files[i].stanzas[j];
+    }
+    qsort(sorted, n, sizeof(*sorted), compare_scanned);
+    for (size_t i = 0; i < n; i++) {
+        if (i == 0 || !same_package(sorted[i - 1], sorted[i])) strings_size += sorted[i]->package_len + 1;
+    }
+    if (strings_size >= UINT32_MAX) {
+        fprintf(stderr, ERROR_PREFIX "apt lists too large to index\n");
+        free(sorted);
+        return -1;
+    }
+
+    struct apt_lists_header header = {
+        .magic = APT_LISTS_MAGIC,
+        .header_size = sizeof(header),
+        .file_count = (uint32_t)count,
+        .stanza_count = (uint32_t)n,
+    };
+    header.files_offset = align8(sizeof(header));
+    header.stanzas_offset = align8(header.files_offset + count * sizeof(struct apt_lists_file));
+    header.strings_offset = align8(header.stanzas_offset + n * sizeof(struct apt_lists_stanza));
+    header.total_size = header.strings_offset + strings_size;
+
+    unsigned char *image = calloc(1, header.total_size);
+    if (image == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while indexing the apt lists\n");
+        free(sorted);
+        return -1;
+    }
+    memcpy(image, &header, sizeof(header));
+    struct apt_lists_file *out_files = (struct apt_lists_file *)(image + header.files_offset);
+    struct apt_lists_stanza *stanzas = (struct apt_lists_stanza *)(image + header.stanzas_offset);
+    char *strings = (char *)(image + header.strings_offset);
+
+    size_t str = 1; // Offset 0 is ""
+    for (size_t i = 0; i < count; i++) {
+        size_t len = strlen(files[i].name) + 1;
+        memcpy(strings + str, files[i].name, len);
+        out_files[i] = (struct apt_lists_file){
+            .name = (uint32_t)str, .flags = files[i].flags, .size = (uint64_t)files[i].st.st_size,
+            .mtime_sec = files[i].st.st_mtim.tv_sec, .mtime_nsec = files[i].st.st_mtim.tv_nsec,
+        };
+        str += len;
+    }
+    uint32_t name = 0;
+    for (size_t i = 0; i < n; i++) {
+        const struct scanned_stanza *s = sorted[i];
+        if (i == 0 || !same_package(sorted[i - 1], s)) {
+            name = (uint32_t)str;
+            memcpy(strings + str, s->package, s->package_len);
+            str += s->package_len + 1;
+        }
+        stanzas[i] = (struct apt_lists_stanza){ .package = name, .file = s->file, .offset = s->offset, .length = s->length };
+    }
+    free(sorted);
+
+    lists->image = image;
+    lists->size = header.total_size;
+    lists->mapped = 0;
+    set_views(lists);
+    return 0;
+}
+
+/** Whether the image was built from exactly these files, at these sizes and mtimes. */
+static int keys_match(const unsigned char *image, const struct packages_file *files, size_t count) {
+    const struct apt_lists_header *h = (const struct apt_lists_header *)image;
+    if (h->file_count != count) return 0;
+    const struct apt_lists_file *cached = (const struct apt_lists_file *)(image + h->files_offset);
+    const char *strings = (const char *)(image + h->strings_offset);
+    for (size_t i = 0; i < count; i++) {
+        if (cached[i].size != (uint64_t)files[i].st.st_size || cached[i].mtime_sec != files[i].st.st_mtim.tv_sec
+            || cached[i].mtime_nsec != files[i].st.st_mtim.tv_nsec || strcmp(strings + cached[i].name, files[i].name) != 0) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Whether every file and stanza of a cached image points inside it (and
+ * inside the Packages file it names); lookups trust these values, so a damaged
+ * cache file has to be caught here.
+ */
+static int image_in_bounds(const struct apt_lists *lists) {
+    const struct apt_lists_header *h = lists->header;
+    uint64_t strings_size = lists->size - h->strings_offset; // The image ends in '\0', so every string is terminated
+    for (uint32_t i = 0; i < h->file_count; i++) {
+        if (lists->files[i].name >= strings_size) return 0;
+    }
+    for (uint32_t i = 0; i < h->stanza_count; i++) {
+        const struct apt_lists_stanza *s = &lists->stanzas[i];
+        if (s->package >= strings_size || s->file >= h->file_count || s->offset > lists->files[s->file].size
+            || s->length > lists->files[s->file].size - s->offset) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int load_cache(const char *path, const struct packages_file *files, size_t count, struct apt_lists *lists) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct apt_lists_header)) {
+        close(fd);
+        return -1;
+    }
+    void *image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return -1;
+
+    const struct apt_lists_header *h = image;
+    size_t size = (size_t)st.st_size;
+    int valid = memcmp(h->magic, APT_LISTS_MAGIC, sizeof(h->magic)) == 0
+        && h->header_size == sizeof(*h) && h->total_size == size
+        && h->files_offset >= sizeof(*h) && h->strings_offset < size
+        && (h->files_offset | h->stanzas_offset | h->strings_offset) % 8 == 0
+        && h->files_offset <= h->stanzas_offset && h->stanzas_offset <= h->strings_offset
+        && h->files_offset + (uint64_t)h->file_count * sizeof(struct apt_lists_file) <= h->stanzas_offset
+        && h->stanzas_offset + (uint64_t)h->stanza_count * sizeof(struct apt_lists_stanza) <= h->strings_offset
+        && ((const char *)image)[size - 1] == '\0';
+    if (valid) {
+        lists->image = image;
+        lists->size = size;
+        lists->mapped = 1;
+        set_views(lists);
+        valid = image_in_bounds(lists) && keys_match(image, files, count);
+    }
+    if (!valid) {
+        munmap(image, size);
+        memset(lists, 0, sizeof(*lists));
+        return -1;
+    }
+    return 0;
+}
+
+int apt_lists_open(struct apt_lists *lists) {
+    memset(lists, 0, sizeof(*lists));
+    size_t count = 0;
+    struct packages_file *files = collect_packages_files(&count);
+    if (files == NULL) return -1;
+
+    char cache_path[PATH_MAX];
+    int have_cache_path = user_cache_path(APT_LISTS_CACHE_NAME, cache_path, sizeof(cache_path)) == 0;
+    if (have_cache_path && load_cache(cache_path, files, count, lists) == 0) {
+        free_packages_files(files, count);
+        return 0;
+    }
+
+    scan_in_parallel(files, count);
+    int rc = build_image(files, count, lists);
+    free_packages_files(files, count);
+
+    // Best effort, as for the file index: without a cache the next lookup scans again.
+    if (rc == 0 && have_cache_path) write_cache_file(cache_path, lists->image, lists->size);
+    return rc;
+}
+
+void apt_lists_close(struct apt_lists *lists) {
+    if (lists->image != NULL) {
+        if (lists->mapped) munmap((void *)lists->image, lists->size);
+        else free((void *)lists->image);
+    }
+    memset(lists, 0, sizeof(*lists));
+}
+
+long apt_lists_find(const struct apt_lists *lists, const char *package) {
+    size_t lo = 0, hi = lists->header->stanza_count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (strcmp(apt_lists_string(lists, lists->stanzas[mid].package), package) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == lists->header->stanza_count || strcmp(apt_lists_string(lists, lists->stanzas[lo].package), package) != 0) {
+        return -1;
+    }
+    return (long)lo;
+}
+
+char *apt_lists_read_stanza(const struct apt_lists *lists, const struct apt_lists_stanza *stanza) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), APT_LISTS_DIR "/%s", apt_lists_string(lists, lists->files[stanza->file].name));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        fprintf(stderr, ERROR_PREFIX "Cannot open %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    char *text = stanza->length < SIZE_MAX ? malloc((size_t)stanza->length + 1) : NULL;
+    size_t got = 0;
+    while (text != NULL && got < stanza->length) {
+        ssize_t n = pread(fd, text + got, (size_t)stanza->length - got, (off_t)(stanza->offset + got));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (text == NULL || got != stanza->length) {
+        fprintf(stderr, ERROR_PREFIX "Cannot read %s\n", path);
+        free(text);
+        return NULL;
+    }
+    text[got] = '\0';
+    return text;
+}
+
+/**
+ * `apt-show <package> [Field...]`: every stanza the apt lists have for the
+ * package (one per version and architecture), separated by blank lines like
+ * `apt-cache show`, or only the given fields of each as "Field: value" lines.
+ */
+int handle_apt_show(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s apt-show <package> [Field...]\n", argv[0]);
+        return 1;
+    }
+
+    struct apt_lists lists;
+    if (apt_lists_open(&lists) != 0) return 1;
+    long first = apt_lists_find(&lists, argv[2]);
+    if (first < 0) {
+        fprintf(stderr, ERROR_PREFIX "No package %s in the apt lists\n", argv[2]);
+        apt_lists_close(&lists);
+        return 1;
+    }
+
+    int rc = 0;
+    uint32_t name = lists.stanzas[first].package;
+    for (uint32_t i = (uint32_t)first; i < lists.header->stanza_count && lists.stanzas[i].package == name; i++) {
+        char *stanza = apt_lists_read_stanza(&lists, &lists.stanzas[i]);
+        if (stanza == NULL) {
+            rc = 1;
+            continue;
+        }
+        if (argc == 3) {
+            fputs(stanza, stdout);
+        } else {
+            for (int j = 3; j < argc; j++) {
+                size_t value_len;
+                const char *value = control_find_field(stanza, argv[j], &value_len);
+                if (value == NULL) continue;
+                const char *line = value;
+                while (line > stanza && line[-1] != '\n') line--;
+                printf("%.*s: %.*s\n", (int)strlen(argv[j]), line, (int)value_len, value);
+            }
+        }
+        putchar('\n');
+        free(stanza);
+    }
+    apt_lists_close(&lists);
+    return fflush(stdout) == 0 ? rc : 1;
+}
@@ -0,0 +1,75 @@
+#ifndef APT_LISTS_H
+#define APT_LISTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define APT_LISTS_DIR "/var/lib/apt/lists"
+#define APT_LISTS_CACHE_NAME "nano-installer/apt-lists-index.bin" // Under $XDG_CACHE_HOME or ~/.cache
+#define APT_LISTS_MAGIC "NANOAPL2"
+
+/*
+ * Where each package's stanzas are in the downloaded Packages files, as one
+ * flat image identical in memory and in the cache file:
+ *
+ *   header | files[] (sorted by name) | stanzas[] (sorted by package) | strings
+ *
+ * The cache is valid while every Packages file still has the recorded size
+ * and mtime; apt replaces them by renaming, so an update changes both.
+ */
+struct apt_lists_header {
+    char magic[8];
+    uint32_t header_size;
+    uint32_t file_count;
+    uint32_t stanza_count;
+    uint32_t reserved;
+    uint64_t files_offset, stanzas_offset, strings_offset;
+    uint64_t total_size;
+};
+
+#define APT_LISTS_NOT_AUTOMATIC 1 // From a suite whose Release says NotAutomatic (e.g. backports)
+
+struct apt_lists_file {
+    uint32_t name;  // String offset, the file name within APT_LISTS_DIR
+    uint32_t flags; // APT_LISTS_*
+    uint64_t size;
+    int64_t mtime_sec, mtime_nsec;
+};
+
+struct apt_lists_stanza {
+    uint32_t package; // String offset
+    uint32_t file;    // Index into files[]
+    uint64_t offset;  // Where the stanza starts in that file
+    uint64_t length;  // Up to, not including, the blank line that ends it
+};
+
+struct apt_lists {
+    const unsigned char *image;
+    size_t size;
+    int mapped; // 1 if image is an mmap of the cache file, 0 if heap-allocated
+    const struct apt_lists_header *header;
+    const struct apt_lists_file *files;
+    const struct apt_lists_stanza *stanzas;
+    const char *strings;
+};
+
+/**
+ * Opens the index: the cached image if the Packages files are unchanged,
+ * otherwise a fresh parallel scan of them, which is then written back to the
+ * cache. No lists at all (apt update never ran) is an empty index, not an
+ * error. Prints an ERROR_PREFIX message and returns -1 on failure.
+ */
+int apt_lists_open(struct apt_lists *lists);
+void apt_lists_close(struct apt_lists *lists);
+
+/** Index of the package's first stanza (the others follow it), or -1 if no list has it. */
+long apt_lists_find(const struct apt_lists *lists, const char *package);
+
+/** Reads a stanza into a NUL-terminated buffer the caller frees; NULL (with an ERROR_PREFIX message) on failure. */
+char *apt_lists_read_stanza(const struct apt_lists *lists, const struct apt_lists_stanza *stanza);
+
+static inline const char *apt_lists_string(const struct apt_lists *lists, uint32_t offset) {
+    return lists->strings + offset;
+}
+
+#endif // APT_LISTS_H
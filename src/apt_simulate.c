@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "apt_lists.h"
+
+/*
+ * `apt-op simulate`: what an install would do, before anything is done.
+ *
+ * apt-get's no-act mode (-s) resolves the transaction exactly as the real
+ * install would and prints one record per step:
+ *
+ *     Inst <package> [<installed version>] (<new version> <origins> [<arch>])
+ *     Conf <package> (<new version> <origins> [<arch>])
+ *     Remv <package> [<installed version>]
+ *     Purg <package> [<installed version>]
+ *
+ * Those records are turned into the plan here, one line per package:
+ *
+ *     <install|upgrade|downgrade|reinstall|remove|purge>\t<package>\t<arch|->\t<old|->\t<new|->\t<download bytes>
+ *
+ * followed by "summary\t<installs>\t<upgrades and downgrades>\t<removals>\t<download bytes>".
+ * Download sizes come from the apt lists index (see apt_lists.c); a local .deb
+ * is not downloaded and counts as 0.
+ */
+
+#define SIMULATE_OUTPUT_MAX (64 * 1024 * 1024)
+
+struct plan_totals {
+    unsigned long installs, upgrades, removals;
+    unsigned long long download;
+};
+
+/** Runs apt-get and collects its stdout; its stderr (the reasons a transaction is impossible) passes through. */
+static char *run_apt_get(char *args[], int *exit_status) {
+    int out_pipe[2];
+    if (pipe(out_pipe) == -1) {
+        perror("pipe failed");
+        return NULL;
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return NULL;
+    }
+    if (pid == 0) {
+        dup2(out_pipe[1], STDOUT_FILENO);
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        setenv("LC_ALL", "C", 1); // The records are not translated, but the surrounding text would be
+        setenv("DEBIAN_FRONTEND", "noninteractive", 1);
+        execv(args[0], args);
+        perror("execv failed");
+        _exit(127);
+    }
+    close(out_pipe[1]);
+
+    size_t len = 0, cap = 65536;
+    char *text = malloc(cap);
+    for (;;) {
+        if (text != NULL && len + 1 == cap) {
+            char *grown = cap < SIMULATE_OUTPUT_MAX ? realloc(text, cap * 2) : NULL;
+            if (grown == NULL) {
+                free(text);
+                text = NULL;
+            } else {
+                text = grown;
+                cap *= 2;
+            }
+        }
+        char discard[4096];
+        ssize_t n = text != NULL ? read(out_pipe[0], text + len, cap - len - 1) : read(out_pipe[0], discard, sizeof(discard));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        if (text != NULL) len += (size_t)n;
+    }
+    close(out_pipe[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+    *exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+    if (text == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while reading the simulation\n");
+        return NULL;
+    }
+    text[len] = '\0';
+    return text;
+}
+
+/** Size field of the listed stanza with this version and architecture; 0 if the lists do not have it. */
+static unsigned long long download_size(const struct apt_lists *lists, const char *package, const char *version,
+                                        const char *arch) {
+    long first = lists != NULL ? apt_lists_find(lists, package) : -1;
+    if (first < 0) return 0;
+    uint32_t name = lists->stanzas[first].package;
+    for (uint32_t i = (uint32_t)first; i < lists->header->stanza_count && lists->stanzas[i].package == name; i++) {
+        char *stanza = apt_lists_read_stanza(lists, &lists->stanzas[i]);
+        if (stanza == NULL) continue;
+        size_t version_len = 0, arch_len = 0, size_len = 0;
+        const char *v = control_find_field(stanza, "Version", &version_len);
+        const char *a = control_find_field(stanza, "Architecture", &arch_len);
+        const char *size = control_find_field(stanza, "Size", &size_len);
+        int match = v != NULL && a != NULL && size != NULL && version_len == strlen(version)
+            && strncmp(v, version, version_len) == 0 && arch_len == strlen(arch) && strncmp(a, arch, arch_len) == 0;
+        unsigned long long bytes = match ? strtoull(size, NULL, 10) : 0;
+        free(stanza);
+        if (match) return bytes;
+    }
+    return 0;
+}
+
+/** Copies the next "[...]" or "(...)" group of a record into buf; returns where parsing goes on, or NULL. */
+static const char *take_group(const char *p, char open, char close, char *buf, size_t size) {
+    while (*p == ' ') p++;
+    if (*p != open) return NULL;
+    const char *end = strchr(p + 1, close);
+    if (end == NULL) return NULL;
+    snprintf(buf, size, "%.*s", (int)(end - p - 1), p + 1);
+    return end + 1;
+}
+
+/** Turns one Inst/Remv/Purg record into a plan line; other lines (Conf, apt's chatter) are skipped. */
+static void plan_record(const char *line, const struct apt_lists *lists, struct plan_totals *totals) {
+    int inst = strncmp(line, "Inst ", 5) == 0;
+    int purge = strncmp(line, "Purg ", 5) == 0;
+    if (!inst && !purge && strncmp(line, "Remv ", 5) != 0) return;
+
+    char package[256], old_version[256] = "", details[1024] = "";
+    const char *p = line + 5;
+    size_t name_len = strcspn(p, " ");
+    if (name_len == 0 || name_len >= sizeof(package)) return;
+    snprintf(package, sizeof(package), "%.*s", (int)name_len, p);
+    p += name_len;
+    const char *after_old = take_group(p, '[', ']', old_version, sizeof(old_version));
+    if (after_old != NULL) p = after_old;
+
+    if (!inst) {
+        printf("%s\t%s\t-\t%s\t-\t0\n", purge ? "purge" : "remove", package, old_version[0] ? old_version : "-");
+        totals->removals++;
+        return;
+    }
+
+    // "(<new version> <origin>... [<arch>])": the version comes first, the architecture last.
+    if (take_group(p, '(', ')', details, sizeof(details)) == NULL) return;
+    char new_version[256], arch[64] = "-";
+    size_t version_len = strcspn(details, " ");
+    snprintf(new_version, sizeof(new_version), "%.*s", (int)version_len, details);
+    const char *open = strrchr(details, '[');
+    if (open != NULL && strchr(open, ']') != NULL) snprintf(arch, sizeof(arch), "%.*s", (int)(strchr(open, ']') - open - 1), open + 1);
+    int local = strstr(details, " local-deb") != NULL;
+
+    const char *action = "install";
+    if (old_version[0]) {
+        int cmp = deb_version_compare(new_version, old_version);
+        action = cmp > 0 ? "upgrade" : cmp < 0 ? "downgrade" : "reinstall";
+    }
+    // Foreign-architecture packages are shown as "name:arch"; the lists know them by name.
+    char list_name[256];
+    snprintf(list_name, sizeof(list_name), "%.*s", (int)strcspn(package, ":"), package);
+    unsigned long long bytes = local ? 0 : download_size(lists, list_name, new_version, arch);
+    printf("%s\t%s\t%s\t%s\t%s\t%llu\n", action, package, arch, old_version[0] ? old_version : "-", new_version, bytes);
+    if (old_version[0]) totals->upgrades++;
+    else totals->installs++;
+    totals->download += bytes;
+}
+
+int apt_simulate_install(char *debs[], int count, int reinstall) {
+    char *args[MAX_ARGS + MAX_BATCH_DEBS];
+    int n = 0;
+    args[n++] = "/usr/bin/apt-get";
+    args[n++] = "-s";
+    args[n++] = "-q";
+    args[n++] = "install";
+    if (reinstall) args[n++] = "--reinstall";
+    for (int i = 0; i < count; i++) args[n++] = debs[i];
+    args[n] = NULL;
+
+    int status = 1;
+    char *output = run_apt_get(args, &status);
+    if (output == NULL) return 1;
+    if (status != 0) {
+        fprintf(stderr, ERROR_PREFIX "apt cannot carry out this installation (exit status %d)\n", status);
+        free(output);
+        return 1;
+    }
+
+    // Sizes are only a nicety: without the lists index the plan is still complete.
+    struct apt_lists lists;
+    int have_lists = apt_lists_open(&lists) == 0;
+    struct plan_totals totals = { 0, 0, 0, 0 };
+    for (char *line = output; line != NULL && *line;) {
+        char *nl = strchr(line, '\n');
+        if (nl != NULL) *nl = '\0';
+        plan_record(line, have_lists ? &lists : NULL, &totals);
+        line = nl != NULL ? nl + 1 : NULL;
+    }
+    printf("summary\t%lu\t%lu\t%lu\t%llu\n", totals.installs, totals.upgrades, totals.removals, totals.download);
+    if (have_lists) apt_lists_close(&lists);
+    free(output);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
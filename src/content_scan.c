@@ -0,0 +1,376 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "aho_corasick.h"
+
+/*
+ * Offline content scanner: every file in control.tar and data.tar is streamed
+ * through Aho-Corasick matchers built from a local rule file, so a package can
+ * be checked without network access.
+ *
+ * Rule file lines (blank lines and #-comments are ignored):
+ *
+ *     <danger|suspicious|info> <any|scripts|data> <text|itext|hex> <name> <pattern>
+ *
+ * scripts covers the control.tar members (maintainer scripts, triggers, ...),
+ * data the installed files. text patterns are the literal rest of the line,
+ * itext is the same matched case-insensitively, hex is byte values ("7f 45 4c 46").
+ * All rules of one case mode share a single DFA, so each byte is one table
+ * lookup no matter how many rules there are; that is well ahead of gzip/xz
+ * decompression, which the scan shares a thread with.
+ *
+ * Output, one line per rule and file that matched, then a summary:
+ *
+ *     hit\t<severity>\t<rule>\t<path>\t<offset of first match>\t<matches>
+ *     summary\t<files>\t<bytes>\t<rules>
+ */
+
+#define SCAN_RULES_MAX_SIZE (4 * 1024 * 1024)
+#define SCAN_PATTERN_MAX 1024
+#define SCAN_PROGRESS_INTERVAL 0.1 // Seconds between progress records
+
+enum rule_scope { SCOPE_ANY, SCOPE_SCRIPTS, SCOPE_DATA };
+
+static const char *const severity_names[] = { "info", "suspicious", "danger" };
+static const char *const scope_names[] = { "any", "scripts", "data" };
+
+struct scan_rule {
+    const char *name;
+    int severity; // Index into severity_names
+    enum rule_scope scope;
+    size_t len;
+};
+
+/** One matcher per case mode, with a map from its pattern numbers back to rules. */
+struct rule_matcher {
+    struct ac_matcher ac;
+    size_t *rule_of;
+    size_t count;
+};
+
+struct rule_set {
+    char *text; // Rule file contents; names point into it
+    struct scan_rule *rules;
+    size_t count;
+    struct rule_matcher exact, folded;
+};
+
+struct content_scan {
+    struct rule_set *set;
+    enum rule_scope area;
+    char path[TAR_PATH_MAX + 16];
+    uint32_t *counts; // Per rule, for the current file
+    uint64_t *first;
+    size_t *touched;  // Rules with a nonzero count
+    size_t touched_count;
+    uint64_t files, bytes;
+    int progress;
+    const char *name;
+    uint64_t total;
+    uint64_t *archive_pos;
+    struct timespec started;
+    double last_report;
+};
+
+static int parse_severity(const char *word) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(word, severity_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int parse_scope(const char *word) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(word, scope_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    c = (char)tolower((unsigned char)c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+/** Decodes a hex pattern in place; returns its length or -1. */
+static long decode_hex(char *text) {
+    size_t out = 0;
+    for (char *p = text; *p != '\0';) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+            continue;
+        }
+        int hi = hex_value(p[0]), lo = p[1] ? hex_value(p[1]) : -1;
+        if (hi < 0 || lo < 0) return -1;
+        text[out++] = (char)(hi << 4 | lo);
+        p += 2;
+    }
+    return (long)out;
+}
+
+static char *next_word(char **cursor) {
+    char *p = *cursor;
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '\0') return NULL;
+    char *word = p;
+    while (*p != '\0' && *p != ' ' && *p != '\t') p++;
+    if (*p != '\0') *p++ = '\0';
+    while (*p == ' ' || *p == '\t') p++;
+    *cursor = p;
+    return word;
+}
+
+static int build_matcher(struct rule_matcher *m, const char **patterns, const size_t *lengths, int fold) {
+    if (m->count == 0) return 0;
+    return ac_build(&m->ac, patterns, lengths, m->count, fold);
+}
+
+static void free_rule_set(struct rule_set *set) {
+    if (set->exact.count) ac_free(&set->exact.ac);
+    if (set->folded.count) ac_free(&set->folded.ac);
+    free(set->exact.rule_of);
+    free(set->folded.rule_of);
+    free(set->rules);
+    free(set->text);
+}
+
+static int load_rules(const char *path, struct rule_set *set) {
+    memset(set, 0, sizeof(*set));
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Cannot open rule file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    set->text = malloc(SCAN_RULES_MAX_SIZE + 1);
+    size_t len = set->text ? fread(set->text, 1, SCAN_RULES_MAX_SIZE + 1, f) : 0;
+    fclose(f);
+    if (set->text == NULL || len > SCAN_RULES_MAX_SIZE) {
+        fprintf(stderr, ERROR_PREFIX "Rule file %s is too large\n", path);
+        free(set->text);
+        return -1;
+    }
+    set->text[len] = '\0';
+
+    size_t max_rules = 1;
+    for (size_t i = 0; i < len; i++) max_rules += set->text[i] == '\n';
+    set->rules = calloc(max_rules, sizeof(*set->rules));
+    const char **exact_patterns = calloc(max_rules, sizeof(*exact_patterns));
+    const char **folded_patterns = calloc(max_rules, sizeof(*folded_patterns));
+    size_t *exact_lengths = calloc(max_rules, sizeof(*exact_lengths));
+    size_t *folded_lengths = calloc(max_rules, sizeof(*folded_lengths));
+    set->exact.rule_of = calloc(max_rules, sizeof(size_t));
+    set->folded.rule_of = calloc(max_rules, sizeof(size_t));
+    int rc = -1;
+    if (!set->rules || !exact_patterns || !folded_patterns || !exact_lengths || !folded_lengths
+        || !set->exact.rule_of || !set->folded.rule_of) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        goto done;
+    }
+
+    int line_no = 0;
+    for (char *line = set->text, *next; line != NULL; line = next) {
+        next = strchr(line, '\n');
+        if (next) *next++ = '\0';
+        line_no++;
+        line[strcspn(line, "\r")] = '\0';
+
+        char *cursor = line;
+        char *severity = next_word(&cursor);
+        if (severity == NULL || severity[0] == '#') continue;
+        char *scope = next_word(&cursor), *kind = next_word(&cursor), *name = next_word(&cursor);
+        char *pattern = cursor;
+        struct scan_rule *rule = &set->rules[set->count];
+        int sev = parse_severity(severity), scp = scope ? parse_scope(scope) : -1;
+        long pattern_len = -1;
+        if (kind != NULL && name != NULL && pattern[0] != '\0') {
+            if (strcmp(kind, "hex") == 0) pattern_len = decode_hex(pattern);
+            else if (strcmp(kind, "text") == 0 || strcmp(kind, "itext") == 0) pattern_len = (long)strlen(pattern);
+        }
+        if (sev < 0 || scp < 0 || pattern_len <= 0 || pattern_len > SCAN_PATTERN_MAX) {
+            fprintf(stderr, ERROR_PREFIX "%s:%d: invalid rule\n", path, line_no);
+            goto done;
+        }
+        rule->name = name;
+        rule->severity = sev;
+        rule->scope = (enum rule_scope)scp;
+        rule->len = (size_t)pattern_len;
+
+        struct rule_matcher *m = strcmp(kind, "itext") == 0 ? &set->folded : &set->exact;
+        const char **patterns = m == &set->folded ? folded_patterns : exact_patterns;
+        size_t *lengths = m == &set->folded ? folded_lengths : exact_lengths;
+        patterns[m->count] = pattern;
+        lengths[m->count] = rule->len;
+        m->rule_of[m->count++] = set->count++;
+    }
+    if (set->count == 0) {
+        fprintf(stderr, ERROR_PREFIX "Rule file %s has no rules\n", path);
+        goto done;
+    }
+    if (build_matcher(&set->exact, exact_patterns, exact_lengths, 0) != 0
+        || build_matcher(&set->folded, folded_patterns, folded_lengths, 1) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        goto done;
+    }
+    rc = 0;
+
+done:
+    free(exact_patterns);
+    free(folded_patterns);
+    free(exact_lengths);
+    free(folded_lengths);
+    if (rc != 0) {
+        // The matchers are only built once every rule parsed, so nothing to undo there.
+        set->exact.count = set->folded.count = 0;
+        free_rule_set(set);
+    }
+    return rc;
+}
+
+static void report_progress(struct content_scan *scan, int done) {
+    if (!scan->progress || scan->total == 0) return;
+    double elapsed = seconds_since(&scan->started);
+    if (!done && elapsed - scan->last_report < SCAN_PROGRESS_INTERVAL) return;
+    scan->last_report = elapsed;
+
+    uint64_t pos = *scan->archive_pos;
+    double rate = elapsed > 0 ? (double)scan->bytes / elapsed : 0;
+    double archive_rate = elapsed > 0 ? (double)pos / elapsed : 0;
+    double left = (double)(scan->total > pos ? scan->total - pos : 0);
+    char message[96];
+    snprintf(message, sizeof(message), "%llu files, %.0f MB/s", (unsigned long long)scan->files, rate / 1e6);
+    emit_status_record("scan", scan->name, done ? 100.0 : 100.0 * (double)pos / (double)scan->total,
+                       archive_rate > 0 ? (long)(left / archive_rate + 0.5) : -1, message);
+}
+
+struct match_ctx {
+    struct content_scan *scan;
+    const struct rule_matcher *matcher;
+};
+
+static int record_match(size_t pattern, uint64_t end, void *ctx) {
+    struct match_ctx *m = ctx;
+    struct content_scan *scan = m->scan;
+    size_t rule = m->matcher->rule_of[pattern];
+    enum rule_scope scope = scan->set->rules[rule].scope;
+    if (scope != SCOPE_ANY && scope != scan->area) return 0;
+    if (scan->counts[rule]++ == 0) {
+        scan->first[rule] = end - scan->set->rules[rule].len;
+        scan->touched[scan->touched_count++] = rule;
+    }
+    return 0;
+}
+
+static int scan_entry(struct tar_entry *entry, void *ctx) {
+    struct content_scan *scan = ctx;
+    if (entry->type != '0' && entry->type != '\0' && entry->type != '7') return 0;
+    snprintf(scan->path, sizeof(scan->path), "%s%s", scan->area == SCOPE_SCRIPTS ? "DEBIAN/" : "/",
+             tar_entry_name(entry));
+
+    struct rule_set *set = scan->set;
+    struct match_ctx exact = { scan, &set->exact }, folded = { scan, &set->folded };
+    uint32_t exact_state = 0, folded_state = 0;
+    unsigned char buf[DEB_STREAM_CHUNK];
+    uint64_t offset = 0;
+    for (;;) {
+        ssize_t n = tar_read_data(entry, buf, sizeof(buf));
+        if (n < 0) return -1;
+        if (n == 0) break;
+        if (set->exact.count) ac_scan(&set->exact.ac, &exact_state, buf, (size_t)n, offset, record_match, &exact);
+        if (set->folded.count) ac_scan(&set->folded.ac, &folded_state, buf, (size_t)n, offset, record_match, &folded);
+        offset += (uint64_t)n;
+        scan->bytes += (uint64_t)n;
+        report_progress(scan, 0);
+    }
+    if (entry->remaining != 0) return -1; // Truncated
+
+    scan->files++;
+    for (size_t i = 0; i < scan->touched_count; i++) {
+        size_t rule = scan->touched[i];
+        printf("hit\t%s\t%s\t%s\t%llu\t%u\n", severity_names[set->rules[rule].severity], set->rules[rule].name,
+               scan->path, (unsigned long long)scan->first[rule], scan->counts[rule]);
+        scan->counts[rule] = 0;
+    }
+    scan->touched_count = 0;
+    return 0;
+}
+
+static int scan_member(struct deb_archive *deb, const char *prefix, struct content_scan *scan) {
+    if (deb_find_member(deb, prefix) != 1) {
+        fprintf(stderr, ERROR_PREFIX "Package has no %s member\n", prefix);
+        return -1;
+    }
+    struct deb_stream stream;
+    if (deb_stream_open(deb, &stream) != 0) return -1;
+    int rc = tar_walk(&stream, scan_entry, scan);
+    deb_stream_close(&stream);
+    if (rc < 0) fprintf(stderr, ERROR_PREFIX "Cannot read %s\n", deb->member.name);
+    return rc < 0 ? -1 : 0;
+}
+
+/**
+ * `deb-scan [--progress] --rules <rule file> <file.deb>`: matches every file of
+ * the package against the rules (see above). Exits 0 whenever the scan
+ * completed, matches or not.
+ */
+int handle_deb_scan(int argc, char *argv[]) {
+    const char *rules_path = NULL, *deb_path = NULL;
+    int progress = 0;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--progress") == 0) {
+            progress = 1;
+        } else if (strcmp(argv[i], "--rules") == 0 && i + 1 < argc) {
+            rules_path = argv[++i];
+        } else if (deb_path == NULL) {
+            deb_path = argv[i];
+        } else {
+            deb_path = NULL;
+            break;
+        }
+    }
+    if (rules_path == NULL || deb_path == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deb-scan [--progress] --rules <rule file> <file.deb>\n", argv[0]);
+        return 1;
+    }
+
+    struct rule_set set;
+    if (load_rules(rules_path, &set) != 0) return 1;
+    struct content_scan scan = { .set = &set, .progress = progress };
+    scan.counts = calloc(set.count, sizeof(*scan.counts));
+    scan.first = calloc(set.count, sizeof(*scan.first));
+    scan.touched = calloc(set.count, sizeof(*scan.touched));
+    struct deb_archive deb;
+    int rc = 1;
+    if (scan.counts == NULL || scan.first == NULL || scan.touched == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+    } else if (deb_open(deb_path, &deb) == 0) {
+        struct stat st;
+        if (fstat(deb.fd, &st) == 0) scan.total = (uint64_t)st.st_size;
+        scan.name = strrchr(deb_path, '/') ? strrchr(deb_path, '/') + 1 : deb_path;
+        scan.archive_pos = &deb.pos;
+        clock_gettime(CLOCK_MONOTONIC, &scan.started);
+
+        scan.area = SCOPE_SCRIPTS;
+        if (scan_member(&deb, "control.tar", &scan) == 0) {
+            scan.area = SCOPE_DATA;
+            if (scan_member(&deb, "data.tar", &scan) == 0) {
+                report_progress(&scan, 1);
+                printf("summary\t%llu\t%llu\t%zu\n", (unsigned long long)scan.files,
+                       (unsigned long long)scan.bytes, set.count);
+                rc = fflush(stdout) == 0 ? 0 : 1;
+            }
+        }
+        deb_close(&deb);
+    }
+    free(scan.counts);
+    free(scan.first);
+    free(scan.touched);
+    free_rule_set(&set);
+    return rc;
+}
@@ -0,0 +1,380 @@
+#define _GNU_SOURCE // For accept4() and struct ucred
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <limits.h> // For PATH_MAX
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "nano_backend.h"
+
+/*
+ * Persistent daemon mode.
+ *
+ * The GUI authenticates once through `sudo -S nano_backend daemon`; the daemon then
+ * listens on a per-user Unix socket and runs backend commands on request, so a chain
+ * like update -> install -> autoremove pays for sudo and PAM only once.
+ *
+ * Every message on the socket is a frame: 1 type byte, a 4-byte big-endian payload
+ * length, then the payload.
+ *   'R' (client) request: the command arguments (without argv[0]), each NUL-terminated.
+ *   'C' (client) cancel the running job. Closing the connection has the same effect.
+ *   'Q' (client) shut the daemon down.
+ *   'O' (daemon) a chunk of the job's combined stdout/stderr.
+ *   'S' (daemon) one or more progress records from the job's status channel (progress.c).
+ *   'X' (daemon) the job finished; payload is its exit code as a 4-byte big-endian int.
+ *
+ * Connections are served one at a time, which serializes jobs: a second client simply
+ * waits in the listen backlog until the current one disconnects.
+ */
+
+#define DAEMON_IDLE_TIMEOUT_SEC 300
+#define FRAME_HEADER_SIZE 5
+#define FRAME_MAX_PAYLOAD (MAX_BATCH_DEBS * PATH_MAX) // Room for a full install batch
+#define JOB_MAX_ARGS (MAX_ARGS + MAX_BATCH_DEBS)
+
+static int write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return -1; // Peer closed the connection
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int send_frame(int fd, char type, const void *payload, uint32_t len) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    header[0] = (unsigned char)type;
+    header[1] = (unsigned char)(len >> 24);
+    header[2] = (unsigned char)(len >> 16);
+    header[3] = (unsigned char)(len >> 8);
+    header[4] = (unsigned char)len;
+    if (write_all(fd, header, sizeof(header)) != 0) return -1;
+    if (len > 0 && write_all(fd, payload, len) != 0) return -1;
+    return 0;
+}
+
+/**
+ * Reads one frame into buf (which must hold FRAME_MAX_PAYLOAD + 1 bytes).
+ * Returns 0 on success, -1 on EOF, I/O error or an oversized frame.
+ */
+static int read_frame(int fd, char *type, char *buf, uint32_t *len) {
+    unsigned char header[FRAME_HEADER_SIZE];
+    if (read_all(fd, header, sizeof(header)) != 0) return -1;
+
+    *type = (char)header[0];
+    *len = ((uint32_t)header[1] << 24) | ((uint32_t)header[2] << 16) | ((uint32_t)header[3] << 8) | header[4];
+    if (*len > FRAME_MAX_PAYLOAD) return -1;
+    if (*len > 0 && read_all(fd, buf, *len) != 0) return -1;
+    buf[*len] = '\0';
+    return 0;
+}
+
+static int send_exit_frame(int fd, int code) {
+    unsigned char payload[4];
+    uint32_t value = (uint32_t)code;
+    payload[0] = (unsigned char)(value >> 24);
+    payload[1] = (unsigned char)(value >> 16);
+    payload[2] = (unsigned char)(value >> 8);
+    payload[3] = (unsigned char)value;
+    return send_frame(fd, 'X', payload, sizeof(payload));
+}
+
+/**
+ * Runs one request in a forked child and streams its output back as 'O' frames
+ * and its progress records as 'S' frames.
+ * Returns 0 if the connection is still usable afterwards, -1 otherwise.
+ */
+static int run_job(int conn, int listen_fd, char *payload, uint32_t len) {
+    char *job_argv[JOB_MAX_ARGS + 2];
+    int job_argc = 0;
+
+    // argv[0] is never sent by the client; the handlers only use it in usage messages.
+    job_argv[job_argc++] = "nano_backend";
+    for (uint32_t pos = 0; pos < len; ) {
+        if (job_argc > JOB_MAX_ARGS) {
+            const char *msg = ERROR_PREFIX "Too many arguments in daemon request.\n";
+            send_frame(conn, 'O', msg, strlen(msg));
+            return send_exit_frame(conn, 1);
+        }
+        job_argv[job_argc++] = payload + pos;
+        pos += strlen(payload + pos) + 1;
+    }
+    job_argv[job_argc] = NULL;
+
+    if (job_argc < 2 || len == 0 || payload[len - 1] != '\0' || strcmp(job_argv[1], "daemon") == 0) {
+        const char *msg = ERROR_PREFIX "Malformed daemon request.\n";
+        send_frame(conn, 'O', msg, strlen(msg));
+        return send_exit_frame(conn, 1);
+    }
+
+    int out_pipe[2];
+    int stat_pipe[2];
+    if (pipe(out_pipe) == -1) {
+        return send_exit_frame(conn, 1);
+    }
+    if (pipe(stat_pipe) == -1) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return send_exit_frame(conn, 1);
+    }
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        close(stat_pipe[0]);
+        close(stat_pipe[1]);
+        return send_exit_frame(conn, 1);
+    } else if (pid == 0) {
+        // Own process group, so cancellation can stop apt and dpkg along with the job.
+        setpgid(0, 0);
+        signal(SIGPIPE, SIG_DFL);
+        close(conn);
+        close(listen_fd);
+        close(out_pipe[0]);
+        dup2(out_pipe[1], STDOUT_FILENO);
+        dup2(out_pipe[1], STDERR_FILENO);
+        close(out_pipe[1]);
+        close(stat_pipe[0]);
+        status_fd = stat_pipe[1];
+
+        int rc = dispatch_command(job_argc, job_argv);
+        fflush(NULL);
+        _exit(rc);
+    }
+
+    setpgid(pid, pid); // Also set from the parent so an early cancel cannot miss the group
+    close(out_pipe[1]);
+    close(stat_pipe[1]);
+
+    int cancelled = 0;
+    int conn_alive = 1;
+    char chunk[4096];
+    struct pollfd fds[3] = {
+        { .fd = out_pipe[0], .events = POLLIN },
+        { .fd = stat_pipe[0], .events = POLLIN },
+        { .fd = conn, .events = POLLIN },
+    };
+
+    // Runs until the job's output pipe closes; the status pipe closes at the same time.
+    for (;;) {
+        if (!conn_alive) fds[2].fd = -1;
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (conn_alive && (fds[2].revents & (POLLIN | POLLHUP | POLLERR))) {
+            // The client only talks during a job to cancel it (or by disconnecting).
+            static char frame[FRAME_MAX_PAYLOAD + 1];
+            char type = 0;
+            uint32_t frame_len;
+            if (read_frame(conn, &type, frame, &frame_len) != 0) {
+                conn_alive = 0;
+            }
+            if (!cancelled && (!conn_alive || type == 'C')) {
+                kill(-pid, SIGTERM);
+                cancelled = 1;
+            }
+        }
+
+        if (fds[1].fd >= 0 && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t n = read(stat_pipe[0], chunk, sizeof(chunk));
+            if (n > 0) {
+                if (conn_alive) send_frame(conn, 'S', chunk, (uint32_t)n);
+            } else if (n == 0 || errno != EINTR) {
+                fds[1].fd = -1; // Stop polling the closed status pipe
+            }
+        }
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t n = read(out_pipe[0], chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            if (conn_alive && send_frame(conn, 'O', chunk, (uint32_t)n) != 0) {
+                conn_alive = 0;
+                if (!cancelled) {
+                    kill(-pid, SIGTERM);
+                    cancelled = 1;
+                }
+            }
+        }
+    }
+    close(out_pipe[0]);
+
+    // Forward records written just before the job exited.
+    if (fds[1].fd >= 0) {
+        ssize_t n;
+        while ((n = read(stat_pipe[0], chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR)) {
+            if (n > 0 && conn_alive) send_frame(conn, 'S', chunk, (uint32_t)n);
+        }
+    }
+    close(stat_pipe[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {}
+    int rc = WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+
+    if (!conn_alive) return -1;
+    return send_exit_frame(conn, rc);
+}
+
+/**
+ * Serves requests on one connection until the client disconnects.
+ * Returns 1 if the client asked the daemon to shut down.
+ */
+static int serve_connection(int conn, int listen_fd) {
+    static char payload[FRAME_MAX_PAYLOAD + 1]; // Too large for the stack
+    char type;
+    uint32_t len;
+
+    while (read_frame(conn, &type, payload, &len) == 0) {
+        if (type == 'Q') {
+            return 1;
+        } else if (type == 'R') {
+            if (run_job(conn, listen_fd, payload, len) != 0) break;
+        }
+        // Stray cancel frames between jobs are ignored.
+    }
+    return 0;
+}
+
+/**
+ * Creates the root-owned socket directory, refusing anything that is not a plain
+ * directory owned by root (e.g. a symlink planted by an unprivileged user).
+ */
+static int prepare_socket_dir(void) {
+    struct stat st;
+    if (mkdir(DAEMON_SOCKET_DIR, 0755) == -1 && errno != EEXIST) {
+        fprintf(stderr, ERROR_PREFIX "Cannot create %s: %s\n", DAEMON_SOCKET_DIR, strerror(errno));
+        return -1;
+    }
+    if (lstat(DAEMON_SOCKET_DIR, &st) == -1 || !S_ISDIR(st.st_mode) || st.st_uid != 0 || (st.st_mode & 022)) {
+        fprintf(stderr, ERROR_PREFIX "Refusing to use unsafe socket directory %s\n", DAEMON_SOCKET_DIR);
+        return -1;
+    }
+    return 0;
+}
+
+int handle_daemon(int argc, char *argv[]) {
+    int idle_timeout = DAEMON_IDLE_TIMEOUT_SEC;
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--idle-timeout") == 0 && i + 1 < argc) {
+            idle_timeout = atoi(argv[++i]);
+            if (idle_timeout <= 0) idle_timeout = DAEMON_IDLE_TIMEOUT_SEC;
+        } else {
+            fprintf(stderr, ERROR_PREFIX "Usage: %s daemon [--idle-timeout <seconds>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Only the user who authenticated through sudo (and root) may talk to the daemon.
+    uid_t owner_uid = 0;
+    const char *sudo_uid = getenv("SUDO_UID");
+    if (sudo_uid != NULL && sudo_uid[0] != '\0') {
+        owner_uid = (uid_t)strtoul(sudo_uid, NULL, 10);
+    }
+
+    if (prepare_socket_dir() != 0) {
+        return 1;
+    }
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/backend-%u.sock", DAEMON_SOCKET_DIR, (unsigned)owner_uid);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        perror("socket failed");
+        return 1;
+    }
+
+    // The directory is root-owned, so removing a stale socket here is safe.
+    unlink(addr.sun_path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        perror("bind failed");
+        close(listen_fd);
+        return 1;
+    }
+    if (chown(addr.sun_path, owner_uid, (gid_t)-1) == -1 || chmod(addr.sun_path, 0600) == -1 || listen(listen_fd, 8) == -1) {
+        perror("socket setup failed");
+        unlink(addr.sun_path);
+        close(listen_fd);
+        return 1;
+    }
+
+    printf(DAEMON_READY_PREFIX "%s\n", addr.sun_path);
+    fflush(stdout);
+
+    // Detach from the launching pipe; from here on all output travels over the socket.
+    int devnull = open("/dev/null", O_RDWR);
+    if (devnull != -1) {
+        dup2(devnull, STDIN_FILENO);
+        dup2(devnull, STDOUT_FILENO);
+        dup2(devnull, STDERR_FILENO);
+        if (devnull > STDERR_FILENO) close(devnull);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+
+    int shutdown_requested = 0;
+    while (!shutdown_requested) {
+        struct pollfd pfd = { .fd = listen_fd, .events = POLLIN };
+        int ready = poll(&pfd, 1, idle_timeout * 1000);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (ready == 0) break; // Idle timeout
+
+        int conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (conn == -1) continue;
+
+        struct ucred cred;
+        socklen_t cred_len = sizeof(cred);
+        if (getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &cred_len) == -1 ||
+            (cred.uid != owner_uid && cred.uid != 0)) {
+            close(conn);
+            continue;
+        }
+
+        shutdown_requested = serve_connection(conn, listen_fd);
+        close(conn);
+    }
+
+    unlink(addr.sun_path);
+    close(listen_fd);
+    return 0;
+}
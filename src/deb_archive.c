@@ -0,0 +1,895 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ctype.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <zlib.h>
+#include <lzma.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "sha256.h"
+
+/*
+ * Native .deb reader.
+ *
+ * A .deb is an ar archive holding debian-binary, control.tar[.gz|.xz|.zst] and
+ * data.tar[.gz|.xz|.zst]. The archive is read strictly front to back: members are
+ * discovered one header at a time and their payloads are decompressed as a stream,
+ * so nothing is buffered beyond the decompressor's window and a single pass over the
+ * file is enough to reach both tarballs.
+ */
+
+#define AR_MAGIC "!<arch>\n"
+#define AR_MAGIC_LEN 8
+#define AR_HEADER_LEN 60
+#define TAR_BLOCK 512
+
+static uint64_t parse_decimal(const char *field, size_t len) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < len && isdigit((unsigned char)field[i]); i++) {
+        value = value * 10 + (uint64_t)(field[i] - '0');
+    }
+    return value;
+}
+
+/** Reads exactly len raw archive bytes. Returns 0 on success, -1 on EOF or error. */
+static int deb_read_raw(struct deb_archive *deb, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(deb->fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) return -1;
+        if (deb->hash) sha256_update(deb->hash, p, (size_t)n);
+        p += n;
+        len -= (size_t)n;
+        deb->pos += (uint64_t)n;
+    }
+    return 0;
+}
+
+/** Advances the archive to the given offset, reading forward rather than seeking. */
+static int deb_skip_to(struct deb_archive *deb, uint64_t offset) {
+    char scratch[DEB_STREAM_CHUNK];
+    while (deb->pos < offset) {
+        uint64_t gap = offset - deb->pos;
+        size_t want = gap < sizeof(scratch) ? (size_t)gap : sizeof(scratch);
+        if (deb_read_raw(deb, scratch, want) != 0) return -1;
+    }
+    return 0;
+}
+
+int deb_open(const char *path, struct deb_archive *deb) {
+    memset(deb, 0, sizeof(*deb));
+    deb->fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (deb->fd == -1) {
+        fprintf(stderr, ERROR_PREFIX "Cannot open %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    posix_fadvise(deb->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    char magic[AR_MAGIC_LEN];
+    if (deb_read_raw(deb, magic, sizeof(magic)) != 0 || memcmp(magic, AR_MAGIC, AR_MAGIC_LEN) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Not a Debian package (bad ar header): %s\n", path);
+        close(deb->fd);
+        deb->fd = -1;
+        return -1;
+    }
+    deb->member_end = deb->pos;
+    return 0;
+}
+
+void deb_close(struct deb_archive *deb) {
+    if (deb->fd >= 0) close(deb->fd);
+    deb->fd = -1;
+}
+
+static enum deb_compression compression_for_name(const char *name) {
+    const char *ext = strrchr(name, '.');
+    if (ext == NULL || strcmp(ext, ".tar") == 0) return DEB_COMP_NONE;
+    if (strcmp(ext, ".gz") == 0) return DEB_COMP_GZIP;
+    if (strcmp(ext, ".xz") == 0) return DEB_COMP_XZ;
+    if (strcmp(ext, ".zst") == 0) return DEB_COMP_ZSTD;
+    return DEB_COMP_UNSUPPORTED;
+}
+
+int deb_next_member(struct deb_archive *deb) {
+    // Members are padded to an even offset.
+    uint64_t next = deb->member_end + (deb->member_end & 1);
+    if (deb_skip_to(deb, next) != 0) return 0;
+
+    char header[AR_HEADER_LEN];
+    if (deb_read_raw(deb, header, sizeof(header)) != 0) return 0; // Clean end of archive
+    if (header[58] != '`' || header[59] != '\n') {
+        fprintf(stderr, ERROR_PREFIX "Corrupt ar member header at offset %llu\n", (unsigned long long)(deb->pos - AR_HEADER_LEN));
+        return -1;
+    }
+
+    struct deb_member *m = &deb->member;
+    memcpy(m->name, header, 16);
+    m->name[16] = '\0';
+    // Trim the space padding and the optional GNU-style trailing '/'.
+    for (int i = 15; i >= 0 && (m->name[i] == ' ' || m->name[i] == '/'); i--) {
+        m->name[i] = '\0';
+    }
+    m->size = parse_decimal(header + 48, 10);
+    m->offset = deb->pos;
+    m->compression = compression_for_name(m->name);
+    deb->member_end = m->offset + m->size;
+    return 1;
+}
+
+int deb_find_member(struct deb_archive *deb, const char *prefix) {
+    int rc;
+    while ((rc = deb_next_member(deb)) == 1) {
+        if (strncmp(deb->member.name, prefix, strlen(prefix)) == 0) return 1;
+    }
+    return rc;
+}
+
+ssize_t deb_read_member(struct deb_archive *deb, void *buf, size_t len) {
+    uint64_t left = deb->member_end - deb->pos;
+    if (left == 0) return 0;
+    if (len > left) len = (size_t)left;
+    for (;;) {
+        ssize_t n = read(deb->fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n > 0) {
+            if (deb->hash) sha256_update(deb->hash, buf, (size_t)n);
+            deb->pos += (uint64_t)n;
+        }
+        return n;
+    }
+}
+
+int deb_drain(struct deb_archive *deb) {
+    char scratch[DEB_STREAM_CHUNK];
+    for (;;) {
+        ssize_t n = read(deb->fd, scratch, sizeof(scratch));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, ERROR_PREFIX "Read error: %s\n", strerror(errno));
+            return -1;
+        }
+        if (n == 0) return 0;
+        if (deb->hash) sha256_update(deb->hash, scratch, (size_t)n);
+        deb->pos += (uint64_t)n;
+    }
+}
+
+// --- Decompressing member stream ---
+
+int deb_stream_open(struct deb_archive *deb, struct deb_stream *s) {
+    memset(s, 0, sizeof(*s));
+    s->deb = deb;
+    s->compression = deb->member.compression;
+
+    switch (s->compression) {
+    case DEB_COMP_NONE:
+        return 0;
+    case DEB_COMP_GZIP:
+        // 15 + 32: accept a gzip (or zlib) header with the maximum window.
+        if (inflateInit2(&s->gz, 15 + 32) != Z_OK) break;
+        return 0;
+    case DEB_COMP_XZ: {
+        lzma_stream init = LZMA_STREAM_INIT;
+        s->xz = init;
+        if (lzma_stream_decoder(&s->xz, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) break;
+        return 0;
+    }
+    case DEB_COMP_ZSTD:
+#ifdef HAVE_ZSTD
+        s->zst = ZSTD_createDStream();
+        if (s->zst == NULL || ZSTD_isError(ZSTD_initDStream(s->zst))) break;
+        return 0;
+#else
+        fprintf(stderr, ERROR_PREFIX "%s: zstd support was not compiled into this backend\n", deb->member.name);
+        return -1;
+#endif
+    case DEB_COMP_UNSUPPORTED:
+        break;
+    }
+    fprintf(stderr, ERROR_PREFIX "Unsupported or unreadable compression for member %s\n", deb->member.name);
+    return -1;
+}
+
+/** Refills the compressed input buffer once it has been consumed. */
+static int deb_stream_fill(struct deb_stream *s) {
+    if (s->in_pos < s->in_len) return 1;
+    ssize_t n = deb_read_member(s->deb, s->in_buf, sizeof(s->in_buf));
+    if (n < 0) return -1;
+    s->in_len = (size_t)n;
+    s->in_pos = 0;
+    return n > 0;
+}
+
+ssize_t deb_stream_read(struct deb_stream *s, void *buf, size_t len) {
+    if (s->finished || len == 0) return 0;
+
+    if (s->compression == DEB_COMP_NONE) {
+        ssize_t n = deb_read_member(s->deb, buf, len);
+        if (n == 0) s->finished = 1;
+        return n;
+    }
+
+    for (;;) {
+        int filled = deb_stream_fill(s);
+        if (filled < 0) return -1;
+        size_t produced = 0;
+        int done = 0;
+
+        if (s->compression == DEB_COMP_GZIP) {
+            s->gz.next_in = s->in_buf + s->in_pos;
+            s->gz.avail_in = (uInt)(s->in_len - s->in_pos);
+            s->gz.next_out = buf;
+            s->gz.avail_out = (uInt)len;
+            int zrc = inflate(&s->gz, Z_NO_FLUSH);
+            if (zrc != Z_OK && zrc != Z_STREAM_END && !(zrc == Z_BUF_ERROR && filled == 0)) return -1;
+            s->in_pos = s->in_len - s->gz.avail_in;
+            produced = len - s->gz.avail_out;
+            done = zrc == Z_STREAM_END;
+        } else if (s->compression == DEB_COMP_XZ) {
+            s->xz.next_in = s->in_buf + s->in_pos;
+            s->xz.avail_in = s->in_len - s->in_pos;
+            s->xz.next_out = buf;
+            s->xz.avail_out = len;
+            lzma_ret xrc = lzma_code(&s->xz, filled == 0 ? LZMA_FINISH : LZMA_RUN);
+            if (xrc != LZMA_OK && xrc != LZMA_STREAM_END && !(xrc == LZMA_BUF_ERROR && filled == 0)) return -1;
+            s->in_pos = s->in_len - s->xz.avail_in;
+            produced = len - s->xz.avail_out;
+            done = xrc == LZMA_STREAM_END;
+#ifdef HAVE_ZSTD
+        } else if (s->compression == DEB_COMP_ZSTD) {
+            ZSTD_inBuffer in = { s->in_buf + s->in_pos, s->in_len - s->in_pos, 0 };
+            ZSTD_outBuffer out = { buf, len, 0 };
+            size_t zrc = ZSTD_decompressStream(s->zst, &out, &in);
+            if (ZSTD_isError(zrc)) return -1;
+            s->in_pos += in.pos;
+            produced = out.pos;
+            done = zrc == 0 && filled == 0;
+#endif
+        } else {
+            return -1;
+        }
+
+        if (done || (filled == 0 && produced == 0)) s->finished = 1;
+        if (produced > 0 || s->finished) return (ssize_t)produced;
+    }
+}
+
+int deb_stream_read_full(struct deb_stream *s, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = deb_stream_read(s, p, len);
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+void deb_stream_close(struct deb_stream *s) {
+    if (s->compression == DEB_COMP_GZIP) {
+        inflateEnd(&s->gz);
+    } else if (s->compression == DEB_COMP_XZ) {
+        lzma_end(&s->xz);
+#ifdef HAVE_ZSTD
+    } else if (s->compression == DEB_COMP_ZSTD && s->zst != NULL) {
+        ZSTD_freeDStream(s->zst);
+#endif
+    }
+}
+
+// --- Streaming tar walker ---
+
+static uint64_t parse_tar_number(const char *field, size_t len) {
+    // GNU base-256 encoding for values that do not fit in octal.
+    if ((unsigned char)field[0] & 0x80) {
+        uint64_t value = (unsigned char)field[0] & 0x7f;
+        for (size_t i = 1; i < len; i++) value = (value << 8) | (unsigned char)field[i];
+        return value;
+    }
+    uint64_t value = 0;
+    size_t i = 0;
+    while (i < len && field[i] == ' ') i++;
+    for (; i < len && field[i] >= '0' && field[i] <= '7'; i++) {
+        value = (value << 3) | (uint64_t)(field[i] - '0');
+    }
+    return value;
+}
+
+static int tar_skip(struct deb_stream *s, uint64_t len) {
+    char scratch[DEB_STREAM_CHUNK];
+    while (len > 0) {
+        size_t want = len < sizeof(scratch) ? (size_t)len : sizeof(scratch);
+        if (deb_stream_read_full(s, scratch, want) != 0) return -1;
+        len -= want;
+    }
+    return 0;
+}
+
+static uint64_t tar_padding(uint64_t size) {
+    return (TAR_BLOCK - (size % TAR_BLOCK)) % TAR_BLOCK;
+}
+
+/** Reads a GNU long name/link payload into dest (truncated to TAR_PATH_MAX - 1). */
+static int tar_read_long_name(struct deb_stream *s, uint64_t size, char *dest) {
+    size_t keep = size < TAR_PATH_MAX - 1 ? (size_t)size : TAR_PATH_MAX - 1;
+    if (deb_stream_read_full(s, dest, keep) != 0) return -1;
+    dest[keep] = '\0';
+    return tar_skip(s, size - keep + tar_padding(size));
+}
+
+/** Applies the path, linkpath and size records of a pax extended header. */
+static int tar_read_pax(struct deb_stream *s, uint64_t size, struct tar_entry *pending, int *have_size,
+                        int *have_mtime) {
+    if (size > 1024 * 1024) return tar_skip(s, size + tar_padding(size)); // Ignore absurd headers
+    char *data = malloc((size_t)size + 1);
+    if (data == NULL) return -1;
+    if (deb_stream_read_full(s, data, (size_t)size) != 0) {
+        free(data);
+        return -1;
+    }
+    data[size] = '\0';
+
+    // Records look like "<len> <key>=<value>\n".
+    char *p = data;
+    while (p < data + size) {
+        char *space = strchr(p, ' ');
+        long rec_len = strtol(p, NULL, 10);
+        if (space == NULL || rec_len <= 0 || p + rec_len > data + size) break;
+        char *key = space + 1;
+        char *eq = strchr(key, '=');
+        char *end = p + rec_len - 1; // Points at the record's trailing newline
+        if (eq != NULL && eq < end) {
+            *eq = '\0';
+            *end = '\0';
+            if (strcmp(key, "path") == 0) {
+                snprintf(pending->path, sizeof(pending->path), "%s", eq + 1);
+            } else if (strcmp(key, "linkpath") == 0) {
+                snprintf(pending->link, sizeof(pending->link), "%s", eq + 1);
+            } else if (strcmp(key, "size") == 0) {
+                pending->size = strtoull(eq + 1, NULL, 10);
+                *have_size = 1;
+            } else if (strcmp(key, "mtime") == 0) {
+                pending->mtime = strtoll(eq + 1, NULL, 10); // Drops any fraction
+                *have_mtime = 1;
+            }
+        }
+        p += rec_len;
+    }
+    free(data);
+    return tar_skip(s, tar_padding(size));
+}
+
+ssize_t tar_read_data(struct tar_entry *entry, void *buf, size_t len) {
+    if (entry->remaining == 0) return 0;
+    if (len > entry->remaining) len = (size_t)entry->remaining;
+    ssize_t n = deb_stream_read(entry->stream, buf, len);
+    if (n > 0) entry->remaining -= (uint64_t)n;
+    return n;
+}
+
+int tar_walk(struct deb_stream *s, tar_entry_cb cb, void *ctx) {
+    char header[TAR_BLOCK];
+    struct tar_entry entry;
+    struct tar_entry pending; // Overrides collected from GNU/pax extension headers
+    int have_long_name = 0, have_long_link = 0, have_pax_size = 0, have_pax_mtime = 0;
+
+    memset(&pending, 0, sizeof(pending));
+    for (;;) {
+        // Only the zero block ends an archive; running out of data before it means the package is cut short.
+        if (deb_stream_read_full(s, header, TAR_BLOCK) != 0) {
+            fprintf(stderr, ERROR_PREFIX "%s is truncated or damaged (no end-of-archive block)\n", s->deb->member.name);
+            return -1;
+        }
+        if (header[0] == '\0') return 0; // End-of-archive block
+
+        uint64_t size = parse_tar_number(header + 124, 12);
+        char type = header[156];
+
+        if (type == 'L' || type == 'K') {
+            char *dest = type == 'L' ? pending.path : pending.link;
+            if (tar_read_long_name(s, size, dest) != 0) return -1;
+            if (type == 'L') have_long_name = 1; else have_long_link = 1;
+            continue;
+        }
+        if (type == 'x') {
+            if (tar_read_pax(s, size, &pending, &have_pax_size, &have_pax_mtime) != 0) return -1;
+            if (pending.path[0]) have_long_name = 1;
+            if (pending.link[0]) have_long_link = 1;
+            continue;
+        }
+        if (type == 'g') {
+            if (tar_skip(s, size + tar_padding(size)) != 0) return -1;
+            continue;
+        }
+
+        memset(&entry, 0, sizeof(entry));
+        if (have_long_name) {
+            memcpy(entry.path, pending.path, sizeof(entry.path));
+        } else if (memcmp(header + 257, "ustar", 5) == 0 && header[345] != '\0') {
+            snprintf(entry.path, sizeof(entry.path), "%.155s/%.100s", header + 345, header);
+        } else {
+            snprintf(entry.path, sizeof(entry.path), "%.100s", header);
+        }
+        if (have_long_link) {
+            memcpy(entry.link, pending.link, sizeof(entry.link));
+        } else {
+            snprintf(entry.link, sizeof(entry.link), "%.100s", header + 157);
+        }
+        entry.size = have_pax_size ? pending.size : size;
+        entry.mode = (unsigned)parse_tar_number(header + 100, 8);
+        entry.mtime = have_pax_mtime ? pending.mtime : (int64_t)parse_tar_number(header + 136, 12);
+        entry.type = type == '\0' ? '0' : type;
+        entry.stream = s;
+        // Only regular files carry data; hard links and symlinks report a size of 0.
+        entry.remaining = (entry.type == '0' || entry.type == '7') ? entry.size : 0;
+
+        memset(&pending, 0, sizeof(pending));
+        have_long_name = have_long_link = have_pax_size = have_pax_mtime = 0;
+
+        int rc = cb(&entry, ctx);
+        if (rc != 0) return rc < 0 ? -1 : 1;
+
+        uint64_t data_size = (entry.type == '0' || entry.type == '7') ? entry.size : 0;
+        if (tar_skip(s, entry.remaining + tar_padding(data_size)) != 0) return -1;
+    }
+}
+
+const char *tar_entry_name(const struct tar_entry *entry) {
+    // All of them: "//tmp/x" or ".//home" would otherwise stay absolute, and openat() ignores its directory for those.
+    const char *name = entry->path;
+    while (name[0] == '/' || (name[0] == '.' && name[1] == '/')) name += name[0] == '/' ? 1 : 2;
+    return name;
+}
+
+static char entry_kind(char type) {
+    switch (type) {
+    case '0': case '\0': case '7': return 'f';
+    case '5': return 'd';
+    case '2': return 'l';
+    case '1': return 'h';
+    case '3': return 'c';
+    case '4': return 'b';
+    case '6': return 'p';
+    default: return 0;
+    }
+}
+
+int tar_entry_listing(const struct tar_entry *entry, char *line, size_t size) {
+    char kind = entry_kind(entry->type);
+    const char *name = tar_entry_name(entry);
+    size_t name_len = strlen(name);
+    while (name_len > 0 && name[name_len - 1] == '/') name_len--;
+    if (kind == 0 || name_len == 0) return 0; // Unknown entry types, and the "./" root itself
+    if (strpbrk(entry->path, "\t\n") != NULL || strpbrk(entry->link, "\t\n") != NULL) {
+        fprintf(stderr, ERROR_PREFIX "Invalid file name in data.tar: %s\n", entry->path);
+        return -1; // dpkg refuses these as well
+    }
+
+    int len = snprintf(line, size, "%c\t%04o\t%llu\t/%.*s", kind, entry->mode & 07777,
+                       (unsigned long long)(kind == 'f' ? entry->size : 0), (int)name_len, name);
+    if (kind == 'l' || kind == 'h') {
+        // Hard link targets are archive paths; show them the way the entries themselves are shown.
+        const char *link = entry->link;
+        if (kind == 'h' && link[0] == '.' && link[1] == '/') link += 1;
+        len += snprintf(line + len, size - (size_t)len, "\t%s%s", kind == 'h' && link[0] != '/' ? "/" : "", link);
+    }
+    line[len++] = '\n';
+    return len;
+}
+
+// --- control file access ---
+
+const char *const deb_script_names[DEB_SCRIPT_COUNT] = { "preinst", "postinst", "prerm", "postrm", "config" };
+
+struct control_grab {
+    char *buf;
+    size_t len;
+    struct deb_scripts *scripts; // Also wanted, so the walk goes on past the control file
+};
+
+/** Reads a whole (small) entry into a NUL-terminated buffer. */
+static char *read_entry(struct tar_entry *entry, size_t *len) {
+    if (entry->size > DEB_CONTROL_MAX) return NULL;
+    char *buf = malloc((size_t)entry->size + 1);
+    if (buf == NULL) return NULL;
+    size_t got = 0;
+    while (got < entry->size) {
+        ssize_t n = tar_read_data(entry, buf + got, (size_t)entry->size - got);
+        if (n <= 0) {
+            free(buf);
+            return NULL;
+        }
+        got += (size_t)n;
+    }
+    buf[got] = '\0';
+    *len = got;
+    return buf;
+}
+
+static int grab_control_file(struct tar_entry *entry, void *ctx) {
+    struct control_grab *grab = ctx;
+    if (entry->type != '0') return 0;
+    const char *name = tar_entry_name(entry);
+    if (strcmp(name, "control") == 0) {
+        grab->buf = read_entry(entry, &grab->len);
+        if (grab->buf == NULL) return -1;
+        return grab->scripts ? 0 : 1; // Without scripts to collect, we have what we came for
+    }
+    if (grab->scripts == NULL) return 0;
+    for (int i = 0; i < DEB_SCRIPT_COUNT; i++) {
+        if (strcmp(name, deb_script_names[i]) == 0 && grab->scripts->text[i] == NULL) {
+            grab->scripts->text[i] = read_entry(entry, &grab->scripts->len[i]);
+            return grab->scripts->text[i] ? 0 : -1;
+        }
+    }
+    return 0;
+}
+
+char *deb_read_control_scripts(struct deb_archive *deb, size_t *len, struct deb_scripts *scripts) {
+    if (scripts) memset(scripts, 0, sizeof(*scripts));
+    if (deb_find_member(deb, "control.tar") != 1) {
+        fprintf(stderr, ERROR_PREFIX "Package has no control.tar member\n");
+        return NULL;
+    }
+
+    struct deb_stream stream;
+    if (deb_stream_open(deb, &stream) != 0) return NULL;
+    struct control_grab grab = { NULL, 0, scripts };
+    int walked = tar_walk(&stream, grab_control_file, &grab);
+    deb_stream_close(&stream);
+
+    if (grab.buf == NULL || (scripts && walked < 0)) {
+        fprintf(stderr, ERROR_PREFIX "control.tar does not contain a readable control file\n");
+        free(grab.buf);
+        if (scripts) deb_scripts_free(scripts);
+        return NULL;
+    }
+    if (len) *len = grab.len;
+    return grab.buf;
+}
+
+char *deb_read_control(struct deb_archive *deb, size_t *len) {
+    return deb_read_control_scripts(deb, len, NULL);
+}
+
+void deb_scripts_free(struct deb_scripts *scripts) {
+    for (int i = 0; i < DEB_SCRIPT_COUNT; i++) free(scripts->text[i]);
+    memset(scripts, 0, sizeof(*scripts));
+}
+
+const char *control_find_field(const char *control, const char *name, size_t *value_len) {
+    size_t name_len = strlen(name);
+    const char *line = control;
+    while (line && *line) {
+        if (strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            const char *value = line + name_len + 1;
+            while (*value == ' ' || *value == '\t') value++;
+            // The value runs on through any continuation lines (those starting with whitespace).
+            const char *end = value;
+            for (;;) {
+                const char *nl = strchr(end, '\n');
+                if (nl == NULL) { end += strlen(end); break; }
+                if (nl[1] != ' ' && nl[1] != '\t') { end = nl; break; }
+                end = nl + 1;
+            }
+            if (value_len) *value_len = (size_t)(end - value);
+            return value;
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    return NULL;
+}
+
+// --- icon extraction ---
+
+#define DESKTOP_FILE_MAX (256 * 1024)
+#define ICON_PENDING_MAX (16 * 1024 * 1024) // Icons kept while the .desktop file is still to come
+
+/* Where an icon named in a .desktop file's Icon= key is looked up, best first. */
+static const char *const icon_search_paths[] = {
+    "usr/share/icons/hicolor/scalable/apps/%s.svg",
+    "usr/share/icons/hicolor/256x256/apps/%s.png",
+    "usr/share/icons/hicolor/512x512/apps/%s.png",
+    "usr/share/pixmaps/%s.svg",
+    "usr/share/pixmaps/%s.png",
+    "usr/share/pixmaps/%s.xpm",
+};
+#define ICON_RANK_COUNT (int)(sizeof(icon_search_paths) / sizeof(icon_search_paths[0]))
+
+struct icon_candidate {
+    char *name;
+    unsigned char *data;
+    size_t len;
+    struct icon_candidate *next;
+};
+
+/** Returns the search rank of an archive path for the current Icon= value, or -1. */
+static int icon_rank(const struct icon_search *search, const char *name) {
+    if (search->icon[0] == '/') {
+        return strcmp(name, search->icon + 1) == 0 ? 0 : -1; // Absolute Icon= paths are used as-is
+    }
+    char candidate[TAR_PATH_MAX];
+    for (int i = 0; i < ICON_RANK_COUNT; i++) {
+        snprintf(candidate, sizeof(candidate), icon_search_paths[i], search->icon);
+        if (strcmp(name, candidate) == 0) return i;
+    }
+    return -1;
+}
+
+/** Whether some Icon= value would give this path a rank, i.e. it fits one of the search paths. */
+static int could_be_icon(const char *name) {
+    size_t name_len = strlen(name);
+    for (int i = 0; i < ICON_RANK_COUNT; i++) {
+        const char *slot = strstr(icon_search_paths[i], "%s");
+        size_t prefix_len = (size_t)(slot - icon_search_paths[i]);
+        const char *suffix = slot + 2;
+        size_t suffix_len = strlen(suffix);
+        if (name_len <= prefix_len + suffix_len) continue;
+        if (strncmp(name, icon_search_paths[i], prefix_len) != 0) continue;
+        if (strcmp(name + name_len - suffix_len, suffix) != 0) continue;
+        if (memchr(name + prefix_len, '/', name_len - prefix_len - suffix_len) == NULL) return 1;
+    }
+    return 0;
+}
+
+/** Reads a whole entry into a new buffer; the caller frees it. */
+static unsigned char *read_entry_data(struct tar_entry *entry, size_t limit, size_t *len) {
+    if (entry->size > limit) return NULL;
+    unsigned char *buf = malloc((size_t)entry->size + 1);
+    if (buf == NULL) return NULL;
+    size_t got = 0;
+    while (got < entry->size) {
+        ssize_t n = tar_read_data(entry, buf + got, (size_t)entry->size - got);
+        if (n <= 0) {
+            free(buf);
+            return NULL;
+        }
+        got += (size_t)n;
+    }
+    buf[got] = '\0';
+    *len = got;
+    return buf;
+}
+
+static void read_desktop_icon(struct tar_entry *entry, struct icon_search *search) {
+    size_t len;
+    char *desktop = (char *)read_entry_data(entry, DESKTOP_FILE_MAX, &len);
+    if (desktop == NULL) return;
+    for (char *line = strtok(desktop, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        while (*line == ' ' || *line == '\t') line++;
+        if (strncmp(line, "Icon=", 5) != 0) continue;
+        char *value = line + 5;
+        value[strcspn(value, "\r")] = '\0';
+        // Names containing '/' are only meaningful as absolute paths.
+        if (value[0] != '\0' && (value[0] == '/' || strchr(value, '/') == NULL)) {
+            snprintf(search->icon, sizeof(search->icon), "%s", value);
+        }
+        break;
+    }
+    free(desktop);
+}
+
+static void adopt_icon(struct icon_search *search, unsigned char *data, size_t len, int rank) {
+    free(search->data);
+    search->data = data;
+    search->len = len;
+    search->rank = rank;
+}
+
+static void free_pending(struct icon_search *search) {
+    while (search->pending) {
+        struct icon_candidate *next = search->pending->next;
+        free(search->pending->name);
+        free(search->pending->data);
+        free(search->pending);
+        search->pending = next;
+    }
+    search->pending_bytes = 0;
+}
+
+/** Now that the Icon= value is known, picks the best of the icons kept so far. */
+static void resolve_pending(struct icon_search *search) {
+    for (struct icon_candidate *c = search->pending; c != NULL; c = c->next) {
+        int rank = icon_rank(search, c->name);
+        if (rank < 0 || rank >= search->rank) continue;
+        adopt_icon(search, c->data, c->len, rank);
+        c->data = NULL;
+    }
+    free_pending(search);
+}
+
+/** Keeps a possible icon that went by before the .desktop file, within ICON_PENDING_MAX. */
+static void keep_pending(struct tar_entry *entry, struct icon_search *search, const char *name) {
+    if (entry->size > DEB_ICON_MAX) return; // Could never be used anyway
+    if (search->pending_bytes + entry->size > ICON_PENDING_MAX) {
+        search->missed_candidates = 1;
+        return;
+    }
+    struct icon_candidate *c = calloc(1, sizeof(*c));
+    if (c == NULL || (c->name = strdup(name)) == NULL
+        || (c->data = read_entry_data(entry, DEB_ICON_MAX, &c->len)) == NULL) {
+        search->missed_candidates = 1; // A second pass can still find it
+        if (c != NULL) free(c->name);
+        free(c);
+        return;
+    }
+    c->next = search->pending;
+    search->pending = c;
+    search->pending_bytes += c->len;
+}
+
+void icon_search_init(struct icon_search *search) {
+    memset(search, 0, sizeof(*search));
+    search->rank = ICON_RANK_COUNT;
+}
+
+void icon_search_free(struct icon_search *search) {
+    free_pending(search);
+    free(search->data);
+    search->data = NULL;
+}
+
+int icon_search_visit(struct tar_entry *entry, struct icon_search *search) {
+    if (entry->type != '0') return 0;
+    const char *name = tar_entry_name(entry);
+
+    if (search->icon[0] == '\0') {
+        size_t name_len = strlen(name);
+        if (strncmp(name, "usr/share/applications/", 23) == 0 && name_len > 8
+            && strcmp(name + name_len - 8, ".desktop") == 0) {
+            read_desktop_icon(entry, search);
+            if (search->icon[0] != '\0') resolve_pending(search);
+            return search->rank == 0;
+        }
+        if (could_be_icon(name)) keep_pending(entry, search, name);
+        return 0;
+    }
+
+    int rank = icon_rank(search, name);
+    if (rank < 0 || rank >= search->rank) return 0;
+    size_t len;
+    unsigned char *data = read_entry_data(entry, DEB_ICON_MAX, &len);
+    if (data == NULL) return 0;
+    adopt_icon(search, data, len, rank);
+    return rank == 0; // Nothing can beat the first search path
+}
+
+int icon_search_incomplete(const struct icon_search *search) {
+    // An absolute Icon= path can point anywhere, so any file may have gone past unnoticed.
+    return search->rank != 0 && search->icon[0] != '\0' && (search->missed_candidates || search->icon[0] == '/');
+}
+
+static int find_icon_entry(struct tar_entry *entry, void *ctx) {
+    return icon_search_visit(entry, ctx);
+}
+
+/** Walks data.tar.* once; returns 0 when the walk completed or stopped early. */
+static int scan_data_for_icon(const char *path, struct icon_search *search) {
+    struct deb_archive deb;
+    if (deb_open(path, &deb) != 0) return -1;
+    if (deb_find_member(&deb, "data.tar") != 1) {
+        fprintf(stderr, ERROR_PREFIX "Package has no data.tar member\n");
+        deb_close(&deb);
+        return -1;
+    }
+    struct deb_stream stream;
+    int rc = -1;
+    if (deb_stream_open(&deb, &stream) == 0) {
+        rc = tar_walk(&stream, find_icon_entry, search) < 0 ? -1 : 0;
+        deb_stream_close(&stream);
+    }
+    deb_close(&deb);
+    return rc;
+}
+
+/**
+ * Writes the package's application icon to stdout.
+ * data.tar is decompressed as a stream and the walk stops as soon as the best
+ * possible match has been captured, so memory stays bounded by the decompressor
+ * window plus the icons kept until the .desktop file shows up. Only if more of
+ * those went past than could be kept is a second pass needed.
+ */
+int handle_deb_icon(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deb-icon <file.deb>\n", argv[0]);
+        return 1;
+    }
+
+    struct icon_search search;
+    icon_search_init(&search);
+    if (scan_data_for_icon(argv[2], &search) != 0) {
+        icon_search_free(&search);
+        return 1;
+    }
+    if (icon_search_incomplete(&search)) scan_data_for_icon(argv[2], &search);
+
+    if (search.data == NULL) {
+        fprintf(stderr, ERROR_PREFIX "No application icon found in %s\n", argv[2]);
+        icon_search_free(&search);
+        return 1;
+    }
+    fwrite(search.data, 1, search.len, stdout);
+    icon_search_free(&search);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
+
+/** Appends the maintainer-script findings as one more field, a line per finding. */
+static int print_script_risks(const struct deb_scripts *scripts) {
+    size_t len;
+    char *risks = script_risk_report(scripts, &len);
+    if (risks == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        return -1;
+    }
+    printf("Nano-Script-Risks:");
+    for (char *line = risks, *nl; *line; line = nl + 1) {
+        nl = strchr(line, '\n');
+        printf("\n %.*s", (int)(nl - line), line);
+    }
+    putchar('\n');
+    free(risks);
+    return 0;
+}
+
+/**
+ * `deb-info [--scripts] <file.deb> [Field...]`: the control file, or the given
+ * fields of it. --scripts adds a Nano-Script-Risks field with the findings of
+ * the maintainer-script analysis, read in the same pass over control.tar.
+ */
+int handle_deb_info(int argc, char *argv[]) {
+    int first = 2, with_scripts = 0;
+    if (argc > first && strcmp(argv[first], "--scripts") == 0) {
+        with_scripts = 1;
+        first++;
+    }
+    if (argc <= first) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deb-info [--scripts] <file.deb> [Field...]\n", argv[0]);
+        return 1;
+    }
+
+    struct deb_archive deb;
+    if (deb_open(argv[first], &deb) != 0) return 1;
+    size_t control_len;
+    struct deb_scripts scripts;
+    char *control = deb_read_control_scripts(&deb, &control_len, with_scripts ? &scripts : NULL);
+    deb_close(&deb);
+    if (control == NULL) return 1;
+
+    if (argc == first + 1) {
+        // No fields requested: print the whole control file.
+        fwrite(control, 1, control_len, stdout);
+    } else {
+        // Unlike `dpkg-deb -f`, always print "Field: value" so callers parse one format.
+        for (int i = first + 1; i < argc; i++) {
+            size_t value_len;
+            const char *value = control_find_field(control, argv[i], &value_len);
+            if (value == NULL) continue;
+            // Print the field name as the package spells it, not as it was requested.
+            const char *line = value;
+            while (line > control && line[-1] != '\n') line--;
+            printf("%.*s: %.*s\n", (int)strlen(argv[i]), line, (int)value_len, value);
+        }
+    }
+    int rc = 0;
+    if (with_scripts) {
+        rc = print_script_risks(&scripts) == 0 ? 0 : 1;
+        deb_scripts_free(&scripts);
+    }
+    free(control);
+    return rc;
+}
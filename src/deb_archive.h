@@ -0,0 +1,136 @@
+#ifndef DEB_ARCHIVE_H
+#define DEB_ARCHIVE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <zlib.h>
+#include <lzma.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#define DEB_STREAM_CHUNK 65536
+#define DEB_CONTROL_MAX (4 * 1024 * 1024) // Refuse control files larger than this
+#define TAR_PATH_MAX 4096
+
+enum deb_compression {
+    DEB_COMP_NONE,
+    DEB_COMP_GZIP,
+    DEB_COMP_XZ,
+    DEB_COMP_ZSTD,
+    DEB_COMP_UNSUPPORTED,
+};
+
+struct deb_member {
+    char name[17];
+    uint64_t offset; // File offset of the member's payload
+    uint64_t size;
+    enum deb_compression compression;
+};
+
+struct sha256_ctx;
+
+/** An ar archive read strictly sequentially; `member` is the member being read. */
+struct deb_archive {
+    int fd;
+    uint64_t pos;
+    uint64_t member_end;
+    struct deb_member member;
+    struct sha256_ctx *hash; // When set, every byte read from the file is also fed to it
+};
+
+/** Decompressing reader over the payload of the archive's current member. */
+struct deb_stream {
+    struct deb_archive *deb;
+    enum deb_compression compression;
+    int finished;
+    unsigned char in_buf[DEB_STREAM_CHUNK];
+    size_t in_len;
+    size_t in_pos;
+    z_stream gz;
+    lzma_stream xz;
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zst;
+#endif
+};
+
+struct tar_entry {
+    char path[TAR_PATH_MAX]; // As stored, usually "./usr/bin/foo"
+    char link[TAR_PATH_MAX];
+    char type;               // tar typeflag: '0' file, '5' dir, '2' symlink, '1' hard link, ...
+    unsigned mode;
+    uint64_t size;
+    int64_t mtime;           // Seconds since the epoch
+    struct deb_stream *stream;
+    uint64_t remaining;      // Unread data bytes of this entry
+};
+
+/** Return 0 to continue the walk, 1 to stop it, -1 to abort with an error. */
+typedef int (*tar_entry_cb)(struct tar_entry *entry, void *ctx);
+
+// All functions print an ERROR_PREFIX message before reporting failure.
+int deb_open(const char *path, struct deb_archive *deb);
+void deb_close(struct deb_archive *deb);
+int deb_next_member(struct deb_archive *deb);                     // 1 next member, 0 end, -1 error
+int deb_find_member(struct deb_archive *deb, const char *prefix); // Same as deb_next_member
+ssize_t deb_read_member(struct deb_archive *deb, void *buf, size_t len);
+int deb_drain(struct deb_archive *deb); // Reads the rest of the file (so that deb->hash covers all of it)
+
+int deb_stream_open(struct deb_archive *deb, struct deb_stream *s);
+ssize_t deb_stream_read(struct deb_stream *s, void *buf, size_t len);
+int deb_stream_read_full(struct deb_stream *s, void *buf, size_t len);
+void deb_stream_close(struct deb_stream *s);
+
+int tar_walk(struct deb_stream *s, tar_entry_cb cb, void *ctx); // 0 end, 1 stopped by cb, -1 error
+ssize_t tar_read_data(struct tar_entry *entry, void *buf, size_t len);
+const char *tar_entry_name(const struct tar_entry *entry); // Path without any leading "./" or "/"
+
+/**
+ * Formats an entry as a line of deb-ingest's file listing,
+ * "<f|d|l|h|c|b|p>\t<octal mode>\t<size>\t</path>[\t<link target>]\n".
+ * Returns its length, 0 for entries that are not listed (the root, unknown
+ * types), or -1 for a name with a tab or newline (which dpkg refuses too).
+ */
+#define TAR_LISTING_LINE_MAX (2 * TAR_PATH_MAX + 64)
+int tar_entry_listing(const struct tar_entry *entry, char *line, size_t size);
+
+/**
+ * Picks a package's application icon out of a data.tar walk: the one named by
+ * its .desktop file's Icon= key, looked up along the usual icon search paths.
+ */
+struct icon_candidate;
+struct icon_search {
+    char icon[256];                 // Icon= value, empty until a .desktop file has been read
+    struct icon_candidate *pending; // Possible icons seen before the Icon= value was known
+    size_t pending_bytes;
+    int missed_candidates;          // Possible icons went by that could not be kept
+    unsigned char *data;            // Best icon captured so far
+    size_t len;
+    int rank;                       // Its search path rank, lower is better
+};
+
+#define DEB_ICON_MAX (8 * 1024 * 1024)
+
+void icon_search_init(struct icon_search *search);
+int icon_search_visit(struct tar_entry *entry, struct icon_search *search); // 1 once no better icon can follow
+int icon_search_incomplete(const struct icon_search *search); // Another walk is needed to be sure
+void icon_search_free(struct icon_search *search);
+
+/** Maintainer scripts from control.tar, indexed like deb_script_names; NULL where absent. */
+#define DEB_SCRIPT_COUNT 5
+extern const char *const deb_script_names[DEB_SCRIPT_COUNT];
+struct deb_scripts {
+    char *text[DEB_SCRIPT_COUNT];
+    size_t len[DEB_SCRIPT_COUNT];
+};
+
+/** Reads the control file out of control.tar.*; the caller frees the result. */
+char *deb_read_control(struct deb_archive *deb, size_t *len);
+/** The same, also collecting the maintainer scripts in that one walk; free them with deb_scripts_free. */
+char *deb_read_control_scripts(struct deb_archive *deb, size_t *len, struct deb_scripts *scripts);
+void deb_scripts_free(struct deb_scripts *scripts);
+/** Finds a field (case-insensitively) in a control paragraph; the value includes continuation lines. */
+const char *control_find_field(const char *control, const char *name, size_t *value_len);
+
+#endif // DEB_ARCHIVE_H
@@ -0,0 +1,452 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "deb_contents.h"
+#include "file_index.h"
+#include "dpkg_status.h"
+#include "sha256.h"
+
+/*
+ * On-disk content index of .deb files.
+ *
+ * Browsing a package's files, or checking them against the installed system,
+ * used to mean decompressing its data.tar again each time. deb-ingest already
+ * produces the full listing on its single pass; it is laid out here as a flat
+ * image sorted by path (see deb_contents.h) and saved under the package's
+ * SHA-256, so later listings, prefix searches and conflict checks are a
+ * binary search over an mmap. The digest is also what makes the cache safe: a
+ * rebuilt package with the same name and version gets an index of its own.
+ */
+
+struct listing_line {
+    const char *path, *link;
+    size_t path_len, link_len;
+    uint64_t size;
+    uint32_t mode;
+    char kind;
+};
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static void set_views(struct deb_contents *dc) {
+    dc->header = (const struct deb_contents_header *)dc->image;
+    dc->entries = (const struct deb_contents_entry *)(dc->image + dc->header->entries_offset);
+    dc->strings = (const char *)(dc->image + dc->header->strings_offset);
+}
+
+static int compare_lines(const void *a, const void *b) {
+    const struct listing_line *x = a, *y = b;
+    size_t len = x->path_len < y->path_len ? x->path_len : y->path_len;
+    int cmp = memcmp(x->path, y->path, len);
+    if (cmp != 0) return cmp;
+    return (x->path_len > y->path_len) - (x->path_len < y->path_len);
+}
+
+/** Splits one "<kind>\t<mode>\t<size>\t<path>[\t<link>]" line; -1 if it is malformed. */
+static int parse_line(const char *line, size_t len, struct listing_line *out) {
+    const char *end = line + len;
+    if (len < 2 || line[1] != '\t') return -1;
+    out->kind = line[0];
+    char *p;
+    out->mode = (uint32_t)strtoul(line + 2, &p, 8);
+    if (p >= end || *p != '\t') return -1;
+    out->size = strtoull(p + 1, &p, 10);
+    if (p >= end || *p != '\t' || p[1] != '/') return -1;
+    out->path = p + 1;
+    const char *tab = memchr(out->path, '\t', (size_t)(end - out->path));
+    out->path_len = (size_t)((tab ? tab : end) - out->path);
+    out->link = tab ? tab + 1 : NULL;
+    out->link_len = tab ? (size_t)(end - tab - 1) : 0;
+    return 0;
+}
+
+/** Copies a control field value as one line (continuation lines joined) and NUL-terminates it. */
+static size_t copy_field(char *dest, const char *value, size_t len) {
+    for (size_t i = 0; i < len; i++) dest[i] = value[i] == '\n' ? ' ' : value[i];
+    dest[len] = '\0';
+    return len + 1;
+}
+
+int deb_contents_build(const char *listing, size_t len, const char *control, struct deb_contents *dc) {
+    memset(dc, 0, sizeof(*dc));
+    size_t package_len = 0, replaces_len = 0;
+    const char *package = control_find_field(control, "Package", &package_len);
+    const char *replaces = control_find_field(control, "Replaces", &replaces_len);
+    if (package == NULL) package_len = 0;
+    if (replaces == NULL) replaces_len = 0;
+    size_t count = 0;
+    for (const char *p = listing; p < listing + len; p++) count += *p == '\n';
+
+    struct listing_line *lines = malloc((count ? count : 1) * sizeof(*lines));
+    if (lines == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while indexing the package contents\n");
+        return -1;
+    }
+    size_t n = 0, strings_size = 1 + package_len + 1 + replaces_len + 1; // "" at offset 0, then the two fields
+    uint64_t installed = 0;
+    for (size_t pos = 0; pos < len;) {
+        const char *line = listing + pos;
+        const char *nl = memchr(line, '\n', len - pos);
+        size_t line_len = nl != NULL ? (size_t)(nl - line) : len - pos;
+        pos += line_len + 1;
+        if (line_len == 0) continue;
+        if (n == count || parse_line(line, line_len, &lines[n]) != 0) {
+            fprintf(stderr, ERROR_PREFIX "Malformed file listing: %.*s\n", (int)line_len, line);
+            free(lines);
+            return -1;
+        }
+        strings_size += lines[n].path_len + 1 + (lines[n].link ? lines[n].link_len + 1 : 0);
+        if (lines[n].kind == 'f') installed += lines[n].size;
+        n++;
+    }
+    if (strings_size >= UINT32_MAX) {
+        fprintf(stderr, ERROR_PREFIX "Package contents too large to index\n");
+        free(lines);
+        return -1;
+    }
+    qsort(lines, n, sizeof(*lines), compare_lines);
+
+    struct deb_contents_header header = {
+        .magic = DEB_CONTENTS_MAGIC,
+        .header_size = sizeof(header),
+        .entry_count = (uint32_t)n,
+        .package = 1,
+        .replaces = replaces_len > 0 ? (uint32_t)(1 + package_len + 1) : 0,
+        .installed_bytes = installed,
+    };
+    header.entries_offset = align8(sizeof(header));
+    header.strings_offset = align8(header.entries_offset + n * sizeof(struct deb_contents_entry));
+    header.total_size = header.strings_offset + strings_size;
+
+    unsigned char *image = calloc(1, header.total_size);
+    if (image == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while indexing the package contents\n");
+        free(lines);
+        return -1;
+    }
+    memcpy(image, &header, sizeof(header));
+    struct deb_contents_entry *entries = (struct deb_contents_entry *)(image + header.entries_offset);
+    char *strings = (char *)(image + header.strings_offset);
+
+    size_t str = 1 + copy_field(strings + 1, package, package_len);
+    if (replaces_len > 0) str += copy_field(strings + str, replaces, replaces_len);
+    for (size_t i = 0; i < n; i++) {
+        const struct listing_line *l = &lines[i];
+        entries[i] = (struct deb_contents_entry){ .path = (uint32_t)str, .size = l->size, .mode = l->mode, .kind = l->kind };
+        memcpy(strings + str, l->path, l->path_len);
+        str += l->path_len + 1;
+        if (l->link != NULL) {
+            entries[i].link = (uint32_t)str;
+            memcpy(strings + str, l->link, l->link_len);
+            str += l->link_len + 1;
+        }
+    }
+    free(lines);
+
+    dc->image = image;
+    dc->size = header.total_size;
+    dc->mapped = 0;
+    set_views(dc);
+    return 0;
+}
+
+static int cache_file_for(const char *sha256_hex, char *buf, size_t size) {
+    char name[sizeof(DEB_CONTENTS_CACHE_DIR) + SHA256_HEX_SIZE + 8];
+    snprintf(name, sizeof(name), DEB_CONTENTS_CACHE_DIR "/%s.bin", sha256_hex);
+    return user_cache_path(name, buf, size);
+}
+
+/** Whether every entry's path and link string lies inside a cached image; lookups trust them. */
+static int image_in_bounds(const struct deb_contents *dc) {
+    uint64_t strings_size = dc->size - dc->header->strings_offset; // The image ends in '\0', so every string is terminated
+    for (uint32_t i = 0; i < dc->header->entry_count; i++) {
+        if (dc->entries[i].path >= strings_size || dc->entries[i].link >= strings_size) return 0;
+    }
+    return 1;
+}
+
+int deb_contents_load(const char *sha256_hex, struct deb_contents *dc) {
+    memset(dc, 0, sizeof(*dc));
+    char path[PATH_MAX];
+    if (cache_file_for(sha256_hex, path, sizeof(path)) != 0) return -1;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct deb_contents_header)) {
+        close(fd);
+        return -1;
+    }
+    void *image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return -1;
+
+    const struct deb_contents_header *h = image;
+    size_t size = (size_t)st.st_size;
+    int valid = memcmp(h->magic, DEB_CONTENTS_MAGIC, sizeof(h->magic)) == 0
+        && h->header_size == sizeof(*h) && h->total_size == size
+        && h->entries_offset >= sizeof(*h) && (h->entries_offset | h->strings_offset) % 8 == 0
+        && h->entries_offset + (uint64_t)h->entry_count * sizeof(struct deb_contents_entry) <= h->strings_offset
+        && h->strings_offset < size && h->strings_offset + h->package < size && h->strings_offset + h->replaces < size
+        && ((const char *)image)[size - 1] == '\0';
+    if (valid) {
+        dc->image = image;
+        dc->size = size;
+        dc->mapped = 1;
+        set_views(dc);
+        valid = image_in_bounds(dc);
+    }
+    if (!valid) {
+        munmap(image, size);
+        memset(dc, 0, sizeof(*dc));
+        return -1;
+    }
+
+    utimensat(AT_FDCWD, path, NULL, 0); // Recently used: the pruning in deb_contents_save goes by mtime
+    return 0;
+}
+
+struct cached_index {
+    char name[SHA256_HEX_SIZE + 8];
+    struct timespec mtime;
+};
+
+static int compare_cached_age(const void *a, const void *b) {
+    const struct timespec *x = &((const struct cached_index *)a)->mtime, *y = &((const struct cached_index *)b)->mtime;
+    if (x->tv_sec != y->tv_sec) return (x->tv_sec > y->tv_sec) - (x->tv_sec < y->tv_sec);
+    return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+/** Drops the least recently used indexes beyond DEB_CONTENTS_CACHE_MAX. */
+static void prune_cache(const char *dir_path) {
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) return;
+    struct cached_index *found = NULL;
+    size_t count = 0, cap = 0;
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        if (len != SHA256_HEX_SIZE - 1 + 4 || strcmp(ent->d_name + len - 4, ".bin") != 0) continue;
+        struct stat st;
+        if (fstatat(dirfd(dir), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (count == cap) {
+            size_t grown_cap = cap ? cap * 2 : 2 * DEB_CONTENTS_CACHE_MAX;
+            struct cached_index *grown = realloc(found, grown_cap * sizeof(*grown));
+            if (grown == NULL) break;
+            found = grown;
+            cap = grown_cap;
+        }
+        memcpy(found[count].name, ent->d_name, len + 1);
+        found[count++].mtime = st.st_mtim;
+    }
+    if (count > DEB_CONTENTS_CACHE_MAX) {
+        qsort(found, count, sizeof(*found), compare_cached_age);
+        for (size_t i = 0; i < count - DEB_CONTENTS_CACHE_MAX; i++) unlinkat(dirfd(dir), found[i].name, 0);
+    }
+    free(found);
+    closedir(dir);
+}
+
+void deb_contents_save(const char *sha256_hex, const struct deb_contents *dc) {
+    char path[PATH_MAX];
+    if (cache_file_for(sha256_hex, path, sizeof(path)) != 0) return;
+    write_cache_file(path, dc->image, dc->size);
+    *strrchr(path, '/') = '\0';
+    prune_cache(path);
+}
+
+void deb_contents_close(struct deb_contents *dc) {
+    if (dc->image != NULL) {
+        if (dc->mapped) munmap((void *)dc->image, dc->size);
+        else free((void *)dc->image);
+    }
+    memset(dc, 0, sizeof(*dc));
+}
+
+struct listing {
+    char *data;
+    size_t len, cap;
+};
+
+static int append_listing(struct tar_entry *entry, void *ctx) {
+    struct listing *out = ctx;
+    char line[TAR_LISTING_LINE_MAX];
+    int len = tar_entry_listing(entry, line, sizeof(line));
+    if (len <= 0) return len;
+    if (out->len + (size_t)len > out->cap) {
+        size_t cap = out->cap ? out->cap * 2 : 65536;
+        while (cap < out->len + (size_t)len) cap *= 2;
+        char *grown = realloc(out->data, cap);
+        if (grown == NULL) {
+            fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+            return -1;
+        }
+        out->data = grown;
+        out->cap = cap;
+    }
+    memcpy(out->data + out->len, line, (size_t)len);
+    out->len += (size_t)len;
+    return 0;
+}
+
+/** Indexes a package that has not been seen yet: its control file, then its data.tar. */
+static int index_package(const char *path, struct deb_contents *dc) {
+    struct deb_archive deb;
+    if (deb_open(path, &deb) != 0) return -1;
+    size_t control_len = 0;
+    char *control = deb_read_control(&deb, &control_len);
+    struct listing listing = { NULL, 0, 0 };
+    int rc = -1;
+    if (control != NULL && deb_find_member(&deb, "data.tar") == 1) {
+        struct deb_stream stream;
+        if (deb_stream_open(&deb, &stream) == 0) {
+            rc = tar_walk(&stream, append_listing, &listing) < 0 ? -1 : 0;
+            deb_stream_close(&stream);
+        }
+    } else if (control != NULL) {
+        fprintf(stderr, ERROR_PREFIX "Package has no data.tar member\n");
+    }
+    deb_close(&deb);
+
+    if (rc == 0) rc = deb_contents_build(listing.data ? listing.data : "", listing.len, control, dc);
+    free(control);
+    free(listing.data);
+    return rc;
+}
+
+static int is_sha256_hex(const char *s) {
+    size_t len = strspn(s, "0123456789abcdef");
+    return len == SHA256_HEX_SIZE - 1 && s[len] == '\0';
+}
+
+/** Lower bound of prefix among the sorted paths. */
+static uint32_t find_prefix(const struct deb_contents *dc, const char *prefix) {
+    uint32_t lo = 0, hi = dc->header->entry_count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (strcmp(deb_contents_string(dc, dc->entries[mid].path), prefix) < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static void print_entry(const struct deb_contents *dc, const struct deb_contents_entry *e) {
+    printf("%c\t%04o\t%llu\t%s", e->kind, (unsigned)e->mode, (unsigned long long)e->size,
+           deb_contents_string(dc, e->path));
+    if (e->link != 0) printf("\t%s", deb_contents_string(dc, e->link));
+    putchar('\n');
+}
+
+/** Whether an installed package name ("foo" or "foo:amd64") is the indexed package itself. */
+static int is_same_package(const char *installed, const char *package) {
+    size_t len = strlen(package);
+    return len > 0 && strncmp(installed, package, len) == 0 && (installed[len] == '\0' || installed[len] == ':');
+}
+
+/** Prints one line per path with the owners a check sorted into this kind of line, if there are any. */
+static void print_owners(const char *kind, const char *path, const char *const *names, size_t count) {
+    if (count == 0) return;
+    printf("%s\t%s\t", kind, path);
+    for (size_t i = 0; i < count; i++) printf("%s%s", i ? ", " : "", names[i]);
+    putchar('\n');
+}
+
+/**
+ * Joins the package's non-directory paths against the ownership index, a hash
+ * lookup per path. Owners the package Replaces (at their installed version)
+ * are taken over by dpkg without complaint; every other owner is a conflict.
+ */
+static int print_conflicts(const struct deb_contents *dc) {
+    struct file_index idx;
+    if (file_index_open(&idx) != 0) return 1;
+    const char *package = deb_contents_string(dc, dc->header->package);
+    const char *replaces = deb_contents_string(dc, dc->header->replaces);
+    struct dpkg_status_db status;
+    int have_status = replaces[0] != '\0' && dpkg_status_load(&status, DPKG_STATUS_PATH) == 0;
+
+    uint32_t owners[16];
+    const char *conflicting[16], *replaced[16];
+    for (uint32_t i = 0; i < dc->header->entry_count; i++) {
+        const struct deb_contents_entry *e = &dc->entries[i];
+        if (e->kind == 'd') continue; // Directories are shared freely
+        const char *path = deb_contents_string(dc, e->path);
+        size_t count = file_index_owners(&idx, path, owners, sizeof(owners) / sizeof(owners[0]));
+        if (count > sizeof(owners) / sizeof(owners[0])) count = sizeof(owners) / sizeof(owners[0]);
+        size_t conflict_count = 0, replaced_count = 0;
+        for (size_t j = 0; j < count; j++) {
+            const char *owner = file_index_string(&idx, idx.packages[owners[j]].name);
+            if (is_same_package(owner, package)) continue; // Replacing its own files is an upgrade
+            if (have_status && dpkg_replaces(&status, replaces, owner, strcspn(owner, ":"))) {
+                replaced[replaced_count++] = owner;
+            } else {
+                conflicting[conflict_count++] = owner;
+            }
+        }
+        print_owners("conflict", path, conflicting, conflict_count);
+        print_owners("replaces", path, replaced, replaced_count);
+    }
+    if (have_status) dpkg_status_free(&status);
+    file_index_close(&idx);
+    return 0;
+}
+
+/**
+ * `deb-contents <file.deb|sha256> list [<prefix>]`: prints the package's file
+ * listing in path order, as deb-ingest's files section, optionally only the
+ * paths starting with prefix.
+ * `deb-contents <file.deb|sha256> conflicts`: for each file of the package that
+ * other installed packages own, prints "conflict\t<path>\t<owner>[, <owner>...]"
+ * (dpkg would refuse to overwrite it) and/or "replaces\t<path>\t<owner>[, ...]"
+ * (the package's Replaces lets it take the file over).
+ *
+ * A digest answers from the cache alone and fails if the package was never
+ * ingested; a file is hashed first and indexed (and cached) only on a miss.
+ */
+int handle_deb_contents(int argc, char *argv[]) {
+    int list = argc >= 4 && strcmp(argv[3], "list") == 0;
+    if (!(list && argc <= 5) && !(argc == 4 && strcmp(argv[3], "conflicts") == 0)) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deb-contents <file.deb|sha256> list [<prefix>] | conflicts\n", argv[0]);
+        return 1;
+    }
+
+    const char *target = argv[2];
+    struct deb_contents dc;
+    if (is_sha256_hex(target) && access(target, F_OK) != 0) {
+        if (deb_contents_load(target, &dc) != 0) {
+            fprintf(stderr, ERROR_PREFIX "No content index for %s\n", target);
+            return 1;
+        }
+    } else {
+        char hex[SHA256_HEX_SIZE];
+        if (sha256_file(target, 0, hex) != 0) return 1;
+        if (deb_contents_load(hex, &dc) != 0) {
+            if (index_package(target, &dc) != 0) return 1;
+            deb_contents_save(hex, &dc);
+        }
+    }
+
+    int rc = 0;
+    if (list) {
+        const char *prefix = argc == 5 ? argv[4] : "";
+        size_t prefix_len = strlen(prefix);
+        for (uint32_t i = find_prefix(&dc, prefix); i < dc.header->entry_count; i++) {
+            if (strncmp(deb_contents_string(&dc, dc.entries[i].path), prefix, prefix_len) != 0) break;
+            print_entry(&dc, &dc.entries[i]);
+        }
+    } else {
+        rc = print_conflicts(&dc);
+    }
+    deb_contents_close(&dc);
+    return fflush(stdout) == 0 ? rc : 1;
+}
@@ -0,0 +1,63 @@
+#ifndef DEB_CONTENTS_H
+#define DEB_CONTENTS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEB_CONTENTS_CACHE_DIR "nano-installer/deb-contents" // Under $XDG_CACHE_HOME or ~/.cache
+#define DEB_CONTENTS_MAGIC "NANODCI2"
+#define DEB_CONTENTS_CACHE_MAX 256 // Indexes kept; the least recently used are dropped first
+
+/*
+ * A package's file listing as one flat image, identical in memory and in its
+ * cache file (named after the .deb's SHA-256), so a cached listing is used
+ * straight from mmap:
+ *
+ *   header | entries[] (sorted by path) | strings
+ */
+struct deb_contents_header {
+    char magic[8];
+    uint32_t header_size;
+    uint32_t entry_count;
+    uint32_t package;        // String offset of the Package field
+    uint32_t replaces;       // String offset of the Replaces field ("" if none)
+    uint64_t installed_bytes; // Sum of the regular files' sizes
+    uint64_t entries_offset, strings_offset;
+    uint64_t total_size;
+};
+
+struct deb_contents_entry {
+    uint32_t path;  // String offset, "/usr/bin/foo"
+    uint32_t link;  // String offset of the link target, 0 if none (offset 0 is always "")
+    uint64_t size;
+    uint32_t mode;
+    char kind;      // As in deb-ingest's listing: f, d, l, h, c, b or p
+    char pad[3];
+};
+
+struct deb_contents {
+    const unsigned char *image;
+    size_t size;
+    int mapped; // 1 if image is an mmap of the cache file, 0 if heap-allocated
+    const struct deb_contents_header *header;
+    const struct deb_contents_entry *entries;
+    const char *strings;
+};
+
+/**
+ * Builds the index from deb-ingest's file listing (see tar_entry_listing) and
+ * the package's control paragraph. Prints an ERROR_PREFIX message and returns
+ * -1 on failure.
+ */
+int deb_contents_build(const char *listing, size_t len, const char *control, struct deb_contents *dc);
+/** Maps the cached index of the package with this SHA-256 (hex); -1 if there is none. */
+int deb_contents_load(const char *sha256_hex, struct deb_contents *dc);
+/** Stores the index under the digest, dropping the least recently used ones beyond DEB_CONTENTS_CACHE_MAX. */
+void deb_contents_save(const char *sha256_hex, const struct deb_contents *dc);
+void deb_contents_close(struct deb_contents *dc);
+
+static inline const char *deb_contents_string(const struct deb_contents *dc, uint32_t offset) {
+    return dc->strings + offset;
+}
+
+#endif // DEB_CONTENTS_H
@@ -0,0 +1,642 @@
+#define _GNU_SOURCE // For fallocate() and memrchr()
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+
+/*
+ * Native replacement for `dpkg-deb -x`: unpacks a package's data.tar into a
+ * directory, optionally only the paths on an allow-list.
+ *
+ * Decompression is inherently serial, so this thread walks the archive and a
+ * pool of writer threads does the file system work. A file up to
+ * EXTRACT_CHUNK bytes becomes one job (create, preallocate, write, close); a
+ * larger one is created and preallocated here and its chunks are written at
+ * their offsets by whichever writers are free. At most EXTRACT_INFLIGHT_MAX
+ * bytes are held between the two sides. Each directory is created once, when
+ * the first entry below it needs it, and gets its own mode and time only
+ * after everything has been written into it.
+ *
+ * This runs as the user, so files keep their permission bits but lose
+ * setuid/setgid, and devices and FIFOs are skipped. Entries that would land
+ * outside the destination (an absolute path or hard-link target, "..", or a
+ * symlink the package created or the destination already held) are refused:
+ * every directory on the way is opened from the destination without
+ * following symlinks before anything is written below it.
+ */
+
+#define EXTRACT_MAX_THREADS 16
+#define EXTRACT_DEFAULT_THREADS 4
+#define EXTRACT_CHUNK (1024 * 1024)
+#define EXTRACT_INFLIGHT_MAX (64 * 1024 * 1024)
+#define EXTRACT_MAX_ONLY 64
+#define EXTRACT_PROGRESS_INTERVAL 0.1 // Seconds between progress records
+
+/** A large file being written in chunks; whoever drops the last reference finishes it. */
+struct out_file {
+    int fd;
+    atomic_int refs;
+    unsigned mode;
+    int64_t mtime;
+    char path[];
+};
+
+struct write_job {
+    struct write_job *next;
+    struct out_file *file; // A chunk of a large file, written at offset; NULL for a whole small file
+    uint64_t offset;
+    unsigned mode;
+    int64_t mtime;
+    size_t len;
+    char *path;            // Small files only: where to create it, relative to the destination
+    unsigned char data[];
+};
+
+/** Open-addressing set of relative paths. */
+struct path_set {
+    char **slots;
+    size_t mask;
+    size_t count;
+};
+
+struct dir_fixup {
+    char *path;
+    unsigned mode;
+    int64_t mtime;
+};
+
+struct extract {
+    int dest_fd;
+    const char *name; // Of the .deb, for progress records
+    struct deb_archive deb;
+    uint64_t total;
+    const char **only;
+    size_t only_count;
+
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;  // Writers wait for jobs
+    pthread_cond_t space_ready; // The reader waits for in-flight bytes to drain
+    struct write_job *head, *tail;
+    size_t inflight;            // Bytes queued or being written
+    size_t pending;             // Jobs queued or being written
+    int closing;
+    char error[512];            // First write error, empty while all is well
+
+    struct path_set dirs;       // Created (or found) directories
+    struct path_set symlinks;   // Symlinks this extraction created
+    struct dir_fixup *fixups;
+    size_t fixup_count, fixup_cap;
+
+    uint64_t files, directories, links, bytes, skipped;
+    int progress;
+    struct timespec started;
+    double last_report;
+};
+
+// --- path sets ---
+
+static size_t hash_path(const char *path, size_t len) {
+    size_t h = 14695981039346656037u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)path[i]) * 1099511628211u;
+    return h;
+}
+
+static int path_set_contains(const struct path_set *set, const char *path, size_t len) {
+    if (set->slots == NULL) return 0;
+    for (size_t i = hash_path(path, len) & set->mask;; i = (i + 1) & set->mask) {
+        const char *slot = set->slots[i];
+        if (slot == NULL) return 0;
+        if (strncmp(slot, path, len) == 0 && slot[len] == '\0') return 1;
+    }
+}
+
+static int path_set_add(struct path_set *set, const char *path, size_t len) {
+    if ((set->count + 1) * 2 > (set->slots ? set->mask + 1 : 0)) {
+        size_t size = set->slots ? (set->mask + 1) * 2 : 1024;
+        char **slots = calloc(size, sizeof(*slots));
+        if (slots == NULL) return -1;
+        for (size_t i = 0; set->slots && i <= set->mask; i++) {
+            if (set->slots[i] == NULL) continue;
+            size_t j = hash_path(set->slots[i], strlen(set->slots[i])) & (size - 1);
+            while (slots[j] != NULL) j = (j + 1) & (size - 1);
+            slots[j] = set->slots[i];
+        }
+        free(set->slots);
+        set->slots = slots;
+        set->mask = size - 1;
+    }
+    size_t i = hash_path(path, len) & set->mask;
+    while (set->slots[i] != NULL) i = (i + 1) & set->mask;
+    set->slots[i] = strndup(path, len);
+    if (set->slots[i] == NULL) return -1;
+    set->count++;
+    return 0;
+}
+
+static void path_set_free(struct path_set *set) {
+    for (size_t i = 0; set->slots && i <= set->mask; i++) free(set->slots[i]);
+    free(set->slots);
+}
+
+// --- writers ---
+
+static void set_error(struct extract *ex, const char *what, const char *path, int error) {
+    pthread_mutex_lock(&ex->lock);
+    if (ex->error[0] == '\0') snprintf(ex->error, sizeof(ex->error), "%s %s: %s", what, path, strerror(error));
+    pthread_mutex_unlock(&ex->lock);
+}
+
+/** Creates (or truncates) a file for writing; a read-only or busy leftover is replaced. */
+static int create_file(int dest_fd, const char *path) {
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW | O_CLOEXEC;
+    int fd = openat(dest_fd, path, flags, 0600);
+    if (fd < 0 && (errno == EACCES || errno == ETXTBSY || errno == ELOOP)) {
+        if (unlinkat(dest_fd, path, 0) == 0) fd = openat(dest_fd, path, flags, 0600);
+    }
+    return fd;
+}
+
+static void preallocate(int fd, uint64_t size) {
+    // Lets the file system lay the file out in one piece; not every file system can.
+    if (size > 0) (void)fallocate(fd, 0, 0, (off_t)size);
+}
+
+static int write_all(int fd, const unsigned char *data, size_t len, uint64_t offset) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, data, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return n < 0 ? errno : EIO;
+        data += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static int finish_file(int fd, unsigned mode, int64_t mtime) {
+    struct timespec times[2] = { { .tv_nsec = UTIME_OMIT }, { .tv_sec = (time_t)mtime } };
+    int rc = fchmod(fd, mode & 0777) == 0 && futimens(fd, times) == 0 ? 0 : errno;
+    return close(fd) == 0 ? rc : errno;
+}
+
+static void release_file(struct extract *ex, struct out_file *file) {
+    if (atomic_fetch_sub(&file->refs, 1) != 1) return;
+    int error = finish_file(file->fd, file->mode, file->mtime);
+    if (error != 0) set_error(ex, "Cannot write", file->path, error);
+    free(file);
+}
+
+static void run_job(struct extract *ex, struct write_job *job) {
+    if (job->file != NULL) {
+        int error = write_all(job->file->fd, job->data, job->len, job->offset);
+        if (error != 0) set_error(ex, "Cannot write", job->file->path, error);
+        release_file(ex, job->file);
+        return;
+    }
+    int fd = create_file(ex->dest_fd, job->path);
+    if (fd < 0) {
+        set_error(ex, "Cannot create", job->path, errno);
+        return;
+    }
+    preallocate(fd, job->len);
+    int error = write_all(fd, job->data, job->len, 0);
+    int finished = finish_file(fd, job->mode, job->mtime);
+    if (error != 0 || finished != 0) set_error(ex, "Cannot write", job->path, error ? error : finished);
+}
+
+static void *writer_thread(void *arg) {
+    struct extract *ex = arg;
+    pthread_mutex_lock(&ex->lock);
+    for (;;) {
+        while (ex->head == NULL && !ex->closing) pthread_cond_wait(&ex->work_ready, &ex->lock);
+        if (ex->head == NULL) break;
+        struct write_job *job = ex->head;
+        ex->head = job->next;
+        if (ex->head == NULL) ex->tail = NULL;
+        pthread_mutex_unlock(&ex->lock);
+
+        run_job(ex, job);
+
+        pthread_mutex_lock(&ex->lock);
+        ex->inflight -= job->len;
+        ex->pending--;
+        pthread_cond_signal(&ex->space_ready);
+        free(job);
+    }
+    pthread_mutex_unlock(&ex->lock);
+    return NULL;
+}
+
+/** Queues a job once there is room for it; fails if a writer has already failed. */
+static int submit(struct extract *ex, struct write_job *job) {
+    pthread_mutex_lock(&ex->lock);
+    while (ex->inflight > 0 && ex->inflight + job->len > EXTRACT_INFLIGHT_MAX && ex->error[0] == '\0') {
+        pthread_cond_wait(&ex->space_ready, &ex->lock);
+    }
+    int failed = ex->error[0] != '\0';
+    if (!failed) {
+        job->next = NULL;
+        if (ex->tail) ex->tail->next = job; else ex->head = job;
+        ex->tail = job;
+        ex->inflight += job->len;
+        ex->pending++;
+        pthread_cond_signal(&ex->work_ready);
+    }
+    pthread_mutex_unlock(&ex->lock);
+    if (failed) {
+        if (job->file) release_file(ex, job->file);
+        free(job);
+        return -1;
+    }
+    return 0;
+}
+
+/** Waits until every queued job has been written (before a hard link to one of those files). */
+static int wait_idle(struct extract *ex) {
+    pthread_mutex_lock(&ex->lock);
+    while (ex->pending > 0) pthread_cond_wait(&ex->space_ready, &ex->lock);
+    int failed = ex->error[0] != '\0';
+    pthread_mutex_unlock(&ex->lock);
+    return failed ? -1 : 0;
+}
+
+// --- the walk ---
+
+static void report_progress(struct extract *ex, const char *current, int done) {
+    if (!ex->progress || ex->total == 0) return;
+    double elapsed = seconds_since(&ex->started);
+    if (!done && elapsed - ex->last_report < EXTRACT_PROGRESS_INTERVAL) return;
+    ex->last_report = elapsed;
+
+    double rate = elapsed > 0 ? (double)ex->deb.pos / elapsed : 0;
+    double left = (double)(ex->total > ex->deb.pos ? ex->total - ex->deb.pos : 0);
+    char message[TAR_PATH_MAX + 64];
+    snprintf(message, sizeof(message), "%llu files, %.0f MB/s%s%s", (unsigned long long)ex->files,
+             elapsed > 0 ? (double)ex->bytes / elapsed / 1e6 : 0.0, current ? ": /" : "", current ? current : "");
+    emit_status_record("extract", ex->name, done ? 100.0 : 100.0 * (double)ex->deb.pos / (double)ex->total,
+                       done ? 0 : rate > 0 ? (long)(left / rate + 0.5) : -1, message);
+}
+
+/** Relative, no "..", and nothing below a symlink this package created (which could point anywhere). */
+static int safe_path(const struct extract *ex, const char *path) {
+    if (path[0] == '/') return 0;
+    for (const char *p = path; *p;) {
+        size_t len = strcspn(p, "/");
+        if (len == 2 && p[0] == '.' && p[1] == '.') return 0;
+        if (p[len] == '/' && path_set_contains(&ex->symlinks, path, (size_t)(p + len - path))) return 0;
+        p += len;
+        while (*p == '/') p++;
+    }
+    return 1;
+}
+
+/** An allow-list entry selects a path if it matches it (fnmatch, '*' spanning '/') or is a directory above it. */
+static int selected(const struct extract *ex, const char *name) {
+    if (ex->only_count == 0) return 1;
+    char absolute[TAR_PATH_MAX + 1];
+    snprintf(absolute, sizeof(absolute), "/%s", name);
+    for (size_t i = 0; i < ex->only_count; i++) {
+        const char *only = ex->only[i];
+        size_t len = strlen(only);
+        while (len > 1 && only[len - 1] == '/') len--;
+        if (strncmp(absolute, only, len) == 0 && (absolute[len] == '\0' || absolute[len] == '/')) return 1;
+        if (fnmatch(only, absolute, 0) == 0) return 1;
+    }
+    return 0;
+}
+
+/** Creates the directory (and those above it) unless this extraction has already seen it. */
+static int ensure_dir(struct extract *ex, const char *path, size_t len) {
+    if (len == 0 || path_set_contains(&ex->dirs, path, len)) return 0;
+    const char *slash = memrchr(path, '/', len);
+    if (slash != NULL && ensure_dir(ex, path, (size_t)(slash - path)) != 0) return -1;
+
+    char dir[TAR_PATH_MAX];
+    snprintf(dir, sizeof(dir), "%.*s", (int)len, path);
+    if (mkdirat(ex->dest_fd, dir, 0755) != 0) {
+        if (errno != EEXIST) {
+            fprintf(stderr, ERROR_PREFIX "Cannot create directory %s: %s\n", dir, strerror(errno));
+            return -1;
+        }
+        // Already there, but maybe as a symlink out of the destination; its parents were checked the same way.
+        int fd = openat(ex->dest_fd, dir, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, ERROR_PREFIX "Refusing to extract below %s: %s\n", dir,
+                    errno == ELOOP || errno == ENOTDIR ? "not a directory of the destination" : strerror(errno));
+            return -1;
+        }
+        close(fd);
+    }
+    if (path_set_add(&ex->dirs, path, len) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+static int ensure_parent(struct extract *ex, const char *path) {
+    const char *slash = strrchr(path, '/');
+    return slash ? ensure_dir(ex, path, (size_t)(slash - path)) : 0;
+}
+
+static int remember_dir(struct extract *ex, const char *path, unsigned mode, int64_t mtime) {
+    if (ex->fixup_count == ex->fixup_cap) {
+        size_t cap = ex->fixup_cap ? ex->fixup_cap * 2 : 256;
+        struct dir_fixup *grown = realloc(ex->fixups, cap * sizeof(*grown));
+        if (grown == NULL) return -1;
+        ex->fixups = grown;
+        ex->fixup_cap = cap;
+    }
+    char *copy = strdup(path);
+    if (copy == NULL) return -1;
+    ex->fixups[ex->fixup_count++] = (struct dir_fixup){ copy, mode, mtime };
+    return 0;
+}
+
+static int read_fully(struct tar_entry *entry, unsigned char *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = tar_read_data(entry, buf + got, len - got);
+        if (n <= 0) {
+            fprintf(stderr, ERROR_PREFIX "Truncated data for %s\n", tar_entry_name(entry));
+            return -1;
+        }
+        got += (size_t)n;
+    }
+    return 0;
+}
+
+static int extract_file(struct extract *ex, struct tar_entry *entry, const char *name) {
+    if (entry->size <= EXTRACT_CHUNK) {
+        size_t len = (size_t)entry->size, name_len = strlen(name);
+        struct write_job *job = malloc(sizeof(*job) + len + name_len + 1);
+        if (job == NULL) {
+            fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+            return -1;
+        }
+        *job = (struct write_job){ .mode = entry->mode, .mtime = entry->mtime, .len = len };
+        job->path = (char *)job->data + len;
+        memcpy(job->path, name, name_len + 1);
+        if (read_fully(entry, job->data, len) != 0) {
+            free(job);
+            return -1;
+        }
+        ex->bytes += len;
+        return submit(ex, job);
+    }
+
+    size_t name_len = strlen(name);
+    struct out_file *file = malloc(sizeof(*file) + name_len + 1);
+    if (file == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        return -1;
+    }
+    memcpy(file->path, name, name_len + 1);
+    file->mode = entry->mode;
+    file->mtime = entry->mtime;
+    atomic_init(&file->refs, 1); // This thread's, until the last chunk is queued
+    file->fd = create_file(ex->dest_fd, name);
+    if (file->fd < 0) {
+        fprintf(stderr, ERROR_PREFIX "Cannot create %s: %s\n", name, strerror(errno));
+        free(file);
+        return -1;
+    }
+    preallocate(file->fd, entry->size);
+
+    int rc = 0;
+    for (uint64_t offset = 0; offset < entry->size && rc == 0;) {
+        size_t len = entry->size - offset < EXTRACT_CHUNK ? (size_t)(entry->size - offset) : EXTRACT_CHUNK;
+        struct write_job *job = malloc(sizeof(*job) + len);
+        if (job == NULL) {
+            fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+            rc = -1;
+            break;
+        }
+        *job = (struct write_job){ .file = file, .offset = offset, .len = len };
+        if (read_fully(entry, job->data, len) != 0) {
+            free(job);
+            rc = -1;
+            break;
+        }
+        atomic_fetch_add(&file->refs, 1);
+        rc = submit(ex, job);
+        offset += len;
+        ex->bytes += len;
+        report_progress(ex, name, 0);
+    }
+    release_file(ex, file);
+    return rc;
+}
+
+static int extract_link(struct extract *ex, struct tar_entry *entry, const char *name) {
+    if (unlinkat(ex->dest_fd, name, 0) != 0 && errno != ENOENT && errno != EISDIR) {
+        fprintf(stderr, ERROR_PREFIX "Cannot replace %s: %s\n", name, strerror(errno));
+        return -1;
+    }
+    if (entry->type == '2') {
+        if (symlinkat(entry->link, ex->dest_fd, name) != 0) {
+            fprintf(stderr, ERROR_PREFIX "Cannot create symlink %s: %s\n", name, strerror(errno));
+            return -1;
+        }
+        struct timespec times[2] = { { .tv_nsec = UTIME_OMIT }, { .tv_sec = (time_t)entry->mtime } };
+        (void)utimensat(ex->dest_fd, name, times, AT_SYMLINK_NOFOLLOW);
+        if (path_set_add(&ex->symlinks, name, strlen(name)) != 0) {
+            fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+            return -1;
+        }
+        return 0;
+    }
+
+    // A hard link's target is an earlier entry, which may still be with a writer.
+    struct tar_entry target_entry = { .type = '1' };
+    snprintf(target_entry.path, sizeof(target_entry.path), "%s", entry->link);
+    const char *target = tar_entry_name(&target_entry);
+    if (!selected(ex, target)) {
+        ex->skipped++; // Its target was left out, and its data went by with it
+        return 0;
+    }
+    if (!safe_path(ex, target) || ensure_parent(ex, target) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Refusing to link %s to %s outside the destination\n", name, target);
+        return -1;
+    }
+    if (wait_idle(ex) != 0) return -1;
+    if (linkat(ex->dest_fd, target, ex->dest_fd, name, 0) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Cannot link %s to %s: %s\n", name, target, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int extract_entry(struct tar_entry *entry, void *ctx) {
+    struct extract *ex = ctx;
+    char name[TAR_PATH_MAX];
+    snprintf(name, sizeof(name), "%s", tar_entry_name(entry));
+    size_t len = strlen(name);
+    while (len > 0 && name[len - 1] == '/') name[--len] = '\0';
+    if (len == 0 || strcmp(name, ".") == 0 || !selected(ex, name)) return 0;
+    if (!safe_path(ex, name)) {
+        fprintf(stderr, ERROR_PREFIX "Refusing to extract %s outside the destination\n", name);
+        return -1;
+    }
+
+    int rc = 0;
+    switch (entry->type) {
+    case '5':
+        rc = ensure_dir(ex, name, len);
+        if (rc == 0 && remember_dir(ex, name, entry->mode, entry->mtime) != 0) {
+            fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+            rc = -1;
+        }
+        ex->directories += rc == 0;
+        break;
+    case '0':
+    case '7':
+        rc = ensure_parent(ex, name) == 0 ? extract_file(ex, entry, name) : -1;
+        ex->files += rc == 0;
+        break;
+    case '1':
+    case '2':
+        rc = ensure_parent(ex, name) == 0 ? extract_link(ex, entry, name) : -1;
+        ex->links += rc == 0;
+        break;
+    default: // Devices and FIFOs cannot be created without privileges
+        ex->skipped++;
+        break;
+    }
+    report_progress(ex, name, 0);
+    return rc;
+}
+
+/** Directory modes and times last, deepest first, once nothing more is written into them. */
+static int fix_directories(struct extract *ex) {
+    int rc = 0;
+    for (size_t i = ex->fixup_count; i-- > 0;) {
+        const struct dir_fixup *dir = &ex->fixups[i];
+        struct timespec times[2] = { { .tv_nsec = UTIME_OMIT }, { .tv_sec = (time_t)dir->mtime } };
+        if (fchmodat(ex->dest_fd, dir->path, dir->mode & 0777, 0) != 0 ||
+            utimensat(ex->dest_fd, dir->path, times, 0) != 0) {
+            fprintf(stderr, ERROR_PREFIX "Cannot set attributes of %s: %s\n", dir->path, strerror(errno));
+            rc = -1;
+        }
+    }
+    return rc;
+}
+
+static int parse_thread_count(const char *text, int *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < 1 || value > EXTRACT_MAX_THREADS) return -1;
+    *out = (int)value;
+    return 0;
+}
+
+/**
+ * `deb-extract [--progress] [--threads N] [--only <path|glob>]... <file.deb> <dir>`:
+ * unpacks the package's files into dir (created if missing), like
+ * `dpkg-deb -x`. With --only, just the matching paths ("/usr/share/doc/foo"
+ * also takes everything below it) and the directories leading to them. Prints
+ * "summary\t<files>\t<directories>\t<links>\t<bytes>\t<skipped>". With
+ * --progress, "extract" status records name the file being written.
+ */
+int handle_deb_extract(int argc, char *argv[]) {
+    const char *only[EXTRACT_MAX_ONLY];
+    struct extract ex = { .only = only, .dest_fd = -1 };
+    int thread_count = EXTRACT_DEFAULT_THREADS, first = 2;
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+        if (strcmp(argv[first], "--progress") == 0) {
+            ex.progress = 1;
+        } else if (strcmp(argv[first], "--threads") == 0 && first + 1 < argc &&
+                   parse_thread_count(argv[first + 1], &thread_count) == 0) {
+            first++;
+        } else if (strcmp(argv[first], "--only") == 0 && first + 1 < argc && ex.only_count < EXTRACT_MAX_ONLY) {
+            only[ex.only_count++] = argv[++first];
+        } else {
+            break;
+        }
+    }
+    if (argc != first + 2) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deb-extract [--progress] [--threads N] [--only <path>]... "
+                "<file.deb> <dir>\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[first], *dest = argv[first + 1];
+    ex.name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+
+    if (mkdir(dest, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, ERROR_PREFIX "Cannot create %s: %s\n", dest, strerror(errno));
+        return 1;
+    }
+    ex.dest_fd = open(dest, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (ex.dest_fd < 0) {
+        fprintf(stderr, ERROR_PREFIX "Cannot open %s: %s\n", dest, strerror(errno));
+        return 1;
+    }
+    if (deb_open(path, &ex.deb) != 0) {
+        close(ex.dest_fd);
+        return 1;
+    }
+    struct stat st;
+    if (fstat(ex.deb.fd, &st) == 0) ex.total = (uint64_t)st.st_size;
+    clock_gettime(CLOCK_MONOTONIC, &ex.started);
+
+    pthread_mutex_init(&ex.lock, NULL);
+    pthread_cond_init(&ex.work_ready, NULL);
+    pthread_cond_init(&ex.space_ready, NULL);
+    pthread_t threads[EXTRACT_MAX_THREADS];
+    int started = 0;
+    for (; started < thread_count; started++) {
+        if (pthread_create(&threads[started], NULL, writer_thread, &ex) != 0) break;
+    }
+
+    int rc = -1;
+    if (started == 0) {
+        fprintf(stderr, ERROR_PREFIX "Cannot start writer threads\n");
+    } else if (deb_find_member(&ex.deb, "data.tar") != 1) {
+        fprintf(stderr, ERROR_PREFIX "Package has no data.tar member\n");
+    } else {
+        struct deb_stream stream;
+        if (deb_stream_open(&ex.deb, &stream) == 0) {
+            rc = tar_walk(&stream, extract_entry, &ex) < 0 ? -1 : 0;
+            deb_stream_close(&stream);
+        }
+    }
+
+    pthread_mutex_lock(&ex.lock);
+    ex.closing = 1;
+    pthread_cond_broadcast(&ex.work_ready);
+    pthread_mutex_unlock(&ex.lock);
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+    if (ex.error[0] != '\0') {
+        fprintf(stderr, ERROR_PREFIX "%s\n", ex.error);
+        rc = -1;
+    }
+    if (rc == 0) rc = fix_directories(&ex);
+    if (rc == 0) {
+        report_progress(&ex, NULL, 1);
+        printf("summary\t%llu\t%llu\t%llu\t%llu\t%llu\n", (unsigned long long)ex.files,
+               (unsigned long long)ex.directories, (unsigned long long)ex.links, (unsigned long long)ex.bytes,
+               (unsigned long long)ex.skipped);
+    }
+
+    pthread_cond_destroy(&ex.space_ready);
+    pthread_cond_destroy(&ex.work_ready);
+    pthread_mutex_destroy(&ex.lock);
+    deb_close(&ex.deb);
+    close(ex.dest_fd);
+    path_set_free(&ex.dirs);
+    path_set_free(&ex.symlinks);
+    for (size_t i = 0; i < ex.fixup_count; i++) free(ex.fixups[i].path);
+    free(ex.fixups);
+    return rc == 0 && fflush(stdout) == 0 ? 0 : 1;
+}
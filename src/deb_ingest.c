@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "sha256.h"
+#include "elf_inspect.h"
+#include "file_index.h"
+#include "deb_contents.h"
+#include "dpkg_status.h"
+
+/*
+ * Single-pass .deb ingest.
+ *
+ * Opening a package used to read it several times over (control fields, icon,
+ * hash). Here the archive is read once, front to back: every byte goes through
+ * SHA-256 as it is read, the control file is taken out of control.tar, and the
+ * data.tar walk both lists the contents and picks out the application icon.
+ * The combined result is written as a sequence of sections,
+ *
+ *     <name> <length>\n<length bytes>\n
+ *
+ * named sha256, size, control, files, scripts and (if the package has one)
+ * icon. Each line of files is
+ * "<f|d|l|h|c|b|p>\t<octal mode>\t<size>\t<path>[\t<link target>]"; scripts
+ * holds the maintainer-script findings (see script_risk.c), which cost no
+ * extra read since the scripts come out of the same control.tar walk.
+ *
+ * The data.tar walk also parses the headers of every ELF file it passes (see
+ * elf_inspect.c); the elf section has a line per ELF file and one per library
+ * it needs, the latter resolved against the installed packages:
+ *
+ *     elf\t<path>\t<architecture>\t<type>\t<setuid|setgid|setuid+setgid|->\t<interpreter|->
+ *     needed\t<path>\t<library>\t<bundled|declared|undeclared|unpackaged|missing|unchecked>\t<owner|->
+ *
+ * (see elf_needed_status), or "needed\t<path>\t-\tunreadable\t-" when the
+ * library names could not be reached in the stream.
+ *
+ * The listing is also saved as the package's content index (see
+ * deb_contents.c), so deb-contents can answer for it later from the digest.
+ */
+
+#define INGEST_PROGRESS_INTERVAL 0.1 // Seconds between progress records
+
+struct text_buffer {
+    char *data;
+    size_t len;
+    size_t cap;
+};
+
+struct ingest {
+    struct deb_archive deb;
+    struct text_buffer files;
+    struct icon_search icon;
+    struct deb_scripts scripts;
+    struct elf_file *elves;
+    size_t elf_count, elf_cap;
+    struct elf_buffer elf_buf;
+    int progress;
+    const char *name;
+    uint64_t total;
+    struct timespec started;
+    double last_report;
+};
+
+static int buffer_append(struct text_buffer *buf, const char *text, size_t len) {
+    if (buf->len + len + 1 > buf->cap) {
+        size_t cap = buf->cap ? buf->cap * 2 : 65536;
+        while (cap < buf->len + len + 1) cap *= 2;
+        char *grown = realloc(buf->data, cap);
+        if (grown == NULL) return -1;
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    memcpy(buf->data + buf->len, text, len);
+    buf->len += len;
+    buf->data[buf->len] = '\0';
+    return 0;
+}
+
+/**
+ * Appends one tab-separated record. Fields can come from the package (library
+ * names out of a dynamic string table), so they go in at any length, and a tab
+ * or newline in one becomes '?' rather than splitting the record.
+ */
+static int buffer_append_record(struct text_buffer *buf, const char *const fields[], size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        size_t start = buf->len;
+        if (buffer_append(buf, fields[i], strlen(fields[i])) != 0) return -1;
+        for (size_t j = start; j < buf->len; j++) {
+            if (buf->data[j] == '\t' || buf->data[j] == '\n') buf->data[j] = '?';
+        }
+        if (buffer_append(buf, i + 1 < count ? "\t" : "\n", 1) != 0) return -1;
+    }
+    return 0;
+}
+
+static void report_progress(struct ingest *in, int done) {
+    if (!in->progress || in->total == 0) return;
+    double elapsed = seconds_since(&in->started);
+    if (!done && elapsed - in->last_report < INGEST_PROGRESS_INTERVAL) return;
+    in->last_report = elapsed;
+
+    double rate = elapsed > 0 ? (double)in->deb.pos / elapsed : 0;
+    double left = (double)(in->total > in->deb.pos ? in->total - in->deb.pos : 0);
+    char message[64];
+    snprintf(message, sizeof(message), "%.0f MB/s", rate / 1e6);
+    emit_status_record("read", in->name, done ? 100.0 : 100.0 * (double)in->deb.pos / (double)in->total,
+                       rate > 0 ? (long)(left / rate + 0.5) : -1, message);
+}
+
+/** Keeps the header information of an ELF file; icons and .desktop files were read already and are skipped. */
+static int inspect_elf_entry(struct ingest *in, struct tar_entry *entry, const char *name, size_t name_len) {
+    struct elf_file elf;
+    int rc = elf_inspect(entry, &in->elf_buf, &elf);
+    if (rc <= 0) {
+        elf_file_free(&elf);
+        return rc;
+    }
+    if (in->elf_count == in->elf_cap) {
+        size_t cap = in->elf_cap ? in->elf_cap * 2 : 64;
+        struct elf_file *grown = realloc(in->elves, cap * sizeof(*grown));
+        if (grown == NULL) {
+            elf_file_free(&elf);
+            return -1;
+        }
+        in->elves = grown;
+        in->elf_cap = cap;
+    }
+    elf.mode = entry->mode;
+    elf.path = malloc(name_len + 2);
+    if (elf.path == NULL) {
+        elf_file_free(&elf);
+        return -1;
+    }
+    elf.path[0] = '/';
+    memcpy(elf.path + 1, name, name_len);
+    elf.path[name_len + 1] = '\0';
+    in->elves[in->elf_count++] = elf;
+    return 0;
+}
+
+static int ingest_data_entry(struct tar_entry *entry, void *ctx) {
+    struct ingest *in = ctx;
+    report_progress(in, 0);
+
+    char line[TAR_LISTING_LINE_MAX];
+    int len = tar_entry_listing(entry, line, sizeof(line));
+    if (len <= 0) return len; // Skipped, or a name dpkg would refuse as well
+    if (buffer_append(&in->files, line, (size_t)len) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        return -1;
+    }
+
+    icon_search_visit(entry, &in->icon); // Keep walking regardless: the listing must be complete
+    if (line[0] != 'f') return 0;
+    const char *name = tar_entry_name(entry);
+    size_t name_len = strlen(name);
+    while (name_len > 0 && name[name_len - 1] == '/') name_len--;
+    return inspect_elf_entry(in, entry, name, name_len);
+}
+
+static void write_section(const char *name, const void *data, size_t len) {
+    printf("%s %zu\n", name, len);
+    fwrite(data, 1, len, stdout);
+    putchar('\n');
+}
+
+static int visit_icon_entry(struct tar_entry *entry, void *ctx) {
+    return icon_search_visit(entry, ctx);
+}
+
+/** The single pass: control file, then the data.tar walk, then whatever trails it. */
+static char *ingest_archive(struct ingest *in, size_t *control_len) {
+    char *control = deb_read_control_scripts(&in->deb, control_len, &in->scripts);
+    if (control == NULL) return NULL;
+
+    if (deb_find_member(&in->deb, "data.tar") != 1) {
+        fprintf(stderr, ERROR_PREFIX "Package has no data.tar member\n");
+        free(control);
+        return NULL;
+    }
+    struct deb_stream stream;
+    int walked = -1;
+    if (deb_stream_open(&in->deb, &stream) == 0) {
+        walked = tar_walk(&stream, ingest_data_entry, in);
+        deb_stream_close(&stream);
+    }
+    if (walked < 0 || deb_drain(&in->deb) != 0) {
+        free(control);
+        return NULL;
+    }
+    report_progress(in, 1);
+    return control;
+}
+
+static const char *setid_name(unsigned mode) {
+    switch (mode & 06000) {
+    case 04000: return "setuid";
+    case 02000: return "setgid";
+    case 06000: return "setuid+setgid";
+    default: return "-";
+    }
+}
+
+/** The elf section: each ELF file, and where each library it needs would come from. */
+static int describe_elves(struct ingest *in, const char *control, struct text_buffer *out) {
+    struct file_index index;
+    struct dpkg_status_db status;
+    int have_index = 0, have_status = 0;
+    size_t needing = 0;
+    while (needing < in->elf_count && in->elves[needing].needed_count == 0) needing++;
+    if (needing < in->elf_count) {
+        // Only loaded when some library needs resolving. Failing to load is reported per library, not fatal.
+        have_index = file_index_open(&index) == 0;
+        have_status = have_index && dpkg_status_load(&status, DPKG_STATUS_PATH) == 0;
+    }
+
+    // Libraries may be declared in either field; the alternatives within them all count.
+    char *depends = NULL;
+    size_t depends_len = 0, pre_len = 0;
+    const char *dep = control_find_field(control, "Depends", &depends_len);
+    const char *pre = control_find_field(control, "Pre-Depends", &pre_len);
+    depends = malloc(depends_len + pre_len + 3);
+    int rc = depends ? 0 : -1;
+    if (depends) snprintf(depends, depends_len + pre_len + 3, "%.*s, %.*s", (int)depends_len, dep ? dep : "",
+                          (int)pre_len, pre ? pre : "");
+
+    char owner[256];
+    for (size_t i = 0; i < in->elf_count && rc == 0; i++) {
+        const struct elf_file *elf = &in->elves[i];
+        const char *elf_record[] = { "elf", elf->path, elf->arch, elf->type, setid_name(elf->mode),
+                                     elf->interp ? elf->interp : "-" };
+        rc = buffer_append_record(out, elf_record, 6);
+        if (rc == 0 && elf->needed_unknown) {
+            const char *unknown[] = { "needed", elf->path, "-", "unreadable", "-" };
+            rc = buffer_append_record(out, unknown, 5);
+        }
+        for (const char *lib = elf->needed; rc == 0 && lib && lib < elf->needed + elf->needed_len; lib += strlen(lib) + 1) {
+            const char *where = elf_needed_status(lib, elf->arch, in->files.data, depends, have_index ? &index : NULL,
+                                                  have_status ? &status : NULL, owner, sizeof(owner));
+            const char *needed[] = { "needed", elf->path, lib, where, owner[0] ? owner : "-" };
+            rc = buffer_append_record(out, needed, 5);
+        }
+    }
+    free(depends);
+    if (have_status) dpkg_status_free(&status);
+    if (have_index) file_index_close(&index);
+    return rc;
+}
+
+static void free_ingest(struct ingest *in) {
+    free(in->files.data);
+    icon_search_free(&in->icon);
+    for (size_t i = 0; i < in->elf_count; i++) elf_file_free(&in->elves[i]);
+    free(in->elves);
+    free(in->elf_buf.data);
+}
+
+/** Caches the listing under the digest unless it is there already; best effort like every cache. */
+static void save_contents_index(const char *hex, const char *control, const struct text_buffer *files) {
+    struct deb_contents dc;
+    if (deb_contents_load(hex, &dc) == 0) {
+        deb_contents_close(&dc);
+        return;
+    }
+    if (deb_contents_build(files->data ? files->data : "", files->len, control, &dc) == 0) {
+        deb_contents_save(hex, &dc);
+        deb_contents_close(&dc);
+    }
+}
+
+/** Rare: more possible icons came before the .desktop file than could be kept. */
+static void rescan_for_icon(const char *path, struct icon_search *icon) {
+    struct deb_archive deb;
+    if (deb_open(path, &deb) != 0) return;
+    struct deb_stream stream;
+    if (deb_find_member(&deb, "data.tar") == 1 && deb_stream_open(&deb, &stream) == 0) {
+        tar_walk(&stream, visit_icon_entry, icon);
+        deb_stream_close(&stream);
+    }
+    deb_close(&deb);
+}
+
+/**
+ * `deb-ingest [--progress] <file.deb>`: reads the package once and prints its
+ * digest, size, control file, file list and icon as sections (see above).
+ * With --progress, "read" status records come first.
+ */
+int handle_deb_ingest(int argc, char *argv[]) {
+    int first = 2;
+    struct ingest in;
+    memset(&in, 0, sizeof(in));
+    if (argc > first && strcmp(argv[first], "--progress") == 0) {
+        in.progress = 1;
+        first++;
+    }
+    if (argc != first + 1) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deb-ingest [--progress] <file.deb>\n", argv[0]);
+        return 1;
+    }
+    const char *path = argv[first];
+    in.name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+
+    if (deb_open(path, &in.deb) != 0) return 1;
+    struct stat st;
+    if (fstat(in.deb.fd, &st) == 0) in.total = (uint64_t)st.st_size;
+    clock_gettime(CLOCK_MONOTONIC, &in.started);
+
+    // deb_open has consumed the ar magic already; start the digest with it.
+    struct sha256_ctx hash;
+    sha256_init(&hash);
+    sha256_update(&hash, "!<arch>\n", 8);
+    in.deb.hash = &hash;
+    icon_search_init(&in.icon);
+
+    size_t control_len = 0;
+    char *control = ingest_archive(&in, &control_len);
+    uint64_t size = in.deb.pos;
+    deb_close(&in.deb);
+    size_t risks_len = 0;
+    char *risks = control ? script_risk_report(&in.scripts, &risks_len) : NULL;
+    deb_scripts_free(&in.scripts);
+    struct text_buffer elves = { NULL, 0, 0 };
+    if (risks == NULL || describe_elves(&in, control, &elves) != 0) {
+        if (control != NULL) fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        free(control);
+        free(risks);
+        free(elves.data);
+        free_ingest(&in);
+        return 1;
+    }
+    if (icon_search_incomplete(&in.icon)) rescan_for_icon(path, &in.icon);
+
+    unsigned char digest[SHA256_DIGEST_SIZE];
+    char hex[SHA256_HEX_SIZE], size_text[32];
+    sha256_final(&hash, digest);
+    sha256_hex(digest, hex);
+    snprintf(size_text, sizeof(size_text), "%llu", (unsigned long long)size);
+    save_contents_index(hex, control, &in.files);
+
+    write_section("sha256", hex, strlen(hex));
+    write_section("size", size_text, strlen(size_text));
+    write_section("control", control, control_len);
+    write_section("files", in.files.data ? in.files.data : "", in.files.len);
+    write_section("scripts", risks, risks_len);
+    write_section("elf", elves.data ? elves.data : "", elves.len);
+    if (in.icon.data != NULL) write_section("icon", in.icon.data, in.icon.len);
+
+    free(control);
+    free(risks);
+    free(elves.data);
+    free_ingest(&in);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "nano_backend.h"
+
+/*
+ * Debian version comparison, following dpkg's epoch:upstream-revision rules.
+ *
+ * Versions are compared in place as [start, end) spans, so batch comparisons
+ * never allocate. The upstream and revision parts use dpkg's verrevcmp ordering:
+ * '~' sorts before everything (even the end of the string), then the end, then
+ * letters, then all other characters; digit runs compare numerically.
+ */
+
+struct version_span {
+    unsigned long epoch;
+    const char *upstream, *upstream_end;
+    const char *revision, *revision_end; // Empty when there is no revision
+};
+
+const char *deb_version_check(const char *version) {
+    if (*version == '\0') return "version string is empty";
+    for (const char *p = version; *p; p++) {
+        if (isspace((unsigned char)*p)) return "version string has embedded spaces";
+    }
+    const char *colon = strchr(version, ':');
+    if (colon != NULL) {
+        if (colon == version) return "epoch in version is empty";
+        for (const char *p = version; p < colon; p++) {
+            if (!isdigit((unsigned char)*p)) return "epoch in version is not number";
+        }
+        if (colon[1] == '\0') return "nothing after colon in version number";
+    }
+    const char *hyphen = strrchr(version, '-');
+    if (hyphen != NULL && hyphen[1] == '\0') return "revision number is empty";
+    // Like dpkg, a non-digit start or unusual characters are tolerated and still compared.
+    return NULL;
+}
+
+static void split_version(const char *version, struct version_span *v) {
+    const char *colon = strchr(version, ':');
+    v->epoch = colon != NULL ? strtoul(version, NULL, 10) : 0;
+    v->upstream = colon != NULL ? colon + 1 : version;
+
+    const char *end = v->upstream + strlen(v->upstream);
+    const char *hyphen = strrchr(v->upstream, '-');
+    if (hyphen != NULL) {
+        v->upstream_end = hyphen;
+        v->revision = hyphen + 1;
+    } else {
+        v->upstream_end = end;
+        v->revision = end;
+    }
+    v->revision_end = end;
+}
+
+static int char_order(const char *p, const char *end) {
+    if (p >= end) return 0;
+    int c = (unsigned char)*p;
+    if (isdigit(c)) return 0;
+    if (isalpha(c)) return c;
+    if (c == '~') return -1;
+    return c + 256;
+}
+
+static int verrevcmp(const char *a, const char *a_end, const char *b, const char *b_end) {
+    while (a < a_end || b < b_end) {
+        int first_diff = 0;
+
+        while ((a < a_end && !isdigit((unsigned char)*a)) || (b < b_end && !isdigit((unsigned char)*b))) {
+            int ac = char_order(a, a_end);
+            int bc = char_order(b, b_end);
+            if (ac != bc) return ac - bc;
+            a++;
+            b++;
+        }
+        while (a < a_end && *a == '0') a++;
+        while (b < b_end && *b == '0') b++;
+        while (a < a_end && b < b_end && isdigit((unsigned char)*a) && isdigit((unsigned char)*b)) {
+            if (!first_diff) first_diff = *a - *b;
+            a++;
+            b++;
+        }
+        if (a < a_end && isdigit((unsigned char)*a)) return 1;
+        if (b < b_end && isdigit((unsigned char)*b)) return -1;
+        if (first_diff) return first_diff;
+    }
+    return 0;
+}
+
+int deb_version_compare(const char *a, const char *b) {
+    struct version_span va, vb;
+    split_version(a, &va);
+    split_version(b, &vb);
+
+    if (va.epoch != vb.epoch) return va.epoch > vb.epoch ? 1 : -1;
+    int rc = verrevcmp(va.upstream, va.upstream_end, vb.upstream, vb.upstream_end);
+    if (rc != 0) return rc > 0 ? 1 : -1;
+    rc = verrevcmp(va.revision, va.revision_end, vb.revision, vb.revision_end);
+    return rc > 0 ? 1 : (rc < 0 ? -1 : 0);
+}
+
+int deb_version_satisfies(const char *a, const char *op, const char *b) {
+    int cmp = deb_version_compare(a, b);
+    // Relation operators as written in control files, and dpkg --compare-versions' names.
+    // The obsolete "<" and ">" mean "<=" and ">=", as in dpkg.
+    if (strcmp(op, "<<") == 0 || strcmp(op, "lt") == 0) return cmp < 0;
+    if (strcmp(op, "<=") == 0 || strcmp(op, "le") == 0 || strcmp(op, "<") == 0) return cmp <= 0;
+    if (strcmp(op, "=") == 0 || strcmp(op, "eq") == 0) return cmp == 0;
+    if (strcmp(op, "ne") == 0) return cmp != 0;
+    if (strcmp(op, ">=") == 0 || strcmp(op, "ge") == 0 || strcmp(op, ">") == 0) return cmp >= 0;
+    if (strcmp(op, ">>") == 0 || strcmp(op, "gt") == 0) return cmp > 0;
+    return -1;
+}
+
+static void print_comparison(const char *a, const char *op, const char *b) {
+    const char *problem = deb_version_check(a);
+    if (problem == NULL) problem = deb_version_check(b);
+    if (problem != NULL) {
+        fprintf(stderr, ERROR_PREFIX "%s %s %s: %s\n", a, op, b, problem);
+        puts("invalid");
+        return;
+    }
+    int result = deb_version_satisfies(a, op, b);
+    if (result < 0) {
+        fprintf(stderr, ERROR_PREFIX "Unknown relation operator: %s\n", op);
+        puts("invalid");
+        return;
+    }
+    puts(result ? "true" : "false");
+}
+
+/**
+ * Batch version comparison: `version-compare <v1> <op> <v2> [...]`, or
+ * `version-compare -` to read one "v1 op v2" triple per line from stdin.
+ * Prints true, false or invalid for each triple, in order.
+ */
+int handle_version_compare(int argc, char *argv[]) {
+    if (argc == 3 && strcmp(argv[2], "-") == 0) {
+        char line[1024];
+        while (fgets(line, sizeof(line), stdin) != NULL) {
+            char *a = strtok(line, " \t\n");
+            char *op = strtok(NULL, " \t\n");
+            char *b = strtok(NULL, " \t\n");
+            if (a == NULL) continue;
+            if (op == NULL || b == NULL) {
+                fprintf(stderr, ERROR_PREFIX "Expected \"<v1> <op> <v2>\"\n");
+                puts("invalid");
+                continue;
+            }
+            print_comparison(a, op, b);
+        }
+        return 0;
+    }
+
+    if (argc < 5 || (argc - 2) % 3 != 0) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s version-compare <v1> <op> <v2> [<v1> <op> <v2>...] | -\n", argv[0]);
+        return 1;
+    }
+    for (int i = 2; i < argc; i += 3) {
+        print_comparison(argv[i], argv[i + 1], argv[i + 2]);
+    }
+    return 0;
+}
@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "dpkg_status.h"
+
+/*
+ * Fast path of `apt-op install`: dpkg without apt.
+ *
+ * `apt install ./x.deb` loads the whole apt cache and runs its solver before
+ * it hands the file to dpkg, which takes seconds on a machine with many lists
+ * even when there is nothing to solve. When every package of the batch only
+ * needs what is already installed, nothing is fetched, removed or held back,
+ * so dpkg can be run on the files directly. The checks are deliberately
+ * conservative; whenever one fails the caller goes through apt as before:
+ *
+ *  - the package is not on hold (dpkg -i would change it, apt refuses to);
+ *  - every Depends and Pre-Depends group is met by a configured package;
+ *  - so is every Recommends group, unless APT::Install-Recommends is off: apt
+ *    would install the missing recommendations along with the package;
+ *  - no installed package, nor another file of the batch, is named by the
+ *    package's Conflicts or Breaks, and no installed package's Conflicts or
+ *    Breaks names the package or its Provides;
+ *  - when it replaces an installed version: it is not a downgrade (apt refuses
+ *    those under -y), the architecture stays the same, the Provides field is
+ *    unchanged, and no installed package depends on a version it does not meet.
+ *
+ * As with apt, a package already installed at the same version is skipped
+ * unless --reinstall is given.
+ */
+
+struct direct_deb {
+    const char *path;
+    char *control;
+    char name[256], version[256], arch[64];
+    int skip; // Installed at this version already
+};
+
+/** Copies a single-word field of the control paragraph; 0 if it is missing or too long. */
+static int copy_field(const char *control, const char *field, char *buf, size_t size) {
+    size_t len = 0;
+    const char *value = control_find_field(control, field, &len);
+    if (value == NULL) return 0;
+    size_t word = strcspn(value, " \t\r\n");
+    if (word < len) len = word;
+    if (len == 0 || len >= size) return 0;
+    snprintf(buf, size, "%.*s", (int)len, value);
+    return 1;
+}
+
+/** Calls cb for each comma-separated group of a control field, continuation lines joined; stops at its first non-zero result. */
+static int for_each_group(const char *control, const char *field, int (*cb)(const char *group, void *ctx), void *ctx) {
+    size_t len = 0;
+    const char *value = control_find_field(control, field, &len);
+    char group[1024];
+    for (size_t i = 0; value != NULL && i < len;) {
+        size_t n = 0;
+        while (i < len && value[i] != ',') {
+            if (n < sizeof(group) - 1) group[n++] = value[i] == '\n' ? ' ' : value[i];
+            i++;
+        }
+        group[n] = '\0';
+        i++;
+        if (strspn(group, " \t") == n) continue;
+        int rc = cb(group, ctx);
+        if (rc != 0) return rc;
+    }
+    return 0;
+}
+
+struct check {
+    const struct dpkg_status_db *db;
+    int recommends; // APT::Install-Recommends is on
+    const struct direct_deb *deb;
+    const struct direct_deb *batch;
+    int count;
+    char *reason;
+    size_t reason_size;
+};
+
+static int check_dependency(const char *group, void *ctx) {
+    struct check *c = ctx;
+    enum dep_state state = dpkg_dependency_state(c->db, group, c->deb->arch);
+    if (state == DEP_SATISFIED) return 0;
+    snprintf(c->reason, c->reason_size, "%s needs %s, which is %s", c->deb->name, group + strspn(group, " \t"),
+             state == DEP_OUTDATED ? "not installed at an acceptable version" : "not installed");
+    return 1;
+}
+
+static int check_recommendation(const char *group, void *ctx) {
+    struct check *c = ctx;
+    if (dpkg_dependency_state(c->db, group, c->deb->arch) == DEP_SATISFIED) return 0;
+    snprintf(c->reason, c->reason_size, "%s recommends %s, which apt would install", c->deb->name, group + strspn(group, " \t"));
+    return 1;
+}
+
+static int check_conflict(const char *group, void *ctx) {
+    struct check *c = ctx;
+    const char *entry = group + strspn(group, " \t");
+    if (dpkg_dependency_state(c->db, group, c->deb->arch) == DEP_SATISFIED) {
+        snprintf(c->reason, c->reason_size, "%s conflicts with installed %s", c->deb->name, entry);
+        return 1;
+    }
+    for (int i = 0; i < c->count; i++) {
+        const struct direct_deb *other = &c->batch[i];
+        if (other == c->deb) continue;
+        if (dpkg_relation_mentions(group, other->name, strlen(other->name), other->version) & DPKG_RELATION_MET) {
+            snprintf(c->reason, c->reason_size, "%s conflicts with %s from the same batch", c->deb->name, other->name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int mentions(const char *field, const char *name, size_t name_len, const char *version) {
+    return field != NULL ? dpkg_relation_mentions(field, name, name_len, version) : 0;
+}
+
+/** Whether an installed package's Conflicts or Breaks names one of the virtual packages the new one provides. */
+static int check_provide(const char *group, void *ctx) {
+    struct check *c = ctx;
+    const char *name = group + strspn(group, " \t");
+    size_t name_len = strcspn(name, " \t(:");
+    if (name_len == 0) return 0;
+    for (size_t i = 0; i < c->db->package_count; i++) {
+        const struct dpkg_package *pkg = &c->db->packages[i];
+        if (!pkg->installed || strcmp(pkg->name, c->deb->name) == 0) continue;
+        if (mentions(pkg->conflicts, name, name_len, c->deb->version) || mentions(pkg->breaks, name, name_len, c->deb->version)) {
+            snprintf(c->reason, c->reason_size, "installed %s conflicts with %.*s, which %s provides", pkg->name,
+                     (int)name_len, name, c->deb->name);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** The installed packages' side: their Conflicts, Breaks and, on an upgrade, versioned Depends. */
+static int check_reverse(struct check *c, int upgrade) {
+    const struct direct_deb *d = c->deb;
+    size_t len = strlen(d->name);
+    for (size_t i = 0; i < c->db->package_count; i++) {
+        const struct dpkg_package *pkg = &c->db->packages[i];
+        if (!pkg->installed || strcmp(pkg->name, d->name) == 0) continue;
+        const char *relation = NULL;
+        if (mentions(pkg->conflicts, d->name, len, d->version) & DPKG_RELATION_MET) {
+            relation = "conflicts with";
+        } else if (mentions(pkg->breaks, d->name, len, d->version) & DPKG_RELATION_MET) {
+            relation = "breaks";
+        } else if (upgrade && ((mentions(pkg->depends, d->name, len, d->version)
+                                | mentions(pkg->pre_depends, d->name, len, d->version)) & DPKG_RELATION_UNMET)) {
+            relation = "depends on another version of";
+        }
+        if (relation != NULL) {
+            snprintf(c->reason, c->reason_size, "installed %s %s %s %s", pkg->name, relation, d->name, d->version);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** 1 if dpkg alone can install the package, 0 with the reason filled in if apt is needed. */
+static int can_install_directly(struct check *c, struct direct_deb *d, int reinstall) {
+    int upgrade = 0;
+    for (struct dpkg_package *pkg = dpkg_status_find(c->db, d->name, strlen(d->name), NULL); pkg != NULL;
+         pkg = dpkg_status_find(c->db, d->name, strlen(d->name), pkg)) {
+        if (strncmp(pkg->status, "hold ", 5) == 0) {
+            snprintf(c->reason, c->reason_size, "%s is on hold", d->name);
+            return 0;
+        }
+        const char *word = strrchr(pkg->status, ' ');
+        word = word != NULL ? word + 1 : pkg->status;
+        if (strcmp(word, "not-installed") == 0 || strcmp(word, "config-files") == 0) continue;
+        if (!pkg->installed) {
+            snprintf(c->reason, c->reason_size, "%s is only partly installed", d->name);
+            return 0;
+        }
+        if (strcmp(pkg->architecture, d->arch) != 0) {
+            snprintf(c->reason, c->reason_size, "%s is installed for architecture %s", d->name, pkg->architecture);
+            return 0;
+        }
+        int cmp = deb_version_compare(d->version, pkg->version);
+        if (cmp < 0) {
+            snprintf(c->reason, c->reason_size, "%s would be downgraded from %s", d->name, pkg->version);
+            return 0;
+        }
+        if (cmp == 0 && !reinstall) {
+            d->skip = 1;
+            return 1;
+        }
+        size_t provides_len = 0;
+        const char *provides = control_find_field(d->control, "Provides", &provides_len);
+        if ((pkg->provides == NULL) != (provides == NULL)
+            || (provides != NULL && (strlen(pkg->provides) != provides_len || strncmp(pkg->provides, provides, provides_len) != 0))) {
+            snprintf(c->reason, c->reason_size, "%s changes what it provides", d->name);
+            return 0;
+        }
+        upgrade = cmp > 0;
+    }
+
+    if (for_each_group(d->control, "Pre-Depends", check_dependency, c) || for_each_group(d->control, "Depends", check_dependency, c)
+        || (c->recommends && for_each_group(d->control, "Recommends", check_recommendation, c))
+        || for_each_group(d->control, "Conflicts", check_conflict, c) || for_each_group(d->control, "Breaks", check_conflict, c)
+        || for_each_group(d->control, "Provides", check_provide, c) || check_reverse(c, upgrade)) {
+        return 0;
+    }
+    return 1;
+}
+
+/** Whether apt installs recommendations; taken as on, apt's default, when apt-config cannot say otherwise. */
+static int install_recommends(void) {
+    FILE *config = popen("/usr/bin/apt-config shell VALUE APT::Install-Recommends/b 2>/dev/null", "r");
+    if (config == NULL) return 1;
+    char line[64] = "";
+    if (fgets(line, sizeof(line), config) == NULL) line[0] = '\0';
+    pclose(config);
+    return strcmp(line, "VALUE='false'\n") != 0;
+}
+
+static int read_deb(struct direct_deb *d) {
+    struct deb_archive deb;
+    if (deb_open(d->path, &deb) != 0) return -1;
+    d->control = deb_read_control(&deb, NULL);
+    deb_close(&deb);
+    if (d->control == NULL) return -1;
+    if (!copy_field(d->control, "Package", d->name, sizeof(d->name)) || !copy_field(d->control, "Version", d->version, sizeof(d->version))
+        || !copy_field(d->control, "Architecture", d->arch, sizeof(d->arch))) {
+        return -1;
+    }
+    return 0;
+}
+
+int dpkg_direct_install(char *debs[], int count, int reinstall, int unsafe_io) {
+    struct direct_deb *batch = calloc((size_t)count, sizeof(*batch));
+    if (batch == NULL) return -1;
+    char reason[1024] = "a package could not be read";
+    int direct = 1;
+
+    struct dpkg_status_db db;
+    if (dpkg_status_load(&db, DPKG_STATUS_PATH) != 0) {
+        free(batch);
+        return -1;
+    }
+    for (int i = 0; i < count && direct; i++) {
+        batch[i].path = debs[i];
+        direct = read_deb(&batch[i]) == 0;
+        // The same package twice is left to apt's judgement.
+        for (int j = 0; j < i && direct; j++) {
+            if (strcmp(batch[i].name, batch[j].name) == 0) {
+                snprintf(reason, sizeof(reason), "%s is given more than once", batch[i].name);
+                direct = 0;
+            }
+        }
+    }
+    int recommends = direct ? install_recommends() : 1;
+    for (int i = 0; i < count && direct; i++) {
+        struct check c = { &db, recommends, &batch[i], batch, count, reason, sizeof(reason) };
+        direct = can_install_directly(&c, &batch[i], reinstall);
+    }
+    dpkg_status_free(&db);
+
+    char *args[MAX_ARGS + MAX_BATCH_DEBS];
+    int n = 0, packages = 0;
+    args[n++] = "/usr/bin/dpkg";
+    args[n++] = DPKG_STATUS_FD_OPTION;
+    if (unsafe_io) args[n++] = DPKG_UNSAFE_IO_OPTION;
+    args[n++] = "--install";
+    for (int i = 0; i < count && direct; i++) {
+        if (batch[i].skip) {
+            printf("%s is already the newest version (%s).\n", batch[i].name, batch[i].version);
+        } else {
+            args[n++] = (char *)batch[i].path;
+            packages++;
+        }
+    }
+    args[n] = NULL;
+    for (int i = 0; i < count; i++) free(batch[i].control);
+    free(batch);
+
+    if (!direct) {
+        printf("Installing through apt: %s.\n", reason);
+        fflush(stdout);
+        return -1;
+    }
+    if (packages == 0) return fflush(stdout) == 0 ? 0 : 1;
+    printf("All dependencies are already installed; installing with dpkg directly.\n");
+    return execute_dpkg_with_status(args, packages);
+}
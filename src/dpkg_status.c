@@ -0,0 +1,448 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "dpkg_status.h"
+
+/*
+ * In-memory index of the dpkg status database.
+ *
+ * The status file is read once and parsed in place: field values are
+ * NUL-terminated inside the buffer and the package entries point into it.
+ * Packages are hashed by name (chained, one entry per architecture) and a
+ * second table maps every virtual name in an installed package's Provides
+ * field to its provider, so a whole Depends line is answered without forking.
+ */
+
+static uint64_t hash_name(const char *name, size_t len) {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)name[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int name_equals(const char *a, const char *b, size_t b_len) {
+    return strncmp(a, b, b_len) == 0 && a[b_len] == '\0';
+}
+
+char *read_whole_file(const char *path, size_t *size_out) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        return NULL;
+    }
+
+    // Room for the terminator and for the one-byte read that finds the end.
+    size_t capacity = (size_t)st.st_size + 2, size = 0;
+    char *text = malloc(capacity);
+    int error = text == NULL ? ENOMEM : 0;
+    while (text != NULL) {
+        if (size + 1 >= capacity) {
+            // The file grew while we were reading it.
+            char *bigger = realloc(text, capacity * 2);
+            if (bigger == NULL) { free(text); text = NULL; error = ENOMEM; break; }
+            text = bigger;
+            capacity *= 2;
+        }
+        ssize_t n = read(fd, text + size, capacity - size - 1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) { error = errno; free(text); text = NULL; break; }
+        if (n == 0) break;
+        size += (size_t)n;
+    }
+    close(fd);
+    if (text == NULL) {
+        errno = error;
+        return NULL;
+    }
+    text[size] = '\0';
+    *size_out = size;
+    return text;
+}
+
+static int append_package(struct dpkg_status_db *db, size_t *capacity, const struct dpkg_package *pkg) {
+    if (db->package_count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 1024;
+        struct dpkg_package *bigger = realloc(db->packages, grown * sizeof(*bigger));
+        if (bigger == NULL) return -1;
+        db->packages = bigger;
+        *capacity = grown;
+    }
+    db->packages[db->package_count++] = *pkg;
+    return 0;
+}
+
+static void record_field(struct dpkg_package *pkg, char *line) {
+    char *colon = strchr(line, ':');
+    if (colon == NULL) return;
+    *colon = '\0';
+    char *value = colon + 1;
+    while (*value == ' ' || *value == '\t') value++;
+
+    if (strcasecmp(line, "Package") == 0) pkg->name = value;
+    else if (strcasecmp(line, "Version") == 0) pkg->version = value;
+    else if (strcasecmp(line, "Architecture") == 0) pkg->architecture = value;
+    else if (strcasecmp(line, "Multi-Arch") == 0) pkg->multi_arch = value;
+    else if (strcasecmp(line, "Status") == 0) pkg->status = value;
+    else if (strcasecmp(line, "Provides") == 0) pkg->provides = value;
+    else if (strcasecmp(line, "Installed-Size") == 0) pkg->installed_size = value;
+    else if (strcasecmp(line, "Depends") == 0) pkg->depends = value;
+    else if (strcasecmp(line, "Pre-Depends") == 0) pkg->pre_depends = value;
+    else if (strcasecmp(line, "Breaks") == 0) pkg->breaks = value;
+    else if (strcasecmp(line, "Conflicts") == 0) pkg->conflicts = value;
+}
+
+/** Splits the buffer into paragraphs and records the fields the index needs. */
+static int parse_paragraphs(struct dpkg_status_db *db) {
+    const struct dpkg_package blank = { .version = "", .architecture = "", .multi_arch = "", .status = "",
+                                        .installed_size = "" };
+    struct dpkg_package pkg = blank;
+    size_t capacity = 0;
+    char *line = db->text;
+
+    while (line != NULL) {
+        char *end = strchr(line, '\n');
+        if (end != NULL) *end = '\0';
+        // Continuation lines only belong to fields the index does not use.
+        if (line[0] != '\0' && line[0] != ' ' && line[0] != '\t') {
+            record_field(&pkg, line);
+        }
+        // A blank line or the end of the file completes the paragraph.
+        if (line[0] == '\0' || end == NULL) {
+            if (pkg.name != NULL && append_package(db, &capacity, &pkg) != 0) return -1;
+            pkg = blank;
+        }
+        line = end != NULL ? end + 1 : NULL;
+    }
+    return 0;
+}
+
+static int add_provide(struct dpkg_status_db *db, size_t *capacity, const struct dpkg_provide *provide) {
+    if (db->provide_count == *capacity) {
+        size_t grown = *capacity ? *capacity * 2 : 256;
+        struct dpkg_provide *bigger = realloc(db->provides, grown * sizeof(*bigger));
+        if (bigger == NULL) return -1;
+        db->provides = bigger;
+        *capacity = grown;
+    }
+    db->provides[db->provide_count++] = *provide;
+    return 0;
+}
+
+/** Parses "name [(= version)], ..." from every installed package's Provides field. */
+static int collect_provides(struct dpkg_status_db *db) {
+    size_t capacity = 0;
+    for (size_t i = 0; i < db->package_count; i++) {
+        struct dpkg_package *pkg = &db->packages[i];
+        if (!pkg->installed || pkg->provides == NULL) continue;
+
+        const char *p = pkg->provides;
+        while (*p) {
+            struct dpkg_provide provide = { .provider = pkg };
+            while (*p == ' ' || *p == '\t' || *p == ',') p++;
+            provide.name = p;
+            while (*p && *p != ' ' && *p != '\t' && *p != ',' && *p != '(' && *p != ':') p++;
+            provide.name_len = (size_t)(p - provide.name);
+            while (*p && *p != ',' && *p != '(') p++;
+            if (*p == '(') {
+                p++;
+                while (*p == '=' || *p == ' ') p++;
+                provide.version = p;
+                while (*p && *p != ')' && *p != ' ') p++;
+                provide.version_len = (size_t)(p - provide.version);
+                while (*p && *p != ',') p++;
+            }
+            if (provide.name_len > 0 && add_provide(db, &capacity, &provide) != 0) return -1;
+        }
+    }
+    return 0;
+}
+
+static int build_tables(struct dpkg_status_db *db) {
+    size_t buckets = 64;
+    while (buckets < 2 * (db->package_count + db->provide_count)) buckets <<= 1;
+    db->bucket_mask = buckets - 1;
+    db->buckets = calloc(buckets, sizeof(*db->buckets));
+    db->provide_buckets = calloc(buckets, sizeof(*db->provide_buckets));
+    if (db->buckets == NULL || db->provide_buckets == NULL) return -1;
+
+    for (size_t i = 0; i < db->package_count; i++) {
+        struct dpkg_package *pkg = &db->packages[i];
+        size_t b = hash_name(pkg->name, strlen(pkg->name)) & db->bucket_mask;
+        pkg->next_in_bucket = db->buckets[b];
+        db->buckets[b] = pkg;
+    }
+    for (size_t i = 0; i < db->provide_count; i++) {
+        struct dpkg_provide *provide = &db->provides[i];
+        size_t b = hash_name(provide->name, provide->name_len) & db->bucket_mask;
+        provide->next_in_bucket = db->provide_buckets[b];
+        db->provide_buckets[b] = provide;
+    }
+    return 0;
+}
+
+int dpkg_status_load(struct dpkg_status_db *db, const char *path) {
+    memset(db, 0, sizeof(*db));
+    size_t size;
+    db->text = read_whole_file(path, &size);
+    if (db->text == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Cannot read %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+
+    if (parse_paragraphs(db) != 0) goto oom;
+    for (size_t i = 0; i < db->package_count; i++) {
+        // "<want> <flag> <status>": only a configured package satisfies dependencies.
+        const char *word = strrchr(db->packages[i].status, ' ');
+        db->packages[i].installed = word != NULL && strcmp(word + 1, "installed") == 0;
+    }
+    if (collect_provides(db) != 0 || build_tables(db) != 0) goto oom;
+    return 0;
+
+oom:
+    fprintf(stderr, ERROR_PREFIX "Out of memory while indexing %s\n", path);
+    dpkg_status_free(db);
+    return -1;
+}
+
+void dpkg_status_free(struct dpkg_status_db *db) {
+    free(db->buckets);
+    free(db->provide_buckets);
+    free(db->provides);
+    free(db->packages);
+    free(db->text);
+    memset(db, 0, sizeof(*db));
+}
+
+struct dpkg_package *dpkg_status_find(const struct dpkg_status_db *db, const char *name, size_t len,
+                                      struct dpkg_package *prev) {
+    struct dpkg_package *pkg = prev != NULL ? prev->next_in_bucket
+                                            : db->buckets[hash_name(name, len) & db->bucket_mask];
+    for (; pkg != NULL; pkg = pkg->next_in_bucket) {
+        if (name_equals(pkg->name, name, len)) return pkg;
+    }
+    return NULL;
+}
+
+struct dpkg_provide *dpkg_status_find_provide(const struct dpkg_status_db *db, const char *name, size_t len,
+                                              struct dpkg_provide *prev) {
+    struct dpkg_provide *provide = prev != NULL ? prev->next_in_bucket
+                                                : db->provide_buckets[hash_name(name, len) & db->bucket_mask];
+    for (; provide != NULL; provide = provide->next_in_bucket) {
+        if (provide->name_len == len && strncmp(provide->name, name, len) == 0) return provide;
+    }
+    return NULL;
+}
+
+/** Architecture the backend was built for, in dpkg's naming. */
+static const char *build_architecture(void) {
+#if defined(__x86_64__)
+    return "amd64";
+#elif defined(__aarch64__)
+    return "arm64";
+#elif defined(__i386__)
+    return "i386";
+#elif defined(__arm__)
+    return "armhf";
+#elif defined(__riscv) && __riscv_xlen == 64
+    return "riscv64";
+#elif defined(__powerpc64__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    return "ppc64el";
+#elif defined(__s390x__)
+    return "s390x";
+#else
+    return "";
+#endif
+}
+
+const char *dpkg_native_architecture(const struct dpkg_status_db *db) {
+    // dpkg is always installed for the native architecture.
+    for (struct dpkg_package *pkg = dpkg_status_find(db, "dpkg", 4, NULL); pkg != NULL;
+         pkg = dpkg_status_find(db, "dpkg", 4, pkg)) {
+        if (pkg->installed && pkg->architecture[0] != '\0') return pkg->architecture;
+    }
+    return build_architecture();
+}
+
+struct dep_alternative {
+    const char *name;
+    size_t name_len;
+    const char *arch; // Qualifier after ':', NULL if none
+    size_t arch_len;
+    char op[3];       // Relation operator, empty if unversioned
+    char version[256];
+};
+
+static int is_dep_delimiter(char c) {
+    return c == '\0' || c == ' ' || c == '\t' || c == '(' || c == '|' || c == ':' || c == ')';
+}
+
+/** Parses one "name[:arch] [(op version)]" alternative; returns where the next one starts. */
+static const char *parse_alternative(const char *p, struct dep_alternative *alt) {
+    memset(alt, 0, sizeof(*alt));
+    while (*p == ' ' || *p == '\t') p++;
+    alt->name = p;
+    while (!is_dep_delimiter(*p)) p++;
+    alt->name_len = (size_t)(p - alt->name);
+    if (*p == ':') {
+        alt->arch = ++p;
+        while (!is_dep_delimiter(*p)) p++;
+        alt->arch_len = (size_t)(p - alt->arch);
+    }
+    while (*p == ' ' || *p == '\t') p++;
+    if (*p == '(') {
+        p++;
+        while (*p == ' ' || *p == '\t') p++;
+        size_t op_len = 0;
+        while ((*p == '<' || *p == '>' || *p == '=') && op_len < 2) alt->op[op_len++] = *p++;
+        while (*p == ' ' || *p == '\t') p++;
+        size_t version_len = 0;
+        while (*p && *p != ')' && *p != ' ' && *p != '\t' && *p != '|') {
+            if (version_len < sizeof(alt->version) - 1) alt->version[version_len++] = *p;
+            p++;
+        }
+    }
+    while (*p && *p != '|') p++;
+    return *p == '|' ? p + 1 : p;
+}
+
+/** Architectures "all" and "" (unknown) act as the native architecture. */
+static int same_architecture(const char *a, size_t a_len, const char *b, const char *native) {
+    if (a_len == 0 || (a_len == 3 && strncmp(a, "all", 3) == 0)) {
+        a = native;
+        a_len = strlen(native);
+    }
+    if (b[0] == '\0' || strcmp(b, "all") == 0) b = native;
+    return strlen(b) == a_len && strncmp(a, b, a_len) == 0;
+}
+
+/**
+ * dpkg's architecture rules: an unqualified dependency is met by a package of the
+ * depending package's architecture or by a Multi-Arch: foreign one; ":any" needs
+ * Multi-Arch: allowed; any other qualifier names the architecture exactly.
+ */
+static int architecture_satisfies(const struct dpkg_package *pkg, const struct dep_alternative *alt,
+                                  const char *dependent_arch, const char *native) {
+    if (alt->arch == NULL) {
+        if (strcmp(pkg->multi_arch, "foreign") == 0) return 1;
+        return same_architecture(dependent_arch, strlen(dependent_arch), pkg->architecture, native);
+    }
+    if (alt->arch_len == 3 && strncmp(alt->arch, "any", 3) == 0) {
+        return strcmp(pkg->multi_arch, "allowed") == 0;
+    }
+    return same_architecture(alt->arch, alt->arch_len, pkg->architecture, native);
+}
+
+enum dep_state dpkg_dependency_state(const struct dpkg_status_db *db, const char *group, const char *dependent_arch) {
+    const char *native = dpkg_native_architecture(db);
+    enum dep_state state = DEP_MISSING;
+    const char *p = group;
+
+    while (*p) {
+        struct dep_alternative alt;
+        p = parse_alternative(p, &alt);
+        if (alt.name_len == 0) continue;
+
+        for (struct dpkg_package *pkg = dpkg_status_find(db, alt.name, alt.name_len, NULL); pkg != NULL;
+             pkg = dpkg_status_find(db, alt.name, alt.name_len, pkg)) {
+            if (!pkg->installed || !architecture_satisfies(pkg, &alt, dependent_arch, native)) continue;
+            if (alt.op[0] == '\0' || deb_version_satisfies(pkg->version, alt.op, alt.version) == 1) {
+                return DEP_SATISFIED;
+            }
+            state = DEP_OUTDATED; // Installed, but at a version the relation rules out
+        }
+
+        // Only installed providers are indexed. An unversioned Provides never meets a versioned dependency.
+        for (struct dpkg_provide *provide = dpkg_status_find_provide(db, alt.name, alt.name_len, NULL); provide != NULL;
+             provide = dpkg_status_find_provide(db, alt.name, alt.name_len, provide)) {
+            if (!architecture_satisfies(provide->provider, &alt, dependent_arch, native)) continue;
+            if (alt.op[0] == '\0') return DEP_SATISFIED;
+            if (provide->version == NULL) continue;
+
+            char version[256];
+            snprintf(version, sizeof(version), "%.*s", (int)provide->version_len, provide->version);
+            if (deb_version_satisfies(version, alt.op, alt.version) == 1) return DEP_SATISFIED;
+            state = DEP_OUTDATED;
+        }
+    }
+    return state;
+}
+
+int dpkg_replaces(const struct dpkg_status_db *db, const char *replaces, const char *name, size_t name_len) {
+    char entry[512];
+    for (const char *p = replaces; *p;) {
+        size_t len = strcspn(p, ",");
+        snprintf(entry, sizeof(entry), "%.*s", (int)len, p);
+        p += p[len] == ',' ? len + 1 : len;
+
+        struct dep_alternative alt;
+        parse_alternative(entry, &alt);
+        if (alt.name_len != name_len || strncmp(alt.name, name, name_len) != 0) continue;
+        if (alt.op[0] == '\0') return 1;
+        // The files may belong to a package that is only unpacked, so any entry with a version counts.
+        for (struct dpkg_package *pkg = dpkg_status_find(db, name, name_len, NULL); pkg != NULL;
+             pkg = dpkg_status_find(db, name, name_len, pkg)) {
+            if (pkg->version[0] && deb_version_satisfies(pkg->version, alt.op, alt.version) == 1) return 1;
+        }
+    }
+    return 0;
+}
+
+int dpkg_relation_mentions(const char *field, const char *name, size_t name_len, const char *version) {
+    int mask = 0;
+    char entry[512];
+    for (const char *p = field; *p;) {
+        size_t len = strcspn(p, ",");
+        snprintf(entry, sizeof(entry), "%.*s", (int)len, p);
+        p += p[len] == ',' ? len + 1 : len;
+
+        for (const char *q = entry; *q;) {
+            struct dep_alternative alt;
+            q = parse_alternative(q, &alt);
+            if (alt.name_len != name_len || strncmp(alt.name, name, name_len) != 0) continue;
+            mask |= alt.op[0] == '\0' || deb_version_satisfies(version, alt.op, alt.version) == 1 ? DPKG_RELATION_MET
+                                                                                                : DPKG_RELATION_UNMET;
+        }
+    }
+    return mask;
+}
+
+/**
+ * Answers a whole Depends/Pre-Depends set in one call: each argument is one
+ * comma-separated entry, alternatives included. For every argument one
+ * "<state>\t<group>" line is printed, where state is satisfied, outdated
+ * (installed, but not at an acceptable version) or missing.
+ * --arch names the depending package's architecture (default: native).
+ */
+int handle_deps_check(int argc, char *argv[]) {
+    int first = 2;
+    const char *arch = "";
+    if (argc > 3 && strcmp(argv[2], "--arch") == 0) {
+        arch = argv[3];
+        first = 4;
+    }
+    if (argc <= first) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s deps-check [--arch <arch>] <dependency-group>...\n", argv[0]);
+        return 1;
+    }
+
+    static const char *const state_names[] = { "missing", "outdated", "satisfied" };
+    struct dpkg_status_db db;
+    if (dpkg_status_load(&db, DPKG_STATUS_PATH) != 0) return 1;
+    for (int i = first; i < argc; i++) {
+        printf("%s\t%s\n", state_names[dpkg_dependency_state(&db, argv[i], arch)], argv[i]);
+    }
+    dpkg_status_free(&db);
+    return 0;
+}
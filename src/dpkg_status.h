@@ -0,0 +1,91 @@
+#ifndef DPKG_STATUS_H
+#define DPKG_STATUS_H
+
+#include <stddef.h>
+
+#define DPKG_STATUS_PATH "/var/lib/dpkg/status"
+
+/** One paragraph of the dpkg status file. Strings point into the loaded file. */
+struct dpkg_package {
+    const char *name;
+    const char *version;      // "" if absent
+    const char *architecture; // "" if absent
+    const char *multi_arch;   // "" if absent
+    const char *status;       // e.g. "install ok installed"
+    const char *provides;     // Raw Provides field, NULL if none
+    const char *installed_size; // In KiB, "" if absent
+    const char *depends, *pre_depends, *breaks, *conflicts; // Raw relation fields, NULL if none
+    int installed;            // Unpacked and configured (status word "installed")
+    struct dpkg_package *next_in_bucket;
+};
+
+/** A virtual package name offered by an installed package's Provides field. */
+struct dpkg_provide {
+    const char *name;    // Not NUL-terminated
+    size_t name_len;
+    const char *version; // Version of a versioned provide "(= v)", not NUL-terminated; NULL if none
+    size_t version_len;
+    struct dpkg_package *provider;
+    struct dpkg_provide *next_in_bucket;
+};
+
+struct dpkg_status_db {
+    char *text;
+    struct dpkg_package *packages;
+    size_t package_count;
+    struct dpkg_package **buckets;
+    struct dpkg_provide *provides;
+    size_t provide_count;
+    struct dpkg_provide **provide_buckets;
+    size_t bucket_mask; // Both tables have bucket_mask + 1 buckets
+};
+
+/** Loads and indexes a status file. Prints an ERROR_PREFIX message and returns -1 on failure. */
+int dpkg_status_load(struct dpkg_status_db *db, const char *path);
+void dpkg_status_free(struct dpkg_status_db *db);
+
+/**
+ * Iterates over the entries named `name` (one per architecture on multiarch
+ * systems): pass NULL to get the first and the previous result to get the next.
+ */
+struct dpkg_package *dpkg_status_find(const struct dpkg_status_db *db, const char *name, size_t len,
+                                      struct dpkg_package *prev);
+/** Same iteration over the installed packages that provide `name`. */
+struct dpkg_provide *dpkg_status_find_provide(const struct dpkg_status_db *db, const char *name, size_t len,
+                                              struct dpkg_provide *prev);
+
+enum dep_state {
+    DEP_MISSING,
+    DEP_OUTDATED,   // Some alternative is installed, but at a version the relation rules out
+    DEP_SATISFIED,
+};
+
+/** Native architecture: that of the installed dpkg, else the one the backend was built for. */
+const char *dpkg_native_architecture(const struct dpkg_status_db *db);
+
+/**
+ * Evaluates a dependency group ("a (>= 1) | b:any | c") against the installed
+ * packages and their Provides, honouring relation operators and architecture
+ * qualifiers. dependent_arch is the depending package's architecture ("" or
+ * "all" for native).
+ */
+enum dep_state dpkg_dependency_state(const struct dpkg_status_db *db, const char *group, const char *dependent_arch);
+
+/**
+ * Whether a Replaces field ("a (<< 2), b") lets a package take over files of
+ * the installed package `name`: it is listed, and the installed version meets
+ * the relation if there is one.
+ */
+int dpkg_replaces(const struct dpkg_status_db *db, const char *replaces, const char *name, size_t name_len);
+
+#define DPKG_RELATION_MET 1   // Some entry names the package with a relation the version meets (or no relation)
+#define DPKG_RELATION_UNMET 2 // Some entry names the package with a relation the version fails
+
+/**
+ * How a relation field ("a (>= 1) | b, c") of some other package speaks of
+ * version `version` of `name`: a mask of DPKG_RELATION_*, 0 if it does not
+ * mention it. Architecture qualifiers are not looked at.
+ */
+int dpkg_relation_mentions(const char *field, const char *name, size_t name_len, const char *version);
+
+#endif // DPKG_STATUS_H
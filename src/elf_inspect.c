@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <elf.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "dpkg_status.h"
+#include "file_index.h"
+#include "elf_inspect.h"
+
+/*
+ * ELF inspection of data.tar members as they stream past.
+ *
+ * A tar entry can only be read forward, so the parser asks for byte ranges in
+ * file order: the ELF header, the program headers, PT_INTERP, then
+ * PT_DYNAMIC. Everything before the dynamic section is kept (up to
+ * ELF_PREFIX_MAX), because the string table DT_NEEDED points into is only
+ * located by the dynamic section and is normally laid out before it. Bytes
+ * past the last range needed are never copied; the tar walk skips them.
+ */
+
+#define ELF_MAX_PHDRS 512
+#define ELF_MAX_LOADS 16
+#define ELF_DYNAMIC_MAX (1024 * 1024)
+#define ELF_MAX_NEEDED 256
+#define ELF_INTERP_MAX 4096
+
+struct elf_reader {
+    struct tar_entry *entry;
+    struct elf_buffer *buf; // Kept file bytes [0, buf->len)
+    uint64_t pos;           // File offset of the next byte the entry will yield
+    int contiguous;         // pos == buf->len: the kept prefix can still grow
+};
+
+struct elf_load {
+    uint64_t vaddr, offset, filesz;
+};
+
+/** Appends file bytes to the kept prefix until it reaches end (or the file ends). */
+static int fill_to(struct elf_reader *r, uint64_t end) {
+    struct elf_buffer *buf = r->buf;
+    if (end > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 65536;
+        while (cap < end) cap *= 2;
+        unsigned char *grown = realloc(buf->data, cap);
+        if (grown == NULL) return -1;
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    while (buf->len < end) {
+        ssize_t n = tar_read_data(r->entry, buf->data + buf->len, (size_t)(end - buf->len));
+        if (n < 0) return -1;
+        if (n == 0) break;
+        buf->len += (size_t)n;
+        r->pos += (uint64_t)n;
+    }
+    return 0;
+}
+
+/** Streams on to offset; from here on the kept prefix stops growing. */
+static int skip_to(struct elf_reader *r, uint64_t offset) {
+    unsigned char scratch[DEB_STREAM_CHUNK];
+    r->contiguous = 0;
+    while (r->pos < offset) {
+        uint64_t gap = offset - r->pos;
+        ssize_t n = tar_read_data(r->entry, scratch, gap < sizeof(scratch) ? (size_t)gap : sizeof(scratch));
+        if (n <= 0) return n < 0 ? -1 : 1;
+        r->pos += (uint64_t)n;
+    }
+    return 0;
+}
+
+/**
+ * Copies file bytes [offset, offset + len) into out. Returns 0, 1 if they are
+ * out of reach (already streamed past, or beyond the end), -1 on a read error.
+ */
+static int read_at(struct elf_reader *r, uint64_t offset, size_t len, void *out) {
+    uint64_t end = offset + len;
+    if (end < offset || end > r->entry->size) return 1;
+    if (r->contiguous && end > r->buf->len) {
+        // Keep everything up to the range, as far as ELF_PREFIX_MAX allows: it may hold the string table.
+        if (fill_to(r, end < ELF_PREFIX_MAX ? end : ELF_PREFIX_MAX) != 0) return -1;
+    }
+    unsigned char *p = out;
+    size_t got = 0;
+    if (offset < r->buf->len) {
+        got = r->buf->len - offset < len ? (size_t)(r->buf->len - offset) : len;
+        memcpy(p, r->buf->data + offset, got);
+    }
+    if (got == len) return 0;
+    if (offset + got < r->pos) return 1; // Streamed past without keeping it
+
+    int rc = skip_to(r, offset + got);
+    if (rc != 0) return rc;
+    while (got < len) {
+        ssize_t n = tar_read_data(r->entry, p + got, len - got);
+        if (n <= 0) return n < 0 ? -1 : 1;
+        got += (size_t)n;
+        r->pos += (uint64_t)n;
+    }
+    return 0;
+}
+
+static uint64_t get_uint(const unsigned char *p, int size, int big_endian) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; i++) value |= (uint64_t)p[big_endian ? size - 1 - i : i] << (8 * i);
+    return value;
+}
+
+static const char *debian_arch(unsigned machine, int is64, int big_endian, uint32_t flags) {
+    switch (machine) {
+    case EM_X86_64: return is64 ? "amd64" : "x32";
+    case EM_386: return "i386";
+    case EM_AARCH64: return "arm64";
+    case EM_ARM: return flags & EF_ARM_ABI_FLOAT_HARD ? "armhf" : "armel";
+    case EM_PPC64: return big_endian ? "ppc64" : "ppc64el";
+    case EM_PPC: return "powerpc";
+    case EM_S390: return is64 ? "s390x" : "s390";
+    case EM_RISCV: return is64 ? "riscv64" : "riscv32";
+    case EM_MIPS: return is64 ? (big_endian ? "mips64" : "mips64el") : (big_endian ? "mips" : "mipsel");
+    case 258: return "loong64"; // EM_LOONGARCH, missing from older <elf.h>
+    case EM_SPARCV9: return "sparc64";
+    default: return "unknown";
+    }
+}
+
+static const char *elf_type_name(unsigned type, int has_interp) {
+    switch (type) {
+    case ET_EXEC: return "exec";
+    case ET_DYN: return has_interp ? "pie" : "shared";
+    case ET_REL: return "relocatable";
+    case ET_CORE: return "core";
+    default: return "other";
+    }
+}
+
+/** Reads the DT_NEEDED names out of the string table, if it can still be reached. */
+static int read_needed(struct elf_reader *r, struct elf_file *elf, const uint64_t *needed, size_t count,
+                       uint64_t strtab, uint64_t strsz, const struct elf_load *loads, size_t load_count) {
+    uint64_t offset = UINT64_MAX;
+    for (size_t i = 0; i < load_count; i++) {
+        if (strtab >= loads[i].vaddr && strtab - loads[i].vaddr < loads[i].filesz) {
+            offset = strtab - loads[i].vaddr + loads[i].offset;
+        }
+    }
+    if (offset == UINT64_MAX || strsz == 0 || strsz > ELF_PREFIX_MAX) {
+        elf->needed_unknown = 1;
+        return 0;
+    }
+    char *strings = malloc((size_t)strsz + 1);
+    if (strings == NULL) return -1;
+    int rc = read_at(r, offset, (size_t)strsz, strings);
+    if (rc != 0) {
+        free(strings);
+        if (rc > 0) elf->needed_unknown = 1;
+        return rc < 0 ? -1 : 0;
+    }
+    strings[strsz] = '\0';
+
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) total += needed[i] < strsz ? strlen(strings + needed[i]) + 1 : 0;
+    elf->needed = malloc(total ? total : 1);
+    if (elf->needed == NULL) {
+        free(strings);
+        return -1;
+    }
+    for (size_t i = 0; i < count; i++) {
+        if (needed[i] >= strsz) continue;
+        size_t len = strlen(strings + needed[i]) + 1;
+        memcpy(elf->needed + elf->needed_len, strings + needed[i], len);
+        elf->needed_len += len;
+        elf->needed_count++;
+    }
+    free(strings);
+    return 0;
+}
+
+static int parse_dynamic(struct elf_reader *r, struct elf_file *elf, uint64_t offset, uint64_t size, int is64,
+                         int big_endian, const struct elf_load *loads, size_t load_count) {
+    if (size > ELF_DYNAMIC_MAX) size = ELF_DYNAMIC_MAX;
+    unsigned char *dynamic = malloc(size ? (size_t)size : 1);
+    if (dynamic == NULL) return -1;
+    int rc = read_at(r, offset, (size_t)size, dynamic);
+    if (rc != 0) {
+        free(dynamic);
+        if (rc > 0) elf->needed_unknown = 1;
+        return rc < 0 ? -1 : 0;
+    }
+
+    int word = is64 ? 8 : 4;
+    uint64_t needed[ELF_MAX_NEEDED], strtab = 0, strsz = 0;
+    size_t count = 0;
+    for (uint64_t at = 0; at + 2 * (uint64_t)word <= size; at += 2 * (uint64_t)word) {
+        uint64_t tag = get_uint(dynamic + at, word, big_endian);
+        uint64_t value = get_uint(dynamic + at + word, word, big_endian);
+        if (tag == DT_NULL) break;
+        if (tag == DT_NEEDED && count < ELF_MAX_NEEDED) needed[count++] = value;
+        else if (tag == DT_STRTAB) strtab = value;
+        else if (tag == DT_STRSZ) strsz = value;
+    }
+    free(dynamic);
+    if (count == 0) return 0;
+    return read_needed(r, elf, needed, count, strtab, strsz, loads, load_count);
+}
+
+int elf_inspect(struct tar_entry *entry, struct elf_buffer *buf, struct elf_file *elf) {
+    memset(elf, 0, sizeof(*elf));
+    if (entry->remaining != entry->size || entry->size < 52) return 0;
+    buf->len = 0;
+    struct elf_reader r = { entry, buf, 0, 1 };
+
+    unsigned char ident[64];
+    size_t ident_len = entry->size < sizeof(ident) ? (size_t)entry->size : sizeof(ident);
+    int rc = read_at(&r, 0, ident_len, ident);
+    if (rc != 0) return rc < 0 ? -1 : 0;
+    if (memcmp(ident, ELFMAG, SELFMAG) != 0) return 0;
+    int is64 = ident[EI_CLASS] == ELFCLASS64, big_endian = ident[EI_DATA] == ELFDATA2MSB;
+    if ((!is64 && ident[EI_CLASS] != ELFCLASS32) || (!big_endian && ident[EI_DATA] != ELFDATA2LSB)) return 0;
+    if (is64 && ident_len < 64) return 0;
+
+    unsigned type = (unsigned)get_uint(ident + 16, 2, big_endian);
+    unsigned machine = (unsigned)get_uint(ident + 18, 2, big_endian);
+    uint64_t phoff = get_uint(ident + (is64 ? 32 : 28), is64 ? 8 : 4, big_endian);
+    uint32_t flags = (uint32_t)get_uint(ident + (is64 ? 48 : 36), 4, big_endian);
+    unsigned phentsize = (unsigned)get_uint(ident + (is64 ? 54 : 42), 2, big_endian);
+    unsigned phnum = (unsigned)get_uint(ident + (is64 ? 56 : 44), 2, big_endian);
+    elf->arch = debian_arch(machine, is64, big_endian, flags);
+    elf->type = elf_type_name(type, 0);
+    if (phnum == 0 || phnum > ELF_MAX_PHDRS || phentsize < (is64 ? 56u : 32u)) return 1; // Nothing to link
+
+    unsigned char *phdrs = malloc((size_t)phnum * phentsize);
+    if (phdrs == NULL) return -1;
+    rc = read_at(&r, phoff, (size_t)phnum * phentsize, phdrs);
+    if (rc != 0) {
+        free(phdrs);
+        return rc < 0 ? -1 : 1;
+    }
+    struct elf_load loads[ELF_MAX_LOADS];
+    size_t load_count = 0;
+    uint64_t interp_offset = 0, interp_size = 0, dynamic_offset = 0, dynamic_size = 0;
+    int has_dynamic = 0;
+    for (unsigned i = 0; i < phnum; i++) {
+        const unsigned char *ph = phdrs + (size_t)i * phentsize;
+        uint32_t p_type = (uint32_t)get_uint(ph, 4, big_endian);
+        uint64_t offset = get_uint(ph + (is64 ? 8 : 4), is64 ? 8 : 4, big_endian);
+        uint64_t vaddr = get_uint(ph + (is64 ? 16 : 8), is64 ? 8 : 4, big_endian);
+        uint64_t filesz = get_uint(ph + (is64 ? 32 : 16), is64 ? 8 : 4, big_endian);
+        if (p_type == PT_LOAD && load_count < ELF_MAX_LOADS) {
+            loads[load_count++] = (struct elf_load){ vaddr, offset, filesz };
+        } else if (p_type == PT_INTERP) {
+            interp_offset = offset;
+            interp_size = filesz;
+        } else if (p_type == PT_DYNAMIC) {
+            dynamic_offset = offset;
+            dynamic_size = filesz;
+            has_dynamic = 1;
+        }
+    }
+    free(phdrs);
+
+    if (interp_size > 0 && interp_size < ELF_INTERP_MAX) {
+        elf->interp = calloc(1, (size_t)interp_size + 1);
+        if (elf->interp == NULL) return -1;
+        rc = read_at(&r, interp_offset, (size_t)interp_size, elf->interp);
+        if (rc < 0) return -1;
+        if (rc > 0) {
+            free(elf->interp);
+            elf->interp = NULL;
+        }
+    }
+    elf->type = elf_type_name(type, interp_size > 0);
+    if (has_dynamic && parse_dynamic(&r, elf, dynamic_offset, dynamic_size, is64, big_endian, loads, load_count) != 0) {
+        return -1;
+    }
+    return 1;
+}
+
+void elf_file_free(struct elf_file *elf) {
+    free(elf->path);
+    free(elf->interp);
+    free(elf->needed);
+    memset(elf, 0, sizeof(*elf));
+}
+
+// --- needed library resolution ---
+
+static const char *multiarch_triplet(const char *arch) {
+    static const char *const triplets[][2] = {
+        { "amd64", "x86_64-linux-gnu" },     { "i386", "i386-linux-gnu" },
+        { "arm64", "aarch64-linux-gnu" },    { "armhf", "arm-linux-gnueabihf" },
+        { "armel", "arm-linux-gnueabi" },    { "ppc64el", "powerpc64le-linux-gnu" },
+        { "s390x", "s390x-linux-gnu" },      { "riscv64", "riscv64-linux-gnu" },
+        { "mips64el", "mips64el-linux-gnuabi64" }, { "loong64", "loongarch64-linux-gnu" },
+        { "x32", "x86_64-linux-gnux32" },
+    };
+    for (size_t i = 0; i < sizeof(triplets) / sizeof(triplets[0]); i++) {
+        if (strcmp(arch, triplets[i][0]) == 0) return triplets[i][1];
+    }
+    return NULL;
+}
+
+static int ships_file_named(const char *files, const char *soname) {
+    size_t len = strlen(soname);
+    for (const char *p = files; (p = strstr(p, soname)) != NULL; p += len) {
+        if (p > files && p[-1] == '/' && (p[len] == '\n' || p[len] == '\t' || p[len] == '\0')) return 1;
+    }
+    return 0;
+}
+
+/** Whether Depends/Pre-Depends name owner, directly or through something it provides. */
+static int is_declared(const char *depends, const char *owner, const struct dpkg_status_db *status) {
+    size_t owner_len = strcspn(owner, ":");
+    for (const char *p = depends; *p;) {
+        p += strspn(p, " \t\n,|");
+        size_t len = strcspn(p, " \t\n,|(:[");
+        if (len == 0) {
+            if (*p) p++;
+            continue;
+        }
+        if (len == owner_len && strncmp(p, owner, len) == 0) return 1;
+        for (struct dpkg_provide *provide = status ? dpkg_status_find_provide(status, p, len, NULL) : NULL; provide;
+             provide = dpkg_status_find_provide(status, p, len, provide)) {
+            if (strncmp(provide->provider->name, owner, owner_len) == 0 && provide->provider->name[owner_len] == '\0') {
+                return 1;
+            }
+        }
+        p += len;
+        p += strcspn(p, ",|"); // Skip the version relation and architecture qualifier
+    }
+    return 0;
+}
+
+const char *elf_needed_status(const char *soname, const char *arch, const char *files, const char *depends,
+                              const struct file_index *index, const struct dpkg_status_db *status,
+                              char *owner, size_t owner_size) {
+    owner[0] = '\0';
+    if (files != NULL && ships_file_named(files, soname)) return "bundled";
+    if (index == NULL) return "unchecked";
+
+    const char *triplet = multiarch_triplet(arch);
+    char dirs[6][64];
+    size_t dir_count = 0;
+    if (triplet) {
+        snprintf(dirs[dir_count++], sizeof(dirs[0]), "/lib/%s", triplet);
+        snprintf(dirs[dir_count++], sizeof(dirs[0]), "/usr/lib/%s", triplet);
+    }
+    static const char *const plain_dirs[] = { "/lib", "/usr/lib", "/lib64", "/usr/lib64" };
+    for (size_t i = 0; i < 4; i++) snprintf(dirs[dir_count++], sizeof(dirs[0]), "%s", plain_dirs[i]);
+
+    int present = 0;
+    for (size_t i = 0; i < dir_count; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", dirs[i], soname);
+        uint32_t found;
+        if (index != NULL && file_index_owners(index, path, &found, 1) > 0) {
+            snprintf(owner, owner_size, "%s", file_index_string(index, index->packages[found].name));
+            owner[strcspn(owner, ":")] = '\0';
+            return is_declared(depends ? depends : "", owner, status) ? "declared" : "undeclared";
+        }
+        struct stat st;
+        if (!present && stat(path, &st) == 0) present = 1;
+    }
+    return present ? "unpackaged" : "missing";
+}
@@ -0,0 +1,56 @@
+#ifndef ELF_INSPECT_H
+#define ELF_INSPECT_H
+
+#include <stddef.h>
+
+struct tar_entry;
+struct file_index;
+struct dpkg_status_db;
+
+#define ELF_PREFIX_MAX (16 * 1024 * 1024) // File bytes kept in memory while the dynamic section is still to come
+
+/** What the headers of one packaged ELF file say. */
+struct elf_file {
+    char *path;           // As listed by deb-ingest: "/usr/bin/foo"
+    unsigned mode;        // From the tar header
+    const char *arch;     // Debian architecture name ("amd64", "arm64", ...) or "unknown"
+    const char *type;     // "exec", "pie", "shared", "relocatable", "core" or "other"
+    char *interp;         // PT_INTERP, NULL if none
+    char *needed;         // DT_NEEDED names, each NUL-terminated, back to back
+    size_t needed_len;
+    size_t needed_count;
+    int needed_unknown;   // There is a dynamic section, but its strings were out of reach
+};
+
+/** Reusable read buffer, so that a data.tar walk allocates it once. */
+struct elf_buffer {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+};
+
+/**
+ * Reads an ELF file's header, program headers, interpreter and dynamic
+ * section from an entry that has not been read from yet, in one forward pass
+ * (the strings DT_NEEDED refers to normally precede the dynamic section, so
+ * the bytes before it are kept, up to ELF_PREFIX_MAX). Returns 1 and fills
+ * elf for an ELF file, 0 if the entry is something else, -1 on a read error;
+ * free elf with elf_file_free in every case.
+ */
+int elf_inspect(struct tar_entry *entry, struct elf_buffer *buf, struct elf_file *elf);
+void elf_file_free(struct elf_file *elf);
+
+/**
+ * Where a needed library would come from: "bundled" (the package ships a file
+ * of that name; files is deb-ingest's listing), "declared" or "undeclared" (an
+ * installed package owns it, and Depends/Pre-Depends does or does not name
+ * that package or something it provides), "unpackaged" (present in a library
+ * directory, owned by no package) or "missing". owner receives the owning
+ * package, or "" if there is none. Without an index the answer is "bundled"
+ * or "unchecked"; without a status database, provides are not considered.
+ */
+const char *elf_needed_status(const char *soname, const char *arch, const char *files, const char *depends,
+                              const struct file_index *index, const struct dpkg_status_db *status,
+                              char *owner, size_t owner_size);
+
+#endif // ELF_INSPECT_H
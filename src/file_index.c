@@ -0,0 +1,480 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "dpkg_status.h"
+#include "file_index.h"
+
+/*
+ * Reverse file-ownership index over dpkg's info/<package>.list files.
+ *
+ * Building it means reading a few thousand small files, which is done by a
+ * pool of threads; the result is laid out as a single flat image (see
+ * file_index.h) and saved to the user's cache directory. The cache is keyed
+ * by the mtimes of the info directory and the status file: dpkg replaces
+ * .list files by renaming them into place and rewrites the status file on
+ * every run, so any package change invalidates it.
+ */
+
+#define SCAN_MAX_THREADS 8
+
+struct list_file {
+    char *package;
+    char *data;
+    size_t len;
+};
+
+struct scan_job {
+    struct list_file *files;
+    size_t count;
+    atomic_size_t next;
+};
+
+static uint64_t hash_path(const char *path) {
+    uint64_t hash = 1469598103934665603ULL; // FNV-1a
+    for (const unsigned char *p = (const unsigned char *)path; *p; p++) {
+        hash ^= *p;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static int compare_list_files(const void *a, const void *b) {
+    return strcmp(((const struct list_file *)a)->package, ((const struct list_file *)b)->package);
+}
+
+/** Reads a .list file; a file removed mid-scan simply reads as empty. */
+static void read_list_file(struct list_file *file) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), DPKG_INFO_DIR "/%s.list", file->package);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        file->data = malloc((size_t)st.st_size);
+        while (file->data != NULL && file->len < (size_t)st.st_size) {
+            ssize_t n = read(fd, file->data + file->len, (size_t)st.st_size - file->len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) break;
+            file->len += (size_t)n;
+        }
+    }
+    close(fd);
+}
+
+static void *scan_worker(void *arg) {
+    struct scan_job *job = arg;
+    for (;;) {
+        size_t i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->count) break;
+        read_list_file(&job->files[i]);
+    }
+    return NULL;
+}
+
+/** Lists DPKG_INFO_DIR's .list files, sorted by package name. */
+static struct list_file *collect_list_files(size_t *count_out) {
+    DIR *dir = opendir(DPKG_INFO_DIR);
+    if (dir == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Cannot open " DPKG_INFO_DIR ": %s\n", strerror(errno));
+        return NULL;
+    }
+
+    struct list_file *files = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= 5 || strcmp(entry->d_name + len - 5, ".list") != 0) continue;
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            struct list_file *bigger = realloc(files, capacity * sizeof(*bigger));
+            if (bigger == NULL) break;
+            files = bigger;
+        }
+        files[count] = (struct list_file){ .package = strndup(entry->d_name, len - 5) };
+        if (files[count].package != NULL) count++;
+    }
+    closedir(dir);
+
+    qsort(files, count, sizeof(*files), compare_list_files);
+    *count_out = count;
+    return files;
+}
+
+static void scan_in_parallel(struct list_file *files, size_t count) {
+    struct scan_job job = { .files = files, .count = count };
+    atomic_init(&job.next, 0);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = cpus > 1 ? (size_t)cpus : 1;
+    if (thread_count > SCAN_MAX_THREADS) thread_count = SCAN_MAX_THREADS;
+
+    pthread_t threads[SCAN_MAX_THREADS];
+    size_t started = 0;
+    for (; started < thread_count - 1; started++) {
+        if (pthread_create(&threads[started], NULL, scan_worker, &job) != 0) break;
+    }
+    scan_worker(&job); // The calling thread works too
+    for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+}
+
+static size_t align8(size_t n) {
+    return (n + 7) & ~(size_t)7;
+}
+
+static void set_views(struct file_index *idx) {
+    idx->header = (const struct file_index_header *)idx->image;
+    idx->packages = (const struct file_index_package *)(idx->image + idx->header->packages_offset);
+    idx->paths = (const struct file_index_path *)(idx->image + idx->header->paths_offset);
+    idx->slots = (const uint32_t *)(idx->image + idx->header->slots_offset);
+    idx->strings = (const char *)(idx->image + idx->header->strings_offset);
+}
+
+/** Lays the scanned lists out as an index image. */
+static int build_image(struct list_file *files, size_t count, const struct stat *info_st,
+                       const struct stat *status_st, struct file_index *idx) {
+    size_t path_count = 0, strings_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        strings_size += strlen(files[i].package) + 1;
+        for (size_t pos = 0; pos < files[i].len;) {
+            const char *line = files[i].data + pos;
+            const char *nl = memchr(line, '\n', files[i].len - pos);
+            size_t len = nl != NULL ? (size_t)(nl - line) : files[i].len - pos;
+            pos += len + 1;
+            if (len == 0 || (len == 2 && line[0] == '/' && line[1] == '.')) continue; // dpkg lists "/." first
+            path_count++;
+            strings_size += len + 1;
+        }
+    }
+    if (strings_size >= UINT32_MAX || path_count >= UINT32_MAX / 2) {
+        fprintf(stderr, ERROR_PREFIX "File index too large\n");
+        return -1;
+    }
+
+    size_t slot_count = 16;
+    while (slot_count < 2 * path_count) slot_count <<= 1;
+
+    struct file_index_header header = {
+        .magic = FILE_INDEX_MAGIC,
+        .header_size = sizeof(header),
+        .package_count = (uint32_t)count,
+        .path_count = (uint32_t)path_count,
+        .slot_count = (uint32_t)slot_count,
+        .info_mtime_sec = info_st->st_mtim.tv_sec,
+        .info_mtime_nsec = info_st->st_mtim.tv_nsec,
+        .status_mtime_sec = status_st->st_mtim.tv_sec,
+        .status_mtime_nsec = status_st->st_mtim.tv_nsec,
+    };
+    header.packages_offset = align8(sizeof(header));
+    header.paths_offset = align8(header.packages_offset + count * sizeof(struct file_index_package));
+    header.slots_offset = align8(header.paths_offset + path_count * sizeof(struct file_index_path));
+    header.strings_offset = align8(header.slots_offset + slot_count * sizeof(uint32_t));
+    header.total_size = header.strings_offset + strings_size;
+
+    unsigned char *image = calloc(1, header.total_size);
+    if (image == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while building the file index\n");
+        return -1;
+    }
+    memcpy(image, &header, sizeof(header));
+    struct file_index_package *packages = (struct file_index_package *)(image + header.packages_offset);
+    struct file_index_path *paths = (struct file_index_path *)(image + header.paths_offset);
+    uint32_t *slots = (uint32_t *)(image + header.slots_offset);
+    char *strings = (char *)(image + header.strings_offset);
+
+    size_t str = 0, path_index = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t name_len = strlen(files[i].package) + 1;
+        memcpy(strings + str, files[i].package, name_len);
+        packages[i] = (struct file_index_package){ .name = (uint32_t)str, .first_path = (uint32_t)path_index };
+        str += name_len;
+
+        for (size_t pos = 0; pos < files[i].len;) {
+            const char *line = files[i].data + pos;
+            const char *nl = memchr(line, '\n', files[i].len - pos);
+            size_t len = nl != NULL ? (size_t)(nl - line) : files[i].len - pos;
+            pos += len + 1;
+            if (len == 0 || (len == 2 && line[0] == '/' && line[1] == '.')) continue;
+
+            memcpy(strings + str, line, len);
+            strings[str + len] = '\0';
+            paths[path_index] = (struct file_index_path){ .path = (uint32_t)str, .package = (uint32_t)i };
+            size_t slot = hash_path(strings + str) & (slot_count - 1);
+            while (slots[slot] != 0) slot = (slot + 1) & (slot_count - 1);
+            slots[slot] = (uint32_t)path_index + 1;
+            str += len + 1;
+            path_index++;
+        }
+        packages[i].path_count = (uint32_t)path_index - packages[i].first_path;
+    }
+
+    idx->image = image;
+    idx->size = header.total_size;
+    idx->mapped = 0;
+    set_views(idx);
+    return 0;
+}
+
+int user_cache_path(const char *name, char *buf, size_t size) {
+    const char *xdg = getenv("XDG_CACHE_HOME");
+    const char *home = getenv("HOME");
+    int n;
+    if (xdg != NULL && xdg[0] == '/') {
+        n = snprintf(buf, size, "%s/%s", xdg, name);
+    } else if (home != NULL && home[0] == '/') {
+        n = snprintf(buf, size, "%s/.cache/%s", home, name);
+    } else {
+        return -1;
+    }
+    return n > 0 && (size_t)n < size ? 0 : -1;
+}
+
+static int keys_match(const struct file_index_header *h, const struct stat *info_st, const struct stat *status_st) {
+    return h->info_mtime_sec == info_st->st_mtim.tv_sec && h->info_mtime_nsec == info_st->st_mtim.tv_nsec
+        && h->status_mtime_sec == status_st->st_mtim.tv_sec && h->status_mtime_nsec == status_st->st_mtim.tv_nsec;
+}
+
+/**
+ * Whether every package, path and slot of a cached image points inside it.
+ * The lookups trust these values, so a damaged or foreign cache file must be
+ * caught here rather than crash them; one linear pass costs far less than the
+ * scan it saves.
+ */
+static int image_in_bounds(const struct file_index *idx) {
+    const struct file_index_header *h = idx->header;
+    uint64_t strings_size = idx->size - h->strings_offset; // The image ends in '\0', so every string is terminated
+    for (uint32_t i = 0; i < h->package_count; i++) {
+        const struct file_index_package *pkg = &idx->packages[i];
+        if (pkg->name >= strings_size || pkg->first_path > h->path_count || pkg->path_count > h->path_count - pkg->first_path) {
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < h->path_count; i++) {
+        if (idx->paths[i].path >= strings_size || idx->paths[i].package >= h->package_count) return 0;
+    }
+    int have_empty_slot = 0; // Without one a probe for a missing path would never stop
+    for (uint32_t i = 0; i < h->slot_count; i++) {
+        if (idx->slots[i] > h->path_count) return 0;
+        if (idx->slots[i] == 0) have_empty_slot = 1;
+    }
+    return have_empty_slot;
+}
+
+static int load_cache(const char *path, const struct stat *info_st, const struct stat *status_st, struct file_index *idx) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return -1;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(struct file_index_header)) {
+        close(fd);
+        return -1;
+    }
+    void *image = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return -1;
+
+    const struct file_index_header *h = image;
+    size_t size = (size_t)st.st_size;
+    int valid = memcmp(h->magic, FILE_INDEX_MAGIC, sizeof(h->magic)) == 0
+        && h->header_size == sizeof(*h) && h->total_size == size
+        && h->packages_offset >= sizeof(*h) && h->strings_offset < size
+        && (h->packages_offset | h->paths_offset | h->slots_offset | h->strings_offset) % 8 == 0
+        && h->packages_offset <= h->paths_offset && h->paths_offset <= h->slots_offset && h->slots_offset <= h->strings_offset
+        && h->packages_offset + (uint64_t)h->package_count * sizeof(struct file_index_package) <= h->paths_offset
+        && h->paths_offset + (uint64_t)h->path_count * sizeof(struct file_index_path) <= h->slots_offset
+        && h->slots_offset + (uint64_t)h->slot_count * sizeof(uint32_t) <= h->strings_offset
+        && ((const char *)image)[size - 1] == '\0'
+        && h->slot_count != 0 && (h->slot_count & (h->slot_count - 1)) == 0
+        && keys_match(h, info_st, status_st);
+    if (valid) {
+        idx->image = image;
+        idx->size = size;
+        idx->mapped = 1;
+        set_views(idx);
+        valid = image_in_bounds(idx);
+    }
+    if (!valid) {
+        munmap(image, size);
+        memset(idx, 0, sizeof(*idx));
+        return -1;
+    }
+    return 0;
+}
+
+void write_cache_file(const char *path, const void *data, size_t size) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), "%s", path);
+    for (char *slash = strchr(dir + 1, '/'); slash != NULL; slash = strchr(slash + 1, '/')) {
+        *slash = '\0';
+        mkdir(dir, 0700);
+        *slash = '/';
+    }
+
+    char tmp[PATH_MAX];
+    if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp)) return;
+    int fd = mkstemp(tmp);
+    if (fd == -1) return;
+
+    const unsigned char *p = data;
+    size_t left = size;
+    while (left > 0) {
+        ssize_t n = write(fd, p, left);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        p += n;
+        left -= (size_t)n;
+    }
+    if (close(fd) != 0 || left != 0 || rename(tmp, path) != 0) {
+        unlink(tmp);
+    }
+}
+
+int file_index_open(struct file_index *idx) {
+    memset(idx, 0, sizeof(*idx));
+    struct stat info_st, status_st;
+    if (stat(DPKG_INFO_DIR, &info_st) == -1 || stat(DPKG_STATUS_PATH, &status_st) == -1) {
+        fprintf(stderr, ERROR_PREFIX "Cannot read the dpkg database: %s\n", strerror(errno));
+        return -1;
+    }
+
+    char cache_path[PATH_MAX];
+    int have_cache_path = user_cache_path(FILE_INDEX_CACHE_NAME, cache_path, sizeof(cache_path)) == 0;
+    if (have_cache_path && load_cache(cache_path, &info_st, &status_st, idx) == 0) {
+        return 0;
+    }
+
+    size_t count = 0;
+    struct list_file *files = collect_list_files(&count);
+    if (files == NULL) return -1;
+    scan_in_parallel(files, count);
+    int rc = build_image(files, count, &info_st, &status_st, idx);
+    for (size_t i = 0; i < count; i++) {
+        free(files[i].package);
+        free(files[i].data);
+    }
+    free(files);
+
+    // Best effort: a missing or unwritable cache directory only costs the next run a rescan.
+    if (rc == 0 && have_cache_path) write_cache_file(cache_path, idx->image, idx->size);
+    return rc;
+}
+
+void file_index_close(struct file_index *idx) {
+    if (idx->image != NULL) {
+        if (idx->mapped) munmap((void *)idx->image, idx->size);
+        else free((void *)idx->image);
+    }
+    memset(idx, 0, sizeof(*idx));
+}
+
+size_t file_index_owners(const struct file_index *idx, const char *path, uint32_t *owners, size_t max) {
+    uint32_t mask = idx->header->slot_count - 1;
+    size_t found = 0;
+    for (uint32_t slot = hash_path(path) & mask; idx->slots[slot] != 0; slot = (slot + 1) & mask) {
+        const struct file_index_path *entry = &idx->paths[idx->slots[slot] - 1];
+        if (strcmp(file_index_string(idx, entry->path), path) != 0) continue;
+        if (found < max) owners[found] = entry->package;
+        found++;
+    }
+    return found;
+}
+
+long file_index_find_package(const struct file_index *idx, const char *name, long after) {
+    size_t len = strlen(name);
+    size_t lo = 0, hi = idx->header->package_count;
+    if (after >= 0) {
+        lo = (size_t)after + 1;
+    } else {
+        while (lo < hi) { // Lower bound of name
+            size_t mid = lo + (hi - lo) / 2;
+            if (strcmp(file_index_string(idx, idx->packages[mid].name), name) < 0) lo = mid + 1;
+            else hi = mid;
+        }
+    }
+
+    // "libc6" matches "libc6" and "libc6:<arch>"; "libc6-dev" sorts in between and is skipped.
+    for (size_t i = lo; i < idx->header->package_count; i++) {
+        const char *candidate = file_index_string(idx, idx->packages[i].name);
+        if (strncmp(candidate, name, len) != 0) break;
+        if (candidate[len] == '\0' || candidate[len] == ':') return (long)i;
+    }
+    return -1;
+}
+
+static int compare_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/** `file-owner <path>...`: prints "pkg[, pkg...]: path" per owned path, like `dpkg -S`. */
+int handle_file_owner(int argc, char *argv[]) {
+    if (argc < 3) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s file-owner <path>...\n", argv[0]);
+        return 1;
+    }
+
+    struct file_index idx;
+    if (file_index_open(&idx) != 0) return 1;
+    int rc = 0;
+    for (int i = 2; i < argc; i++) {
+        size_t count = file_index_owners(&idx, argv[i], NULL, 0);
+        if (count == 0) {
+            fprintf(stderr, ERROR_PREFIX "No package owns %s\n", argv[i]);
+            rc = 1;
+            continue;
+        }
+        uint32_t *owners = malloc(count * sizeof(*owners));
+        if (owners == NULL) {
+            rc = 1;
+            break;
+        }
+        file_index_owners(&idx, argv[i], owners, count);
+        qsort(owners, count, sizeof(*owners), compare_u32); // Package indices are in name order
+        for (size_t j = 0; j < count; j++) {
+            printf("%s%s", j ? ", " : "", file_index_string(&idx, idx.packages[owners[j]].name));
+        }
+        printf(": %s\n", argv[i]);
+        free(owners);
+    }
+    file_index_close(&idx);
+    return rc;
+}
+
+/** `package-files <package> [<glob>]`: lists the package's files, optionally filtered with fnmatch(3). */
+int handle_package_files(int argc, char *argv[]) {
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s package-files <package> [<glob>]\n", argv[0]);
+        return 1;
+    }
+
+    struct file_index idx;
+    if (file_index_open(&idx) != 0) return 1;
+    const char *pattern = argc == 4 ? argv[3] : NULL;
+    long pkg = file_index_find_package(&idx, argv[2], -1);
+    if (pkg < 0) {
+        fprintf(stderr, ERROR_PREFIX "Package %s is not installed\n", argv[2]);
+        file_index_close(&idx);
+        return 1;
+    }
+    for (; pkg >= 0; pkg = file_index_find_package(&idx, argv[2], pkg)) {
+        const struct file_index_package *p = &idx.packages[pkg];
+        for (uint32_t i = p->first_path; i < p->first_path + p->path_count; i++) {
+            const char *path = file_index_string(&idx, idx.paths[i].path);
+            if (pattern == NULL || fnmatch(pattern, path, 0) == 0) puts(path);
+        }
+    }
+    file_index_close(&idx);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DPKG_INFO_DIR "/var/lib/dpkg/info"
+#define FILE_INDEX_CACHE_NAME "nano-installer/file-index.bin" // Under $XDG_CACHE_HOME or ~/.cache
+#define FILE_INDEX_MAGIC "NANOFIX1"
+
+/*
+ * The index is one flat image, identical in memory and in the cache file, so a
+ * cached index is used straight from mmap without any parsing:
+ *
+ *   header | packages[] (sorted by name) | paths[] (grouped by package) | slots[] | strings
+ *
+ * slots[] is an open-addressing hash over path strings holding path index + 1
+ * (0 = empty); a path owned by several packages (e.g. a shared directory) has
+ * one slot per owner.
+ */
+struct file_index_header {
+    char magic[8];
+    uint32_t header_size;
+    uint32_t package_count;
+    uint32_t path_count;
+    uint32_t slot_count; // Power of two
+    int64_t info_mtime_sec, info_mtime_nsec;     // Cache key: DPKG_INFO_DIR's mtime...
+    int64_t status_mtime_sec, status_mtime_nsec; // ...and the status file's
+    uint64_t packages_offset, paths_offset, slots_offset, strings_offset;
+    uint64_t total_size;
+};
+
+struct file_index_package {
+    uint32_t name;       // String offset, e.g. "libc6:amd64" for Multi-Arch: same packages
+    uint32_t first_path;
+    uint32_t path_count;
+};
+
+struct file_index_path {
+    uint32_t path;    // String offset
+    uint32_t package; // Index into packages[]
+};
+
+struct file_index {
+    const unsigned char *image;
+    size_t size;
+    int mapped; // 1 if image is an mmap of the cache file, 0 if heap-allocated
+    const struct file_index_header *header;
+    const struct file_index_package *packages;
+    const struct file_index_path *paths;
+    const uint32_t *slots;
+    const char *strings;
+};
+
+/**
+ * Opens the index: the cached image if it is still current, otherwise a fresh
+ * parallel scan of DPKG_INFO_DIR, which is then written back to the cache.
+ * Prints an ERROR_PREFIX message and returns -1 on failure.
+ */
+int file_index_open(struct file_index *idx);
+void file_index_close(struct file_index *idx);
+
+/** Stores up to max owner package indices of path in owners; returns the total number of owners. */
+size_t file_index_owners(const struct file_index *idx, const char *path, uint32_t *owners, size_t max);
+
+/** Finds the index of a package by name, with or without its ":arch" suffix, starting after `after` (-1 for the first). */
+long file_index_find_package(const struct file_index *idx, const char *name, long after);
+
+/** name under $XDG_CACHE_HOME or ~/.cache; -1 if neither is set. */
+int user_cache_path(const char *name, char *buf, size_t size);
+/** Atomically replaces path (creating its directories) with data; failures are silently ignored. */
+void write_cache_file(const char *path, const void *data, size_t size);
+
+static inline const char *file_index_string(const struct file_index *idx, uint32_t offset) {
+    return idx->strings + offset;
+}
+
+#endif // FILE_INDEX_H
@@ -0,0 +1,309 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "aho_corasick.h"
+
+/*
+ * Leftover-file scanner used after an uninstall: finds entries under the
+ * user's config/data/cache directories whose names contain any variation of
+ * the package name as a whole word: bounded by the ends of the name or by
+ * punctuation, so "foo" finds ".foo", "foo.conf" and "org.foo-2" but not
+ * "foobar" or "tofoo".
+ *
+ * All variations are compiled into one case-insensitive Aho-Corasick matcher,
+ * so every directory entry is tested in a single pass over its name. Directories
+ * are handed out to a small pool of threads through a shared queue, and each
+ * match is printed as soon as its size is known so the GUI can fill in its list
+ * while the scan is still running. A matched directory is reported as a whole
+ * (with its total size) and not descended into; symlinks are never followed.
+ */
+
+#define LEFTOVER_MAX_THREADS 8
+#define LEFTOVER_DEFAULT_THREADS 4
+#define LEFTOVER_DEFAULT_DEPTH 4
+#define LEFTOVER_MAX_NAMES 64
+#define LEFTOVER_MAX_ROOTS 16
+
+struct scan_dir {
+    char *path;
+    int depth;         // Levels below its root
+    int dotfiles_only; // Top of a --dotfiles root: only report dot entries, never descend
+    struct scan_dir *next;
+};
+
+struct leftover_scan {
+    struct ac_matcher matcher;
+    int max_depth;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    struct scan_dir *queue;
+    int busy; // Workers currently expanding a directory
+    int failed;
+};
+
+static void mark_failed(struct leftover_scan *scan) {
+    pthread_mutex_lock(&scan->lock);
+    scan->failed = 1;
+    pthread_mutex_unlock(&scan->lock);
+}
+
+static void queue_push(struct leftover_scan *scan, char *path, int depth, int dotfiles_only) {
+    struct scan_dir *dir = malloc(sizeof(*dir));
+    if (dir == NULL) {
+        free(path);
+        mark_failed(scan);
+        return;
+    }
+    dir->path = path;
+    dir->depth = depth;
+    dir->dotfiles_only = dotfiles_only;
+
+    pthread_mutex_lock(&scan->lock);
+    dir->next = scan->queue;
+    scan->queue = dir;
+    pthread_cond_signal(&scan->cond);
+    pthread_mutex_unlock(&scan->lock);
+}
+
+/** Total apparent size of a directory tree, opened relative to parent_fd. Unreadable parts count as 0. */
+static uint64_t tree_size(int parent_fd, const char *name) {
+    int fd = openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    if (fd < 0) return 0;
+    DIR *dir = fdopendir(fd);
+    if (dir == NULL) {
+        close(fd);
+        return 0;
+    }
+
+    uint64_t total = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        struct stat st;
+        if (fstatat(fd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        if (S_ISDIR(st.st_mode)) {
+            total += tree_size(fd, entry->d_name);
+        } else {
+            total += (uint64_t)st.st_size;
+        }
+    }
+    closedir(dir);
+    return total;
+}
+
+struct word_match {
+    const struct ac_matcher *matcher;
+    const char *name;
+    size_t len;
+};
+
+/** Letters, digits and any byte of a non-ASCII character continue a word; everything else separates. */
+static int is_word_byte(unsigned char c) {
+    return c >= 0x80 || isalnum(c);
+}
+
+static int on_word_match(size_t pattern, uint64_t end, void *ctx) {
+    const struct word_match *m = ctx;
+    size_t start = (size_t)end - m->matcher->pattern_len[pattern];
+    return (start == 0 || !is_word_byte((unsigned char)m->name[start - 1]))
+        && (end == m->len || !is_word_byte((unsigned char)m->name[end]));
+}
+
+/** Whether one of the names occurs in the entry name as a whole word. */
+static int name_matches(const struct ac_matcher *matcher, const char *name) {
+    struct word_match m = { matcher, name, strlen(name) };
+    uint32_t state = 0;
+    return ac_scan(matcher, &state, name, m.len, 0, on_word_match, &m);
+}
+
+static void report_match(const char *path, char kind, uint64_t size) {
+    flockfile(stdout);
+    printf("%llu\t%c\t%s\n", (unsigned long long)size, kind, path);
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void scan_directory(struct leftover_scan *scan, const struct scan_dir *job) {
+    DIR *dir = opendir(job->path);
+    if (dir == NULL) {
+        if (job->depth == 0 && errno != ENOENT) {
+            fprintf(stderr, ERROR_PREFIX "Cannot scan %s: %s\n", job->path, strerror(errno));
+        }
+        return;
+    }
+    int fd = dirfd(dir);
+    size_t path_len = strlen(job->path);
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        const char *name = entry->d_name;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) continue;
+        if (job->dotfiles_only && name[0] != '.') continue;
+
+        int matched = name_matches(&scan->matcher, name);
+        int descend = !matched && !job->dotfiles_only && job->depth < scan->max_depth;
+        unsigned char type = entry->d_type;
+        if (!matched && !descend) continue;
+
+        struct stat st;
+        if (matched || type == DT_UNKNOWN) {
+            if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISLNK(st.st_mode) ? DT_LNK : DT_REG;
+        }
+        if (!matched && type != DT_DIR) continue;
+
+        size_t name_len = strlen(name);
+        int slash = path_len > 0 && job->path[path_len - 1] != '/';
+        char *child = malloc(path_len + slash + name_len + 1);
+        if (child == NULL) {
+            mark_failed(scan);
+            break;
+        }
+        memcpy(child, job->path, path_len);
+        if (slash) child[path_len] = '/';
+        memcpy(child + path_len + slash, name, name_len + 1);
+
+        if (matched) {
+            char kind = type == DT_DIR ? 'd' : type == DT_LNK ? 'l' : 'f';
+            uint64_t size = type == DT_DIR ? tree_size(fd, name) : (uint64_t)st.st_size;
+            report_match(child, kind, size);
+            free(child);
+        } else {
+            queue_push(scan, child, job->depth + 1, 0);
+        }
+    }
+    closedir(dir);
+}
+
+static void *leftover_worker(void *arg) {
+    struct leftover_scan *scan = arg;
+    pthread_mutex_lock(&scan->lock);
+    for (;;) {
+        while (scan->queue == NULL && scan->busy > 0) pthread_cond_wait(&scan->cond, &scan->lock);
+        if (scan->queue == NULL) break; // Nothing queued and nobody left to queue more
+        struct scan_dir *job = scan->queue;
+        scan->queue = job->next;
+        scan->busy++;
+        pthread_mutex_unlock(&scan->lock);
+
+        scan_directory(scan, job);
+        free(job->path);
+        free(job);
+
+        pthread_mutex_lock(&scan->lock);
+        scan->busy--;
+        if (scan->busy == 0 && scan->queue == NULL) pthread_cond_broadcast(&scan->cond);
+    }
+    pthread_mutex_unlock(&scan->lock);
+    return NULL;
+}
+
+static int parse_count(const char *text, int min, int max, int *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < min || value > max) return -1;
+    *out = (int)value;
+    return 0;
+}
+
+/**
+ * `leftover-scan [--max-depth N] [--threads N] --name <s>... [--root <dir>...] [--dotfiles <dir>...]`:
+ * prints "<bytes>\t<d|f|l>\t<path>" for every entry whose name contains one of
+ * the names as a whole word (case-insensitively), as it is found. --root directories are walked
+ * up to --max-depth levels deep; --dotfiles directories only have their own
+ * dot entries checked (for ~ itself).
+ */
+int handle_leftover_scan(int argc, char *argv[]) {
+    const char *names[LEFTOVER_MAX_NAMES];
+    size_t name_lengths[LEFTOVER_MAX_NAMES];
+    const char *roots[LEFTOVER_MAX_ROOTS];
+    int root_dotfiles[LEFTOVER_MAX_ROOTS];
+    size_t name_count = 0, root_count = 0;
+    int max_depth = LEFTOVER_DEFAULT_DEPTH, thread_count = LEFTOVER_DEFAULT_THREADS;
+
+    enum { LIST_NONE, LIST_NAMES, LIST_ROOTS, LIST_DOTFILES } list = LIST_NONE;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--max-depth") == 0 || strcmp(argv[i], "--threads") == 0) {
+            int is_depth = argv[i][2] == 'm';
+            if (i + 1 >= argc ||
+                parse_count(argv[i + 1], is_depth ? 0 : 1, is_depth ? 64 : LEFTOVER_MAX_THREADS,
+                            is_depth ? &max_depth : &thread_count) != 0) {
+                fprintf(stderr, ERROR_PREFIX "Invalid value for %s\n", argv[i]);
+                return 1;
+            }
+            i++;
+        } else if (strcmp(argv[i], "--name") == 0) {
+            list = LIST_NAMES;
+        } else if (strcmp(argv[i], "--root") == 0) {
+            list = LIST_ROOTS;
+        } else if (strcmp(argv[i], "--dotfiles") == 0) {
+            list = LIST_DOTFILES;
+        } else if (list == LIST_NAMES) {
+            if (name_count == LEFTOVER_MAX_NAMES || argv[i][0] == '\0') {
+                fprintf(stderr, ERROR_PREFIX "Too many or empty names\n");
+                return 1;
+            }
+            names[name_count] = argv[i];
+            name_lengths[name_count++] = strlen(argv[i]);
+        } else if (list == LIST_ROOTS || list == LIST_DOTFILES) {
+            if (root_count == LEFTOVER_MAX_ROOTS || argv[i][0] != '/') {
+                fprintf(stderr, ERROR_PREFIX "Too many roots, or not an absolute path: %s\n", argv[i]);
+                return 1;
+            }
+            roots[root_count] = argv[i];
+            root_dotfiles[root_count++] = list == LIST_DOTFILES;
+        } else {
+            list = LIST_NONE;
+            break;
+        }
+    }
+    if (name_count == 0 || root_count == 0 || list == LIST_NONE) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s leftover-scan [--max-depth N] [--threads N] --name <name>... "
+                "[--root <dir>...] [--dotfiles <dir>...]\n", argv[0]);
+        return 1;
+    }
+
+    struct leftover_scan scan = { .max_depth = max_depth };
+    if (ac_build(&scan.matcher, names, name_lengths, name_count, 1) != 0) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        return 1;
+    }
+    pthread_mutex_init(&scan.lock, NULL);
+    pthread_cond_init(&scan.cond, NULL);
+
+    for (size_t i = root_count; i-- > 0;) { // The queue is LIFO: push in reverse to start with the first root
+        char *path = strdup(roots[i]);
+        if (path == NULL) {
+            mark_failed(&scan);
+            continue;
+        }
+        queue_push(&scan, path, 0, root_dotfiles[i]);
+    }
+
+    pthread_t threads[LEFTOVER_MAX_THREADS];
+    int started = 0;
+    for (; started < thread_count; started++) {
+        if (pthread_create(&threads[started], NULL, leftover_worker, &scan) != 0) break;
+    }
+    if (started == 0) leftover_worker(&scan); // Still scan, just on this thread
+    for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+
+    pthread_cond_destroy(&scan.cond);
+    pthread_mutex_destroy(&scan.lock);
+    ac_free(&scan.matcher);
+    if (scan.failed) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory while scanning\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <string.h>
+
+#include "md5.h"
+
+/*
+ * MD5 (RFC 1321), only because dpkg's per-package .md5sums lists are what an
+ * installed file can be checked against. Portable C: MD5's rounds are one
+ * serial dependency chain, so it runs at roughly disk speed per core anyway.
+ */
+
+static const uint32_t K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+#define ROTL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+#define STEP(f, a, b, c, d, i, g, s) ((a) = (b) + ROTL((a) + f((b), (c), (d)) + K[i] + m[g], s))
+
+static void md5_blocks(uint32_t state[4], const unsigned char *data, size_t blocks) {
+    while (blocks--) {
+        uint32_t m[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = (uint32_t)data[4 * i] | (uint32_t)data[4 * i + 1] << 8 |
+                   (uint32_t)data[4 * i + 2] << 16 | (uint32_t)data[4 * i + 3] << 24;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        // Fully unrolled: with the message index and shift constant, each step is a handful of instructions.
+        for (int i = 0; i < 16; i += 4) {
+            STEP(F, a, b, c, d, i, i, 7);
+            STEP(F, d, a, b, c, i + 1, i + 1, 12);
+            STEP(F, c, d, a, b, i + 2, i + 2, 17);
+            STEP(F, b, c, d, a, i + 3, i + 3, 22);
+        }
+        for (int i = 16; i < 32; i += 4) {
+            STEP(G, a, b, c, d, i, (5 * i + 1) & 15, 5);
+            STEP(G, d, a, b, c, i + 1, (5 * i + 6) & 15, 9);
+            STEP(G, c, d, a, b, i + 2, (5 * i + 11) & 15, 14);
+            STEP(G, b, c, d, a, i + 3, (5 * i + 16) & 15, 20);
+        }
+        for (int i = 32; i < 48; i += 4) {
+            STEP(H, a, b, c, d, i, (3 * i + 5) & 15, 4);
+            STEP(H, d, a, b, c, i + 1, (3 * i + 8) & 15, 11);
+            STEP(H, c, d, a, b, i + 2, (3 * i + 11) & 15, 16);
+            STEP(H, b, c, d, a, i + 3, (3 * i + 14) & 15, 23);
+        }
+        for (int i = 48; i < 64; i += 4) {
+            STEP(I, a, b, c, d, i, (7 * i) & 15, 6);
+            STEP(I, d, a, b, c, i + 1, (7 * i + 7) & 15, 10);
+            STEP(I, c, d, a, b, i + 2, (7 * i + 14) & 15, 15);
+            STEP(I, b, c, d, a, i + 3, (7 * i + 21) & 15, 21);
+        }
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        data += MD5_BLOCK_SIZE;
+    }
+}
+
+void md5_init(struct md5_ctx *ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xefcdab89;
+    ctx->state[2] = 0x98badcfe;
+    ctx->state[3] = 0x10325476;
+    ctx->length = 0;
+    ctx->block_len = 0;
+}
+
+void md5_update(struct md5_ctx *ctx, const void *data, size_t len) {
+    const unsigned char *p = data;
+    ctx->length += len;
+    if (ctx->block_len > 0) {
+        size_t take = MD5_BLOCK_SIZE - ctx->block_len;
+        if (take > len) take = len;
+        memcpy(ctx->block + ctx->block_len, p, take);
+        ctx->block_len += take;
+        p += take;
+        len -= take;
+        if (ctx->block_len < MD5_BLOCK_SIZE) return;
+        md5_blocks(ctx->state, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+    size_t blocks = len / MD5_BLOCK_SIZE;
+    if (blocks > 0) {
+        md5_blocks(ctx->state, p, blocks);
+        p += blocks * MD5_BLOCK_SIZE;
+        len -= blocks * MD5_BLOCK_SIZE;
+    }
+    memcpy(ctx->block, p, len);
+    ctx->block_len = len;
+}
+
+void md5_final(struct md5_ctx *ctx, unsigned char digest[MD5_DIGEST_SIZE]) {
+    uint64_t bit_length = ctx->length * 8;
+    ctx->block[ctx->block_len++] = 0x80;
+    if (ctx->block_len > MD5_BLOCK_SIZE - 8) {
+        memset(ctx->block + ctx->block_len, 0, MD5_BLOCK_SIZE - ctx->block_len);
+        md5_blocks(ctx->state, ctx->block, 1);
+        ctx->block_len = 0;
+    }
+    memset(ctx->block + ctx->block_len, 0, MD5_BLOCK_SIZE - 8 - ctx->block_len);
+    for (int i = 0; i < 8; i++) ctx->block[MD5_BLOCK_SIZE - 8 + i] = (unsigned char)(bit_length >> (8 * i));
+    md5_blocks(ctx->state, ctx->block, 1);
+
+    for (int i = 0; i < 4; i++) {
+        digest[4 * i] = (unsigned char)ctx->state[i];
+        digest[4 * i + 1] = (unsigned char)(ctx->state[i] >> 8);
+        digest[4 * i + 2] = (unsigned char)(ctx->state[i] >> 16);
+        digest[4 * i + 3] = (unsigned char)(ctx->state[i] >> 24);
+    }
+}
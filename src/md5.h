@@ -0,0 +1,22 @@
+#ifndef MD5_H
+#define MD5_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MD5_DIGEST_SIZE 16
+#define MD5_BLOCK_SIZE 64
+
+/** Incremental MD5, only for checking files against dpkg's .md5sums lists. */
+struct md5_ctx {
+    uint32_t state[4];
+    uint64_t length; // Bytes hashed so far
+    unsigned char block[MD5_BLOCK_SIZE];
+    size_t block_len;
+};
+
+void md5_init(struct md5_ctx *ctx);
+void md5_update(struct md5_ctx *ctx, const void *data, size_t len);
+void md5_final(struct md5_ctx *ctx, unsigned char digest[MD5_DIGEST_SIZE]);
+
+#endif // MD5_H
@@ -2,57 +2,92 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/types.h>
-#include <sys/wait.h>
 #include <ctype.h>
 #include <limits.h> // For PATH_MAX
 
-#define MAX_ARGS 32
-#define ERROR_PREFIX "[NANO_BACKEND_ERROR] "
+#include "nano_backend.h"
 
-int handle_apt_operation(int argc, char *argv[]);
-int is_valid_package_name(const char *name);
-int is_valid_deb_path(const char *path);
+/**
+ * Read-only queries that any user may run. They never touch the system, so they
+ * are dispatched before the root check and the GUI can call them without sudo.
+ * They are only run as the user who asked: several write where they are told
+ * (deb-extract) or into the user's cache, which root must not do on a user's
+ * behalf, so sudo and the daemon refuse them.
+ */
+static const struct {
+    const char *name;
+    int (*handler)(int argc, char *argv[]);
+} query_commands[] = {
+    { "deb-info", handle_deb_info },
+    { "deb-icon", handle_deb_icon },
+    { "deb-ingest", handle_deb_ingest },
+    { "deb-extract", handle_deb_extract },
+    { "deb-contents", handle_deb_contents },
+    { "deps-check", handle_deps_check },
+    { "apt-show", handle_apt_show },
+    { "upgrade-plan", handle_upgrade_plan },
+    { "version-compare", handle_version_compare },
+    { "file-owner", handle_file_owner },
+    { "package-files", handle_package_files },
+    { "leftover-scan", handle_leftover_scan },
+    { "sha256", handle_sha256 },
+    { "deb-scan", handle_deb_scan },
+    { "package-verify", handle_package_verify },
+};
 
-int execute_command(char *command, char *args[]) {
-    pid_t pid = fork();
-    if (pid == -1) {
-        perror("fork failed");
-        return 1;
-    } else if (pid == 0) {
-        // Set DEBIAN_FRONTEND to noninteractive to prevent apt/dpkg from prompting
-        setenv("DEBIAN_FRONTEND", "noninteractive", 1);
-        execvp(command, args);
-        perror("execvp failed");
-        _exit(1);
-    } else {
-        int status;
-        if (waitpid(pid, &status, 0) == -1) {
-            perror("waitpid failed");
-            return 1;
-        }
-        if (WIFEXITED(status)) {
-            return WEXITSTATUS(status);
-        } else {
-            return 1;
-        }
+static int (*find_query_command(const char *name))(int, char **) {
+    for (size_t i = 0; i < sizeof(query_commands) / sizeof(query_commands[0]); i++) {
+        if (strcmp(query_commands[i].name, name) == 0) return query_commands[i].handler;
     }
+    return NULL;
+}
+
+static int refuse_privileged_query(const char *name) {
+    fprintf(stderr, ERROR_PREFIX "%s is a query; run it as your own user, not through sudo or the daemon.\n", name);
+    return 1;
 }
 
 int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s <command> [args...]\n", argv[0]);
+        return 1;
+    }
+
+    int (*query)(int, char **) = find_query_command(argv[1]);
+    if (query != NULL) {
+        // Root for someone else: sudo, pkexec or a setuid bit. A root login runs queries as itself.
+        int elevated = geteuid() == 0 && (getuid() != 0 || getenv("SUDO_UID") != NULL || getenv("PKEXEC_UID") != NULL);
+        return elevated ? refuse_privileged_query(argv[1]) : query(argc, argv);
+    }
+
+    // A simulation changes nothing, and apt-get runs it for any user.
+    if (argc > 2 && strcmp(argv[1], "apt-op") == 0 && strcmp(argv[2], "simulate") == 0) {
+        return handle_apt_operation(argc, argv);
+    }
+
     if (geteuid() != 0) {
         fprintf(stderr, ERROR_PREFIX "This helper must be run with root privileges.\n");
         return 1;
     }
 
-    if (argc < 2) {
-        fprintf(stderr, ERROR_PREFIX "Usage: %s <command> [args...]\n", argv[0]);
-        return 1;
+    // The daemon is only reachable from the command line, never from inside a daemon job.
+    if (strcmp(argv[1], "daemon") == 0) {
+        return handle_daemon(argc, argv);
     }
 
+    return dispatch_command(argc, argv);
+}
+
+/**
+ * Routes a single privileged command to its handler.
+ * Shared by the one-shot command line and by jobs submitted to the daemon.
+ */
+int dispatch_command(int argc, char *argv[]) {
     char *command_name = argv[1];
 
-    if (strcmp(command_name, "apt-op") == 0) {
+    if (find_query_command(command_name) != NULL) {
+        return refuse_privileged_query(command_name);
+    } else if (strcmp(command_name, "apt-op") == 0) {
         return handle_apt_operation(argc, argv);
     } else if (strcmp(command_name, "apt-autoremove") == 0) {
         return handle_apt_operation(argc, argv);
@@ -70,6 +105,13 @@ int main(int argc, char *argv[]) {
     return 1;
 }
 
+/** Marks the log of a run without dpkg's fsync calls, whose files may be lost or truncated by a crash. */
+static void print_unsafe_io_notice(void) {
+    printf("[UNSAFE-IO] dpkg runs with " DPKG_UNSAFE_IO_OPTION ": installed files are not synced to disk "
+           "and may be lost on a crash or power failure.\n");
+    fflush(stdout);
+}
+
 int handle_apt_operation(int argc, char *argv[]) {
     // This function now handles multiple command types passed from main().
     // argv[1] is the command that got us here.
@@ -78,9 +120,11 @@ int handle_apt_operation(int argc, char *argv[]) {
     // Validate argument count based on command type
     if (strcmp(command_type, "apt-op") == 0) {
         if (argc < 4) {
-            fprintf(stderr, ERROR_PREFIX "Usage: %s <install|purge> <target> [--reinstall]\n", command_type);
+            fprintf(stderr, ERROR_PREFIX "Usage: %s <install <deb>...|simulate <deb>...|purge <package>> [--reinstall] [--unsafe-io]\n", command_type);
             return 1;
         }
+    } else if (strcmp(command_type, "apt-upgrade") == 0 && argc == 3 && strcmp(argv[2], UNSAFE_IO_FLAG) == 0) {
+        // The one option apt-upgrade takes, --unsafe-io.
     } else if (argc != 2) {
         // All other commands (apt-autoremove, apt-update, etc.) should only have 2 arguments:
         // argv[0] = path/to/nano_backend, argv[1] = command_type
@@ -89,33 +133,76 @@ int handle_apt_operation(int argc, char *argv[]) {
     }
 
     char *operation = NULL;
-    char *target = NULL;
+    char *targets[MAX_BATCH_DEBS];
+    int target_count = 0;
+    int reinstall = 0;
+    int unsafe_io = strcmp(command_type, "apt-upgrade") == 0 && argc == 3;
 
     if (strcmp(command_type, "apt-op") == 0) {
         operation = argv[2]; // install or purge
-        target = argv[3];    // package name or .deb path
+        // Everything after the operation is either a flag or a target (package name or .deb path).
+        for (int i = 3; i < argc; i++) {
+            if (strncmp(argv[i], "--", 2) == 0) {
+                if (strcmp(argv[i], "--reinstall") == 0) {
+                    reinstall = 1;
+                } else if (strcmp(argv[i], UNSAFE_IO_FLAG) == 0) {
+                    unsafe_io = 1;
+                } else {
+                    fprintf(stderr, ERROR_PREFIX "Unknown option for apt-op: %s\n", argv[i]);
+                    return 1;
+                }
+            } else if (target_count < MAX_BATCH_DEBS) {
+                targets[target_count++] = argv[i];
+            } else {
+                fprintf(stderr, ERROR_PREFIX "Too many packages in one batch (maximum is %d).\n", MAX_BATCH_DEBS);
+                return 1;
+            }
+        }
+        if (target_count == 0) {
+            fprintf(stderr, ERROR_PREFIX "No target given for apt-op %s\n", operation);
+            return 1;
+        }
     }
 
     // Build the apt command arguments
-    char *apt_args[MAX_ARGS];
+    char *apt_args[MAX_ARGS + MAX_BATCH_DEBS];
     int arg_idx = 0;
 
-    // 1. apt command
+    // 1. apt command, reporting machine-readable progress on the status channel
     apt_args[arg_idx++] = "/usr/bin/apt";
+    apt_args[arg_idx++] = "-o";
+    apt_args[arg_idx++] = APT_STATUS_FD_OPTION;
+    if (unsafe_io) {
+        apt_args[arg_idx++] = "-o";
+        apt_args[arg_idx++] = "Dpkg::Options::=" DPKG_UNSAFE_IO_OPTION;
+    }
 
     if (strcmp(command_type, "apt-op") == 0) {
-        // 2. operation (install or purge)
-        if (strcmp(operation, "install") == 0) {
-            // For install, the target must be a valid and safe .deb file path.
-            if (!is_valid_deb_path(target)) {
-                fprintf(stderr, ERROR_PREFIX "Invalid or unsafe .deb file path provided for install: %s\n", target);
-                return 1;
+        // 2. operation (install, simulate or purge)
+        if (strcmp(operation, "install") == 0 || strcmp(operation, "simulate") == 0) {
+            // For install, every target must be a valid and safe .deb file path.
+            // A whole batch goes into one apt transaction, so triggers run once per batch.
+            for (int i = 0; i < target_count; i++) {
+                if (!is_valid_deb_path(targets[i])) {
+                    fprintf(stderr, ERROR_PREFIX "Invalid or unsafe .deb file path provided for %s: %s\n", operation, targets[i]);
+                    return 1;
+                }
             }
+            // A simulation of the same transaction is parsed into a plan instead (see apt_simulate.c).
+            if (strcmp(operation, "simulate") == 0) return apt_simulate_install(targets, target_count, reinstall);
+            if (unsafe_io) print_unsafe_io_notice();
+            // Nothing to solve when everything needed is installed: dpkg then does the job without apt (see dpkg_direct.c).
+            int direct = dpkg_direct_install(targets, target_count, reinstall, unsafe_io);
+            if (direct >= 0) return direct;
             apt_args[arg_idx++] = "install";
         } else if (strcmp(operation, "purge") == 0) {
-            // For purge, the target must be a valid package name.
-            if (!is_valid_package_name(target)) {
-                fprintf(stderr, ERROR_PREFIX "Invalid package name provided for purge: %s\n", target);
+            // For purge, the target must be a single valid package name.
+            if (target_count != 1) {
+                fprintf(stderr, ERROR_PREFIX "purge takes exactly one package name.\n");
+                return 1;
+            }
+            if (!is_valid_package_name(targets[0])) {
+                fprintf(stderr, ERROR_PREFIX "Invalid package name provided for purge: %s\n", targets[0]);
                 return 1;
             }
             apt_args[arg_idx++] = "purge";
@@ -128,6 +215,7 @@ int handle_apt_operation(int argc, char *argv[]) {
     } else if (strcmp(command_type, "apt-update") == 0) {
         apt_args[arg_idx++] = "update";
     } else if (strcmp(command_type, "apt-upgrade") == 0) {
+        if (unsafe_io) print_unsafe_io_notice();
         apt_args[arg_idx++] = "upgrade";
     } else if (strcmp(command_type, "apt-fix-broken") == 0) {
         // This handles 'apt --fix-broken install'
@@ -145,23 +233,23 @@ int handle_apt_operation(int argc, char *argv[]) {
         apt_args[arg_idx++] = "-y"; // Assume yes
     }
 
-    // 4. Check for optional flags like --reinstall
+    // 4. Optional flags like --reinstall
     if (strcmp(command_type, "apt-op") == 0) {
-        for (int i = 4; i < argc; i++) {
-            if (strcmp(argv[i], "--reinstall") == 0) {
-                apt_args[arg_idx++] = "--reinstall";
-            }
+        if (reinstall) {
+            apt_args[arg_idx++] = "--reinstall";
         }
 
-        // 5. Target package/path
-        apt_args[arg_idx++] = target;
+        // 5. Target packages/paths
+        for (int i = 0; i < target_count; i++) {
+            apt_args[arg_idx++] = targets[i];
+        }
     }
     
     // 6. Null terminator
     apt_args[arg_idx] = NULL;
 
     // Execute the command (e.g., apt install -y package)
-    return execute_command(apt_args[0], apt_args);
+    return execute_command_with_status(apt_args[0], apt_args);
 }
 
 /**
@@ -183,7 +271,9 @@ int is_valid_package_name(const char *name) {
 
 /**
  * Validates that a string is a safe, absolute path to a .deb file.
- * Prevents path traversal and ensures it ends with .deb.
+ * Prevents path traversal and ensures it ends with .deb. The path reaches apt
+ * and dpkg through argv, never a shell, so any character a file name may hold
+ * is accepted except control characters, which have no business in one.
  */
 int is_valid_deb_path(const char *path) {
     if (path == NULL || path[0] != '/') {
@@ -196,16 +286,12 @@ int is_valid_deb_path(const char *path) {
     }
 
     // Check for path traversal sequences like "/../" or "//"
-    if (strstr(path, "/../") != NULL || strstr(path, "//") != NULL) {
+    if (strstr(path, "/../") != NULL || strstr(path, "/./") != NULL || strstr(path, "//") != NULL) {
         return 0;
     }
 
-    // Check for invalid characters in the path
-    for (int i = 0; path[i] != '\0'; i++) {
-        // Allow alphanum, /, -, _, ., +, and space (unquoted from file:// URI)
-        if (!isalnum(path[i]) && path[i] != '/' && path[i] != '-' && path[i] != '_' && path[i] != '.' && path[i] != '+' && path[i] != ' ') {
-            return 0;
-        }
+    for (const unsigned char *p = (const unsigned char *)path; *p != '\0'; p++) {
+        if (*p < 0x20 || *p == 0x7f) return 0;
     }
 
     return 1;
@@ -0,0 +1,94 @@
+#ifndef NANO_BACKEND_H
+#define NANO_BACKEND_H
+
+#include <stddef.h>
+#include <time.h>
+
+#define MAX_ARGS 32
+#define MAX_BATCH_DEBS 256 // Upper bound on .deb files in one `apt-op install` transaction
+#define UNSAFE_IO_FLAG "--unsafe-io" // Opt-in for `apt-op install` and `apt-upgrade`, for throwaway systems
+#define DPKG_UNSAFE_IO_OPTION "--force-unsafe-io"
+#define ERROR_PREFIX "[NANO_BACKEND_ERROR] "
+
+// --- nano_backend.c ---
+int dispatch_command(int argc, char *argv[]);
+int handle_apt_operation(int argc, char *argv[]);
+int is_valid_package_name(const char *name);
+int is_valid_deb_path(const char *path);
+
+// --- progress.c ---
+#define STATUS_PREFIX "[NANO_STATUS] "
+#define STATUS_CHILD_FD 3 // Must match APT_STATUS_FD_OPTION and DPKG_STATUS_FD_OPTION
+#define APT_STATUS_FD_OPTION "APT::Status-Fd=3"
+#define DPKG_STATUS_FD_OPTION "--status-fd=3"
+
+extern int status_fd;
+
+double seconds_since(const struct timespec *since); // Against CLOCK_MONOTONIC
+void emit_status_record(const char *phase, const char *package, double percent, long eta, const char *message);
+int execute_command_with_status(char *command, char *args[]);
+int execute_dpkg_with_status(char *args[], int packages); // dpkg started with DPKG_STATUS_FD_OPTION
+
+// --- apt_simulate.c ---
+int apt_simulate_install(char *debs[], int count, int reinstall); // Prints the transaction plan of `apt-op install`
+
+// --- dpkg_direct.c ---
+int dpkg_direct_install(char *debs[], int count, int reinstall, int unsafe_io); // dpkg's exit status, or -1 if apt is needed
+
+// --- daemon.c ---
+#define DAEMON_SOCKET_DIR "/run/nano-installer"
+#define DAEMON_READY_PREFIX "[NANO_DAEMON_READY] "
+
+int handle_daemon(int argc, char *argv[]);
+
+// --- deb_archive.c (types and reader API in deb_archive.h) ---
+int handle_deb_info(int argc, char *argv[]);
+int handle_deb_icon(int argc, char *argv[]);
+
+// --- deb_ingest.c ---
+int handle_deb_ingest(int argc, char *argv[]);
+
+// --- deb_extract.c ---
+int handle_deb_extract(int argc, char *argv[]);
+
+// --- deb_contents.c (index API in deb_contents.h) ---
+int handle_deb_contents(int argc, char *argv[]);
+
+// --- dpkg_status.c (index API in dpkg_status.h) ---
+char *read_whole_file(const char *path, size_t *size_out); // NUL-terminated, or NULL with errno set
+int handle_deps_check(int argc, char *argv[]);
+
+// --- apt_lists.c (index API in apt_lists.h) ---
+int handle_apt_show(int argc, char *argv[]);
+
+// --- upgrade_plan.c ---
+int handle_upgrade_plan(int argc, char *argv[]);
+
+// --- debversion.c ---
+const char *deb_version_check(const char *version); // NULL if valid, otherwise what is wrong
+int deb_version_compare(const char *a, const char *b); // -1, 0 or 1
+int deb_version_satisfies(const char *a, const char *op, const char *b); // 1, 0, or -1 for an unknown op
+int handle_version_compare(int argc, char *argv[]);
+
+// --- file_index.c (index API in file_index.h) ---
+int handle_file_owner(int argc, char *argv[]);
+int handle_package_files(int argc, char *argv[]);
+
+// --- leftover_scan.c ---
+int handle_leftover_scan(int argc, char *argv[]);
+
+// --- sha256.c (hash API in sha256.h) ---
+int handle_sha256(int argc, char *argv[]);
+
+// --- content_scan.c ---
+int handle_deb_scan(int argc, char *argv[]);
+
+// --- package_verify.c (MD5 in md5.h) ---
+int handle_package_verify(int argc, char *argv[]);
+
+// --- script_risk.c ---
+struct deb_scripts;
+/** Findings for the maintainer scripts, one "<severity>\t<check>\t<script>\t<line>\t<source line>" per line (NULL if out of memory). */
+char *script_risk_report(const struct deb_scripts *scripts, size_t *len);
+
+#endif // NANO_BACKEND_H
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "nano_backend.h"
+#include "file_index.h"
+#include "md5.h"
+
+/*
+ * debsums-style integrity check of installed packages: every file listed in
+ * DPKG_INFO_DIR/<package>.md5sums is hashed and compared with its recorded
+ * MD5, so modified or deleted files can be spotted before a reinstall or an
+ * upgrade replaces them.
+ *
+ * All packages' files go into one list, in .md5sums order (which roughly
+ * follows the on-disk layout). Worker threads take batches from a shared
+ * cursor: batches start large, so that runs of small files cost one atomic
+ * operation each, and shrink as the list runs out, so that no thread is left
+ * with a long tail of work while the others idle. Each file is streamed
+ * through a per-thread buffer, whatever its size. Problems are printed as they
+ * are found; files dpkg-divert moved are checked at their new location.
+ */
+
+#define VERIFY_MAX_THREADS 16
+#define VERIFY_MAX_BATCH 256
+#define VERIFY_READ_SIZE (256 * 1024)
+#define VERIFY_PROGRESS_INTERVAL 0.25 // Seconds between progress records
+#define DPKG_DIVERSIONS_PATH "/var/lib/dpkg/diversions"
+
+struct verify_package {
+    char *name; // As in the .md5sums file name: "foo" or "foo:amd64"
+    char *sums;
+    size_t sums_len;
+};
+
+struct verify_item {
+    const char *path; // Without the leading '/', inside its package's sums
+    size_t package;
+    unsigned char expected[MD5_DIGEST_SIZE];
+};
+
+struct diversion {
+    const char *from, *to, *by; // by is the diverting package, ":" for a local diversion
+};
+
+struct verify_job {
+    struct verify_package *packages;
+    struct verify_item *items;
+    size_t count;
+    struct diversion *diversions;
+    size_t diversion_count;
+    size_t thread_count;
+    atomic_size_t next;
+    atomic_size_t done;
+    atomic_uint_least64_t bytes;
+    atomic_size_t changed, missing, unreadable;
+    int progress;
+    pthread_mutex_t report_lock; // Held by whoever is emitting a progress record
+    struct timespec started;
+    double last_report;
+};
+
+static int compare_names(const void *a, const void *b) {
+    return strcmp(((const struct verify_package *)a)->name, ((const struct verify_package *)b)->name);
+}
+
+/** A package named on the command line matches "foo" and any "foo:<arch>". */
+static int name_selected(const char *stem, char **names, int name_count) {
+    if (name_count == 0) return 1;
+    for (int i = 0; i < name_count; i++) {
+        size_t len = strlen(names[i]);
+        if (strncmp(stem, names[i], len) == 0 && (stem[len] == '\0' || (stem[len] == ':' && !strchr(names[i], ':')))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Reads the .md5sums files of the selected packages (all if name_count is 0),
+ * sorted by name; sums is NULL where a list could not be read. Prints an
+ * ERROR_PREFIX message and returns -1 if DPKG_INFO_DIR cannot be listed.
+ */
+static int collect_packages(char **names, int name_count, struct verify_package **packages_out, size_t *count_out) {
+    DIR *dir = opendir(DPKG_INFO_DIR);
+    if (dir == NULL) {
+        fprintf(stderr, ERROR_PREFIX "Cannot open " DPKG_INFO_DIR ": %s\n", strerror(errno));
+        return -1;
+    }
+    struct verify_package *packages = NULL;
+    size_t count = 0, capacity = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t len = strlen(entry->d_name);
+        if (len <= 8 || strcmp(entry->d_name + len - 8, ".md5sums") != 0) continue;
+        char *stem = strndup(entry->d_name, len - 8);
+        if (stem == NULL || !name_selected(stem, names, name_count)) {
+            free(stem);
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            struct verify_package *bigger = realloc(packages, capacity * sizeof(*bigger));
+            if (bigger == NULL) {
+                free(stem);
+                fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+                break;
+            }
+            packages = bigger;
+        }
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), DPKG_INFO_DIR "/%s", entry->d_name);
+        packages[count] = (struct verify_package){ .name = stem };
+        packages[count].sums = read_whole_file(path, &packages[count].sums_len);
+        count++;
+    }
+    closedir(dir);
+    if (count > 0) qsort(packages, count, sizeof(*packages), compare_names);
+    *packages_out = packages;
+    *count_out = count;
+    return 0;
+}
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * Appends the "<32 hex digits>  <path>" lines of one package's sums to items,
+ * NUL-terminating each path in place. Malformed lines are skipped.
+ */
+static int parse_sums(struct verify_package *package, size_t index, struct verify_item **items, size_t *count,
+                      size_t *capacity) {
+    char *line = package->sums, *end = package->sums + package->sums_len;
+    while (line != NULL && line < end) {
+        char *newline = memchr(line, '\n', (size_t)(end - line));
+        if (newline != NULL) *newline = '\0';
+        char *next = newline ? newline + 1 : NULL;
+
+        struct verify_item item = { .package = index };
+        int ok = strlen(line) > 2 * MD5_DIGEST_SIZE + 2 && line[2 * MD5_DIGEST_SIZE] == ' ';
+        for (int i = 0; ok && i < MD5_DIGEST_SIZE; i++) {
+            int hi = hex_value(line[2 * i]), lo = hex_value(line[2 * i + 1]);
+            ok = hi >= 0 && lo >= 0;
+            item.expected[i] = (unsigned char)(hi << 4 | lo);
+        }
+        if (ok) {
+            item.path = line + 2 * MD5_DIGEST_SIZE + 1;
+            while (*item.path == ' ' || *item.path == '*') item.path++; // "  path" or " *path"
+            while (*item.path == '/') item.path++;
+            if (*count == *capacity) {
+                *capacity = *capacity ? *capacity * 2 : 16384;
+                struct verify_item *bigger = realloc(*items, *capacity * sizeof(*bigger));
+                if (bigger == NULL) return -1;
+                *items = bigger;
+            }
+            (*items)[(*count)++] = item;
+        }
+        line = next;
+    }
+    return 0;
+}
+
+static int compare_diversions(const void *a, const void *b) {
+    return strcmp(((const struct diversion *)a)->from, ((const struct diversion *)b)->from);
+}
+
+/** Parses dpkg's diversions file (from/to/package line triples), sorted by diverted path. */
+static struct diversion *load_diversions(char *text, size_t len, size_t *count_out) {
+    size_t lines = 0;
+    for (size_t i = 0; i < len; i++) lines += text[i] == '\n';
+    struct diversion *diversions = malloc((lines / 3 + 1) * sizeof(*diversions));
+    size_t count = 0;
+    char *p = text, *end = text + len;
+    while (diversions != NULL && p < end) {
+        const char *fields[3];
+        int n = 0;
+        for (; n < 3 && p < end; n++) {
+            char *newline = memchr(p, '\n', (size_t)(end - p));
+            if (newline == NULL) newline = end;
+            *newline = '\0';
+            fields[n] = p;
+            p = newline + 1;
+        }
+        if (n == 3) diversions[count++] = (struct diversion){ fields[0], fields[1], fields[2] };
+    }
+    if (count > 0) qsort(diversions, count, sizeof(*diversions), compare_diversions);
+    *count_out = count;
+    return diversions;
+}
+
+/** Where the file package installed at "/<path>" really is: moved if another package diverted it. */
+static const char *diverted_path(const struct verify_job *job, const char *absolute, const char *package) {
+    struct diversion key = { .from = absolute };
+    const struct diversion *found = bsearch(&key, job->diversions, job->diversion_count, sizeof(key),
+                                            compare_diversions);
+    if (found == NULL) return absolute;
+    size_t len = strcspn(package, ":");
+    if (strncmp(found->by, package, len) == 0 && found->by[len] == '\0') return absolute; // The diverter's own copy
+    return found->to;
+}
+
+static void report(const char *status, const char *package, const char *path, const char *detail) {
+    flockfile(stdout);
+    printf("%s\t%s\t%s%s%s\n", status, package, path, detail ? "\t" : "", detail ? detail : "");
+    fflush(stdout);
+    funlockfile(stdout);
+}
+
+static void report_progress(struct verify_job *job, const char *package) {
+    if (pthread_mutex_trylock(&job->report_lock) != 0) return; // Someone else is on it
+    double elapsed = seconds_since(&job->started);
+    if (elapsed - job->last_report >= VERIFY_PROGRESS_INTERVAL) {
+        size_t done = atomic_load(&job->done);
+        double rate = elapsed > 0 ? (double)done / elapsed : 0;
+        char message[96];
+        snprintf(message, sizeof(message), "%zu of %zu files, %.0f MB/s", done, job->count,
+                 elapsed > 0 ? (double)atomic_load(&job->bytes) / elapsed / 1e6 : 0.0);
+        emit_status_record("verify", package, 100.0 * (double)done / (double)job->count,
+                           rate > 0 ? (long)((double)(job->count - done) / rate + 0.5) : -1, message);
+        job->last_report = elapsed;
+    }
+    pthread_mutex_unlock(&job->report_lock);
+}
+
+static void verify_item(struct verify_job *job, const struct verify_item *item, unsigned char *buffer) {
+    const char *package = job->packages[item->package].name;
+    char absolute[PATH_MAX];
+    if (snprintf(absolute, sizeof(absolute), "/%s", item->path) >= (int)sizeof(absolute)) {
+        atomic_fetch_add(&job->unreadable, 1);
+        report("unreadable", package, item->path, strerror(ENAMETOOLONG));
+        return;
+    }
+    const char *path = diverted_path(job, absolute, package);
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd < 0) {
+        int missing = errno == ENOENT || errno == ENOTDIR;
+        atomic_fetch_add(missing ? &job->missing : &job->unreadable, 1);
+        report(missing ? "missing" : "unreadable", package, path, missing ? NULL : strerror(errno));
+        return;
+    }
+    struct md5_ctx ctx;
+    md5_init(&ctx);
+    int error = 0;
+    for (;;) {
+        ssize_t n = read(fd, buffer, VERIFY_READ_SIZE);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) error = errno;
+        if (n <= 0) break;
+        md5_update(&ctx, buffer, (size_t)n);
+        atomic_fetch_add(&job->bytes, (uint_least64_t)n);
+        if (n == VERIFY_READ_SIZE && job->progress) report_progress(job, package);
+    }
+    close(fd);
+    if (error != 0) {
+        atomic_fetch_add(&job->unreadable, 1);
+        report("unreadable", package, path, strerror(error));
+        return;
+    }
+    unsigned char digest[MD5_DIGEST_SIZE];
+    md5_final(&ctx, digest);
+    if (memcmp(digest, item->expected, MD5_DIGEST_SIZE) != 0) {
+        atomic_fetch_add(&job->changed, 1);
+        report("changed", package, path, NULL);
+    }
+}
+
+/** Claims the next batch [start, *end): about an eighth of each thread's fair share of what is left. */
+static size_t claim_batch(struct verify_job *job, size_t *end) {
+    size_t start = atomic_load(&job->next);
+    for (;;) {
+        if (start >= job->count) return job->count;
+        size_t take = (job->count - start) / (job->thread_count * 8);
+        if (take < 1) take = 1;
+        if (take > VERIFY_MAX_BATCH) take = VERIFY_MAX_BATCH;
+        if (atomic_compare_exchange_weak(&job->next, &start, start + take)) {
+            *end = start + take;
+            return start;
+        }
+    }
+}
+
+static void *verify_worker(void *arg) {
+    struct verify_job *job = arg;
+    unsigned char *buffer = malloc(VERIFY_READ_SIZE);
+    if (buffer == NULL) return NULL; // Claims nothing, so the other workers take its share
+
+    size_t end = 0;
+    for (size_t i; (i = claim_batch(job, &end)) < job->count;) {
+        for (; i < end; i++) {
+            verify_item(job, &job->items[i], buffer);
+            atomic_fetch_add(&job->done, 1);
+        }
+        if (job->progress) report_progress(job, job->packages[job->items[end - 1].package].name);
+    }
+    free(buffer);
+    return NULL;
+}
+
+static int parse_thread_count(const char *text, size_t *out) {
+    char *end;
+    long value = strtol(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value < 1 || value > VERIFY_MAX_THREADS) return -1;
+    *out = (size_t)value;
+    return 0;
+}
+
+/**
+ * `package-verify [--progress] [--threads N] [<package>...]`: checks the
+ * installed files of the named packages (every package with an .md5sums list
+ * if none are named) against their recorded MD5 sums. Prints, as found,
+ * "changed\t<package>\t<path>", "missing\t<package>\t<path>" and
+ * "unreadable\t<package>\t<path>\t<error>", "nosums\t<name>" for a named
+ * package without a list, then "summary\t<packages>\t<files>\t<bytes>\t<changed>\t<missing>\t<unreadable>".
+ * With --progress, "verify" status records report the file count and throughput.
+ */
+int handle_package_verify(int argc, char *argv[]) {
+    int first = 2, progress = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t thread_count = cpus > 1 ? (size_t)cpus : 1;
+    if (thread_count > VERIFY_MAX_THREADS) thread_count = VERIFY_MAX_THREADS;
+    for (; first < argc && strncmp(argv[first], "--", 2) == 0; first++) {
+        if (strcmp(argv[first], "--progress") == 0) {
+            progress = 1;
+        } else if (strcmp(argv[first], "--threads") == 0 && first + 1 < argc &&
+                   parse_thread_count(argv[first + 1], &thread_count) == 0) {
+            first++;
+        } else {
+            fprintf(stderr, ERROR_PREFIX "Usage: %s package-verify [--progress] [--threads N] [<package>...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    char **names = argv + first;
+    int name_count = argc - first;
+
+    struct verify_package *packages = NULL;
+    size_t package_count = 0;
+    if (collect_packages(names, name_count, &packages, &package_count) != 0) return 1;
+    for (int i = 0; i < name_count; i++) {
+        int found = 0;
+        for (size_t p = 0; p < package_count && !found; p++) found = name_selected(packages[p].name, names + i, 1);
+        if (!found) printf("nosums\t%s\n", names[i]);
+    }
+
+    struct verify_job job = { .packages = packages, .thread_count = thread_count, .progress = progress };
+    int rc = 0;
+    size_t capacity = 0;
+    for (size_t p = 0; p < package_count && rc == 0; p++) {
+        if (packages[p].sums == NULL) {
+            char path[PATH_MAX];
+            snprintf(path, sizeof(path), DPKG_INFO_DIR "/%s.md5sums", packages[p].name);
+            report("unreadable", packages[p].name, path, "Cannot read the list");
+            continue;
+        }
+        rc = parse_sums(&packages[p], p, &job.items, &job.count, &capacity);
+    }
+    size_t diversions_len = 0;
+    char *diversions_text = read_whole_file(DPKG_DIVERSIONS_PATH, &diversions_len);
+    if (diversions_text != NULL) job.diversions = load_diversions(diversions_text, diversions_len, &job.diversion_count);
+
+    if (rc == 0 && job.count > 0) {
+        atomic_init(&job.next, 0);
+        pthread_mutex_init(&job.report_lock, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &job.started);
+        if (thread_count > job.count) job.thread_count = thread_count = job.count;
+
+        pthread_t threads[VERIFY_MAX_THREADS];
+        size_t started = 0;
+        for (; started < thread_count - 1; started++) {
+            if (pthread_create(&threads[started], NULL, verify_worker, &job) != 0) break;
+        }
+        verify_worker(&job); // The calling thread works too
+        for (size_t i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        pthread_mutex_destroy(&job.report_lock);
+        if (progress) {
+            double elapsed = seconds_since(&job.started);
+            char message[128];
+            snprintf(message, sizeof(message), "%zu files, %.1f MB in %.2f s", job.count,
+                     (double)job.bytes / 1e6, elapsed);
+            emit_status_record("verify", NULL, 100.0, 0, message);
+        }
+    }
+    if (rc != 0) {
+        fprintf(stderr, ERROR_PREFIX "Out of memory\n");
+        rc = 1;
+    } else {
+        // Only if no worker could get a read buffer are files left over; what was checked still counts.
+        size_t checked = atomic_load(&job.done);
+        if (checked < job.count) {
+            fprintf(stderr, ERROR_PREFIX "Out of memory: %zu of %zu files were not checked\n", job.count - checked, job.count);
+            rc = 1;
+        }
+        printf("summary\t%zu\t%zu\t%llu\t%zu\t%zu\t%zu\n", package_count, checked,
+               (unsigned long long)job.bytes, (size_t)job.changed, (size_t)job.missing, (size_t)job.unreadable);
+    }
+
+    free(job.items);
+    free(job.diversions);
+    free(diversions_text);
+    for (size_t p = 0; p < package_count; p++) {
+        free(packages[p].name);
+        free(packages[p].sums);
+    }
+    free(packages);
+    return rc;
+}
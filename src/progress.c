@@ -0,0 +1,287 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "nano_backend.h"
+
+/*
+ * Structured progress channel.
+ *
+ * apt is started with APT::Status-Fd pointing at a pipe (fd STATUS_CHILD_FD in the
+ * child). Its machine-readable "pmstatus:pkg:percent:message" lines are turned into
+ * compact tab-separated records:
+ *
+ *     <phase>\t<package>\t<percent>\t<eta-seconds>\t<message>
+ *
+ * phase is one of download, install, error, conffile, media; eta is -1 while unknown.
+ * dpkg run directly (see dpkg_direct.c) reports on the same descriptor in its
+ * own --status-fd format, "processing: <action>: <package>", which is mapped
+ * onto install records counting unpack and configure steps.
+ *
+ * Records go to status_fd when one is set (the daemon's dedicated status pipe) and
+ * otherwise to stdout behind STATUS_PREFIX. apt's human-readable output is relayed
+ * line by line so a record never lands in the middle of a log line.
+ */
+
+#define LINE_BUFFER_SIZE 4096
+
+int status_fd = -1;
+
+struct line_buffer {
+    char data[LINE_BUFFER_SIZE];
+    size_t len;
+};
+
+struct phase_clock {
+    char phase[16];
+    struct timespec started;
+    double start_percent;
+    int dpkg_packages; // Set when the channel carries dpkg's own status lines
+    int dpkg_steps;    // Unpack and configure steps seen so far
+};
+
+double seconds_since(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) + (double)(now.tv_nsec - since->tv_nsec) / 1e9;
+}
+
+void emit_status_record(const char *phase, const char *package, double percent, long eta, const char *message) {
+    char record[1024];
+    int len = snprintf(record, sizeof(record), "%s%s\t%s\t%.1f\t%ld\t%s\n",
+                       status_fd >= 0 ? "" : STATUS_PREFIX, phase, package ? package : "",
+                       percent, eta, message ? message : "");
+    if (len < 0) return;
+    if ((size_t)len >= sizeof(record)) {
+        len = sizeof(record) - 1;
+        record[len - 1] = '\n';
+    }
+
+    if (status_fd >= 0) {
+        // A single write below PIPE_BUF keeps each record atomic on the pipe.
+        ssize_t unused = write(status_fd, record, (size_t)len);
+        (void)unused;
+    } else {
+        fwrite(record, 1, (size_t)len, stdout);
+        fflush(stdout);
+    }
+}
+
+static const char *phase_for_apt_status(const char *type) {
+    if (strcmp(type, "dlstatus") == 0) return "download";
+    if (strcmp(type, "pmstatus") == 0) return "install";
+    if (strcmp(type, "pmerror") == 0) return "error";
+    if (strcmp(type, "pmconffile") == 0) return "conffile";
+    if (strcmp(type, "media-change") == 0) return "media";
+    return NULL;
+}
+
+/** Emits a record, extrapolating the ETA from the progress made since the current phase started. */
+static void emit_timed_record(struct phase_clock *clock, const char *phase, const char *package, double percent,
+                              const char *message) {
+    if (strcmp(clock->phase, phase) != 0) {
+        snprintf(clock->phase, sizeof(clock->phase), "%s", phase);
+        clock_gettime(CLOCK_MONOTONIC, &clock->started);
+        clock->start_percent = percent;
+    }
+
+    long eta = -1;
+    if (percent > clock->start_percent && percent < 100.0) {
+        double elapsed = seconds_since(&clock->started);
+        eta = (long)(elapsed * (100.0 - percent) / (percent - clock->start_percent) + 0.5);
+    } else if (percent >= 100.0) {
+        eta = 0;
+    }
+    emit_status_record(phase, package, percent, eta, message);
+}
+
+/** Parses one APT::Status-Fd line ("type:package:percent:message") and emits a record. */
+static void handle_apt_status_line(char *line, struct phase_clock *clock) {
+    char *fields[4] = { NULL, NULL, NULL, NULL };
+    char *cursor = line;
+    for (int i = 0; i < 3; i++) {
+        fields[i] = cursor;
+        cursor = strchr(cursor, ':');
+        if (cursor == NULL) return;
+        *cursor++ = '\0';
+    }
+    fields[3] = cursor; // The message may itself contain ':'
+
+    const char *phase = phase_for_apt_status(fields[0]);
+    if (phase == NULL) return;
+
+    // dlstatus carries a file index rather than a package name in its second field.
+    const char *package = strcmp(fields[0], "dlstatus") == 0 ? "" : fields[1];
+    emit_timed_record(clock, phase, package, strtod(fields[2], NULL), fields[3]);
+}
+
+/**
+ * Parses one dpkg --status-fd line. Each package is unpacked and then
+ * configured, so the steps seen so far give the percentage.
+ */
+static void handle_dpkg_status_line(char *line, struct phase_clock *clock) {
+    char message[512];
+    if (strncmp(line, "processing: ", 12) == 0) {
+        char *action = line + 12;
+        char *package = strstr(action, ": ");
+        if (package == NULL) return;
+        *package = '\0';
+        package += 2;
+        const char *verb = NULL;
+        if (strcmp(action, "install") == 0 || strcmp(action, "upgrade") == 0) verb = "Unpacking";
+        else if (strcmp(action, "configure") == 0) verb = "Configuring";
+        else if (strcmp(action, "trigproc") == 0) verb = "Processing triggers for";
+        if (verb == NULL) return;
+        if (strcmp(action, "trigproc") != 0 && clock->dpkg_steps < 2 * clock->dpkg_packages) clock->dpkg_steps++;
+        snprintf(message, sizeof(message), "%s %s", verb, package);
+        emit_timed_record(clock, "install", package, 100.0 * clock->dpkg_steps / (2 * clock->dpkg_packages), message);
+    } else if (strncmp(line, "status: ", 8) == 0) {
+        // "status: <package> : error : <message>"; the other status lines only repeat the steps.
+        char *error = strstr(line, " : error : ");
+        if (error == NULL) return;
+        *error = '\0';
+        emit_status_record("error", line + 8, 100.0 * clock->dpkg_steps / (2 * clock->dpkg_packages), -1, error + 11);
+    }
+}
+
+/**
+ * Appends data to a line buffer and hands every complete line to the callback.
+ * Overlong lines are flushed in LINE_BUFFER_SIZE pieces.
+ */
+static void feed_lines(struct line_buffer *buf, const char *data, size_t len,
+                       void (*on_line)(char *line, size_t len, void *ctx), void *ctx) {
+    for (size_t i = 0; i < len; i++) {
+        buf->data[buf->len++] = data[i];
+        if (data[i] == '\n' || buf->len == LINE_BUFFER_SIZE - 1) {
+            buf->data[buf->len] = '\0';
+            on_line(buf->data, buf->len, ctx);
+            buf->len = 0;
+        }
+    }
+}
+
+static void relay_log_line(char *line, size_t len, void *ctx) {
+    (void)ctx;
+    fwrite(line, 1, len, stdout);
+    fflush(stdout);
+}
+
+static void relay_status_line(char *line, size_t len, void *ctx) {
+    if (len > 0 && line[len - 1] == '\n') line[len - 1] = '\0';
+    struct phase_clock *clock = ctx;
+    if (clock->dpkg_packages > 0) handle_dpkg_status_line(line, clock);
+    else handle_apt_status_line(line, clock);
+}
+
+/** Runs apt (dpkg_packages 0) or dpkg, relaying its log and turning its status lines into records. */
+static int run_with_status(char *command, char *args[], int dpkg_packages) {
+    int out_pipe[2];
+    int stat_pipe[2];
+
+    if (pipe(out_pipe) == -1) {
+        perror("pipe failed");
+        return 1;
+    }
+    if (pipe(stat_pipe) == -1) {
+        perror("pipe failed");
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        return 1;
+    }
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == -1) {
+        perror("fork failed");
+        close(out_pipe[0]);
+        close(out_pipe[1]);
+        close(stat_pipe[0]);
+        close(stat_pipe[1]);
+        return 1;
+    } else if (pid == 0) {
+        dup2(out_pipe[1], STDOUT_FILENO);
+        dup2(out_pipe[1], STDERR_FILENO);
+        // apt is told to write status to STATUS_CHILD_FD; dup2 also closes whatever was there.
+        if (stat_pipe[1] != STATUS_CHILD_FD) {
+            dup2(stat_pipe[1], STATUS_CHILD_FD);
+        }
+        int fds[] = { out_pipe[0], out_pipe[1], stat_pipe[0], stat_pipe[1] };
+        for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+            if (fds[i] > STATUS_CHILD_FD) close(fds[i]);
+        }
+        if (status_fd > STATUS_CHILD_FD) close(status_fd);
+
+        // Set DEBIAN_FRONTEND to noninteractive to prevent apt/dpkg from prompting
+        setenv("DEBIAN_FRONTEND", "noninteractive", 1);
+        execvp(command, args);
+        perror("execvp failed");
+        _exit(1);
+    }
+
+    close(out_pipe[1]);
+    close(stat_pipe[1]);
+
+    struct line_buffer log_buf = { .len = 0 };
+    struct line_buffer stat_buf = { .len = 0 };
+    struct phase_clock clock = { .phase = "", .start_percent = 0.0, .dpkg_packages = dpkg_packages };
+    char chunk[4096];
+    struct pollfd fds[2] = {
+        { .fd = out_pipe[0], .events = POLLIN },
+        { .fd = stat_pipe[0], .events = POLLIN },
+    };
+    int open_fds = 2;
+
+    while (open_fds > 0) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        for (int i = 0; i < 2; i++) {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            ssize_t n = read(fds[i].fd, chunk, sizeof(chunk));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                close(fds[i].fd);
+                fds[i].fd = -1; // poll() ignores negative descriptors
+                open_fds--;
+                continue;
+            }
+            if (i == 0) {
+                feed_lines(&log_buf, chunk, (size_t)n, relay_log_line, NULL);
+            } else {
+                feed_lines(&stat_buf, chunk, (size_t)n, relay_status_line, &clock);
+            }
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        if (fds[i].fd >= 0) close(fds[i].fd);
+    }
+    if (log_buf.len > 0) {
+        relay_log_line(log_buf.data, log_buf.len, NULL);
+    }
+
+    int status;
+    if (waitpid(pid, &status, 0) == -1) {
+        perror("waitpid failed");
+        return 1;
+    }
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    } else {
+        return 1;
+    }
+}
+
+int execute_command_with_status(char *command, char *args[]) {
+    return run_with_status(command, args, 0);
+}
+
+int execute_dpkg_with_status(char *args[], int packages) {
+    return run_with_status(args[0], args, packages > 0 ? packages : 1);
+}
@@ -0,0 +1,587 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+
+/*
+ * Risk analysis of maintainer scripts.
+ *
+ * preinst/postinst/prerm/postrm/config run as root during installation, so
+ * they are where a third-party package can do the most damage. Each script is
+ * tokenized in memory, roughly the way a POSIX shell would split it (quotes,
+ * escapes, comments, here-documents, pipelines, $(...) and `...`), and every
+ * simple command is checked once it is complete: network fetches, fetched or
+ * decoded data piped into an interpreter, writes outside /usr and /opt
+ * (graded by how sensitive the target is), kernel modules, service and
+ * account changes, setuid bits, firewall edits and the like.
+ *
+ * Findings are lines of
+ *
+ *     <danger|suspicious|info>\t<check>\t<script>\t<line>\t<source line>
+ *
+ * This is a heuristic reading, not a shell: anything computed at run time
+ * (variables, eval'd strings) is only seen as far as its literal text goes.
+ */
+
+#define SCRIPT_MAX_WORDS 48
+#define SCRIPT_WORD_SPACE 4096
+#define SCRIPT_MAX_DEPTH 8       // Nested $(...) and `...` that are followed
+#define SCRIPT_EXCERPT_MAX 160
+#define SCRIPT_HEREDOC_MAX 64
+
+enum severity { SEV_INFO, SEV_SUSPICIOUS, SEV_DANGER };
+static const char *const severity_names[] = { "info", "suspicious", "danger" };
+
+/** One simple command being collected; one per substitution level. */
+struct command {
+    char space[SCRIPT_WORD_SPACE];
+    size_t used;
+    const char *words[SCRIPT_MAX_WORDS];
+    int word_count;
+    const char *writes[SCRIPT_MAX_WORDS]; // Redirection targets
+    int write_count;
+    char word[SCRIPT_WORD_SPACE];        // The word being read
+    size_t word_len;
+    int in_word;
+    int redirect;     // 1: the next word is written to, 2: read from, 3: a here-document delimiter
+    int quote;        // '\'', '"' or 0
+    int backtick;     // This level was opened by ` rather than $( or <(
+    int parens;       // Unmatched ( inside this substitution
+    int stage_payload; // An earlier stage of the current pipeline fetches or decodes data
+    int payload;      // This command fetches or decodes data
+    unsigned line;    // Line the command started on
+};
+
+struct analysis {
+    const char *script;
+    const char *text;
+    size_t len;
+    unsigned line;
+    struct command levels[SCRIPT_MAX_DEPTH];
+    int depth;
+    int fetch_nested;  // A substitution on this line fetched something...
+    int shell_outside; // ...and an interpreter at the top level may run it
+    unsigned shell_line;
+    char heredoc[SCRIPT_HEREDOC_MAX]; // Delimiter of a pending here-document
+    int heredoc_tabs;
+    unsigned last_line;               // Last finding, to report each check once per line
+    const char *last_check;
+    char *out;
+    size_t out_len, out_cap;
+    int failed;
+};
+
+// --- findings ---
+
+static void append(struct analysis *a, const char *text, size_t len) {
+    if (a->failed) return;
+    if (a->out_len + len + 1 > a->out_cap) {
+        size_t cap = a->out_cap ? a->out_cap * 2 : 4096;
+        while (cap < a->out_len + len + 1) cap *= 2;
+        char *grown = realloc(a->out, cap);
+        if (grown == NULL) {
+            a->failed = 1;
+            return;
+        }
+        a->out = grown;
+        a->out_cap = cap;
+    }
+    memcpy(a->out + a->out_len, text, len);
+    a->out_len += len;
+    a->out[a->out_len] = '\0';
+}
+
+/** The source line, trimmed, with tabs flattened and cut to SCRIPT_EXCERPT_MAX. */
+static void excerpt(const struct analysis *a, unsigned line, char *buf) {
+    const char *p = a->text, *end = a->text + a->len;
+    for (unsigned l = 1; l < line && p < end; l++) {
+        const char *nl = memchr(p, '\n', (size_t)(end - p));
+        p = nl ? nl + 1 : end;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) p++;
+    size_t n = 0;
+    while (p < end && *p != '\n' && n < SCRIPT_EXCERPT_MAX) {
+        unsigned char c = (unsigned char)*p++;
+        buf[n++] = c == '\t' || c == '\r' || c < 0x20 ? ' ' : (char)c;
+    }
+    while (n > 0 && buf[n - 1] == ' ') n--;
+    buf[n] = '\0';
+}
+
+static void report(struct analysis *a, enum severity severity, const char *check, unsigned line) {
+    if (line == a->last_line && a->last_check != NULL && strcmp(a->last_check, check) == 0) return;
+    a->last_line = line;
+    a->last_check = check;
+    char source[SCRIPT_EXCERPT_MAX + 1], head[128];
+    excerpt(a, line, source);
+    int n = snprintf(head, sizeof(head), "%s\t%s\t%s\t%u\t", severity_names[severity], check, a->script, line);
+    append(a, head, (size_t)n);
+    append(a, source, strlen(source));
+    append(a, "\n", 1);
+}
+
+// --- command checks ---
+
+static int is_one_of(const char *word, const char *const *list) {
+    for (; *list; list++) {
+        if (strcmp(word, *list) == 0) return 1;
+    }
+    return 0;
+}
+
+static int has_arg(const struct command *cmd, int first, const char *arg) {
+    for (int i = first; i < cmd->word_count; i++) {
+        if (strcmp(cmd->words[i], arg) == 0) return 1;
+    }
+    return 0;
+}
+
+static int has_prefix(const char *s, const char *prefix) {
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+/** path is dir (given with a trailing slash) or lies below it; other prefixes must match exactly. */
+static int is_under(const char *path, const char *dir) {
+    size_t len = strlen(dir);
+    if (strncmp(path, dir, len) == 0) return 1;
+    return len > 1 && dir[len - 1] == '/' && strncmp(path, dir, len - 1) == 0 && path[len - 1] == '\0';
+}
+
+static int is_assignment(const char *word) {
+    if (!isalpha((unsigned char)*word) && *word != '_') return 0;
+    while (isalnum((unsigned char)*word) || *word == '_') word++;
+    return *word == '=';
+}
+
+/** Grades a path the script writes to; -1 if it is of no interest. */
+static int write_risk(const char *path, const char **check) {
+    static const char *const ignored[] = { "/dev/null", "/dev/stdout", "/dev/stderr", "/dev/tty", "/tmp/",
+                                           "/var/tmp/", "/run/", "/proc/self/", "/usr/", "/opt/", NULL };
+    static const char *const critical[] = { "/etc/ld.so.preload", "/etc/shadow", "/etc/gshadow", "/etc/sudoers",
+                                            "/etc/pam.d/", "/etc/security/", NULL };
+    static const char *const sensitive[] = { "/etc/passwd", "/etc/group", "/boot/", "/root/", "/home/", "/etc/cron",
+                                             "/var/spool/cron/", "/etc/systemd/", "/etc/profile", "/etc/bash.bashrc",
+                                             "/etc/environment", "/etc/rc.local", "/etc/init.d/", "/etc/modules",
+                                             "/etc/modprobe.d/", "/lib/modules/", "/etc/hosts", "/etc/resolv.conf",
+                                             "/etc/ssh/", "/etc/xdg/autostart/", "/bin/", "/sbin/", "/lib/", NULL };
+    if (path[0] == '~' || has_prefix(path, "$HOME") || has_prefix(path, "${HOME}")) {
+        *check = "sensitive-write"; // The home directory of whoever runs dpkg: root
+        return SEV_SUSPICIOUS;
+    }
+    if (path[0] != '/' || strcmp(path, "/usr") == 0 || strcmp(path, "/opt") == 0) return -1;
+    for (const char *const *p = ignored; *p; p++) {
+        if (has_prefix(path, *p)) return -1;
+    }
+    *check = "sensitive-write";
+    if (strstr(path, "/.ssh/") != NULL) return SEV_DANGER;
+    for (const char *const *p = critical; *p; p++) {
+        if (is_under(path, *p)) return SEV_DANGER;
+    }
+    for (const char *const *p = sensitive; *p; p++) {
+        if (is_under(path, *p)) return SEV_SUSPICIOUS;
+    }
+    *check = has_prefix(path, "/etc/apt/") ? "apt-source" : "write-outside-usr-opt";
+    return SEV_INFO;
+}
+
+/** removal: the path is deleted rather than written, which is graded one step lower. */
+static void check_write(struct analysis *a, const char *path, int removal, unsigned line) {
+    const char *check;
+    int severity = write_risk(path, &check);
+    if (severity < 0) return;
+    if (removal) {
+        if (severity > SEV_INFO) severity--;
+        check = strcmp(check, "sensitive-write") == 0 ? "sensitive-delete"
+              : strcmp(check, "write-outside-usr-opt") == 0 ? "delete-outside-usr-opt" : check;
+    }
+    report(a, (enum severity)severity, check, line);
+}
+
+/** A command that writes to some of its arguments: which of them. */
+static void check_write_command(struct analysis *a, const struct command *cmd, int at, const char *name) {
+    static const char *const target_last[] = { "cp", "mv", "install", "ln", "rsync", NULL };
+    static const char *const all_args[] = { "tee", "touch", "mkdir", "truncate", "shred", NULL };
+    static const char *const removals[] = { "rm", "rmdir", "unlink", NULL };
+    int operands[SCRIPT_MAX_WORDS], count = 0;
+    for (int i = at + 1; i < cmd->word_count; i++) {
+        if (cmd->words[i][0] != '-') operands[count++] = i;
+    }
+
+    if (strcmp(name, "dd") == 0) {
+        for (int i = at + 1; i < cmd->word_count; i++) {
+            if (has_prefix(cmd->words[i], "of=")) check_write(a, cmd->words[i] + 3, 0, cmd->line);
+        }
+    } else if (is_one_of(name, target_last)) {
+        if (count > 0) check_write(a, cmd->words[operands[count - 1]], 0, cmd->line);
+    } else if (is_one_of(name, all_args) || is_one_of(name, removals)) {
+        for (int i = 0; i < count; i++) check_write(a, cmd->words[operands[i]], is_one_of(name, removals), cmd->line);
+    } else if (strcmp(name, "sed") == 0 && (has_arg(cmd, at + 1, "-i") || has_arg(cmd, at + 1, "--in-place"))) {
+        for (int i = 1; i < count; i++) check_write(a, cmd->words[operands[i]], 0, cmd->line); // After the script
+    }
+}
+
+/** Sets the setuid bit (setgid is left alone: directories use it routinely). */
+static int is_setuid_mode(const char *mode) {
+    if (strcmp(mode, "u+s") == 0 || strcmp(mode, "+s") == 0 || strcmp(mode, "a+s") == 0) return 1;
+    return strlen(mode) == 4 && strspn(mode, "01234567") == 4 && (mode[0] - '0') & 4;
+}
+
+static void check_command(struct analysis *a, struct command *cmd) {
+    static const char *const wrappers[] = { "sudo", "env", "nohup", "exec", "command", "builtin", "time", "nice",
+                                            "ionice", "stdbuf", "timeout", "if", "then", "else", "elif", "do",
+                                            "while", "until", "!", "{", NULL };
+    static const char *const fetchers[] = { "curl", "wget", "aria2c", "axel", "fetch", NULL };
+    static const char *const interpreters[] = { "sh", "bash", "dash", "zsh", "ksh", "python", "python2", "python3",
+                                                "perl", "ruby", "php", "node", "eval", "source", ".", NULL };
+    static const char *const kernel_tools[] = { "modprobe", "insmod", "rmmod", NULL };
+    static const char *const account_tools[] = { "useradd", "adduser", "usermod", "groupadd", "addgroup",
+                                                  "chpasswd", "passwd", "gpasswd", NULL };
+    static const char *const privileged_groups[] = { "sudo", "wheel", "root", "adm", "admin", "docker", NULL };
+    static const char *const firewall_tools[] = { "iptables", "ip6tables", "nft", "ufw", "firewall-cmd", NULL };
+    static const char *const network_tools[] = { "nc", "ncat", "netcat", "socat", "telnet", NULL };
+    static const char *const service_actions[] = { "enable", "disable", "mask", "unmask", "start", "stop",
+                                                   "restart", NULL };
+
+    for (int i = 0; i < cmd->write_count; i++) check_write(a, cmd->writes[i], 0, cmd->line);
+
+    int at = 0;
+    while (at < cmd->word_count && (is_assignment(cmd->words[at]) || is_one_of(cmd->words[at], wrappers)
+                                    || (at > 0 && cmd->words[at][0] == '-'))) {
+        at++;
+    }
+    if (at >= cmd->word_count) return;
+    const char *name = strrchr(cmd->words[at], '/') ? strrchr(cmd->words[at], '/') + 1 : cmd->words[at];
+    const char *sub = at + 1 < cmd->word_count ? cmd->words[at + 1] : "";
+
+    int fetch = is_one_of(name, fetchers) || (strcmp(name, "git") == 0 && strcmp(sub, "clone") == 0)
+                || ((strcmp(name, "pip") == 0 || strcmp(name, "pip3") == 0 || strcmp(name, "npm") == 0)
+                    && strcmp(sub, "install") == 0);
+    int decode = (strcmp(name, "base64") == 0 && (has_arg(cmd, at + 1, "-d") || has_arg(cmd, at + 1, "--decode")))
+                 || (strcmp(name, "xxd") == 0 && has_arg(cmd, at + 1, "-r"));
+    if (fetch) {
+        report(a, SEV_SUSPICIOUS, "network-fetch", cmd->line);
+        if (a->depth > 0) a->fetch_nested = 1;
+    }
+    if (decode) report(a, SEV_SUSPICIOUS, "encoded-payload", cmd->line);
+    cmd->payload = fetch || decode;
+
+    if (is_one_of(name, interpreters)) {
+        if (cmd->stage_payload) report(a, SEV_DANGER, "pipe-to-shell", cmd->line);
+        if (a->depth == 0 && !a->shell_outside) {
+            a->shell_outside = 1;
+            a->shell_line = cmd->line;
+        }
+    } else if (is_one_of(name, kernel_tools)) {
+        report(a, SEV_SUSPICIOUS, "kernel-module", cmd->line);
+    } else if (strcmp(name, "systemctl") == 0) {
+        int i = at + 1;
+        while (i < cmd->word_count && cmd->words[i][0] == '-') i++;
+        if (i < cmd->word_count && is_one_of(cmd->words[i], service_actions)) report(a, SEV_INFO, "service-change", cmd->line);
+    } else if (strcmp(name, "crontab") == 0 && !has_arg(cmd, at + 1, "-l")) {
+        report(a, SEV_SUSPICIOUS, "cron-change", cmd->line);
+    } else if (is_one_of(name, account_tools)) {
+        int privileged = 0;
+        for (int i = at + 1; i < cmd->word_count; i++) {
+            // "usermod -aG sudo user", "adduser user sudo", "-G wheel,docker"
+            char groups[256], *saved;
+            snprintf(groups, sizeof(groups), "%s", cmd->words[i]);
+            for (char *g = strtok_r(groups, ",", &saved); g; g = strtok_r(NULL, ",", &saved)) {
+                privileged |= is_one_of(g, privileged_groups);
+            }
+        }
+        report(a, privileged ? SEV_SUSPICIOUS : SEV_INFO, privileged ? "privileged-group" : "account-change", cmd->line);
+    } else if (strcmp(name, "chmod") == 0) {
+        for (int i = at + 1; i < cmd->word_count; i++) {
+            if (is_setuid_mode(cmd->words[i])) report(a, SEV_SUSPICIOUS, "setuid", cmd->line);
+        }
+    } else if (is_one_of(name, firewall_tools)) {
+        report(a, SEV_SUSPICIOUS, "firewall-change", cmd->line);
+    } else if (is_one_of(name, network_tools)) {
+        report(a, SEV_SUSPICIOUS, "network-tool", cmd->line);
+    } else if (strcmp(name, "setenforce") == 0 || strcmp(name, "aa-disable") == 0 || strcmp(name, "aa-complain") == 0) {
+        report(a, SEV_SUSPICIOUS, "security-disable", cmd->line);
+    } else if (strcmp(name, "apt-key") == 0 || strcmp(name, "add-apt-repository") == 0) {
+        report(a, SEV_INFO, "apt-source", cmd->line);
+    }
+    if (strcmp(name, "rm") == 0 && (has_arg(cmd, at + 1, "-rf") || has_arg(cmd, at + 1, "-fr") || has_arg(cmd, at + 1, "-r"))) {
+        for (int i = at + 1; i < cmd->word_count; i++) {
+            const char *path = cmd->words[i];
+            // "/", "/*", "/etc": whole top-level trees
+            if (path[0] == '/' && strchr(path + 1, '/') == NULL) report(a, SEV_DANGER, "destructive-delete", cmd->line);
+        }
+    }
+    check_write_command(a, cmd, at, name);
+}
+
+// --- tokenizer ---
+
+static void reset_command(struct command *cmd, unsigned line) {
+    cmd->used = 0;
+    cmd->word_count = cmd->write_count = 0;
+    cmd->word_len = 0;
+    cmd->in_word = 0;
+    cmd->redirect = 0;
+    cmd->payload = 0;
+    cmd->line = line;
+}
+
+static void finish_word(struct analysis *a, struct command *cmd) {
+    if (!cmd->in_word) return;
+    cmd->in_word = 0;
+    size_t len = cmd->word_len;
+    cmd->word_len = 0;
+    if (cmd->used + len + 1 > sizeof(cmd->space)) return; // Absurdly long command: the rest goes unchecked
+    char *word = cmd->space + cmd->used;
+    memcpy(word, cmd->word, len);
+    word[len] = '\0';
+    cmd->used += len + 1;
+
+    int redirect = cmd->redirect;
+    cmd->redirect = 0;
+    if (redirect == 1) {
+        if (cmd->write_count < SCRIPT_MAX_WORDS) cmd->writes[cmd->write_count++] = word;
+    } else if (redirect == 3) {
+        snprintf(a->heredoc, sizeof(a->heredoc), "%s", word);
+    } else if (redirect == 0 && cmd->word_count < SCRIPT_MAX_WORDS) {
+        cmd->words[cmd->word_count++] = word;
+    }
+}
+
+static void add_char(struct command *cmd, char c) {
+    cmd->in_word = 1;
+    if (cmd->word_len + 1 < sizeof(cmd->word)) cmd->word[cmd->word_len++] = c;
+}
+
+/** Ends the current simple command; pipe says whether a | follows it. */
+static void end_command(struct analysis *a, int pipe) {
+    struct command *cmd = &a->levels[a->depth];
+    finish_word(a, cmd);
+    if (cmd->word_count > 0 || cmd->write_count > 0) check_command(a, cmd);
+    cmd->stage_payload = pipe && (cmd->stage_payload || cmd->payload);
+    reset_command(cmd, a->line);
+}
+
+static void end_line(struct analysis *a) {
+    if (a->fetch_nested && a->shell_outside) report(a, SEV_DANGER, "pipe-to-shell", a->shell_line);
+    a->fetch_nested = a->shell_outside = 0;
+}
+
+static void open_substitution(struct analysis *a, int backtick) {
+    if (a->depth + 1 >= SCRIPT_MAX_DEPTH) return;
+    struct command *inner = &a->levels[++a->depth];
+    reset_command(inner, a->line);
+    inner->quote = 0;
+    inner->backtick = backtick;
+    inner->parens = 0;
+    inner->stage_payload = 0;
+}
+
+static void close_substitution(struct analysis *a) {
+    end_command(a, 0);
+    a->depth--;
+    a->levels[a->depth].in_word = 1; // The substitution's output is part of the enclosing word
+}
+
+/** Skips the body of a pending here-document, which starts after pos. Returns the new position. */
+static size_t skip_heredoc(struct analysis *a, size_t pos) {
+    size_t delim_len = strlen(a->heredoc);
+    while (pos < a->len) {
+        const char *line = a->text + pos;
+        const char *nl = memchr(line, '\n', a->len - pos);
+        size_t line_len = nl ? (size_t)(nl - line) : a->len - pos;
+        pos += line_len + (nl != NULL);
+        a->line++;
+        const char *body = line;
+        if (a->heredoc_tabs) {
+            while (body < line + line_len && *body == '\t') body++;
+        }
+        if ((size_t)(line + line_len - body) == delim_len && memcmp(body, a->heredoc, delim_len) == 0) break;
+    }
+    a->heredoc[0] = '\0';
+    return pos;
+}
+
+static void analyze(struct analysis *a) {
+    a->line = 1;
+    a->depth = 0;
+    reset_command(&a->levels[0], 1);
+    a->levels[0].quote = 0;
+    a->levels[0].stage_payload = 0;
+
+    for (size_t i = 0; i < a->len; i++) {
+        struct command *cmd = &a->levels[a->depth];
+        char c = a->text[i];
+        char next = i + 1 < a->len ? a->text[i + 1] : '\0';
+
+        if (cmd->quote == '\'') {
+            if (c == '\'') cmd->quote = 0;
+            else add_char(cmd, c);
+            if (c == '\n') a->line++;
+            continue;
+        }
+        if (c == '\\') {
+            if (next == '\n') a->line++;
+            else if (next != '\0') add_char(cmd, next);
+            i++;
+            continue;
+        }
+        if (c == '$' && next == '(' && !(i + 2 < a->len && a->text[i + 2] == '(')) {
+            open_substitution(a, 0);
+            i++;
+            continue;
+        }
+        if (c == '`') {
+            if (cmd->backtick && a->depth > 0) close_substitution(a);
+            else open_substitution(a, 1);
+            continue;
+        }
+        if (cmd->quote == '"') {
+            if (c == '"') cmd->quote = 0;
+            else add_char(cmd, c);
+            if (c == '\n') a->line++;
+            continue;
+        }
+
+        switch (c) {
+        case '\'':
+        case '"':
+            cmd->quote = c;
+            cmd->in_word = 1;
+            break;
+        case '#':
+            if (cmd->in_word) {
+                add_char(cmd, c);
+                break;
+            }
+            while (i + 1 < a->len && a->text[i + 1] != '\n') i++;
+            break;
+        case '\n':
+            end_command(a, 0);
+            if (a->depth == 0) {
+                end_line(a);
+                a->levels[0].stage_payload = 0;
+            }
+            a->line++;
+            a->levels[a->depth].line = a->line;
+            if (a->heredoc[0] != '\0') {
+                i = skip_heredoc(a, i + 1) - 1;
+                a->levels[a->depth].line = a->line;
+            }
+            break;
+        case ';':
+        case '&':
+            if (c == '&' && next == '>') { // &> file
+                finish_word(a, cmd);
+                cmd->redirect = 1;
+                i++;
+                break;
+            }
+            end_command(a, 0);
+            a->levels[a->depth].stage_payload = 0;
+            if (next == c) i++;
+            break;
+        case '|':
+            if (next == '|') {
+                end_command(a, 0);
+                a->levels[a->depth].stage_payload = 0;
+                i++;
+            } else {
+                end_command(a, 1);
+            }
+            break;
+        case '(':
+            if (cmd->in_word && cmd->word_len > 0 && cmd->word[cmd->word_len - 1] == '<') {
+                cmd->word_len--; // <(...) process substitution, read like $(...)
+                open_substitution(a, 0);
+                break;
+            }
+            end_command(a, 0);
+            if (a->depth > 0) a->levels[a->depth].parens++;
+            break;
+        case ')':
+            if (a->depth > 0 && !cmd->backtick && cmd->parens == 0) {
+                close_substitution(a);
+            } else {
+                end_command(a, 0);
+                if (cmd->parens > 0) cmd->parens--;
+            }
+            break;
+        case '>':
+            finish_word(a, cmd);
+            if (next == '&') { // >&2: duplicates a descriptor
+                i++;
+                while (i + 1 < a->len && isdigit((unsigned char)a->text[i + 1])) i++;
+                break;
+            }
+            if (next == '>' || next == '|') i++;
+            cmd->redirect = 1;
+            break;
+        case '<':
+            if (next == '(') { // <(...)
+                finish_word(a, cmd);
+                open_substitution(a, 0);
+                i++;
+                break;
+            }
+            finish_word(a, cmd);
+            if (next == '<' && i + 2 < a->len && a->text[i + 2] != '<') {
+                i++;
+                a->heredoc_tabs = i + 1 < a->len && a->text[i + 1] == '-';
+                if (a->heredoc_tabs) i++;
+                cmd->redirect = 3;
+            } else {
+                if (next == '<') i += 2; // <<< here-string
+                cmd->redirect = 2;
+            }
+            break;
+        case ' ':
+        case '\t':
+        case '\r':
+            finish_word(a, cmd);
+            // Digits before a redirection are a descriptor number, not a word: "2>/dev/null".
+            break;
+        default:
+            if (isdigit((unsigned char)c) && !cmd->in_word && (next == '>' || next == '<')) break;
+            add_char(cmd, c);
+            break;
+        }
+    }
+    while (a->depth > 0) close_substitution(a);
+    end_command(a, 0);
+    end_line(a);
+}
+
+static int looks_binary(const char *text, size_t len) {
+    return (len >= 4 && memcmp(text, "\x7f" "ELF", 4) == 0) || memchr(text, '\0', len) != NULL;
+}
+
+char *script_risk_report(const struct deb_scripts *scripts, size_t *len) {
+    struct analysis *a = calloc(1, sizeof(*a));
+    if (a == NULL) return NULL;
+    append(a, "", 0); // An empty report is still a string
+    for (int i = 0; i < DEB_SCRIPT_COUNT; i++) {
+        if (scripts->text[i] == NULL) continue;
+        a->script = deb_script_names[i];
+        a->text = scripts->text[i];
+        a->len = scripts->len[i];
+        a->last_check = NULL;
+        a->heredoc[0] = '\0';
+        a->fetch_nested = a->shell_outside = 0;
+        if (looks_binary(a->text, a->len)) {
+            // A compiled maintainer script cannot be read at all, which is a finding in itself.
+            char head[128];
+            int n = snprintf(head, sizeof(head), "suspicious\tbinary-script\t%s\t0\t(not a text script)\n", a->script);
+            append(a, head, (size_t)n);
+            continue;
+        }
+        analyze(a);
+    }
+    char *out = a->failed ? NULL : a->out;
+    if (out == NULL) free(a->out);
+    else if (len) *len = a->out_len;
+    free(a);
+    return out;
+}
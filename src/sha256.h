@@ -0,0 +1,30 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+#define SHA256_BLOCK_SIZE 64
+#define SHA256_HEX_SIZE (2 * SHA256_DIGEST_SIZE + 1)
+
+/** Incremental SHA-256. The block function is picked once per process from what the CPU supports. */
+struct sha256_ctx {
+    uint32_t state[8];
+    uint64_t length; // Bytes hashed so far
+    unsigned char block[SHA256_BLOCK_SIZE];
+    size_t block_len;
+};
+
+void sha256_init(struct sha256_ctx *ctx);
+void sha256_update(struct sha256_ctx *ctx, const void *data, size_t len);
+void sha256_final(struct sha256_ctx *ctx, unsigned char digest[SHA256_DIGEST_SIZE]);
+void sha256_hex(const unsigned char digest[SHA256_DIGEST_SIZE], char hex[SHA256_HEX_SIZE]);
+
+/** Hashes one file with large aligned reads, emitting "hash" status records if progress is set. */
+int sha256_file(const char *path, int progress, char hex[SHA256_HEX_SIZE]);
+
+/** Name of the block function in use: "sha-ni" or "portable". */
+const char *sha256_implementation(void);
+
+#endif // SHA256_H
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+#include "nano_backend.h"
+#include "deb_archive.h"
+#include "apt_lists.h"
+#include "dpkg_status.h"
+
+/*
+ * What `apt upgrade` would do, worked out without apt.
+ *
+ * Every installed package is looked up in the apt lists index (see
+ * apt_lists.c) and its candidate is the newest version there for the same
+ * architecture (or "all"), as apt picks it when no pins are set; suites marked
+ * NotAutomatic, such as backports, are left out as apt leaves them out.
+ * Packages on hold are reported separately. The resolver is not modelled, so
+ * an upgrade that needs new packages, which `apt upgrade` keeps back, is still
+ * listed.
+ */
+
+#define APT_ARCHIVES_DIR "/var/cache/apt/archives"
+
+struct candidate {
+    char *stanza; // The chosen stanza; the fields below point into it
+    const char *version, *size, *installed_size;
+    size_t version_len, size_len, installed_size_len;
+};
+
+static int architecture_matches(const char *installed, const char *offered, size_t offered_len) {
+    if (offered_len == 3 && strncmp(offered, "all", 3) == 0) return 1; // A package may move to or from "all"
+    if (strcmp(installed, "all") == 0) return 1;
+    return strlen(installed) == offered_len && strncmp(installed, offered, offered_len) == 0;
+}
+
+/** The newest version of the package the lists offer for its architecture; 0 if there is none. */
+static int find_candidate(const struct apt_lists *lists, const struct dpkg_package *pkg, struct candidate *best) {
+    memset(best, 0, sizeof(*best));
+    long first = apt_lists_find(lists, pkg->name);
+    if (first < 0) return 0;
+    char best_version[256] = "";
+    uint32_t name = lists->stanzas[first].package;
+    for (uint32_t i = (uint32_t)first; i < lists->header->stanza_count && lists->stanzas[i].package == name; i++) {
+        const struct apt_lists_stanza *s = &lists->stanzas[i];
+        if (lists->files[s->file].flags & APT_LISTS_NOT_AUTOMATIC) continue;
+        char *stanza = apt_lists_read_stanza(lists, s);
+        if (stanza == NULL) continue;
+
+        size_t arch_len = 0, version_len = 0;
+        const char *arch = control_find_field(stanza, "Architecture", &arch_len);
+        const char *version = control_find_field(stanza, "Version", &version_len);
+        char text[256];
+        if (arch == NULL || version == NULL || version_len >= sizeof(text) || !architecture_matches(pkg->architecture, arch, arch_len)) {
+            free(stanza);
+            continue;
+        }
+        snprintf(text, sizeof(text), "%.*s", (int)version_len, version);
+        if (best->stanza != NULL && deb_version_compare(text, best_version) <= 0) {
+            free(stanza);
+            continue;
+        }
+        free(best->stanza);
+        best->stanza = stanza;
+        best->version = version;
+        best->version_len = version_len;
+        memcpy(best_version, text, version_len + 1);
+    }
+    if (best->stanza == NULL) return 0;
+    best->size = control_find_field(best->stanza, "Size", &best->size_len);
+    best->installed_size = control_find_field(best->stanza, "Installed-Size", &best->installed_size_len);
+    return 1;
+}
+
+/** Whether apt has the .deb downloaded already, at the expected size, so it need not be fetched again. */
+static int is_downloaded(const char *name, const char *version, const char *arch, uint64_t size) {
+    char path[PATH_MAX];
+    int len = snprintf(path, sizeof(path), APT_ARCHIVES_DIR "/%s_", name);
+    for (const char *p = version; *p && len < (int)sizeof(path) - 4; p++) {
+        if (*p == ':') len += snprintf(path + len, sizeof(path) - (size_t)len, "%%3a"); // apt's escaping of epochs
+        else path[len++] = *p;
+    }
+    if (len >= (int)sizeof(path) - 4 || snprintf(path + len, sizeof(path) - (size_t)len, "_%s.deb", arch) < 0) return 0;
+    struct stat st;
+    return stat(path, &st) == 0 && (uint64_t)st.st_size == size;
+}
+
+/**
+ * `upgrade-plan`: prints a line per package `apt upgrade` would upgrade,
+ * "upgrade\t<package>\t<arch>\t<installed version>\t<new version>\t<download bytes>\t<installed KiB change>",
+ * one per package on hold that has an update, "held\t<package>\t<arch>\t<installed version>\t<new version>",
+ * and finally "summary\t<upgrades>\t<download bytes>\t<installed KiB change>\t<held>".
+ * Download sizes leave out packages apt has downloaded already.
+ */
+int handle_upgrade_plan(int argc, char *argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, ERROR_PREFIX "Usage: %s upgrade-plan\n", argv[0]);
+        return 1;
+    }
+
+    struct dpkg_status_db status;
+    if (dpkg_status_load(&status, DPKG_STATUS_PATH) != 0) return 1;
+    struct apt_lists lists;
+    if (apt_lists_open(&lists) != 0) {
+        dpkg_status_free(&status);
+        return 1;
+    }
+
+    unsigned long upgrades = 0, held = 0;
+    unsigned long long download = 0;
+    long long size_change = 0;
+    for (size_t i = 0; i < status.package_count; i++) {
+        const struct dpkg_package *pkg = &status.packages[i];
+        struct candidate c;
+        if (!pkg->installed || !find_candidate(&lists, pkg, &c)) continue;
+
+        char version[256];
+        snprintf(version, sizeof(version), "%.*s", (int)c.version_len, c.version);
+        if (deb_version_compare(version, pkg->version) > 0) {
+            const char *arch = pkg->architecture[0] ? pkg->architecture : "all";
+            if (strncmp(pkg->status, "hold ", 5) == 0) {
+                printf("held\t%s\t%s\t%s\t%s\n", pkg->name, arch, pkg->version, version);
+                held++;
+            } else {
+                unsigned long long size = c.size ? strtoull(c.size, NULL, 10) : 0;
+                // The file is named after the candidate's own Architecture, which may be "all".
+                size_t arch_len = 0;
+                const char *new_arch = control_find_field(c.stanza, "Architecture", &arch_len);
+                char file_arch[64];
+                snprintf(file_arch, sizeof(file_arch), "%.*s", (int)arch_len, new_arch ? new_arch : arch);
+                if (is_downloaded(pkg->name, version, file_arch, size)) size = 0;
+                long long change = (c.installed_size ? strtoll(c.installed_size, NULL, 10) : 0)
+                    - strtoll(pkg->installed_size, NULL, 10);
+                printf("upgrade\t%s\t%s\t%s\t%s\t%llu\t%lld\n", pkg->name, arch, pkg->version, version, size, change);
+                upgrades++;
+                download += size;
+                size_change += change;
+            }
+        }
+        free(c.stanza);
+    }
+    printf("summary\t%lu\t%llu\t%lld\t%lu\n", upgrades, download, size_change, held);
+
+    apt_lists_close(&lists);
+    dpkg_status_free(&status);
+    return fflush(stdout) == 0 ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+"""
+Regression check for deb-extract: entries and hard-link targets must never
+land outside the destination, whatever their spelling ("//abs", ".//abs",
+"..") and whatever symlinks the destination already holds.
+
+Usage: deb_extract_paths.py <path to nano_backend>
+"""
+import io
+import os
+import subprocess
+import sys
+import tarfile
+import tempfile
+
+
+def build_deb(path, entries):
+    """Writes a minimal .deb whose data.tar holds entries: (name, type, link or data)."""
+    def tar_bytes(members):
+        buf = io.BytesIO()
+        with tarfile.open(fileobj=buf, mode="w:gz", format=tarfile.GNU_FORMAT) as tar:
+            for name, kind, extra in members:
+                info = tarfile.TarInfo(name)
+                info.type = kind
+                if kind == tarfile.REGTYPE:
+                    info.size = len(extra)
+                    tar.addfile(info, io.BytesIO(extra))
+                else:
+                    if kind in (tarfile.LNKTYPE, tarfile.SYMTYPE):
+                        info.linkname = extra
+                    if kind == tarfile.DIRTYPE:
+                        info.mode = 0o755
+                    tar.addfile(info)
+        return buf.getvalue()
+
+    control = b"Package: path-test\nVersion: 1\nArchitecture: all\nMaintainer: x <x@x>\nDescription: t\n"
+    members = [("debian-binary", b"2.0\n"),
+               ("control.tar.gz", tar_bytes([("./control", tarfile.REGTYPE, control)])),
+               ("data.tar.gz", tar_bytes(entries))]
+    with open(path, "wb") as deb:
+        deb.write(b"!<arch>\n")
+        for name, data in members:
+            deb.write(f"{name:<16}{0:<12}{0:<6}{0:<6}{'100644':<8}{len(data):<10}`\n".encode())
+            deb.write(data + (b"\n" if len(data) % 2 else b""))
+
+
+def extract(backend, deb, dest):
+    return subprocess.run([backend, "deb-extract", deb, dest], capture_output=True, text=True).returncode
+
+
+def main():
+    backend = os.path.abspath(sys.argv[1])
+    failures = []
+    with tempfile.TemporaryDirectory() as tmp:
+        outside = os.path.join(tmp, "outside")
+        os.mkdir(outside)
+        secret = os.path.join(outside, "secret")
+        with open(secret, "w") as f:
+            f.write("secret\n")
+
+        def case(title, entries, expect_ok, setup=None):
+            dest = tempfile.mkdtemp(dir=tmp)
+            if setup:
+                setup(dest)
+            deb = os.path.join(tmp, "case.deb")
+            build_deb(deb, entries)
+            rc = extract(backend, deb, dest)
+            escaped = sorted(set(os.listdir(outside)) - {"secret"})
+            if (rc == 0) != expect_ok or escaped or os.stat(secret).st_nlink != 1:
+                failures.append(f"{title}: exit {rc}, written outside: {escaped}, secret links: {os.stat(secret).st_nlink}")
+            return dest
+
+        dest = case("leading //", [("//" + outside.lstrip("/") + "/a", tarfile.REGTYPE, b"a")], True)
+        if not os.path.isfile(os.path.join(dest, outside.lstrip("/"), "a")):
+            failures.append("leading //: not extracted inside the destination")
+        case("leading .//", [(".//" + outside.lstrip("/") + "/b", tarfile.REGTYPE, b"b")], True)
+        case("dot-dot", [("./x/../../outside/c", tarfile.REGTYPE, b"c")], False)
+        case("absolute hard link target", [("./d", tarfile.LNKTYPE, "/" + secret)], False)
+        case("hard link through a symlink the package made",
+             [("./up", tarfile.SYMTYPE, outside), ("./e", tarfile.LNKTYPE, "./up/secret")], False)
+        case("file below a symlink the package made",
+             [("./up", tarfile.SYMTYPE, outside), ("./up/f", tarfile.REGTYPE, b"f")], False)
+        case("file below a symlink already in the destination", [("./usr/g", tarfile.REGTYPE, b"g")], False,
+             setup=lambda dest: os.symlink(outside, os.path.join(dest, "usr")))
+        case("hard link through a symlink already in the destination", [("./h", tarfile.LNKTYPE, "./usr/secret")],
+             False, setup=lambda dest: os.symlink(outside, os.path.join(dest, "usr")))
+
+    for failure in failures:
+        print(f"FAIL {failure}")
+    print(f"deb-extract paths: {'ok' if not failures else f'{len(failures)} failed'}")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
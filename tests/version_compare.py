@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+"""
+Checks version-compare against `dpkg --compare-versions`: every pair of a
+set of edge cases (epochs, '~', missing and zero revisions, leading zeros,
+letters against other characters) and neighbouring pairs of the versions
+installed on this system. Skipped where dpkg is not available.
+
+Usage: version_compare.py <path to nano_backend>
+"""
+import shutil
+import subprocess
+import sys
+
+EDGE_CASES = [
+    "0", "0:0", "1", "01", "001.0", "1.0", "1.00", "1.0.0", "1.0-0", "1.0-1", "1.0-01", "1.0-1.1", "0:1.0", "1:0.9",
+    "2:0", "1:1.0~rc1-1", "1.0~rc1", "1.0~", "1.0~~", "1.0~~a", "1.0~a", "1.0a", "1.0+", "1.0.", "1.0+dfsg-1",
+    "1.0-1ubuntu1", "1.0-1+b2", "1.0-1~bpo1", "1a", "1+b1", "1~b1", "9", "10", "1.2.3.4", "1.0-a", "1.0-a~",
+]
+
+
+def dpkg_order(a, b):
+    """-1, 0 or 1, as dpkg sees it."""
+    if subprocess.run(["dpkg", "--compare-versions", a, "lt", b]).returncode == 0:
+        return -1
+    return 0 if subprocess.run(["dpkg", "--compare-versions", a, "eq", b]).returncode == 0 else 1
+
+
+def main():
+    if shutil.which("dpkg") is None:
+        print("version-compare: skipped, dpkg is not available")
+        return 0
+    backend = sys.argv[1]
+
+    installed = subprocess.run(["dpkg-query", "-W", "-f", "${Version}\n"], capture_output=True, text=True).stdout
+    versions = sorted(set(installed.split()))
+    pairs = [(a, b) for a in EDGE_CASES for b in EDGE_CASES]
+    pairs += list(zip(versions, versions[1:])) + [(b, a) for a, b in zip(versions, versions[1:])]
+
+    # Each pair is asked all three ways; exactly the one matching dpkg's order must be true.
+    ops = ("lt", "eq", "gt")
+    triples = "".join(f"{a} {op} {b}\n" for a, b in pairs for op in ops)
+    answers = subprocess.run([backend, "version-compare", "-"], input=triples, capture_output=True, text=True,
+                             check=True).stdout.split()
+    failures = 0
+    for i, (a, b) in enumerate(pairs):
+        got = answers[3 * i:3 * i + 3]
+        expected = ["true" if op == ("lt", "eq", "gt")[dpkg_order(a, b) + 1] else "false" for op in ops]
+        if got != expected:
+            failures += 1
+            print(f"FAIL {a} vs {b}: dpkg says {expected}, version-compare says {got}")
+
+    print(f"version-compare: {len(pairs)} pairs, {'ok' if failures == 0 else f'{failures} failed'}")
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())